@@ -357,6 +357,7 @@ cmicr_pdma_tx_desc_init(struct pdma_hw *hw, struct pdma_tx_queue *txq)
     txq->curr = 0;
     txq->dirt = 0;
     txq->halt = 0;
+    txq->kick_pend = 0;
 
     txq->halt_addr = txq->ring_addr;
     hw->hdls.chan_goto(hw, txq->chan_id, txq->halt_addr);
@@ -387,6 +388,7 @@ cmicr_pdma_tx_desc_clean(struct pdma_hw *hw, struct pdma_tx_queue *txq)
     txq->curr = 0;
     txq->dirt = 0;
     txq->halt = 0;
+    txq->kick_pend = 0;
 
     return SHR_E_NONE;
 }
@@ -911,6 +913,32 @@ cmicr_pdma_tx_ring_check(struct pdma_hw *hw, struct pdma_tx_queue *txq)
     return SHR_E_NONE;
 }
 
+/*!
+ * Check if the DMA kick can be left to a following packet
+ *
+ * Must be called before the new descriptor is accounted in txq->curr.
+ * The kick is only deferred if the ring still has room for the packet
+ * that is expected to do it.
+ */
+static inline int
+cmicr_pdma_tx_kick_defer(struct pdma_hw *hw, struct pdma_tx_queue *txq,
+                          struct pkt_hdr *pkh)
+{
+    struct pdma_dev *dev = hw->dev;
+
+    if (!pkh || !(pkh->attrs & PDMA_TX_XMIT_MORE)) {
+        return 0;
+    }
+
+    /* Never hold back a kick the Tx resource check might stall on */
+    if (dev->flags & PDMA_CHAIN_MODE || dev->suspended ||
+        txq->state & PDMA_TX_QUEUE_POLL || cmicr_pdma_tx_ring_unused(txq) <= 1) {
+        return 0;
+    }
+
+    return ++txq->kick_pend < NUM_TX_KICK_DEFER;
+}
+
 /*!
  * \brief Start packet transmission
  *
@@ -932,6 +960,7 @@ cmicr_pdma_pkt_xmit(struct pdma_hw *hw, struct pdma_tx_queue *txq, void *buf)
     dma_addr_t addr;
     uint32_t curr;
     int retry = 5000000;
+    int defer;
     int rv;
 
     if (dev->tx_suspend) {
@@ -993,6 +1022,9 @@ cmicr_pdma_pkt_xmit(struct pdma_hw *hw, struct pdma_tx_queue *txq, void *buf)
         }
     }
 
+    /* Decide on the DMA kick against the ring state before this packet */
+    defer = cmicr_pdma_tx_kick_defer(hw, txq, pkh);
+
     /* Update the indicators */
     curr = (curr + 1) % txq->nb_desc;
     txq->curr = curr;
@@ -1023,9 +1055,13 @@ cmicr_pdma_pkt_xmit(struct pdma_hw *hw, struct pdma_tx_queue *txq, void *buf)
         sal_spinlock_unlock(txq->lock);
     }
 
-    /* Kick off DMA */
+    /* Kick off DMA unless more packets follow */
     txq->halt_addr = txq->ring_addr + sizeof(TX_DCB_t) * curr;
-    hw->hdls.chan_goto(hw, txq->chan_id, txq->halt_addr);
+    if (!defer) {
+        hw->hdls.chan_goto(hw, txq->chan_id, txq->halt_addr);
+        txq->kick_pend = 0;
+        txq->stats.kicks++;
+    }
 
     /* Count the packets/bytes */
     txq->stats.packets++;
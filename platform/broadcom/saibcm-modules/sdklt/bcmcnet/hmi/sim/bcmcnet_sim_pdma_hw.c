@@ -0,0 +1,648 @@
+/*! \file bcmcnet_sim_pdma_hw.c
+ *
+ * Utility routines for simulated PDMA HW.
+ *
+ * The CMICx descriptor operations drive the rings as usual. Channel
+ * handlers below emulate the DMA engine: Tx descriptors are completed as
+ * soon as the halt point moves beyond them, and Rx descriptors are filled
+ * when frames are injected.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <bcmcnet/bcmcnet_core.h>
+#include <bcmcnet/bcmcnet_dev.h>
+#include <bcmcnet/bcmcnet_rxtx.h>
+#include <bcmcnet/bcmcnet_sim.h>
+
+/*! Get SIM HW structure */
+#define SIM_HW(hw)  ((struct sim_pdma_hw *)(hw))
+
+/*! Get descriptor bus address */
+#define SIM_DESC_ADDR(d) \
+    ((uint64_t)BUS_TO_DMA_HI((d)->addr_hi) << 32 | (d)->addr_lo)
+
+/*!
+ * Get descriptor ring of a channel
+ */
+static inline struct cmicx_rx_desc *
+sim_pdma_chan_ring(struct pdma_hw *hw, int chan, uint64_t *ring_addr,
+                   uint32_t *nb_desc, int *rx)
+{
+    struct queue_group *grp = &hw->dev->ctrl.grp[chan / SIM_PDMA_CMC_CHAN];
+    struct pdma_rx_queue *rxq = NULL;
+    struct pdma_tx_queue *txq = NULL;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    if (1 << que & grp->bm_rxq) {
+        rxq = (struct pdma_rx_queue *)grp->rx_queue[que];
+        if (!rxq || !rxq->ring) {
+            return NULL;
+        }
+        *ring_addr = rxq->ring_addr;
+        *nb_desc = rxq->nb_desc;
+        *rx = 1;
+        return (struct cmicx_rx_desc *)rxq->ring;
+    }
+
+    if (1 << que & grp->bm_txq) {
+        txq = (struct pdma_tx_queue *)grp->tx_queue[que];
+        if (!txq || !txq->ring) {
+            return NULL;
+        }
+        *ring_addr = txq->ring_addr;
+        *nb_desc = txq->nb_desc;
+        *rx = 0;
+        /* Rx and Tx descriptors share the same layout */
+        return (struct cmicx_rx_desc *)txq->ring;
+    }
+
+    return NULL;
+}
+
+/*!
+ * Convert descriptor address to index
+ */
+static inline uint32_t
+sim_pdma_desc_index(uint64_t ring_addr, uint32_t nb_desc, uint64_t addr)
+{
+    uint32_t di = (uint32_t)((addr - ring_addr) / SIM_PDMA_DCB_SIZE);
+
+    /* The reload descriptor is right after the last one */
+    return di > nb_desc ? 0 : di;
+}
+
+/*!
+ * Check if the engine can go on with the current descriptor
+ */
+static inline int
+sim_pdma_chan_ready(struct pdma_hw *hw, struct sim_pdma_chan *sc)
+{
+    if (!sc->enabled) {
+        return 0;
+    }
+
+    if (hw->dev->flags & PDMA_CHAIN_MODE) {
+        return 1;
+    }
+
+    return sc->curr != sc->halt;
+}
+
+/*!
+ * Complete a descriptor and move forward
+ *
+ * Must be called with the engine lock held.
+ */
+static inline int
+sim_pdma_desc_done(struct pdma_hw *hw, int chan, struct cmicx_rx_desc *d,
+                   uint32_t len)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    struct sim_pdma_chan *sc = &sim->chan[chan];
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+    int raise = 0;
+
+    MEMORY_BARRIER;
+
+    d->status = CMICX_DESC_STAT_RTX_DONE | CMICX_DESC_STAT_PKT_START |
+                CMICX_DESC_STAT_PKT_END | CMICX_DESC_STAT_LEN(len);
+    sc->descs++;
+    sc->bytes += len;
+    sc->curr++;
+
+    if (d->ctrl & CMICX_DESC_CTRL_CNTLD_INTR) {
+        sim->irq_stat[grp] |= CMICX_PDMA_IRQ_CTRLD_INTR(que);
+        raise = hw->dev->ctrl.grp[grp].irq_mask & CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    }
+
+    /* The last descriptor of a chain stops the channel */
+    if (hw->dev->flags & PDMA_CHAIN_MODE && !(d->ctrl & CMICX_DESC_CTRL_CHAIN)) {
+        sc->enabled = 0;
+    }
+
+    return raise;
+}
+
+/*!
+ * Run Tx engine until the halt point
+ *
+ * Must be called with the engine lock held.
+ */
+static int
+sim_pdma_tx_run(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_chan *sc = &SIM_HW(hw)->chan[chan];
+    struct cmicx_rx_desc *ring, *d;
+    uint64_t ring_addr;
+    uint32_t nb_desc;
+    int rx, raise = 0;
+
+    ring = sim_pdma_chan_ring(hw, chan, &ring_addr, &nb_desc, &rx);
+    if (!ring || rx) {
+        return 0;
+    }
+
+    while (sim_pdma_chan_ready(hw, sc)) {
+        d = &ring[sc->curr];
+        if (d->ctrl & CMICX_DESC_CTRL_RELOAD) {
+            sc->curr = 0;
+            continue;
+        }
+        if (!CMICX_DESC_CTRL_LEN(d->ctrl) || CMICX_DESC_STAT_DONE(d->status)) {
+            break;
+        }
+        raise |= sim_pdma_desc_done(hw, chan, d, CMICX_DESC_CTRL_LEN(d->ctrl));
+    }
+
+    return raise;
+}
+
+/*!
+ * Raise interrupt if any
+ */
+static inline void
+sim_pdma_intr_raise(struct pdma_hw *hw, int raise)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+
+    if (raise && sim->intr_raise) {
+        sim->intr_raise(sim->intr_data);
+    }
+}
+
+/*!
+ * Read 32-bit register
+ */
+static void
+sim_pdma_reg_read32(struct pdma_hw *hw, uint32_t addr, uint32_t *data)
+{
+    *data = 0;
+}
+
+/*!
+ * Write 32-bit register
+ */
+static void
+sim_pdma_reg_write32(struct pdma_hw *hw, uint32_t addr, uint32_t data)
+{
+}
+
+/*!
+ * Initialize HW
+ */
+static int
+sim_pdma_hw_init(struct pdma_hw *hw)
+{
+    hw->info.name = SIM_DEV_NAME;
+    hw->info.dev_id = hw->dev->dev_id;
+    hw->info.num_cmcs = SIM_PDMA_CMC_MAX;
+    hw->info.cmc_chans = SIM_PDMA_CMC_CHAN;
+    hw->info.num_chans = SIM_PDMA_CHAN_MAX;
+    hw->info.rx_dcb_size = SIM_PDMA_DCB_SIZE;
+    hw->info.tx_dcb_size = SIM_PDMA_DCB_SIZE;
+    hw->info.rx_ph_size = SIM_RX_PKT_HDR_SIZE;
+    hw->info.tx_ph_size = SIM_TX_PKT_HDR_SIZE;
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Configure HW
+ */
+static int
+sim_pdma_hw_config(struct pdma_hw *hw)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+
+    sal_spinlock_lock(sim->lock);
+    sal_memset(sim->irq_stat, 0, sizeof(sim->irq_stat));
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Reset HW
+ */
+static int
+sim_pdma_hw_reset(struct pdma_hw *hw)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    int ci;
+
+    sal_spinlock_lock(sim->lock);
+    for (ci = 0; ci < SIM_PDMA_CHAN_MAX; ci++) {
+        sim->chan[ci].enabled = 0;
+    }
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Start a channel
+ */
+static int
+sim_pdma_chan_start(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    struct sim_pdma_chan *sc = &sim->chan[chan];
+    uint64_t ring_addr;
+    uint32_t nb_desc;
+    int rx, raise = 0;
+
+    sal_spinlock_lock(sim->lock);
+    if (sim_pdma_chan_ring(hw, chan, &ring_addr, &nb_desc, &rx)) {
+        sc->curr = sim_pdma_desc_index(ring_addr, nb_desc, sc->desc_addr);
+        sc->enabled = 1;
+        raise = sim_pdma_tx_run(hw, chan);
+    }
+    sal_spinlock_unlock(sim->lock);
+
+    sim_pdma_intr_raise(hw, raise);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Stop a channel
+ */
+static int
+sim_pdma_chan_stop(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    sal_spinlock_lock(sim->lock);
+    sim->chan[chan].enabled = 0;
+    sim->irq_stat[grp] &= ~CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Setup a channel
+ */
+static int
+sim_pdma_chan_setup(struct pdma_hw *hw, int chan, uint64_t addr)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+
+    sal_spinlock_lock(sim->lock);
+    sim->chan[chan].desc_addr = addr;
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Set halt point for a channel
+ */
+static int
+sim_pdma_chan_goto(struct pdma_hw *hw, int chan, uint64_t addr)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    uint64_t ring_addr;
+    uint32_t nb_desc;
+    int rx, raise = 0;
+
+    sal_spinlock_lock(sim->lock);
+    if (sim_pdma_chan_ring(hw, chan, &ring_addr, &nb_desc, &rx)) {
+        sim->chan[chan].halt = sim_pdma_desc_index(ring_addr, nb_desc, addr);
+        if (!rx) {
+            raise = sim_pdma_tx_run(hw, chan);
+        }
+    }
+    sal_spinlock_unlock(sim->lock);
+
+    sim_pdma_intr_raise(hw, raise);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Clear a channel
+ */
+static int
+sim_pdma_chan_clear(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    sal_spinlock_lock(sim->lock);
+    sim->irq_stat[grp] &= ~CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Get interrupt number for a channel
+ */
+static int
+sim_pdma_chan_intr_num_get(struct pdma_hw *hw, int chan)
+{
+    return chan;
+}
+
+/*!
+ * Enable interrupt for a channel
+ *
+ * The interrupt is level triggered, so raise it at once if still pending.
+ */
+static int
+sim_pdma_chan_intr_enable(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+    int raise;
+
+    sal_spinlock_lock(sim->lock);
+    hw->dev->ctrl.grp[grp].irq_mask |= CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    raise = sim->irq_stat[grp] & CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    sal_spinlock_unlock(sim->lock);
+
+    sim_pdma_intr_raise(hw, raise);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Disable interrupt for a channel
+ */
+static int
+sim_pdma_chan_intr_disable(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    sal_spinlock_lock(sim->lock);
+    hw->dev->ctrl.grp[grp].irq_mask &= ~CMICX_PDMA_IRQ_CTRLD_INTR(que);
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Query interrupt status for a channel
+ */
+static int
+sim_pdma_chan_intr_query(struct pdma_hw *hw, int chan)
+{
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    return SIM_HW(hw)->irq_stat[grp] & CMICX_PDMA_IRQ_CTRLD_INTR(que);
+}
+
+/*!
+ * Check interrupt validity for a channel
+ */
+static int
+sim_pdma_chan_intr_check(struct pdma_hw *hw, int chan)
+{
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    if (!(hw->dev->ctrl.grp[grp].irq_mask & CMICX_PDMA_IRQ_CTRLD_INTR(que))) {
+        return 0;
+    }
+
+    return sim_pdma_chan_intr_query(hw, chan);
+}
+
+/*!
+ * Coalesce interrupt for a channel
+ *
+ * Interrupts are raised per descriptor. Just keep the setting for dump.
+ */
+static int
+sim_pdma_chan_intr_coalesce(struct pdma_hw *hw, int chan, int count, int timer)
+{
+    SIM_HW(hw)->chan[chan].coal = CMICX_PDMA_INTR_COAL_ENA |
+                                  CMICX_PDMA_INTR_THRESH(count) |
+                                  CMICX_PDMA_INTR_TIMER(timer);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Dump registers for a channel
+ */
+static int
+sim_pdma_chan_reg_dump(struct pdma_hw *hw, int chan)
+{
+    struct sim_pdma_hw *sim = SIM_HW(hw);
+    struct sim_pdma_chan *sc = &sim->chan[chan];
+    int grp = chan / SIM_PDMA_CMC_CHAN;
+    int que = chan % SIM_PDMA_CMC_CHAN;
+
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_ENABLE: %d\n", grp, que, sc->enabled);
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_DESC: 0x%llx\n", grp, que,
+              (unsigned long long)sc->desc_addr);
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_CURR_DESC: %u\n", grp, que, sc->curr);
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_DESC_HALT: %u\n", grp, que, sc->halt);
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_INTR_COAL: 0x%08x\n", grp, que, sc->coal);
+    CNET_INFO(hw->unit, "SIM_CMC%d_DMA_CH%d_PKT_COUNT: %llu\n", grp, que,
+              (unsigned long long)sc->descs);
+    CNET_INFO(hw->unit, "SIM_CMC%d_IRQ_STAT: 0x%08x\n", grp, sim->irq_stat[grp]);
+    CNET_INFO(hw->unit, "SIM_CMC%d_IRQ_ENAB: 0x%08x\n", grp,
+              hw->dev->ctrl.grp[grp].irq_mask);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Initialize function pointers
+ */
+int
+bcmcnet_sim_pdma_hw_hdls_init(struct pdma_hw *hw)
+{
+    if (!hw) {
+        return SHR_E_PARAM;
+    }
+
+    hw->hdls.reg_rd32 = sim_pdma_reg_read32;
+    hw->hdls.reg_wr32 = sim_pdma_reg_write32;
+    hw->hdls.hw_init = sim_pdma_hw_init;
+    hw->hdls.hw_config = sim_pdma_hw_config;
+    hw->hdls.hw_reset = sim_pdma_hw_reset;
+    hw->hdls.chan_start = sim_pdma_chan_start;
+    hw->hdls.chan_stop = sim_pdma_chan_stop;
+    hw->hdls.chan_setup = sim_pdma_chan_setup;
+    hw->hdls.chan_goto = sim_pdma_chan_goto;
+    hw->hdls.chan_clear = sim_pdma_chan_clear;
+    hw->hdls.chan_intr_num_get = sim_pdma_chan_intr_num_get;
+    hw->hdls.chan_intr_enable = sim_pdma_chan_intr_enable;
+    hw->hdls.chan_intr_disable = sim_pdma_chan_intr_disable;
+    hw->hdls.chan_intr_query = sim_pdma_chan_intr_query;
+    hw->hdls.chan_intr_check = sim_pdma_chan_intr_check;
+    hw->hdls.chan_intr_coalesce = sim_pdma_chan_intr_coalesce;
+    hw->hdls.chan_reg_dump = sim_pdma_chan_reg_dump;
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Connect interrupt
+ */
+int
+bcmcnet_sim_pdma_intr_connect(struct pdma_dev *dev, sim_pdma_intr_raise_f raise,
+                              void *data)
+{
+    struct sim_pdma_hw *sim = (struct sim_pdma_hw *)dev->ctrl.hw;
+
+    if (!sim) {
+        return SHR_E_UNAVAIL;
+    }
+
+    sal_spinlock_lock(sim->lock);
+    sim->intr_raise = raise;
+    sim->intr_data = data;
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Receive packets on a simulated Rx channel
+ */
+int
+bcmcnet_sim_pdma_rx_inject(struct pdma_dev *dev, int chan, const uint8_t *buf,
+                           uint32_t len, int count)
+{
+    struct sim_pdma_hw *sim = (struct sim_pdma_hw *)dev->ctrl.hw;
+    struct pdma_hw *hw = (struct pdma_hw *)dev->ctrl.hw;
+    struct sim_pdma_chan *sc = NULL;
+    struct cmicx_rx_desc *ring, *d;
+    uint64_t ring_addr;
+    uint32_t nb_desc;
+    void *data;
+    int rx, done = 0, raise = 0;
+
+    if (!sim || chan < 0 || chan >= SIM_PDMA_CHAN_MAX || !buf) {
+        return SHR_E_PARAM;
+    }
+    sc = &sim->chan[chan];
+
+    sal_spinlock_lock(sim->lock);
+    ring = sim_pdma_chan_ring(hw, chan, &ring_addr, &nb_desc, &rx);
+    if (!ring || !rx) {
+        sal_spinlock_unlock(sim->lock);
+        return SHR_E_UNAVAIL;
+    }
+
+    while (done < count && sim_pdma_chan_ready(hw, sc)) {
+        d = &ring[sc->curr];
+        if (d->ctrl & CMICX_DESC_CTRL_RELOAD) {
+            sc->curr = 0;
+            continue;
+        }
+        /* Not refilled yet or not reaped yet */
+        if (len > CMICX_DESC_CTRL_LEN(d->ctrl) ||
+            CMICX_DESC_STAT_DONE(d->status)) {
+            break;
+        }
+        data = dev->sys_p2v(dev, SIM_DESC_ADDR(d));
+        if (!data) {
+            break;
+        }
+        sal_memcpy(data, buf, len);
+        raise |= sim_pdma_desc_done(hw, chan, d, len);
+        done++;
+    }
+    sal_spinlock_unlock(sim->lock);
+
+    sim_pdma_intr_raise(hw, raise);
+
+    return done;
+}
+
+/*!
+ * Get channel counters
+ */
+int
+bcmcnet_sim_pdma_chan_stats_get(struct pdma_dev *dev, int chan, uint64_t *descs,
+                                uint64_t *bytes)
+{
+    struct sim_pdma_hw *sim = (struct sim_pdma_hw *)dev->ctrl.hw;
+
+    if (!sim || chan < 0 || chan >= SIM_PDMA_CHAN_MAX) {
+        return SHR_E_PARAM;
+    }
+
+    sal_spinlock_lock(sim->lock);
+    *descs = sim->chan[chan].descs;
+    *bytes = sim->chan[chan].bytes;
+    sal_spinlock_unlock(sim->lock);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Attach device driver
+ */
+int
+bcmcnet_sim_pdma_driver_attach(struct pdma_dev *dev)
+{
+    struct sim_pdma_hw *sim = NULL;
+
+    /* Allocate memory for HW data */
+    sim = sal_alloc(sizeof(*sim), "bcmcnetPdmaSimHw");
+    if (!sim) {
+        return SHR_E_MEMORY;
+    }
+    sal_memset(sim, 0, sizeof(*sim));
+    sim->lock = sal_spinlock_create("bcmcnetPdmaSimLock");
+    if (!sim->lock) {
+        sal_free(sim);
+        return SHR_E_MEMORY;
+    }
+    sim->hw.unit = dev->unit;
+    sim->hw.dev = dev;
+    dev->ctrl.hw = &sim->hw;
+
+    bcmcnet_sim_pdma_hw_hdls_init(&sim->hw);
+    bcmcnet_cmicx_pdma_desc_ops_init(&sim->hw);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Detach device driver
+ */
+int
+bcmcnet_sim_pdma_driver_detach(struct pdma_dev *dev)
+{
+    struct sim_pdma_hw *sim = (struct sim_pdma_hw *)dev->ctrl.hw;
+
+    if (sim) {
+        sal_spinlock_destroy(sim->lock);
+        sal_free(sim);
+    }
+    dev->ctrl.hw = NULL;
+
+    return SHR_E_NONE;
+}
@@ -70,6 +70,8 @@ struct pkt_hdr {
 #define PDMA_TX_NO_PAD      (1 << 5)
     /*! Tx to HNET */
 #define PDMA_TX_TO_HNET     (1 << 6)
+    /*! Tx more packets follow */
+#define PDMA_TX_XMIT_MORE   (1 << 7)
     /*! Rx to VNET */
 #define PDMA_RX_TO_VNET     (1 << 10)
     /*! Rx strip vlan tag */
@@ -917,6 +919,8 @@ struct pdma_dev {
 #define PDMA_VNET_DOCKED    (1 << 5)
     /*! Abort PDMA mode for suspend and resume */
 #define PDMA_ABORT          (1 << 6)
+    /*! Dynamic interrupt moderation */
+#define PDMA_INTR_DIM       (1 << 7)
 
     /*! Device mode */
     dev_mode_t mode;
@@ -0,0 +1,169 @@
+/*! \file bcmcnet_dim.h
+ *
+ * Data structure and macro definitions for BCMCNET dynamic interrupt
+ * moderation.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef BCMCNET_DIM_H
+#define BCMCNET_DIM_H
+
+#include <bcmcnet/bcmcnet_types.h>
+
+struct pdma_dev;
+struct intr_handle;
+
+/*! Number of moderation profiles */
+#define PDMA_DIM_PROFILES       5
+
+/*! Interrupt events per measurement window */
+#define PDMA_DIM_NEVENTS        64
+
+/*! Maximum measurement window (us) */
+#define PDMA_DIM_WINDOW_USECS   100000
+
+/*! Packet rate (packets per ms) below which traffic is considered sparse */
+#define PDMA_DIM_SPARSE_PPMS    8
+
+/*! Steps allowed before parking, and windows to stay parked when tired */
+#define PDMA_DIM_TIRED          (PDMA_DIM_PROFILES * 2)
+
+/*!
+ * \brief Moderation profile.
+ */
+struct pdma_dim_profile {
+    /*! Interrupt threshold in descriptors */
+    uint32_t count;
+
+    /*! Interrupt timer value */
+    uint32_t timer;
+};
+
+/*!
+ * \brief Moderation sample.
+ */
+struct pdma_dim_sample {
+    /*! Timestamp (us) */
+    unsigned long usecs;
+
+    /*! Queue packet counter */
+    uint64_t pkts;
+
+    /*! Queue byte counter */
+    uint64_t bytes;
+};
+
+/*!
+ * \brief Rates measured over a window.
+ */
+struct pdma_dim_rates {
+    /*! Packets per ms */
+    uint32_t ppms;
+
+    /*! Bytes per ms */
+    uint32_t bpms;
+
+    /*! Interrupt events per ms */
+    uint32_t epms;
+};
+
+/*!
+ * \brief Moderation state of a queue.
+ */
+struct pdma_dim {
+    /*! Moderation is applied to the queue */
+    int active;
+
+    /*! Tuning state */
+    int state;
+    /*! Parked on the best profile found */
+#define PDMA_DIM_PARKING_ON_TOP 0
+    /*! Parked after too many steps */
+#define PDMA_DIM_PARKING_TIRED  1
+    /*! Moving to heavier moderation */
+#define PDMA_DIM_GOING_RIGHT    2
+    /*! Moving to lighter moderation */
+#define PDMA_DIM_GOING_LEFT     3
+
+    /*! Current profile index */
+    int profile;
+
+    /*! Steps taken in the current direction */
+    int steps;
+
+    /*! Tired counter */
+    int tired;
+
+    /*! Interrupt events in the current window */
+    uint32_t events;
+
+    /*! Start of the current window */
+    struct pdma_dim_sample start;
+
+    /*! Reference rates to compare the next window against */
+    struct pdma_dim_rates rates;
+
+    /*! Number of profile changes */
+    uint64_t changes;
+};
+
+/*!
+ * \brief Sample a queue for interrupt moderation.
+ *
+ * Called by the OS layer once per interrupt event, i.e. right before the
+ * queue interrupt is re-enabled at the end of polling. A new moderation
+ * profile is applied when a measurement window is evaluated.
+ *
+ * Moderation runs only while PDMA_INTR_DIM is set in the device flags. When
+ * the flag is cleared, the queue falls back to the lightest profile on the
+ * next call.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] hdl Queue interrupt handle.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_queue_dim_sample(struct pdma_dev *dev, struct intr_handle *hdl);
+
+/*!
+ * \brief Sample all queues of a group for interrupt moderation.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] group Group number.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_group_dim_sample(struct pdma_dev *dev, int group);
+
+/*!
+ * \brief Get a moderation profile.
+ *
+ * \param [in] dir Queue direction.
+ * \param [in] profile Profile index.
+ *
+ * \return Profile structure point or NULL if out of range.
+ */
+extern const struct pdma_dim_profile *
+bcmcnet_dim_profile_get(int dir, int profile);
+
+#endif /* BCMCNET_DIM_H */
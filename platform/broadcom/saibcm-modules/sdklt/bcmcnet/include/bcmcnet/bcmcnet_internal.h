@@ -293,6 +293,14 @@ typedef struct bcmcnet_vnet_ops_s {
 extern void
 bcmcnet_buf_mngr_init(struct pdma_dev *dev);
 
+/*!
+ * \brief Clean up buffer manager.
+ *
+ * \param [in] dev Device structure pointer.
+ */
+extern void
+bcmcnet_buf_mngr_cleanup(struct pdma_dev *dev);
+
 /*!
  * \brief Register VNET operations.
  *
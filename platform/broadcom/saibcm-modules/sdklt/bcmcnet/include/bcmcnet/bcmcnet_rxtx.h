@@ -23,6 +23,8 @@
 #ifndef BCMCNET_RXTX_H
 #define BCMCNET_RXTX_H
 
+#include <bcmcnet/bcmcnet_dim.h>
+
 /*! Default timeout value (us) to wait for Tx resource. */
 #ifndef BCMCNET_TX_RSRC_WAIT_USEC
 #define BCMCNET_TX_RSRC_WAIT_USEC 1000000
@@ -34,6 +36,9 @@
 /*! Maximum number of packets to be handled in one poll call. */
 #define NUM_RXTX_BUDGET     64
 
+/*! Maximum number of Tx descriptors to set up before a DMA kick. */
+#define NUM_TX_KICK_DEFER   16
+
 /*!
  * \brief Rx buffer mode definitions.
  */
@@ -132,6 +137,9 @@ struct pdma_rx_queue {
     /*! Rx interrupt coalescing */
     int intr_coalescing;
 
+    /*! Rx interrupt moderation */
+    struct pdma_dim dim;
+
     /*! Queue statistics */
     struct rx_stats stats;
 
@@ -181,6 +189,9 @@ struct tx_stats {
 
     /*! Number of suspends */
     uint64_t xoffs;
+
+    /*! Number of DMA kicks */
+    uint64_t kicks;
 };
 
 /*!
@@ -223,6 +234,9 @@ struct pdma_tx_queue {
     /*! Halt ring entry */
     uint32_t halt;
 
+    /*! Descriptors set up but not kicked off yet */
+    uint32_t kick_pend;
+
     /*! Max free descriptors to hold in non-intr mode */
     uint32_t free_thresh;
 
@@ -232,6 +246,9 @@ struct pdma_tx_queue {
     /*! Tx interrupt coalescing */
     int intr_coalescing;
 
+    /*! Tx interrupt moderation */
+    struct pdma_dim dim;
+
     /*! Queue statistics */
     struct tx_stats stats;
 
@@ -459,6 +476,23 @@ bcmcnet_pdma_tx_queue_wakeup(struct pdma_dev *dev, int queue);
 extern int
 bcmcnet_pdma_tx_queue_xmit(struct pdma_dev *dev, int queue, void *buf);
 
+/*!
+ * \brief Kick off pending Tx descriptors.
+ *
+ * Packets marked with PDMA_TX_XMIT_MORE may leave the DMA kick to a later
+ * packet. This starts the DMA for such descriptors if no later packet on
+ * the queue will do it, e.g. the packet has been dropped before reaching
+ * the queue.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] queue Tx queue number.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_pdma_tx_queue_kick(struct pdma_dev *dev, int queue);
+
 /*!
  * \brief Poll Rx queue.
  *
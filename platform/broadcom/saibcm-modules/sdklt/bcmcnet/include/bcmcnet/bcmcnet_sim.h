@@ -0,0 +1,194 @@
+/*! \file bcmcnet_sim.h
+ *
+ * Simulated PDMA HW definitions.
+ *
+ * The simulator keeps the CMICx descriptor format and ring handling and
+ * replaces the channel registers with a software DMA engine working on the
+ * descriptor rings in host memory. It makes the whole packet path usable
+ * and measurable without any switch device.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef BCMCNET_SIM_H
+#define BCMCNET_SIM_H
+
+#include <bcmcnet/bcmcnet_cmicx.h>
+
+/*!
+ * \name SIM PDMA HW definitions
+ */
+/*! \{ */
+/*! SIM device name */
+#define SIM_DEV_NAME                    "sim"
+/*! SIM CMC number */
+#define SIM_PDMA_CMC_MAX                CMICX_PDMA_CMC_MAX
+/*! SIM CMC PDMA channels */
+#define SIM_PDMA_CMC_CHAN               CMICX_PDMA_CMC_CHAN
+/*! SIM PDMA channels */
+#define SIM_PDMA_CHAN_MAX               (SIM_PDMA_CMC_MAX * SIM_PDMA_CMC_CHAN)
+/*! SIM PDMA DCB size */
+#define SIM_PDMA_DCB_SIZE               CMICX_PDMA_DCB_SIZE
+/*! SIM Rx packet header size */
+#define SIM_RX_PKT_HDR_SIZE             64
+/*! SIM Tx packet header size */
+#define SIM_TX_PKT_HDR_SIZE             CMICX_TX_PKT_HDR_SIZE
+/*! \} */
+
+/*!
+ * \brief Raise interrupt.
+ *
+ * Called by the simulated HW whenever an enabled channel interrupt is
+ * pending. It may be called in any context and with the queue locks held,
+ * so it must only signal the interrupt and defer the handling.
+ *
+ * \param [in] data Callback data.
+ */
+typedef void (*sim_pdma_intr_raise_f)(void *data);
+
+/*!
+ * \brief SIM channel state.
+ */
+struct sim_pdma_chan {
+    /*! Channel enabled */
+    int enabled;
+
+    /*! Start descriptor address */
+    uint64_t desc_addr;
+
+    /*! Current descriptor index */
+    uint32_t curr;
+
+    /*! Halt descriptor index */
+    uint32_t halt;
+
+    /*! Interrupt coalescing */
+    uint32_t coal;
+
+    /*! Processed descriptors */
+    uint64_t descs;
+
+    /*! Processed bytes */
+    uint64_t bytes;
+};
+
+/*!
+ * \brief SIM PDMA HW structure.
+ */
+struct sim_pdma_hw {
+    /*! Generic HW structure, must be the first */
+    struct pdma_hw hw;
+
+    /*! Engine lock */
+    sal_spinlock_t lock;
+
+    /*! Channel states */
+    struct sim_pdma_chan chan[SIM_PDMA_CHAN_MAX];
+
+    /*! Interrupt status per CMC */
+    uint32_t irq_stat[SIM_PDMA_CMC_MAX];
+
+    /*! Interrupt raise callback */
+    sim_pdma_intr_raise_f intr_raise;
+
+    /*! Interrupt raise callback data */
+    void *intr_data;
+};
+
+/*!
+ * \brief Initialize HW handles.
+ *
+ * \param [in] hw HW structure point.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_sim_pdma_hw_hdls_init(struct pdma_hw *hw);
+
+/*!
+ * \brief Connect interrupt.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] raise Interrupt raise callback, NULL to disconnect.
+ * \param [in] data Callback data.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_sim_pdma_intr_connect(struct pdma_dev *dev, sim_pdma_intr_raise_f raise,
+                              void *data);
+
+/*!
+ * \brief Receive packets on a simulated Rx channel.
+ *
+ * Copy the same frame (Rx packet header followed by packet data) into
+ * the next available Rx descriptors, as the HW would do. Fewer packets
+ * than requested are received if the channel runs out of descriptors.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] chan Channel number.
+ * \param [in] buf Frame to receive.
+ * \param [in] len Frame length.
+ * \param [in] count Number of copies.
+ *
+ * \retval Number of packets received, negative on errors.
+ */
+extern int
+bcmcnet_sim_pdma_rx_inject(struct pdma_dev *dev, int chan, const uint8_t *buf,
+                           uint32_t len, int count);
+
+/*!
+ * \brief Get channel counters.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] chan Channel number.
+ * \param [out] descs Processed descriptors.
+ * \param [out] bytes Processed bytes.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_sim_pdma_chan_stats_get(struct pdma_dev *dev, int chan, uint64_t *descs,
+                                uint64_t *bytes);
+
+/*!
+ * \brief Attach device driver.
+ *
+ * \param [in] dev Device structure point.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_sim_pdma_driver_attach(struct pdma_dev *dev);
+
+/*!
+ * \brief Detach device driver.
+ *
+ * \param [in] dev Device structure point.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+bcmcnet_sim_pdma_driver_detach(struct pdma_dev *dev);
+
+#endif /* BCMCNET_SIM_H */
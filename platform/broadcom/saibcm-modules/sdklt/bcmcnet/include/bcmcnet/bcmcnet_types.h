@@ -171,6 +171,9 @@ typedef struct bcmcnet_dev_stats {
     /*! Number of suspended transmission */
     uint64_t tx_xoffs;
 
+    /*! Number of Tx DMA kicks */
+    uint64_t tx_kicks;
+
     /*! Number of interrupts */
     uint64_t intrs;
 
@@ -212,6 +215,9 @@ typedef struct bcmcnet_dev_stats {
 
     /*! Number of suspended transmission per queue */
     uint64_t txq_xoffs[NUM_Q_MAX];
+
+    /*! Number of Tx DMA kicks per queue */
+    uint64_t txq_kicks[NUM_Q_MAX];
 } bcmcnet_dev_stats_t;
 
 /*!
@@ -55,6 +55,8 @@ bcmcnet_pdma_dev_cleanup(struct pdma_dev *dev)
     dev->ops->dev_close(dev);
     dev->ops = NULL;
 
+    bcmcnet_buf_mngr_cleanup(dev);
+
     dev->attached = false;
 
     return SHR_E_NONE;
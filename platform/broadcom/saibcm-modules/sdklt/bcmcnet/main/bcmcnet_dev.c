@@ -219,6 +219,10 @@ bcn_rx_queue_group_parse(struct pdma_dev *dev, uint32_t qbm)
                     ctrl->grp[gi].rx_size[qi] = rxq->buf_size;
                 }
                 rxq->buf_size += dev->rx_ph_size;
+                /* Update queue index, buffer managers key on it */
+                rxq->queue_id = ctrl->nb_rxq;
+                ctrl->rx_queue[rxq->queue_id] = rxq;
+                ctrl->nb_rxq++;
                 /* Set mode and state for the queue */
                 rxq->buf_mode = bm->rx_buf_mode(dev, rxq);
                 rxq->state |= PDMA_RX_QUEUE_USED;
@@ -226,10 +230,6 @@ bcn_rx_queue_group_parse(struct pdma_dev *dev, uint32_t qbm)
                     rxq->free_thresh = rxq->nb_desc / 4;
                     rxq->state |= PDMA_RX_BATCH_REFILL;
                 }
-                /* Update queue index */
-                rxq->queue_id = ctrl->nb_rxq;
-                ctrl->rx_queue[rxq->queue_id] = rxq;
-                ctrl->nb_rxq++;
                 qn++;
                 mask |= 1 << qi;
                 /* Set up handler for the queue */
@@ -516,6 +516,7 @@ bcmcnet_pdma_stats_get(struct pdma_dev *dev)
     struct pdma_rx_queue *rxq = NULL;
     struct pdma_tx_queue *txq = NULL;
     uint32_t packets = 0, bytes = 0, dropped = 0, errors = 0, nomems = 0, xoffs = 0;
+    uint32_t kicks = 0;
     uint32_t head_errors = 0, data_errors = 0, cell_errors = 0;
     uint32_t qi;
 
@@ -562,11 +563,13 @@ bcmcnet_pdma_stats_get(struct pdma_dev *dev)
         dropped += txq->stats.dropped;
         errors += txq->stats.errors;
         xoffs += txq->stats.xoffs;
+        kicks += txq->stats.kicks;
         dev->stats.txq_packets[qi] = txq->stats.packets;
         dev->stats.txq_bytes[qi] = txq->stats.bytes;
         dev->stats.txq_dropped[qi] = txq->stats.dropped;
         dev->stats.txq_errors[qi] = txq->stats.errors;
         dev->stats.txq_xoffs[qi] = txq->stats.xoffs;
+        dev->stats.txq_kicks[qi] = txq->stats.kicks;
     }
 
     dev->stats.tx_packets = packets;
@@ -574,6 +577,7 @@ bcmcnet_pdma_stats_get(struct pdma_dev *dev)
     dev->stats.tx_dropped = dropped;
     dev->stats.tx_errors = errors;
     dev->stats.tx_xoffs = xoffs;
+    dev->stats.tx_kicks = kicks;
 }
 
 /*!
@@ -614,6 +618,7 @@ bcmcnet_pdma_stats_reset(struct pdma_dev *dev)
         txq->stats.dropped = 0;
         txq->stats.errors = 0;
         txq->stats.xoffs = 0;
+        txq->stats.kicks = 0;
     }
 }
 
@@ -0,0 +1,406 @@
+/*! \file bcmcnet_dim.c
+ *
+ * Dynamic interrupt moderation for BCMCNET queues.
+ *
+ * Every queue is sampled once per interrupt event. Packet, byte and event
+ * rates are measured over a window of PDMA_DIM_NEVENTS events and compared
+ * with the previous window to walk a small table of coalescing profiles,
+ * looking for the one which moves the most traffic with the fewest
+ * interrupts. Sparse traffic always falls back to the lightest profile so
+ * that control packets are not delayed.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <bcmcnet/bcmcnet_core.h>
+#include <bcmcnet/bcmcnet_dev.h>
+#include <bcmcnet/bcmcnet_rxtx.h>
+#include <bcmcnet/bcmcnet_dim.h>
+
+/*! Upper bound of a measurement window used in rate calculations (us) */
+#define DIM_USECS_MAX       1000000
+
+/*! Window comparison results */
+#define DIM_STATS_WORSE     -1
+#define DIM_STATS_SAME      0
+#define DIM_STATS_BETTER    1
+
+/*! Significant difference, i.e. more than 10% */
+#define DIM_DIFF(c, p)      ((uint64_t)((c) > (p) ? (c) - (p) : (p) - (c)) * 10 > (p))
+
+/*!
+ * Rx moderation profiles from the lightest to the heaviest
+ */
+static const struct pdma_dim_profile bcn_dim_rx_profiles[PDMA_DIM_PROFILES] = {
+    {1, 0}, {4, 16}, {8, 32}, {16, 64}, {32, 128}
+};
+
+/*!
+ * Tx moderation profiles from the lightest to the heaviest
+ */
+static const struct pdma_dim_profile bcn_dim_tx_profiles[PDMA_DIM_PROFILES] = {
+    {1, 0}, {8, 32}, {16, 64}, {32, 128}, {32, 256}
+};
+
+/*!
+ * Get a moderation profile
+ */
+const struct pdma_dim_profile *
+bcmcnet_dim_profile_get(int dir, int profile)
+{
+    if ((uint32_t)profile >= PDMA_DIM_PROFILES) {
+        return NULL;
+    }
+
+    return dir == PDMA_Q_RX ? &bcn_dim_rx_profiles[profile] :
+                              &bcn_dim_tx_profiles[profile];
+}
+
+/*!
+ * Calculate a rate per ms, saturated to 32 bits
+ *
+ * The count of a window can exceed 32 bits, e.g. bytes at several
+ * hundred Gbps over a full window, so the arithmetic is done in 64 bits.
+ */
+static uint32_t
+bcn_dim_rate(uint64_t val, uint32_t usecs)
+{
+    uint64_t rate;
+
+    if (val > (uint64_t)-1 / 1000) {
+        return (uint32_t)-1;
+    }
+    rate = CNET_DIV_U64(val * 1000, usecs);
+
+    return rate > (uint32_t)-1 ? (uint32_t)-1 : (uint32_t)rate;
+}
+
+/*!
+ * Compare the rates of two windows
+ *
+ * More bytes or packets moved is better. With the same traffic, fewer
+ * interrupt events is better.
+ */
+static int
+bcn_dim_rates_compare(struct pdma_dim_rates *curr, struct pdma_dim_rates *prev)
+{
+    if (!prev->bpms) {
+        return curr->bpms ? DIM_STATS_BETTER : DIM_STATS_SAME;
+    }
+    if (DIM_DIFF(curr->bpms, prev->bpms)) {
+        return curr->bpms > prev->bpms ? DIM_STATS_BETTER : DIM_STATS_WORSE;
+    }
+
+    if (!prev->ppms) {
+        return curr->ppms ? DIM_STATS_BETTER : DIM_STATS_SAME;
+    }
+    if (DIM_DIFF(curr->ppms, prev->ppms)) {
+        return curr->ppms > prev->ppms ? DIM_STATS_BETTER : DIM_STATS_WORSE;
+    }
+
+    if (!prev->epms) {
+        return DIM_STATS_SAME;
+    }
+    if (DIM_DIFF(curr->epms, prev->epms)) {
+        return curr->epms < prev->epms ? DIM_STATS_BETTER : DIM_STATS_WORSE;
+    }
+
+    return DIM_STATS_SAME;
+}
+
+/*!
+ * Step to the next profile in the current direction
+ */
+static bool
+bcn_dim_step(struct pdma_dim *dim)
+{
+    if (dim->state == PDMA_DIM_GOING_RIGHT) {
+        if (dim->profile == PDMA_DIM_PROFILES - 1) {
+            return false;
+        }
+        dim->profile++;
+    } else {
+        if (dim->profile == 0) {
+            return false;
+        }
+        dim->profile--;
+    }
+
+    dim->steps++;
+    dim->tired++;
+
+    return true;
+}
+
+/*!
+ * Park on the current profile
+ */
+static void
+bcn_dim_park(struct pdma_dim *dim, int state)
+{
+    dim->state = state;
+    dim->steps = 0;
+    dim->tired = state == PDMA_DIM_PARKING_TIRED ? PDMA_DIM_TIRED : 0;
+}
+
+/*!
+ * Leave parking and start tuning
+ */
+static void
+bcn_dim_unpark(struct pdma_dim *dim)
+{
+    dim->state = dim->profile ? PDMA_DIM_GOING_LEFT : PDMA_DIM_GOING_RIGHT;
+    dim->steps = 0;
+    dim->tired = 0;
+    bcn_dim_step(dim);
+}
+
+/*!
+ * Decide the profile for the next window
+ */
+static void
+bcn_dim_decide(struct pdma_dim *dim, struct pdma_dim_rates *curr)
+{
+    bool single;
+
+    /* Keep sparse traffic on the lightest profile for low latency */
+    if (curr->ppms < PDMA_DIM_SPARSE_PPMS) {
+        dim->profile = 0;
+        bcn_dim_park(dim, PDMA_DIM_PARKING_ON_TOP);
+        return;
+    }
+
+    switch (dim->state) {
+    case PDMA_DIM_PARKING_ON_TOP:
+        if (bcn_dim_rates_compare(curr, &dim->rates) != DIM_STATS_SAME) {
+            bcn_dim_unpark(dim);
+        }
+        break;
+    case PDMA_DIM_PARKING_TIRED:
+        if (--dim->tired <= 0) {
+            bcn_dim_unpark(dim);
+        }
+        break;
+    case PDMA_DIM_GOING_RIGHT:
+    case PDMA_DIM_GOING_LEFT:
+        switch (bcn_dim_rates_compare(curr, &dim->rates)) {
+        case DIM_STATS_SAME:
+            bcn_dim_park(dim, PDMA_DIM_PARKING_ON_TOP);
+            return;
+        case DIM_STATS_WORSE:
+            /* Turn around, and stop at once if the last step was the only one */
+            single = dim->steps <= 1;
+            dim->state = dim->state == PDMA_DIM_GOING_RIGHT ?
+                         PDMA_DIM_GOING_LEFT : PDMA_DIM_GOING_RIGHT;
+            dim->steps = 0;
+            if (single) {
+                bcn_dim_step(dim);
+                bcn_dim_park(dim, PDMA_DIM_PARKING_ON_TOP);
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+        if (dim->tired >= PDMA_DIM_TIRED) {
+            bcn_dim_park(dim, PDMA_DIM_PARKING_TIRED);
+        } else if (!bcn_dim_step(dim)) {
+            bcn_dim_park(dim, PDMA_DIM_PARKING_ON_TOP);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*!
+ * Program the current profile into the queue
+ */
+static int
+bcn_dim_apply(struct pdma_dev *dev, int dir, int queue, struct pdma_dim *dim,
+              uint32_t nb_desc)
+{
+    const struct pdma_dim_profile *prof;
+    uint32_t count;
+
+    prof = bcmcnet_dim_profile_get(dir, dim->profile);
+
+    /* Leave room in the ring for refilling before the interrupt fires */
+    count = prof->count;
+    if (count > nb_desc / 2) {
+        count = nb_desc / 2 ? nb_desc / 2 : 1;
+    }
+
+    if (dir == PDMA_Q_RX) {
+        return bcmcnet_pdma_rx_queue_int_coalesce(dev, queue, count, prof->timer);
+    } else {
+        return bcmcnet_pdma_tx_queue_int_coalesce(dev, queue, count, prof->timer);
+    }
+}
+
+/*!
+ * Sample a queue and evaluate the window if it is complete
+ */
+static int
+bcn_dim_sample(struct pdma_dev *dev, int dir, int queue, struct pdma_dim *dim,
+               uint64_t pkts, uint64_t bytes, uint32_t nb_desc)
+{
+    struct pdma_dim_rates curr;
+    unsigned long usecs, elapsed;
+    int profile, state;
+    int rv = SHR_E_NONE;
+
+    if (!(dev->flags & PDMA_INTR_DIM)) {
+        if (dim->active) {
+            /* Fall back to the lightest profile */
+            dim->active = 0;
+            dim->profile = 0;
+            rv = bcn_dim_apply(dev, dir, queue, dim, nb_desc);
+        }
+        return rv;
+    }
+
+    usecs = sal_time_usecs();
+
+    if (!dim->active) {
+        dim->active = 1;
+        dim->profile = 0;
+        sal_memset(&dim->rates, 0, sizeof(dim->rates));
+        bcn_dim_park(dim, PDMA_DIM_PARKING_ON_TOP);
+        rv = bcn_dim_apply(dev, dir, queue, dim, nb_desc);
+    } else {
+        elapsed = usecs - dim->start.usecs;
+        if (++dim->events < PDMA_DIM_NEVENTS && elapsed < PDMA_DIM_WINDOW_USECS) {
+            return SHR_E_NONE;
+        }
+
+        if (elapsed > DIM_USECS_MAX) {
+            elapsed = DIM_USECS_MAX;
+        } else if (!elapsed) {
+            elapsed = 1;
+        }
+        curr.ppms = bcn_dim_rate(pkts - dim->start.pkts, elapsed);
+        curr.bpms = bcn_dim_rate(bytes - dim->start.bytes, elapsed);
+        curr.epms = bcn_dim_rate(dim->events, elapsed);
+
+        profile = dim->profile;
+        state = dim->state;
+        bcn_dim_decide(dim, &curr);
+
+        /* Keep the reference while staying parked to catch slow drifts */
+        if (state != PDMA_DIM_PARKING_ON_TOP ||
+            dim->state != PDMA_DIM_PARKING_ON_TOP) {
+            dim->rates = curr;
+        }
+
+        if (dim->profile != profile) {
+            dim->changes++;
+            rv = bcn_dim_apply(dev, dir, queue, dim, nb_desc);
+        }
+    }
+
+    /* Start a new window */
+    dim->events = 0;
+    dim->start.usecs = usecs;
+    dim->start.pkts = pkts;
+    dim->start.bytes = bytes;
+
+    return rv;
+}
+
+/*!
+ * Sample a Rx queue
+ */
+static int
+bcn_dim_rx_queue_sample(struct pdma_dev *dev, struct pdma_rx_queue *rxq)
+{
+    if (!rxq || !(rxq->state & PDMA_RX_QUEUE_ACTIVE)) {
+        return SHR_E_NONE;
+    }
+
+    return bcn_dim_sample(dev, PDMA_Q_RX, rxq->queue_id, &rxq->dim,
+                          rxq->stats.packets, rxq->stats.bytes, rxq->nb_desc);
+}
+
+/*!
+ * Sample a Tx queue
+ */
+static int
+bcn_dim_tx_queue_sample(struct pdma_dev *dev, struct pdma_tx_queue *txq)
+{
+    /* Tx queues in polling mode do not raise interrupts */
+    if (!txq || !(txq->state & PDMA_TX_QUEUE_ACTIVE) ||
+        txq->state & PDMA_TX_QUEUE_POLL) {
+        return SHR_E_NONE;
+    }
+
+    return bcn_dim_sample(dev, PDMA_Q_TX, txq->queue_id, &txq->dim,
+                          txq->stats.packets, txq->stats.bytes, txq->nb_desc);
+}
+
+/*!
+ * Sample a queue for interrupt moderation
+ */
+int
+bcmcnet_queue_dim_sample(struct pdma_dev *dev, struct intr_handle *hdl)
+{
+    struct dev_ctrl *ctrl = &dev->ctrl;
+
+    if (!dev->started) {
+        return SHR_E_NONE;
+    }
+
+    if ((uint32_t)hdl->queue >= NUM_Q_MAX) {
+        return SHR_E_PARAM;
+    }
+
+    if (hdl->dir == PDMA_Q_RX) {
+        return bcn_dim_rx_queue_sample(dev, ctrl->rx_queue[hdl->queue]);
+    } else {
+        return bcn_dim_tx_queue_sample(dev, ctrl->tx_queue[hdl->queue]);
+    }
+}
+
+/*!
+ * Sample all queues of a group for interrupt moderation
+ */
+int
+bcmcnet_group_dim_sample(struct pdma_dev *dev, int group)
+{
+    struct queue_group *grp;
+    int i;
+
+    if (!dev->started) {
+        return SHR_E_NONE;
+    }
+
+    if ((uint32_t)group >= NUM_GRP_MAX) {
+        return SHR_E_PARAM;
+    }
+
+    grp = &dev->ctrl.grp[group];
+    for (i = 0; i < dev->grp_queues; i++) {
+        if (1 << i & grp->bm_rxq) {
+            bcn_dim_rx_queue_sample(dev, grp->rx_queue[i]);
+        } else if (1 << i & grp->bm_txq) {
+            bcn_dim_tx_queue_sample(dev, grp->tx_queue[i]);
+        }
+    }
+
+    return SHR_E_NONE;
+}
@@ -539,6 +539,50 @@ bcmcnet_pdma_tx_queue_xmit(struct pdma_dev *dev, int queue, void *buf)
     return hw->dops.pkt_xmit(hw, txq, buf);
 }
 
+/*!
+ * Kick off pending Tx descriptors
+ */
+int
+bcmcnet_pdma_tx_queue_kick(struct pdma_dev *dev, int queue)
+{
+    struct dev_ctrl *ctrl = &dev->ctrl;
+    struct pdma_hw *hw = (struct pdma_hw *)ctrl->hw;
+    struct pdma_tx_queue *txq = NULL;
+
+    if (queue < 0 || queue >= ctrl->nb_txq) {
+        return SHR_E_PARAM;
+    }
+
+    txq = (struct pdma_tx_queue *)ctrl->tx_queue[queue];
+    if (!txq || !(txq->state & PDMA_TX_QUEUE_ACTIVE)) {
+        return SHR_E_UNAVAIL;
+    }
+
+    if (!txq->kick_pend) {
+        return SHR_E_NONE;
+    }
+
+    if (dev->tx_suspend) {
+        sal_spinlock_lock(txq->mutex);
+    } else {
+        sal_sem_take(txq->sem, SAL_SEM_FOREVER);
+    }
+
+    if (txq->kick_pend) {
+        hw->hdls.chan_goto(hw, txq->chan_id, txq->halt_addr);
+        txq->kick_pend = 0;
+        txq->stats.kicks++;
+    }
+
+    if (dev->tx_suspend) {
+        sal_spinlock_unlock(txq->mutex);
+    } else {
+        sal_sem_give(txq->sem);
+    }
+
+    return SHR_E_NONE;
+}
+
 /*!
  * Poll a Rx queues
  */
@@ -177,6 +177,8 @@ typedef struct ngknet_netif_s {
  *
  *  NGKNET_FILTER_DEST_T_CB
  *  Packet is sent to kernel filter call-back function for further filtering.
+ *  If a BPF program is attached to the filter, the program is run first and
+ *  its verdict decides the destination, see \ref NGKNET_FILTER_BPF_XXX.
  *
  * Filter flags:
  *
@@ -220,6 +222,52 @@ typedef struct ngknet_netif_s {
 /*! Filter created with raw metadata */
 #define NGKNET_FILTER_F_RAW_PMD     (1U << 15)
 
+/*!
+ * BPF filter programs
+ *
+ * A BPF_PROG_TYPE_SCHED_CLS program may be attached to a filter with
+ * destination NGKNET_FILTER_DEST_T_CB. It is run on every matching packet
+ * with the __sk_buff context set up as follows:
+ *
+ *  data .. data_end       Packet data starting at the Ethernet header.
+ *  data_meta .. data      Packet metadata (PMD) from the Rx DMA.
+ *  mark                   Filter ID.
+ *  queue_mapping          Rx channel.
+ *  ifindex                Base network interface.
+ *
+ * The program may use BPF maps, e.g. for per-flow counting, and returns a
+ * verdict built with NGKNET_FILTER_BPF_VERDICT():
+ *
+ *  NGKNET_FILTER_BPF_DROP
+ *  Packet is dropped.
+ *
+ *  NGKNET_FILTER_BPF_PASS
+ *  Packet is sent to network interface with the filter <dest_id>.
+ *
+ *  NGKNET_FILTER_BPF_REDIRECT
+ *  Packet is sent to network interface with the ID given in the verdict.
+ *
+ *  NGKNET_FILTER_BPF_SAMPLE
+ *  Packet is sent to kernel filter call-back function, e.g. for sampling.
+ *
+ * Any other verdict drops the packet.
+ */
+/*! Drop packet */
+#define NGKNET_FILTER_BPF_DROP      0
+/*! Send packet to the filter netif */
+#define NGKNET_FILTER_BPF_PASS      1
+/*! Send packet to the netif in the verdict */
+#define NGKNET_FILTER_BPF_REDIRECT  2
+/*! Send packet to kernel filter call-back function */
+#define NGKNET_FILTER_BPF_SAMPLE    3
+
+/*! Build BPF verdict */
+#define NGKNET_FILTER_BPF_VERDICT(_act, _id)    (((_id) & 0xffff) << 8 | ((_act) & 0xff))
+/*! Get action from BPF verdict */
+#define NGKNET_FILTER_BPF_ACT(_v)               ((_v) & 0xff)
+/*! Get netif ID from BPF verdict */
+#define NGKNET_FILTER_BPF_ID(_v)                (((_v) >> 8) & 0xffff)
+
 /*!
  * \brief Filter description.
  */
@@ -291,6 +339,52 @@ typedef struct ngknet_filter_s {
     uint8_t user_data[NGKNET_FILTER_USER_DATA];
 } ngknet_filter_t;
 
+/*!
+ * \brief Rx rate limit per traffic class
+ *
+ * Every Rx channel and every filter owns a token bucket. Packets exceeding
+ * the bucket are dropped before they are delivered, so a flood of one class
+ * does not starve the others.
+ *
+ * Class types:
+ *
+ *  NGKNET_RL_CLASS_RX_CHAN
+ *  Packets received on the Rx channel <id>.
+ *
+ *  NGKNET_RL_CLASS_FILTER
+ *  Packets matching the filter <id>.
+ */
+/*! Rate limit per Rx channel */
+#define NGKNET_RL_CLASS_RX_CHAN     0
+/*! Rate limit per filter */
+#define NGKNET_RL_CLASS_FILTER      1
+
+/*!
+ * \brief Rate limit description.
+ */
+typedef struct ngknet_rate_limit_s {
+    /*! Class type. Refer to \ref NGKNET_RL_CLASS_XXX. */
+    uint16_t class_type;
+
+    /*! Rx channel or filter ID */
+    uint16_t id;
+
+    /*! Rate in packets per second (0 means no limit) */
+    uint32_t rate;
+
+    /*! Burst size in packets (0 means rate / 10, at most rate) */
+    uint32_t burst;
+
+    /*! Reserved */
+    uint32_t rsvd;
+
+    /*! Packets passed while the rate is limited */
+    uint64_t passed;
+
+    /*! Packets dropped for exceeding the rate */
+    uint64_t dropped;
+} ngknet_rate_limit_t;
+
 /*!
  * \brief Device information.
  */
@@ -42,6 +42,7 @@
 
 #define NGKNET_VERSION_GET      _IOR(NGKNET_IOC_MAGIC,  0xa0, unsigned int)
 #define NGKNET_RX_RATE_LIMIT    _IOWR(NGKNET_IOC_MAGIC, 0xa1, unsigned int)
+#define NGKNET_RX_CLASS_LIMIT   _IOWR(NGKNET_IOC_MAGIC, 0xa2, unsigned int)
 #define NGKNET_DEV_INIT         _IOWR(NGKNET_IOC_MAGIC, 0xb0, unsigned int)
 #define NGKNET_DEV_DEINIT       _IOWR(NGKNET_IOC_MAGIC, 0xb1, unsigned int)
 #define NGKNET_DEV_SUSPEND      _IOWR(NGKNET_IOC_MAGIC, 0xb2, unsigned int)
@@ -63,6 +64,7 @@
 #define NGKNET_FILT_DESTROY     _IOWR(NGKNET_IOC_MAGIC, 0xe1, unsigned int)
 #define NGKNET_FILT_GET         _IOR(NGKNET_IOC_MAGIC,  0xe2, unsigned int)
 #define NGKNET_FILT_NEXT        _IOR(NGKNET_IOC_MAGIC,  0xe3, unsigned int)
+#define NGKNET_FILT_BPF         _IOWR(NGKNET_IOC_MAGIC, 0xe4, unsigned int)
 #define NGKNET_INFO_GET         _IOR(NGKNET_IOC_MAGIC,  0xf0, unsigned int)
 #define NGKNET_STATS_GET        _IOR(NGKNET_IOC_MAGIC,  0xf1, unsigned int)
 #define NGKNET_STATS_RESET      _IOWR(NGKNET_IOC_MAGIC, 0xf2, unsigned int)
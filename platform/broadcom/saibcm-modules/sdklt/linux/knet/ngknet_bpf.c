@@ -0,0 +1,174 @@
+/*! \file ngknet_bpf.c
+ *
+ * NGKNET filter BPF programs.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include "ngknet_bpf.h"
+
+#if NGKNET_FILTER_BPF
+
+/*
+ * Filter programs are TC classifiers, so that they get direct packet access,
+ * the metadata area and the map helpers without a new program type. The Rx
+ * packet header and metadata are pulled from the SKB while the program runs
+ * and the metadata is exposed through data_meta.
+ */
+
+int
+ngknet_filter_bpf_set(struct ngknet_dev *dev, int id, int fd)
+{
+    struct filt_ctrl *fc = NULL;
+    struct bpf_prog *prog = NULL, *old_prog;
+
+    if (id <= 0 || id > NUM_FILTER_MAX) {
+        return SHR_E_PARAM;
+    }
+
+    if (fd >= 0) {
+        prog = bpf_prog_get_type(fd, BPF_PROG_TYPE_SCHED_CLS);
+        if (IS_ERR(prog)) {
+            return SHR_E_PARAM;
+        }
+    }
+
+    /* The filter cannot go away while the configuration lock is held */
+    mutex_lock(&dev->filt_lock);
+
+    fc = (struct filt_ctrl *)dev->fc[id];
+    if (!fc || fc->filt.dest_type != NGKNET_FILTER_DEST_T_CB) {
+        mutex_unlock(&dev->filt_lock);
+        if (prog) {
+            bpf_prog_put(prog);
+        }
+        return fc ? SHR_E_PARAM : SHR_E_NOT_FOUND;
+    }
+
+    old_prog = rcu_dereference_protected(fc->prog,
+                                         lockdep_is_held(&dev->filt_lock));
+    rcu_assign_pointer(fc->prog, prog);
+
+    mutex_unlock(&dev->filt_lock);
+
+    /* The program itself is freed after an RCU grace period */
+    if (old_prog) {
+        bpf_prog_put(old_prog);
+    }
+
+    return SHR_E_NONE;
+}
+
+uint32_t
+ngknet_filter_bpf_run(struct ngknet_dev *dev, struct filt_ctrl *fc,
+                      struct sk_buff *skb, int chan)
+{
+    struct pkt_hdr *pkh = (struct pkt_hdr *)skb->data;
+    struct net_device *dev_saved = skb->dev;
+    struct bpf_prog *prog;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    struct bpf_net_context __bpf_net_ctx, *bpf_net_ctx;
+#endif
+    uint8_t cb_saved[sizeof(skb->cb)];
+    uint32_t hdr_len, len, verdict;
+
+    prog = rcu_dereference(fc->prog);
+    if (!prog) {
+        return NGKNET_FILTER_BPF_SAMPLE;
+    }
+
+    /* The BPF control block overlaps ours */
+    memcpy(cb_saved, skb->cb, sizeof(cb_saved));
+
+    hdr_len = PKT_HDR_SIZE + pkh->meta_len;
+    __skb_pull(skb, hdr_len);
+    skb_reset_mac_header(skb);
+    skb_metadata_set(skb, pkh->meta_len);
+    skb->dev = dev->net_dev;
+    skb->mark = fc->filt.id;
+    skb->queue_mapping = chan;
+    len = skb->len;
+
+    /* The HNET path runs in process context */
+    local_bh_disable();
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    bpf_net_ctx = bpf_net_ctx_set(&__bpf_net_ctx);
+#endif
+    bpf_compute_data_pointers(skb);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0))
+    verdict = bpf_prog_run(prog, skb);
+#else
+    verdict = BPF_PROG_RUN(prog, skb);
+#endif
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    bpf_net_ctx_clear(bpf_net_ctx);
+#endif
+    local_bh_enable();
+
+    skb_metadata_clear(skb);
+    skb->dev = dev_saved;
+    skb->mark = 0;
+    skb->queue_mapping = 0;
+    __skb_push(skb, hdr_len);
+    memcpy(skb->cb, cb_saved, sizeof(cb_saved));
+
+    /* The program may have resized the packet */
+    pkh = (struct pkt_hdr *)skb->data;
+    pkh->data_len += skb->len - hdr_len - len;
+
+    return verdict;
+}
+
+void
+ngknet_filter_bpf_release(struct filt_ctrl *fc)
+{
+    struct bpf_prog *prog;
+
+    prog = rcu_dereference_protected(fc->prog, 1);
+    RCU_INIT_POINTER(fc->prog, NULL);
+    if (prog) {
+        bpf_prog_put(prog);
+    }
+}
+
+uint32_t
+ngknet_filter_bpf_prog_id(struct ngknet_dev *dev, int id)
+{
+    struct filt_ctrl *fc = NULL;
+    struct bpf_prog *prog;
+    uint32_t prog_id = 0;
+
+    if (id <= 0 || id > NUM_FILTER_MAX) {
+        return 0;
+    }
+
+    mutex_lock(&dev->filt_lock);
+    fc = (struct filt_ctrl *)dev->fc[id];
+    if (fc) {
+        prog = rcu_dereference_protected(fc->prog,
+                                         lockdep_is_held(&dev->filt_lock));
+        if (prog) {
+            prog_id = prog->aux->id;
+        }
+    }
+    mutex_unlock(&dev->filt_lock);
+
+    return prog_id;
+}
+
+#endif /* NGKNET_FILTER_BPF */
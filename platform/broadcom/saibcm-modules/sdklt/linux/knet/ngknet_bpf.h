@@ -0,0 +1,87 @@
+/*! \file ngknet_bpf.h
+ *
+ * Definitions and APIs declaration for filter BPF programs.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef NGKNET_BPF_H
+#define NGKNET_BPF_H
+
+#include <linux/skbuff.h>
+#include "ngknet_main.h"
+#include "ngknet_extra.h"
+
+#if NGKNET_FILTER_BPF
+
+/*!
+ * \brief Attach a BPF program to a filter.
+ *
+ * The program must be of type BPF_PROG_TYPE_SCHED_CLS and the filter
+ * destination must be NGKNET_FILTER_DEST_T_CB. Any program already
+ * attached to the filter is replaced.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] id Filter ID.
+ * \param [in] fd BPF program file descriptor, negative to detach.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_filter_bpf_set(struct ngknet_dev *dev, int id, int fd);
+
+/*!
+ * \brief Run the BPF program of a callback filter on an Rx packet.
+ *
+ * Must be called within an RCU read-side critical section. The program
+ * may reallocate the SKB data, so any pointer into it must be reloaded.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] fc Filter control.
+ * \param [in] skb Rx packet SKB.
+ * \param [in] chan Rx channel.
+ *
+ * \return BPF verdict, NGKNET_FILTER_BPF_SAMPLE if no program attached.
+ */
+extern uint32_t
+ngknet_filter_bpf_run(struct ngknet_dev *dev, struct filt_ctrl *fc,
+                      struct sk_buff *skb, int chan);
+
+/*!
+ * \brief Release the BPF program of a filter being freed.
+ *
+ * \param [in] fc Filter control.
+ */
+extern void
+ngknet_filter_bpf_release(struct filt_ctrl *fc);
+
+/*!
+ * \brief Get the BPF program attached to a filter.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] id Filter ID.
+ *
+ * \return BPF program ID or 0 if none.
+ */
+extern uint32_t
+ngknet_filter_bpf_prog_id(struct ngknet_dev *dev, int id);
+
+#endif /* NGKNET_FILTER_BPF */
+
+#endif /* NGKNET_BPF_H */
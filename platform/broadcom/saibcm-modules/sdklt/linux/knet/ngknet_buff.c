@@ -48,6 +48,59 @@ ngknet_ring_buf_free(struct pdma_dev *dev, uint32_t size, void *addr, dma_addr_t
     dma_free_coherent(kdev->dev, size, addr, dma);
 }
 
+#if NGKNET_PAGE_POOL
+/*!
+ * Destroy Rx page pool of a queue
+ *
+ * Pages still held by buffers or by the stack keep the pool alive until
+ * they are returned.
+ */
+static void
+ngknet_rx_pool_destroy(struct ngknet_dev *kdev, int queue)
+{
+    if (kdev->rx_pool[queue]) {
+        page_pool_destroy(kdev->rx_pool[queue]);
+        kdev->rx_pool[queue] = NULL;
+    }
+}
+
+/*!
+ * Set up Rx page pool of a queue
+ */
+static void
+ngknet_rx_pool_setup(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
+                     enum buf_mode mode)
+{
+    struct ngknet_dev *kdev = (struct ngknet_dev *)dev->priv;
+    struct page_pool_params pp = {0};
+    struct page_pool *pool;
+
+    ngknet_rx_pool_destroy(kdev, rxq->queue_id);
+
+    if (mode != PDMA_BUF_MODE_PAGE) {
+        return;
+    }
+
+    pp.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+    pp.order = rxq->page_order;
+    pp.pool_size = rxq->nb_desc;
+    pp.nid = dev_to_node(kdev->dev);
+    pp.dev = kdev->dev;
+    pp.dma_dir = DMA_FROM_DEVICE;
+    pp.offset = 0;
+    pp.max_len = PAGE_SIZE * (1 << rxq->page_order);
+
+    pool = page_pool_create(&pp);
+    if (IS_ERR(pool)) {
+        /* Fall back to allocating and mapping pages on demand */
+        printk(KERN_WARNING "ngknet: failed to create page pool for Rx queue %d\n",
+               rxq->queue_id);
+        return;
+    }
+    kdev->rx_pool[rxq->queue_id] = pool;
+}
+#endif /* NGKNET_PAGE_POOL */
+
 /*!
  * Allocate Rx buffer
  */
@@ -56,27 +109,48 @@ ngknet_rx_buf_alloc(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
                     struct pdma_rx_buf *pbuf)
 {
     struct ngknet_dev *kdev = (struct ngknet_dev *)dev->priv;
+    struct ngknet_rx_buf_stats *bs = &kdev->rx_buf_stats[rxq->queue_id];
     dma_addr_t dma;
     struct page *page;
     struct sk_buff *skb;
 
     if (rxq->buf_mode == PDMA_BUF_MODE_PAGE) {
+#if NGKNET_PAGE_POOL
+        /* Pages from the pool are mapped once and stay mapped */
+        pbuf->pool = kdev->rx_pool[rxq->queue_id];
+        if (pbuf->pool) {
+            page = page_pool_dev_alloc_pages(pbuf->pool);
+            if (unlikely(!page)) {
+                bs->alloc_fails++;
+                return SHR_E_MEMORY;
+            }
+            bs->allocs++;
+            pbuf->dma = page_pool_get_dma_addr(page);
+            pbuf->page = page;
+            pbuf->page_offset = 0;
+            return SHR_E_NONE;
+        }
+#endif
         page = kal_dev_alloc_pages(rxq->page_order);
         if (unlikely(!page)) {
+            bs->alloc_fails++;
             return SHR_E_MEMORY;
         }
         dma = kal_dma_map_page_attrs(kdev->dev, page, 0, PAGE_SIZE * (1 << rxq->page_order), DMA_FROM_DEVICE,
                                      DMA_ATTR_SKIP_CPU_SYNC | DMA_ATTR_WEAK_ORDERING);
         if (unlikely(dma_mapping_error(kdev->dev, dma))) {
             __free_pages(page, rxq->page_order);
+            bs->alloc_fails++;
             return SHR_E_MEMORY;
         }
+        bs->allocs++;
         pbuf->dma = dma;
         pbuf->page = page;
         pbuf->page_offset = 0;
     } else {
         skb = netdev_alloc_skb(kdev->net_dev, PDMA_RXB_RESV + pbuf->adj + rxq->buf_size);
         if (unlikely(!skb)) {
+            bs->alloc_fails++;
             return SHR_E_MEMORY;
         }
         skb_reserve(skb, PDMA_RXB_ALIGN - (((unsigned long)skb->data) & (PDMA_RXB_ALIGN - 1)));
@@ -85,8 +159,10 @@ ngknet_rx_buf_alloc(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
         dma = dma_map_single(kdev->dev, &pbuf->pkb->data + pbuf->adj, rxq->buf_size, DMA_FROM_DEVICE);
         if (unlikely(dma_mapping_error(kdev->dev, dma))) {
             dev_kfree_skb_any(skb);
+            bs->alloc_fails++;
             return SHR_E_MEMORY;
         }
+        bs->allocs++;
         pbuf->dma = dma;
     }
 
@@ -129,6 +205,7 @@ ngknet_rx_buf_get(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
                   struct pdma_rx_buf *pbuf, int len)
 {
     struct ngknet_dev *kdev = (struct ngknet_dev *)dev->priv;
+    struct ngknet_rx_buf_stats *bs = &kdev->rx_buf_stats[rxq->queue_id];
     struct sk_buff *skb;
     uint32_t pages_size;
 
@@ -152,10 +229,24 @@ ngknet_rx_buf_get(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
         if (unlikely(page_count(pbuf->page) != 1) ||
             kal_page_is_pfmemalloc(pbuf->page) ||
             page_to_nid(pbuf->page) != numa_mem_id()) {
-            kal_dma_unmap_page_attrs(kdev->dev, pbuf->dma, pages_size, DMA_FROM_DEVICE,
-                                     DMA_ATTR_SKIP_CPU_SYNC | DMA_ATTR_WEAK_ORDERING);
+#if NGKNET_PAGE_POOL
+            if (pbuf->pool) {
+                /*
+                 * The page goes back to the pool if it is the last
+                 * reference when the stack frees it, otherwise the pool
+                 * unmaps and releases it. Recycles are counted by the pool.
+                 */
+                skb_mark_for_recycle(skb);
+            } else
+#endif
+            {
+                kal_dma_unmap_page_attrs(kdev->dev, pbuf->dma, pages_size, DMA_FROM_DEVICE,
+                                         DMA_ATTR_SKIP_CPU_SYNC | DMA_ATTR_WEAK_ORDERING);
+            }
+            bs->releases++;
             pbuf->dma = 0;
         } else {
+            bs->reuses++;
             pbuf->page_offset ^= pages_size >> 1;
             page_ref_inc(pbuf->page);
             dma_sync_single_range_for_device(kdev->dev, pbuf->dma, pbuf->page_offset,
@@ -223,10 +314,18 @@ ngknet_rx_buf_free(struct pdma_dev *dev, struct pdma_rx_queue *rxq,
         if (!pbuf->page) {
             return;
         }
-        pages_size = PAGE_SIZE * (1 << rxq->page_order);
-        kal_dma_unmap_page_attrs(kdev->dev, pbuf->dma, pages_size, DMA_FROM_DEVICE,
-                                 DMA_ATTR_SKIP_CPU_SYNC | DMA_ATTR_WEAK_ORDERING);
-        __free_pages(pbuf->page, rxq->page_order);
+#if NGKNET_PAGE_POOL
+        if (pbuf->pool) {
+            page_pool_put_full_page(pbuf->pool, pbuf->page, false);
+            pbuf->pool = NULL;
+        } else
+#endif
+        {
+            pages_size = PAGE_SIZE * (1 << rxq->page_order);
+            kal_dma_unmap_page_attrs(kdev->dev, pbuf->dma, pages_size, DMA_FROM_DEVICE,
+                                     DMA_ATTR_SKIP_CPU_SYNC | DMA_ATTR_WEAK_ORDERING);
+            __free_pages(pbuf->page, rxq->page_order);
+        }
     } else {
         if (!pbuf->skb) {
             return;
@@ -250,31 +349,39 @@ static enum buf_mode
 ngknet_rx_buf_mode(struct pdma_dev *dev, struct pdma_rx_queue *rxq)
 {
     uint32_t len, order;
+    enum buf_mode mode = PDMA_BUF_MODE_PAGE;
 
     switch (ngknet_page_buffer_mode_get()) {
     case 0:
         /* Forced SKB mode */
-        return PDMA_BUF_MODE_SKB;
+        mode = PDMA_BUF_MODE_SKB;
+        break;
     case 1:
         /* Forced page mode */
         break;
     default: /* -1 */
         /* Select buffer mode based on system capability */
         if (kal_support_paged_skb() == 0) {
-            return PDMA_BUF_MODE_SKB;
+            mode = PDMA_BUF_MODE_SKB;
         }
         break;
     }
 
-    len = dev->rx_ph_size ? rxq->buf_size : rxq->buf_size + PDMA_RXB_META;
-    for (order = 0; order < 32; order++) {
-        if (PDMA_RXB_SIZE(len) * 2 <= PAGE_SIZE * (1 << order)) {
-            rxq->page_order = order;
-            break;
+    if (mode == PDMA_BUF_MODE_PAGE) {
+        len = dev->rx_ph_size ? rxq->buf_size : rxq->buf_size + PDMA_RXB_META;
+        for (order = 0; order < 32; order++) {
+            if (PDMA_RXB_SIZE(len) * 2 <= PAGE_SIZE * (1 << order)) {
+                rxq->page_order = order;
+                break;
+            }
         }
     }
 
-    return PDMA_BUF_MODE_PAGE;
+#if NGKNET_PAGE_POOL
+    ngknet_rx_pool_setup(dev, rxq, mode);
+#endif
+
+    return mode;
 }
 
 /*!
@@ -365,3 +472,19 @@ bcmcnet_buf_mngr_init(struct pdma_dev *dev)
     dev->ctrl.buf_mngr = (struct pdma_buf_mngr *)&buf_mngr;
 }
 
+/*!
+ * Close a device
+ */
+void
+bcmcnet_buf_mngr_cleanup(struct pdma_dev *dev)
+{
+#if NGKNET_PAGE_POOL
+    struct ngknet_dev *kdev = (struct ngknet_dev *)dev->priv;
+    int qi;
+
+    for (qi = 0; qi < NUM_Q_MAX; qi++) {
+        ngknet_rx_pool_destroy(kdev, qi);
+    }
+#endif
+}
+
@@ -55,6 +55,11 @@ struct pdma_rx_buf {
 
     /*! Packet buffer adjustment */
     uint32_t adj;
+
+#if NGKNET_PAGE_POOL
+    /*! Page pool the buffer page comes from */
+    struct page_pool *pool;
+#endif
 };
 
 /*!
@@ -25,10 +25,14 @@
 
 #include <shr/shr_error.h>
 #include <ngknet_linux.h>
+#include <linux/math64.h>
 
 /*! Memorry barrier */
 #define MEMORY_BARRIER      smp_mb()
 
+/*! 64-bit by 32-bit unsigned division */
+#define CNET_DIV_U64(n, d)  div_u64(n, d)
+
 /*! CNET log macros */
 #define CNET_INFO(unit, fmt, args...)   printk(KERN_INFO fmt, ##args)
 #define CNET_ERROR(unit, fmt, args...)  printk(KERN_ERR fmt, ##args)
@@ -48,6 +52,7 @@ extern int _bd##_cnet_pdma_detach(struct pdma_dev *dev);
 typedef enum {
     NGKNET_DEV_T_NONE = 0,
 #include <bcmdrd/bcmdrd_devlist.h>
+    NGKNET_DEV_T_SIM,
     NGKNET_DEV_T_COUNT
 } ngknet_dev_type_t;
 
@@ -43,18 +43,189 @@
 #include <linux/delay.h>
 #include <linux/bitops.h>
 #include <linux/time.h>
+#include <linux/jhash.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
 
 #include <lkm/ngknet_dev.h>
 #include <bcmcnet/bcmcnet_core.h>
 #include "ngknet_main.h"
 #include "ngknet_extra.h"
+#include "ngknet_filt.h"
 #include "ngknet_callback.h"
+#include "ngknet_bpf.h"
 
 /*! Defalut Rx tick for Rx rate limit control. */
 #define NGKNET_EXTRA_RATE_LIMIT_DEFAULT_RX_TICK 10
 
 static struct ngknet_rl_ctrl rl_ctrl;
 
+/*!
+ * Reset a token bucket with a new rate
+ *
+ * Called with the bucket lock held.
+ */
+static void
+ngknet_rx_tbf_reset(struct ngknet_rx_tbf *tbf, uint32_t rate, uint32_t burst)
+{
+    if (rate) {
+        if (!burst) {
+            burst = rate / 10;
+        }
+        /* No more than one second worth of tokens, see ngknet_rx_tbf_conform */
+        burst = clamp(burst, 1U, rate);
+    } else {
+        burst = 0;
+    }
+
+    tbf->rate = rate;
+    tbf->burst = burst;
+    tbf->tokens = (uint64_t)burst * NSEC_PER_SEC;
+    tbf->last_ns = ktime_get_ns();
+    tbf->passed = 0;
+    tbf->dropped = 0;
+}
+
+/*!
+ * Initialize a token bucket without limit
+ */
+static void
+ngknet_rx_tbf_init(struct ngknet_rx_tbf *tbf)
+{
+    spin_lock_init(&tbf->lock);
+    ngknet_rx_tbf_reset(tbf, 0, 0);
+}
+
+/*!
+ * Take a token for a packet
+ *
+ * The refill is capped to one second, so neither the refill nor the bucket
+ * depth can overflow with a 32-bit rate.
+ */
+static bool
+ngknet_rx_tbf_conform(struct ngknet_rx_tbf *tbf)
+{
+    uint64_t now, elapsed, depth;
+    bool conform;
+
+    if (!READ_ONCE(tbf->rate)) {
+        return true;
+    }
+
+    now = ktime_get_ns();
+
+    spin_lock_bh(&tbf->lock);
+    if (!tbf->rate) {
+        spin_unlock_bh(&tbf->lock);
+        return true;
+    }
+    elapsed = min_t(uint64_t, now - tbf->last_ns, NSEC_PER_SEC);
+    depth = (uint64_t)tbf->burst * NSEC_PER_SEC;
+    tbf->tokens = min(tbf->tokens + elapsed * tbf->rate, depth);
+    tbf->last_ns = now;
+    conform = tbf->tokens >= NSEC_PER_SEC;
+    if (conform) {
+        tbf->tokens -= NSEC_PER_SEC;
+        tbf->passed++;
+    } else {
+        tbf->dropped++;
+    }
+    spin_unlock_bh(&tbf->lock);
+
+    return conform;
+}
+
+/*!
+ * Compile the filter list into a filter table
+ *
+ * The filter list must be protected by the caller.
+ */
+static int
+ngknet_filter_table_build(struct ngknet_dev *dev, struct filt_table **tbl)
+{
+    struct filt_table *ft = NULL;
+    struct filt_ctrl *fc = NULL;
+    int num_filts = 0;
+
+    *tbl = NULL;
+
+    list_for_each_entry(fc, &dev->filt_list, list) {
+        num_filts++;
+    }
+    if (!num_filts) {
+        return SHR_E_NONE;
+    }
+
+    ft = ngknet_filt_table_alloc(num_filts);
+    if (!ft) {
+        return SHR_E_MEMORY;
+    }
+    list_for_each_entry(fc, &dev->filt_list, list) {
+        ngknet_filt_table_add(ft, &fc->filt, fc);
+    }
+    ngknet_filt_table_finalize(ft);
+
+    *tbl = ft;
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Publish a new filter table
+ *
+ * Called with the filter configuration lock held.
+ */
+static void
+ngknet_filter_table_publish(struct ngknet_dev *dev, struct filt_table *ft)
+{
+    struct filt_table *old = NULL;
+
+    old = rcu_dereference_protected(dev->filt_tbl,
+                                    lockdep_is_held(&dev->filt_lock));
+    rcu_assign_pointer(dev->filt_tbl, ft);
+    if (old) {
+        kfree_rcu(old, rcu);
+    }
+}
+
+/*!
+ * Rebuild and publish the filter table
+ *
+ * The current table is kept if the rebuild fails.
+ */
+static int
+ngknet_filter_table_update(struct ngknet_dev *dev)
+{
+    struct filt_table *ft = NULL;
+    int rv;
+
+    rv = ngknet_filter_table_build(dev, &ft);
+    if (SHR_FAILURE(rv)) {
+        return rv;
+    }
+
+    ngknet_filter_table_publish(dev, ft);
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Free filter control after the Rx path stops looking at it
+ */
+static void
+ngknet_filter_free_rcu(struct rcu_head *rcu)
+{
+    struct filt_ctrl *fc = container_of(rcu, struct filt_ctrl, rcu);
+
+#if NGKNET_FILTER_BPF
+    ngknet_filter_bpf_release(fc);
+#endif
+    free_percpu(fc->hits);
+    kfree(fc);
+}
+
 int
 ngknet_filter_create(struct ngknet_dev *dev, ngknet_filter_t *filter)
 {
@@ -63,6 +234,7 @@ ngknet_filter_create(struct ngknet_dev *dev, ngknet_filter_t *filter)
     ngknet_filter_t *filt = NULL;
     unsigned long flags;
     int num, id, done = 0;
+    int rv;
 
     switch (filter->type) {
     case NGKNET_FILTER_T_RX_PKT:
@@ -81,6 +253,23 @@ ngknet_filter_create(struct ngknet_dev *dev, ngknet_filter_t *filter)
         return SHR_E_UNAVAIL;
     }
 
+    if (filter->oob_data_size + filter->pkt_data_size > NGKNET_FILTER_BYTES_MAX) {
+        return SHR_E_PARAM;
+    }
+
+    fc = kzalloc(sizeof(*fc), GFP_KERNEL);
+    if (!fc) {
+        return SHR_E_MEMORY;
+    }
+    fc->hits = alloc_percpu(uint64_t);
+    if (!fc->hits) {
+        kfree(fc);
+        return SHR_E_MEMORY;
+    }
+    ngknet_rx_tbf_init(&fc->tbf);
+
+    mutex_lock(&dev->filt_lock);
+
     spin_lock_irqsave(&dev->lock, flags);
 
     num = (long)dev->fc[0];
@@ -91,15 +280,12 @@ ngknet_filter_create(struct ngknet_dev *dev, ngknet_filter_t *filter)
     }
     if (id > NUM_FILTER_MAX) {
         spin_unlock_irqrestore(&dev->lock, flags);
+        mutex_unlock(&dev->filt_lock);
+        free_percpu(fc->hits);
+        kfree(fc);
         return SHR_E_RESOURCE;
     }
 
-    fc = kzalloc(sizeof(*fc), GFP_KERNEL);
-    if (!fc) {
-        spin_unlock_irqrestore(&dev->lock, flags);
-        return SHR_E_MEMORY;
-    }
-
     dev->fc[id] = fc;
     num += id == (num + 1) ? 1 : 0;
     dev->fc[0] = (void *)(long)num;
@@ -137,7 +323,26 @@ ngknet_filter_create(struct ngknet_dev *dev, ngknet_filter_t *filter)
 
     spin_unlock_irqrestore(&dev->lock, flags);
 
-    return SHR_E_NONE;
+    rv = ngknet_filter_table_update(dev);
+    if (SHR_FAILURE(rv)) {
+        spin_lock_irqsave(&dev->lock, flags);
+        list_del(&fc->list);
+        dev->fc[id] = NULL;
+        num = (long)dev->fc[0];
+        while (num-- == id--) {
+            if (dev->fc[id]) {
+                dev->fc[0] = (void *)(long)num;
+                break;
+            }
+        }
+        spin_unlock_irqrestore(&dev->lock, flags);
+        free_percpu(fc->hits);
+        kfree(fc);
+    }
+
+    mutex_unlock(&dev->filt_lock);
+
+    return rv;
 }
 
 int
@@ -146,21 +351,24 @@ ngknet_filter_destroy(struct ngknet_dev *dev, int id)
     struct filt_ctrl *fc = NULL;
     unsigned long flags;
     int num;
+    int rv;
 
     if (id <= 0 || id > NUM_FILTER_MAX) {
         return SHR_E_PARAM;
     }
 
+    mutex_lock(&dev->filt_lock);
+
     spin_lock_irqsave(&dev->lock, flags);
 
     fc = (struct filt_ctrl *)dev->fc[id];
     if (!fc) {
         spin_unlock_irqrestore(&dev->lock, flags);
+        mutex_unlock(&dev->filt_lock);
         return SHR_E_NOT_FOUND;
     }
 
     list_del(&fc->list);
-    kfree(fc);
 
     dev->fc[id] = NULL;
     num = (long)dev->fc[0];
@@ -173,7 +381,21 @@ ngknet_filter_destroy(struct ngknet_dev *dev, int id)
 
     spin_unlock_irqrestore(&dev->lock, flags);
 
-    return SHR_E_NONE;
+    rv = ngknet_filter_table_update(dev);
+    if (SHR_FAILURE(rv)) {
+        /* The stale table must not refer to the filter being freed */
+        ngknet_filter_table_publish(dev, NULL);
+        printk(KERN_WARNING "ngknet: filter table rebuild failed, "
+                            "all filters bypassed\n");
+        rv = SHR_E_NONE;
+    }
+
+    mutex_unlock(&dev->filt_lock);
+
+    /* The Rx path might still be looking at this filter */
+    call_rcu(&fc->rcu, ngknet_filter_free_rcu);
+
+    return rv;
 }
 
 int
@@ -247,6 +469,19 @@ ngknet_filter_get_next(struct ngknet_dev *dev, ngknet_filter_t *filter)
     return ngknet_filter_get(dev, filter->next, filter);
 }
 
+uint64_t
+ngknet_filter_hits_get(struct filt_ctrl *fc)
+{
+    uint64_t hits = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        hits += *per_cpu_ptr(fc->hits, cpu);
+    }
+
+    return hits;
+}
+
 int
 ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_device **ndev,
                      struct net_device **mndev, struct sk_buff **mskb)
@@ -255,15 +490,14 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
     struct net_device *dest_ndev = NULL, *mirror_ndev = NULL;
     struct sk_buff *mirror_skb = NULL;
     struct ngknet_private *priv = NULL;
-    struct filt_ctrl *fc = NULL;
-    struct list_head *list = NULL;
-    ngknet_filter_t scratch, *filt = NULL, *filt_cb = NULL;
+    struct filt_table *ft = NULL;
+    struct filt_ctrl *fc = NULL, *cb_fc = NULL;
+    void *cb = NULL;
+    ngknet_filter_t *filt = NULL, *filt_cb = NULL;
     uint8_t *oob = &pkb->data, *data = NULL;
-    uint16_t tpid;
-    unsigned long flags;
-    int wsize;
+    uint16_t tpid, dest_type, dest_id;
     int chan_id;
-    int rv, idx, match = 0,match_cb = 0;
+    int rv;
 
     rv = bcmcnet_pdma_dev_queue_to_chan(&dev->pdma_dev, pkb->pkh.queue_id,
                                         PDMA_Q_RX, &chan_id);
@@ -271,63 +505,74 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
         return rv;
     }
 
-    spin_lock_irqsave(&dev->lock, flags);
+    /* Drop the excess of a flooded channel before any lookup */
+    if (!ngknet_rx_tbf_conform(&dev->rx_tbf[chan_id])) {
+        return SHR_E_RESOURCE;
+    }
+
+    /*
+     * Network interfaces and filters are freed after an RCU grace period,
+     * so they stay valid all through the lookup below.
+     */
+    rcu_read_lock();
 
-    dest_ndev = dev->bdev[chan_id];
+    dest_ndev = READ_ONCE(dev->bdev[chan_id]);
     if (dest_ndev) {
         skb->dev = dest_ndev;
         priv = netdev_priv(dest_ndev);
-        priv->users++;
+        atomic_inc(&priv->users);
         *ndev = dest_ndev;
-        spin_unlock_irqrestore(&dev->lock, flags);
+        rcu_read_unlock();
         return SHR_E_NONE;
     }
 
-    if (list_empty(&dev->filt_list)) {
-        spin_unlock_irqrestore(&dev->lock, flags);
+    ft = rcu_dereference(dev->filt_tbl);
+    if (!ft) {
+        rcu_read_unlock();
         return SHR_E_NONE;
     }
 
-    list_for_each(list, &dev->filt_list) {
-        fc = (struct filt_ctrl *)list;
-        filt = &fc->filt;
-        if (filt->flags & NGKNET_FILTER_F_ANY_DATA) {
-            match = 1;
-            break;
-        }
-        if (filt->flags & NGKNET_FILTER_F_MATCH_CHAN && filt->chan != chan_id) {
-            continue;
+    fc = ngknet_filt_lookup(ft, oob, oob + pkb->pkh.meta_len, chan_id, &cb);
+    cb_fc = cb;
+    if (fc) {
+        this_cpu_inc(*fc->hits);
+        if (!ngknet_rx_tbf_conform(&fc->tbf)) {
+            rcu_read_unlock();
+            return SHR_E_RESOURCE;
         }
-        memcpy(&scratch.data.b[0],
-               &oob[filt->oob_data_offset], filt->oob_data_size);
-        memcpy(&scratch.data.b[filt->oob_data_size],
-               &pkb->data + pkb->pkh.meta_len + filt->pkt_data_offset,
-               filt->pkt_data_size);
-        wsize = NGKNET_BYTES2WORDS(filt->oob_data_size + filt->pkt_data_size);
-        for (idx = 0; idx < wsize; idx++) {
-            scratch.data.w[idx] &= filt->mask.w[idx];
-            if (scratch.data.w[idx] != filt->data.w[idx]) {
+        filt = &fc->filt;
+        filt_cb = cb_fc ? &cb_fc->filt : NULL;
+        dest_type = filt->dest_type;
+        dest_id = filt->dest_id;
+#if NGKNET_FILTER_BPF
+        if (dest_type == NGKNET_FILTER_DEST_T_CB) {
+            uint32_t verdict = ngknet_filter_bpf_run(dev, fc, skb, chan_id);
+            pkb = (struct pkt_buf *)skb->data;
+            switch (NGKNET_FILTER_BPF_ACT(verdict)) {
+            case NGKNET_FILTER_BPF_PASS:
+                dest_type = NGKNET_FILTER_DEST_T_NETIF;
                 break;
+            case NGKNET_FILTER_BPF_REDIRECT:
+                dest_type = NGKNET_FILTER_DEST_T_NETIF;
+                dest_id = NGKNET_FILTER_BPF_ID(verdict);
+                if (dest_id > NUM_VDEV_MAX) {
+                    rcu_read_unlock();
+                    return SHR_E_UNAVAIL;
+                }
+                break;
+            case NGKNET_FILTER_BPF_SAMPLE:
+                break;
+            default:
+                rcu_read_unlock();
+                return SHR_E_UNAVAIL;
             }
         }
-        if (idx == wsize) {
-            if (NGKNET_FILTER_DEST_T_CB == filt->dest_type) {
-                match_cb = 1;
-                filt_cb = filt;
-                continue;
-            }
-            match = 1;
-            break;
-        }
-    }
-
-    if (match) {
-        fc->hits++;
-        if (filt->dest_type == NGKNET_FILTER_DEST_T_CB) {
+#endif
+        if (dest_type == NGKNET_FILTER_DEST_T_CB) {
             struct ngknet_callback_desc *cbd = NGKNET_SKB_CB(skb);
             struct pkt_hdr *pkh = (struct pkt_hdr *)skb->data;
             if (!dev->cbc->filter_cb) {
-                spin_unlock_irqrestore(&dev->lock, flags);
+                rcu_read_unlock();
                 return SHR_E_UNAVAIL;
             }
             cbd->dinfo = &dev->dev_info;
@@ -337,16 +582,18 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
             cbd->filt = filt;
             skb = dev->cbc->filter_cb(skb, &filt);
             if (!skb || !filt) {
-                spin_unlock_irqrestore(&dev->lock, flags);
+                rcu_read_unlock();
                 return SHR_E_UNAVAIL;
             }
+            dest_type = filt->dest_type;
+            dest_id = filt->dest_id;
         }
-        switch (filt->dest_type) {
+        switch (dest_type) {
         case NGKNET_FILTER_DEST_T_NETIF:
-            if (filt->dest_id == 0) {
+            if (dest_id == 0) {
                 dest_ndev = dev->net_dev;
             } else {
-                dest_ndev = dev->vdev[filt->dest_id];
+                dest_ndev = READ_ONCE(dev->vdev[dest_id]);
             }
             if (dest_ndev) {
                 skb->dev = dest_ndev;
@@ -355,23 +602,22 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
                     skb->protocol = filt->dest_proto;
                 }
                 priv = netdev_priv(dest_ndev);
-                priv->users++;
+                atomic_inc(&priv->users);
             }
             break;
         case NGKNET_FILTER_DEST_T_VNET:
             pkb->pkh.attrs |= PDMA_RX_TO_VNET;
-            spin_unlock_irqrestore(&dev->lock, flags);
+            rcu_read_unlock();
             return SHR_E_NO_HANDLER;
         case NGKNET_FILTER_DEST_T_NULL:
         default:
-            spin_unlock_irqrestore(&dev->lock, flags);
+            rcu_read_unlock();
             return SHR_E_UNAVAIL;
         }
     }
 
-    spin_unlock_irqrestore(&dev->lock, flags);
-
     if (!dest_ndev) {
+        rcu_read_unlock();
         return SHR_E_NONE;
     } else {
         *ndev = dest_ndev;
@@ -393,16 +639,15 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
         NGKNET_SKB_CB(skb)->filt = filt;
         /* Add callback filter if matched */
         if (priv) {
-            priv->filt_cb = match_cb? filt_cb : NULL;
+            priv->filt_cb = filt_cb;
         }
     }
 
     if (filt->mirror_type == NGKNET_FILTER_DEST_T_NETIF) {
-        spin_lock_irqsave(&dev->lock, flags);
         if (filt->mirror_id == 0) {
             mirror_ndev = dev->net_dev;
         } else {
-            mirror_ndev = dev->vdev[filt->mirror_id];
+            mirror_ndev = READ_ONCE(dev->vdev[filt->mirror_id]);
         }
         if (mirror_ndev) {
             mirror_skb = pskb_copy(skb, GFP_ATOMIC);
@@ -416,12 +661,106 @@ ngknet_rx_pkt_filter(struct ngknet_dev *dev, struct sk_buff *skb, struct net_dev
                     NGKNET_SKB_CB(mirror_skb)->filt = filt;
                 }
                 priv = netdev_priv(mirror_ndev);
-                priv->users++;
+                atomic_inc(&priv->users);
                 *mndev = mirror_ndev;
                 *mskb = mirror_skb;
             }
         }
-        spin_unlock_irqrestore(&dev->lock, flags);
+    }
+
+    rcu_read_unlock();
+
+    return SHR_E_NONE;
+}
+
+void
+ngknet_rx_class_rate_limit_init(struct ngknet_dev *dev)
+{
+    int chan;
+
+    for (chan = 0; chan < NUM_Q_MAX; chan++) {
+        ngknet_rx_tbf_init(&dev->rx_tbf[chan]);
+    }
+}
+
+int
+ngknet_rx_class_rate_limit_set(struct ngknet_dev *dev, ngknet_rate_limit_t *rl)
+{
+    struct ngknet_rx_tbf *tbf = NULL;
+    struct filt_ctrl *fc = NULL;
+
+    switch (rl->class_type) {
+    case NGKNET_RL_CLASS_RX_CHAN:
+        if (rl->id >= NUM_Q_MAX) {
+            return SHR_E_PARAM;
+        }
+        tbf = &dev->rx_tbf[rl->id];
+        spin_lock_bh(&tbf->lock);
+        ngknet_rx_tbf_reset(tbf, rl->rate, rl->burst);
+        spin_unlock_bh(&tbf->lock);
+        break;
+    case NGKNET_RL_CLASS_FILTER:
+        if (rl->id == 0 || rl->id > NUM_FILTER_MAX) {
+            return SHR_E_PARAM;
+        }
+        /* The filter cannot go away while the configuration lock is held */
+        mutex_lock(&dev->filt_lock);
+        fc = (struct filt_ctrl *)dev->fc[rl->id];
+        if (!fc) {
+            mutex_unlock(&dev->filt_lock);
+            return SHR_E_NOT_FOUND;
+        }
+        tbf = &fc->tbf;
+        spin_lock_bh(&tbf->lock);
+        ngknet_rx_tbf_reset(tbf, rl->rate, rl->burst);
+        spin_unlock_bh(&tbf->lock);
+        mutex_unlock(&dev->filt_lock);
+        break;
+    default:
+        return SHR_E_PARAM;
+    }
+
+    return SHR_E_NONE;
+}
+
+int
+ngknet_rx_class_rate_limit_get(struct ngknet_dev *dev, ngknet_rate_limit_t *rl)
+{
+    struct ngknet_rx_tbf *tbf = NULL;
+    struct filt_ctrl *fc = NULL;
+
+    switch (rl->class_type) {
+    case NGKNET_RL_CLASS_RX_CHAN:
+        if (rl->id >= NUM_Q_MAX) {
+            return SHR_E_PARAM;
+        }
+        tbf = &dev->rx_tbf[rl->id];
+        break;
+    case NGKNET_RL_CLASS_FILTER:
+        if (rl->id == 0 || rl->id > NUM_FILTER_MAX) {
+            return SHR_E_PARAM;
+        }
+        mutex_lock(&dev->filt_lock);
+        fc = (struct filt_ctrl *)dev->fc[rl->id];
+        if (!fc) {
+            mutex_unlock(&dev->filt_lock);
+            return SHR_E_NOT_FOUND;
+        }
+        tbf = &fc->tbf;
+        break;
+    default:
+        return SHR_E_PARAM;
+    }
+
+    spin_lock_bh(&tbf->lock);
+    rl->rate = tbf->rate;
+    rl->burst = tbf->burst;
+    rl->passed = tbf->passed;
+    rl->dropped = tbf->dropped;
+    spin_unlock_bh(&tbf->lock);
+
+    if (fc) {
+        mutex_unlock(&dev->filt_lock);
     }
 
     return SHR_E_NONE;
@@ -33,8 +33,19 @@ struct filt_ctrl {
     /*! Device number */
     int dev_no;
 
-    /*! Number of hits */
-    uint64_t hits;
+    /*! Number of hits per CPU */
+    uint64_t __percpu *hits;
+
+    /*! Rx token bucket */
+    struct ngknet_rx_tbf tbf;
+
+    /*! RCU head for deferred free */
+    struct rcu_head rcu;
+
+#if NGKNET_FILTER_BPF
+    /*! BPF program run for callback filter */
+    struct bpf_prog __rcu *prog;
+#endif
 
     /*! Filter description */
     ngknet_filter_t filt;
@@ -100,6 +111,18 @@ ngknet_filter_get(struct ngknet_dev *dev, int id, ngknet_filter_t *filter);
 extern int
 ngknet_filter_get_next(struct ngknet_dev *dev, ngknet_filter_t *filter);
 
+/*!
+ * \brief Get filter hits.
+ *
+ * Sum up the per-CPU hit counters of a filter.
+ *
+ * \param [in] fc Filter control structure point.
+ *
+ * \retval Number of hits.
+ */
+extern uint64_t
+ngknet_filter_hits_get(struct filt_ctrl *fc);
+
 /*!
  * \brief Filter packet.
  *
@@ -205,6 +228,40 @@ ngknet_rx_rate_limit_stop(struct ngknet_dev *dev);
 extern void
 ngknet_rx_rate_limit(struct ngknet_dev *dev, int limit);
 
+/*!
+ * \brief Initialize Rx token buckets of a device.
+ *
+ * \param [in] dev Device structure point.
+ */
+extern void
+ngknet_rx_class_rate_limit_init(struct ngknet_dev *dev);
+
+/*!
+ * \brief Set Rx rate limit for a traffic class.
+ *
+ * The bucket is refilled and its counters are cleared.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] rl Rate limit description.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_rx_class_rate_limit_set(struct ngknet_dev *dev, ngknet_rate_limit_t *rl);
+
+/*!
+ * \brief Get Rx rate limit and counters of a traffic class.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in,out] rl Rate limit description.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_rx_class_rate_limit_get(struct ngknet_dev *dev, ngknet_rate_limit_t *rl);
+
 /*!
  * \brief Schedule Tx queue.
  *
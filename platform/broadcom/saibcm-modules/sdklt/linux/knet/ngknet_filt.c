@@ -0,0 +1,265 @@
+/*! \file ngknet_filt.c
+ *
+ * Rx filter classifier for NGKNET.
+ *
+ * This file only depends on a few basic kernel helpers, so that it can
+ * also be built and tested in user space (see test/).
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+
+#include "ngknet_filt.h"
+
+/*!
+ * Check if filter data can never be matched
+ */
+static int
+ngknet_filt_unmatchable(const ngknet_filter_t *filt, int wsize)
+{
+    int idx;
+
+    for (idx = 0; idx < wsize; idx++) {
+        if (filt->data.w[idx] & ~filt->mask.w[idx]) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * Check if filter fits the shape
+ */
+static int
+ngknet_filt_shape_match(const struct filt_shape *fs, const ngknet_filter_t *filt,
+                        int any_data, int match_chan, int wsize)
+{
+    if (fs->any_data || any_data) {
+        return fs->any_data && any_data;
+    }
+
+    return fs->match_chan == match_chan &&
+           fs->oob_data_offset == filt->oob_data_offset &&
+           fs->oob_data_size == filt->oob_data_size &&
+           fs->pkt_data_offset == filt->pkt_data_offset &&
+           fs->pkt_data_size == filt->pkt_data_size &&
+           !memcmp(fs->mask, filt->mask.w, wsize * sizeof(uint32_t));
+}
+
+/*!
+ * Hash filter key
+ */
+static inline uint32_t
+ngknet_filt_hash(const uint32_t *key, int wsize, int chan)
+{
+    return jhash2(key, wsize, chan);
+}
+
+struct filt_table *
+ngknet_filt_table_alloc(int max_filts)
+{
+    struct filt_table *ft = NULL;
+
+    /* Each shape has at most twice of its entries rounded up of buckets */
+    ft = kzalloc(sizeof(*ft) +
+                 max_filts * sizeof(struct filt_shape) +
+                 max_filts * sizeof(struct filt_entry) +
+                 max_filts * 4 * sizeof(int), GFP_KERNEL);
+    if (!ft) {
+        return NULL;
+    }
+    ft->max_filts = max_filts;
+    ft->shapes = (struct filt_shape *)(ft + 1);
+    ft->entries = (struct filt_entry *)(ft->shapes + max_filts);
+    ft->bkts = (int *)(ft->entries + max_filts);
+
+    return ft;
+}
+
+void
+ngknet_filt_table_add(struct filt_table *ft, const ngknet_filter_t *filt,
+                      void *priv)
+{
+    struct filt_shape *fs = NULL;
+    struct filt_entry *fe = NULL;
+    int any_data, match_chan, wsize;
+    int rank, si;
+
+    if (ft->num_ranks >= ft->max_filts) {
+        return;
+    }
+    rank = ft->num_ranks++;
+
+    any_data = filt->flags & NGKNET_FILTER_F_ANY_DATA ? 1 : 0;
+    match_chan = filt->flags & NGKNET_FILTER_F_MATCH_CHAN ? 1 : 0;
+    wsize = any_data ? 0 :
+            NGKNET_BYTES2WORDS(filt->oob_data_size + filt->pkt_data_size);
+    if (!any_data && ngknet_filt_unmatchable(filt, wsize)) {
+        return;
+    }
+
+    /* Shapes are created in rank order, i.e. sorted by lowest rank */
+    for (si = 0; si < ft->num_shapes; si++) {
+        fs = &ft->shapes[si];
+        if (ngknet_filt_shape_match(fs, filt, any_data, match_chan, wsize)) {
+            break;
+        }
+    }
+    if (si == ft->num_shapes) {
+        fs = &ft->shapes[ft->num_shapes++];
+        fs->any_data = any_data;
+        fs->match_chan = any_data ? 0 : match_chan;
+        fs->oob_data_offset = any_data ? 0 : filt->oob_data_offset;
+        fs->oob_data_size = any_data ? 0 : filt->oob_data_size;
+        fs->pkt_data_offset = any_data ? 0 : filt->pkt_data_offset;
+        fs->pkt_data_size = any_data ? 0 : filt->pkt_data_size;
+        fs->wsize = wsize;
+        fs->mask = filt->mask.w;
+        fs->min_rank = rank;
+    }
+
+    fe = &ft->entries[ft->num_entries++];
+    fe->filt = filt;
+    fe->priv = priv;
+    fe->rank = rank;
+    fe->cb = !any_data && filt->dest_type == NGKNET_FILTER_DEST_T_CB;
+    fe->hash = ngknet_filt_hash(filt->data.w, fs->wsize,
+                                fs->match_chan ? filt->chan : 0);
+    /* Temporarily mark the entry with its shape */
+    fe->next = si;
+    fs->num_entries++;
+    if (fe->cb) {
+        fs->num_cb++;
+        ft->num_cb++;
+    }
+}
+
+void
+ngknet_filt_table_finalize(struct filt_table *ft)
+{
+    struct filt_shape *fs = NULL;
+    struct filt_entry *fe = NULL;
+    int num_bkts = 0;
+    int si, ei, bi;
+
+    for (si = 0; si < ft->num_shapes; si++) {
+        fs = &ft->shapes[si];
+        fs->bkt_mask = roundup_pow_of_two(fs->num_entries * 2) - 1;
+        fs->bkts = &ft->bkts[num_bkts];
+        num_bkts += fs->bkt_mask + 1;
+        for (bi = 0; bi <= fs->bkt_mask; bi++) {
+            fs->bkts[bi] = -1;
+        }
+    }
+    for (ei = ft->num_entries - 1; ei >= 0; ei--) {
+        fe = &ft->entries[ei];
+        fs = &ft->shapes[fe->next];
+        bi = fe->hash & fs->bkt_mask;
+        /* Insert in reverse order to keep chains in priority order */
+        fe->next = fs->bkts[bi];
+        fs->bkts[bi] = ei;
+    }
+}
+
+/*!
+ * Extract the masked key of a shape from Rx packet
+ */
+static inline void
+ngknet_filt_key_get(const struct filt_shape *fs, const uint8_t *oob,
+                    const uint8_t *pkt, uint32_t *key)
+{
+    int idx;
+
+    key[fs->wsize - 1] = 0;
+    memcpy(key, &oob[fs->oob_data_offset], fs->oob_data_size);
+    memcpy((uint8_t *)key + fs->oob_data_size,
+           &pkt[fs->pkt_data_offset], fs->pkt_data_size);
+    for (idx = 0; idx < fs->wsize; idx++) {
+        key[idx] &= fs->mask[idx];
+    }
+}
+
+void *
+ngknet_filt_lookup(const struct filt_table *ft, const uint8_t *oob,
+                   const uint8_t *pkt, int chan_id, void **cb_priv)
+{
+    const struct filt_shape *fs = NULL;
+    const struct filt_entry *fe = NULL;
+    void *match = NULL;
+    uint32_t key[NGKNET_FILTER_WORDS_MAX];
+    uint32_t hash;
+    int best = INT_MAX, cb_best = -1;
+    int si, ei, pass;
+
+    *cb_priv = NULL;
+
+    for (pass = 0; pass < 2; pass++) {
+        for (si = 0; si < ft->num_shapes; si++) {
+            fs = &ft->shapes[si];
+            if (fs->min_rank >= best) {
+                break;
+            }
+            if (pass && !fs->num_cb) {
+                continue;
+            }
+            if (fs->wsize) {
+                ngknet_filt_key_get(fs, oob, pkt, key);
+            }
+            hash = ngknet_filt_hash(key, fs->wsize,
+                                    fs->match_chan ? chan_id : 0);
+            for (ei = fs->bkts[hash & fs->bkt_mask]; ei >= 0; ei = fe->next) {
+                fe = &ft->entries[ei];
+                if (fe->rank >= best) {
+                    break;
+                }
+                if (fe->hash != hash || fe->cb != pass) {
+                    continue;
+                }
+                if (fs->match_chan && fe->filt->chan != chan_id) {
+                    continue;
+                }
+                if (memcmp(key, fe->filt->data.w,
+                           fs->wsize * sizeof(uint32_t))) {
+                    continue;
+                }
+                if (pass) {
+                    if (fe->rank > cb_best) {
+                        cb_best = fe->rank;
+                        *cb_priv = fe->priv;
+                    }
+                    continue;
+                }
+                best = fe->rank;
+                match = fe->priv;
+                break;
+            }
+        }
+        /* Callback filters only matter when a terminating filter matched */
+        if (!match || !ft->num_cb) {
+            break;
+        }
+    }
+
+    return match;
+}
@@ -0,0 +1,188 @@
+/*! \file ngknet_filt.h
+ *
+ * Rx filter classifier definitions for NGKNET.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef NGKNET_FILT_H
+#define NGKNET_FILT_H
+
+#include <linux/types.h>
+#include <lkm/ngknet_dev.h>
+
+/*!
+ * \brief Filter classifier entry.
+ *
+ * Entries hashed into the same bucket are chained in filter priority order.
+ */
+struct filt_entry {
+    /*! Filter description */
+    const ngknet_filter_t *filt;
+
+    /*! Owner data returned by lookup */
+    void *priv;
+
+    /*! Rank of the filter in the priority-ordered filter list */
+    int rank;
+
+    /*! Filter to be handled by callback but not terminating the lookup */
+    int cb;
+
+    /*! Hash value of filter data */
+    uint32_t hash;
+
+    /*! Next entry index in the same bucket, -1 if none */
+    int next;
+};
+
+/*!
+ * \brief Filter shape.
+ *
+ * Filters with identical data offsets, sizes, mask and channel matching
+ * are grouped into one shape. The masked packet key is extracted and
+ * hashed once per shape, rather than once per filter.
+ */
+struct filt_shape {
+    /*! Out band data offset */
+    uint16_t oob_data_offset;
+
+    /*! Out band data size */
+    uint16_t oob_data_size;
+
+    /*! Packet data offset */
+    uint16_t pkt_data_offset;
+
+    /*! Packet data size */
+    uint16_t pkt_data_size;
+
+    /*! Key size in words */
+    int wsize;
+
+    /*! Match Rx channel */
+    int match_chan;
+
+    /*! Match any data */
+    int any_data;
+
+    /*! Key mask, shared with the first filter of this shape */
+    const uint32_t *mask;
+
+    /*! Lowest filter rank of this shape */
+    int min_rank;
+
+    /*! Number of callback entries of this shape */
+    int num_cb;
+
+    /*! Number of entries of this shape */
+    int num_entries;
+
+    /*! Hash bucket mask */
+    uint32_t bkt_mask;
+
+    /*! Hash buckets holding the first entry index, -1 if empty */
+    int *bkts;
+};
+
+/*!
+ * \brief Filter table.
+ *
+ * The table is compiled from the filter list whenever a filter is created
+ * or destroyed, and published through RCU so that the Rx path can do the
+ * lookup without holding any lock. Shapes are sorted by their lowest rank.
+ */
+struct filt_table {
+    /*! RCU head for deferred free */
+    struct rcu_head rcu;
+
+    /*! Maximum number of filters */
+    int max_filts;
+
+    /*! Number of filters added, i.e. the next rank */
+    int num_ranks;
+
+    /*! Number of shapes */
+    int num_shapes;
+
+    /*! Number of entries */
+    int num_entries;
+
+    /*! Number of callback entries */
+    int num_cb;
+
+    /*! Shapes */
+    struct filt_shape *shapes;
+
+    /*! Entries */
+    struct filt_entry *entries;
+
+    /*! Bucket storage */
+    int *bkts;
+};
+
+/*!
+ * \brief Allocate an empty filter table.
+ *
+ * \param [in] max_filts Maximum number of filters to be added.
+ *
+ * \return Filter table, or NULL if out of memory. Free with kfree().
+ */
+extern struct filt_table *
+ngknet_filt_table_alloc(int max_filts);
+
+/*!
+ * \brief Add a filter to the table.
+ *
+ * Filters must be added in priority order. The filter description must
+ * stay valid as long as the table is in use.
+ *
+ * \param [in] ft Filter table.
+ * \param [in] filt Filter description.
+ * \param [in] priv Owner data returned by lookup.
+ */
+extern void
+ngknet_filt_table_add(struct filt_table *ft, const ngknet_filter_t *filt,
+                      void *priv);
+
+/*!
+ * \brief Set up the hash buckets once all the filters are added.
+ *
+ * \param [in] ft Filter table.
+ */
+extern void
+ngknet_filt_table_finalize(struct filt_table *ft);
+
+/*!
+ * \brief Look up the filter table.
+ *
+ * Return the first matched terminating filter in priority order, and the
+ * last matched callback filter ahead of it if any.
+ *
+ * \param [in] ft Filter table.
+ * \param [in] oob Out band data of the packet.
+ * \param [in] pkt Packet data.
+ * \param [in] chan_id Rx channel.
+ * \param [out] cb_priv Owner data of the matched callback filter.
+ *
+ * \return Owner data of the matched filter, or NULL if none.
+ */
+extern void *
+ngknet_filt_lookup(const struct filt_table *ft, const uint8_t *oob,
+                   const uint8_t *pkt, int chan_id, void **cb_priv);
+
+#endif /* NGKNET_FILT_H */
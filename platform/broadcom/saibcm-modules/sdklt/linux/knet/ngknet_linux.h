@@ -41,6 +41,38 @@
 #define NGKNET_ETHTOOL_LINK_SETTINGS 0
 #endif
 
+/* Page pool with SKB recycling is usable since 5.15 */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,15,0)) && IS_ENABLED(CONFIG_PAGE_POOL)
+#define NGKNET_PAGE_POOL 1
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,6,0))
+#include <net/page_pool/helpers.h>
+#else
+#include <net/page_pool.h>
+#endif
+#else
+#define NGKNET_PAGE_POOL 0
+#endif
+
+/* Page pool recycling stats are available since 6.0 */
+#if NGKNET_PAGE_POOL && (LINUX_VERSION_CODE >= KERNEL_VERSION(6,0,0)) && \
+    IS_ENABLED(CONFIG_PAGE_POOL_STATS)
+#define NGKNET_PAGE_POOL_STATS 1
+#else
+#define NGKNET_PAGE_POOL_STATS 0
+#endif
+
+/* Driver XDP on top of the generic XDP helpers is usable since 5.10 */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,10,0)) && IS_ENABLED(CONFIG_BPF_SYSCALL)
+#define NGKNET_XDP 1
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#else
+#define NGKNET_XDP 0
+#endif
+
+/* Filter BPF programs run as TC classifiers on the same kernels as XDP */
+#define NGKNET_FILTER_BPF NGKNET_XDP
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0)
 #define kal_vlan_hwaccel_put_tag(skb, proto, tci) \
     __vlan_hwaccel_put_tag(skb, tci)
@@ -186,6 +218,18 @@ kal_copy_to_user(void __user *to, const void *from,
     return copy_to_user(to, from, len);
 }
 
+static inline int
+kal_xmit_more(struct sk_buff *skb)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)
+    return netdev_xmit_more();
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,18,0)
+    return skb->xmit_more;
+#else
+    return 0;
+#endif
+}
+
 static inline int
 kal_support_paged_skb(void)
 {
@@ -82,16 +82,22 @@
 #include <linux/bitops.h>
 #include <linux/time.h>
 #include <linux/random.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 
 #include <lkm/ngbde_kapi.h>
 #include <lkm/ngknet_dev.h>
 #include <lkm/ngknet_ioctl.h>
 #include <bcmcnet/bcmcnet_core.h>
+#include <bcmcnet/bcmcnet_dim.h>
 #include "ngknet_main.h"
 #include "ngknet_extra.h"
 #include "ngknet_procfs.h"
 #include "ngknet_callback.h"
 #include "ngknet_ptp.h"
+#include "ngknet_xdp.h"
+#include "ngknet_bpf.h"
+#include "ngknet_sim.h"
 
 /*! \cond */
 MODULE_AUTHOR("Broadcom Corporation");
@@ -155,6 +161,20 @@ MODULE_PARM_DESC(rx_batching,
 "Rx batching mode (default 0 in single fill mode)");
 /*! \endcond */
 
+/*! \cond */
+static int rx_batch_stats = 0;
+MODULE_PARAM(rx_batch_stats, int, 0);
+MODULE_PARM_DESC(rx_batch_stats,
+"Rx batch size measurement (default 0 disabled)");
+/*! \endcond */
+
+/*! \cond */
+static int intr_moderation = 0;
+MODULE_PARAM(intr_moderation, int, 0);
+MODULE_PARM_DESC(intr_moderation,
+"Dynamic interrupt moderation (default 0 disabled)");
+/*! \endcond */
+
 /*! \cond */
 static int page_buffer_mode = -1;
 MODULE_PARAM(page_buffer_mode, int, 0);
@@ -178,11 +198,23 @@ struct bcmcnet_drv_ops {
     };
 #include <bcmdrd/bcmdrd_devlist.h>
 
+#ifdef NGKNET_SIM
+/* Simulated device with no HW behind */
+static struct bcmcnet_drv_ops sim_cnet_drv_ops = {
+    SIM_DEV_NAME,
+    bcmcnet_sim_pdma_driver_attach,
+    bcmcnet_sim_pdma_driver_detach,
+};
+#endif
+
 #define BCMDRD_DEVLIST_ENTRY(_nm,_vn,_dv,_rv,_md,_pi,_bd,_bc,_fn,_cn,_pf,_pd,_r0,_r1) \
     &_bd##_cnet_drv_ops,
 static struct bcmcnet_drv_ops *drv_ops[] = {
     NULL,
 #include <bcmdrd/bcmdrd_devlist.h>
+#ifdef NGKNET_SIM
+    &sim_cnet_drv_ops,
+#endif
     NULL
 };
 static int drv_num = sizeof(drv_ops) / sizeof(drv_ops[0]);
@@ -198,6 +230,10 @@ struct ngknet_intr_handle {
     struct intr_handle *hdl;
     int napi_resched;
     int napi_pending;
+    /* Packets held for delivery at the end of a poll if GRO is off */
+    struct list_head rx_list;
+    /* Packets delivered to the stack in the current poll */
+    int rx_batch;
 };
 
 static struct ngknet_intr_handle priv_hdl[NUM_PDMA_DEV_MAX][NUM_Q_MAX];
@@ -432,6 +468,7 @@ ngknet_netif_recv(struct net_device *ndev, struct sk_buff *skb)
     struct pdma_dev *pdev = &dev->pdma_dev;
     struct pkt_hdr *pkh = (struct pkt_hdr *)skb->data;
     struct napi_struct *napi = NULL;
+    struct ngknet_intr_handle *kih = NULL;
     uint16_t proto;
     int chan_id, gi, qi, skb_len;
     int rv;
@@ -481,12 +518,33 @@ ngknet_netif_recv(struct net_device *ndev, struct sk_buff *skb)
         napi = (struct napi_struct *)pdev->ctrl.grp[gi].intr_hdl[qi].priv;
     }
 
+#if NGKNET_XDP
+    /* Run the driver mode XDP program, it may consume the packet */
+    skb_len = skb->len;
+    if (SHR_FAILURE(ngknet_xdp_rx(ndev, &skb))) {
+        NGKNET_NETIF_STATS_ADD(priv, rx_packets, 1);
+        NGKNET_NETIF_STATS_ADD(priv, rx_bytes, skb_len);
+        return SHR_E_NONE;
+    }
+#endif
+
    /* FIXME: File CSP on KASAN warning on use-after-free in ngknet_netif_recv */
     skb_len = skb->len;
-    napi_gro_receive(napi, skb);
+    kih = container_of(napi, struct ngknet_intr_handle, napi);
+    if (ndev->features & NETIF_F_GRO) {
+        napi_gro_receive(napi, skb);
+    } else {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0))
+        /* Hand over to the stack in one batch at the end of this poll */
+        list_add_tail(&skb->list, &kih->rx_list);
+#else
+        netif_receive_skb(skb);
+#endif
+    }
+    kih->rx_batch++;
     /* Update accounting */
-    priv->stats.rx_packets++;
-    priv->stats.rx_bytes += skb_len;
+    NGKNET_NETIF_STATS_ADD(priv, rx_packets, 1);
+    NGKNET_NETIF_STATS_ADD(priv, rx_bytes, skb_len);
 
 
     /* Rate limit */
@@ -518,7 +576,6 @@ ngknet_frame_recv(struct pdma_dev *pdev, int queue, void *buf)
     struct sk_buff *skb = (struct sk_buff *)buf, *mskb = NULL;
     struct net_device *ndev = NULL, *mndev = NULL;
     struct ngknet_private *priv = NULL;
-    unsigned long flags;
     int rv;
 
     DBG_VERB(("Rx packet (%d bytes).\n", skb->len));
@@ -538,31 +595,25 @@ ngknet_frame_recv(struct pdma_dev *pdev, int queue, void *buf)
     priv = netdev_priv(ndev);
     if (!netif_carrier_ok(ndev) ||
         SHR_FAILURE(ngknet_netif_recv(ndev, skb))) {
-        priv->stats.rx_dropped++;
+        NGKNET_NETIF_STATS_ADD(priv, rx_dropped, 1);
         rv = SHR_E_UNAVAIL;
     }
 
-    spin_lock_irqsave(&dev->lock, flags);
-    priv->users--;
-    if (!priv->users && priv->wait) {
+    if (atomic_dec_and_test(&priv->users) && wq_has_sleeper(&dev->wq)) {
         wake_up(&dev->wq);
     }
-    spin_unlock_irqrestore(&dev->lock, flags);
 
     /* Handle mirrored packet */
     if (mndev && mskb) {
         priv = netdev_priv(mndev);
         if (!netif_carrier_ok(mndev) ||
             SHR_FAILURE(ngknet_netif_recv(mndev, mskb))) {
-            priv->stats.rx_dropped++;
+            NGKNET_NETIF_STATS_ADD(priv, rx_dropped, 1);
             dev_kfree_skb_any(mskb);
         }
-        spin_lock_irqsave(&dev->lock, flags);
-        priv->users--;
-        if (!priv->users && priv->wait) {
+        if (atomic_dec_and_test(&priv->users) && wq_has_sleeper(&dev->wq)) {
             wake_up(&dev->wq);
         }
-        spin_unlock_irqrestore(&dev->lock, flags);
     }
 
     /* Measure speed */
@@ -956,7 +1007,8 @@ ngknet_intr_disable(struct pdma_dev *pdev, int cmc, int chan,
 static int
 ngknet_poll(struct napi_struct *napi, int budget)
 {
-    struct ngknet_intr_handle *kih = (struct ngknet_intr_handle *)napi;
+    struct ngknet_intr_handle *kih =
+        container_of(napi, struct ngknet_intr_handle, napi);
     struct intr_handle *hdl = kih->hdl;
     struct pdma_dev *pdev = (struct pdma_dev *)hdl->dev;
     struct ngknet_dev *dev = (struct ngknet_dev *)pdev->priv;
@@ -967,6 +1019,7 @@ ngknet_poll(struct napi_struct *napi, int budget)
 
     kih->napi_resched = 0;
     kih->napi_pending = 0;
+    kih->rx_batch = 0;
 
     if (pdev->flags & PDMA_GROUP_INTR) {
         work_done = bcmcnet_group_poll(pdev, hdl->group, budget);
@@ -974,12 +1027,39 @@ ngknet_poll(struct napi_struct *napi, int budget)
         work_done = bcmcnet_queue_poll(pdev, hdl, budget);
     }
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0))
+    /* Deliver the packets which bypassed GRO */
+    if (!list_empty(&kih->rx_list)) {
+        netif_receive_skb_list(&kih->rx_list);
+        INIT_LIST_HEAD(&kih->rx_list);
+    }
+#endif
+
+    if (rx_batch_stats && kih->rx_batch) {
+        struct ngknet_rx_batch_stats *bs = &dev->rx_batch_stats[hdl->chan];
+        bs->polls++;
+        bs->pkts += kih->rx_batch;
+        if (kih->rx_batch > bs->max_batch) {
+            bs->max_batch = kih->rx_batch;
+        }
+    }
+
     if (work_done < budget) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0))
+        napi_complete_done(napi, work_done);
+#else
         napi_complete(napi);
+#endif
         if (kih->napi_pending && napi_schedule_prep(napi)) {
             __napi_schedule(napi);
             return work_done;
         }
+        /* Sample queues for moderation before interrupts are re-armed */
+        if (pdev->flags & PDMA_GROUP_INTR) {
+            bcmcnet_group_dim_sample(pdev, hdl->group);
+        } else {
+            bcmcnet_queue_dim_sample(pdev, hdl);
+        }
         spin_lock_irqsave(&dev->lock, flags);
         if (!kih->napi_resched) {
             if (pdev->flags & PDMA_GROUP_INTR) {
@@ -1070,7 +1150,7 @@ ngknet_dev_hnet_work(struct pdma_dev *pdev)
         for (qi = 0; qi < pdev->grp_queues; qi++) {
             hdl = &pdev->ctrl.grp[gi].intr_hdl[qi];
             napi = (struct napi_struct *)hdl->priv;
-            kih = (struct ngknet_intr_handle *)napi;
+            kih = container_of(napi, struct ngknet_intr_handle, napi);
             kih->napi_pending = 1;
             if (napi_schedule_prep(napi)) {
                 spin_lock_irqsave(&dev->lock, flags);
@@ -1178,6 +1258,60 @@ ngknet_sys_v2p(struct pdma_dev *pdev, void *vaddr)
     return (uint64_t)ngbde_kapi_dma_virt_to_bus(pdev->unit, vaddr);
 }
 
+/*!
+ * Connect interrupt handler
+ */
+static void
+ngknet_dev_intr_connect(struct ngknet_dev *dev)
+{
+    if (ngknet_dev_is_sim(dev)) {
+        ngknet_sim_intr_connect(dev, ngknet_isr, dev);
+    } else {
+        ngbde_kapi_intr_connect(dev->dev_info.dev_no, 0, ngknet_isr, dev);
+    }
+}
+
+/*!
+ * Disconnect interrupt handler
+ */
+static void
+ngknet_dev_intr_disconnect(struct ngknet_dev *dev)
+{
+    if (ngknet_dev_is_sim(dev)) {
+        ngknet_sim_intr_disconnect(dev);
+    } else {
+        ngbde_kapi_intr_disconnect(dev->dev_info.dev_no, 0);
+    }
+}
+
+/*!
+ * Set up default XPS maps
+ *
+ * The maps are only installed when the Tx queue count changes, so any
+ * maps configured through sysfs survive the device going down and up.
+ */
+static void
+ngknet_xps_setup(struct net_device *ndev, int nb_txq)
+{
+#ifdef CONFIG_XPS
+    struct ngknet_private *priv = netdev_priv(ndev);
+    int cpu;
+
+    if (nb_txq == priv->xps_txq) {
+        return;
+    }
+    priv->xps_txq = nb_txq;
+
+    if (nb_txq <= 1) {
+        return;
+    }
+
+    for_each_online_cpu(cpu) {
+        netif_set_xps_queue(ndev, cpumask_of(cpu), cpu % nb_txq);
+    }
+#endif
+}
+
 /*!
  * Open network device
  */
@@ -1199,12 +1333,12 @@ ngknet_enet_open(struct net_device *ndev)
 
     if (priv->netif.id <= 0) {
         /* Register interrupt handler */
-        ngbde_kapi_intr_connect(dev->dev_info.dev_no, 0, ngknet_isr, dev);
+        ngknet_dev_intr_connect(dev);
 
         /* Start PDMA device */
         rv = bcmcnet_pdma_dev_start(pdev);
         if (SHR_FAILURE(rv)) {
-            ngbde_kapi_intr_disconnect(dev->dev_info.dev_no, 0);
+            ngknet_dev_intr_disconnect(dev);
             return -EPERM;
         }
 
@@ -1216,14 +1350,15 @@ ngknet_enet_open(struct net_device *ndev)
         /* Notify the stack of the actual queue counts. */
         rv = netif_set_real_num_rx_queues(dev->net_dev, pdev->ctrl.nb_rxq);
         if (rv < 0) {
-            ngbde_kapi_intr_disconnect(dev->dev_info.dev_no, 0);
+            ngknet_dev_intr_disconnect(dev);
             return rv;
         }
         rv = netif_set_real_num_tx_queues(dev->net_dev, pdev->ctrl.nb_txq);
         if (rv < 0) {
-            ngbde_kapi_intr_disconnect(dev->dev_info.dev_no, 0);
+            ngknet_dev_intr_disconnect(dev);
             return rv;
         }
+        ngknet_xps_setup(dev->net_dev, pdev->ctrl.nb_txq);
 
         for (gi = 0; gi < pdev->num_groups; gi++) {
             if (!pdev->ctrl.grp[gi].attached) {
@@ -1251,6 +1386,7 @@ ngknet_enet_open(struct net_device *ndev)
         if (rv < 0) {
             return rv;
         }
+        ngknet_xps_setup(ndev, pdev->ctrl.nb_txq);
     }
 
     /* Prevent tx timeout */
@@ -1303,12 +1439,38 @@ ngknet_enet_stop(struct net_device *ndev)
         bcmcnet_pdma_dev_stop(pdev);
 
         /* Unregister interrupt handler */
-        ngbde_kapi_intr_disconnect(dev->dev_info.dev_no, 0);
+        ngknet_dev_intr_disconnect(dev);
     }
 
     return 0;
 }
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0))
+/*!
+ * Select Tx queue
+ *
+ * Let the stack honor the priority-to-tc mapping, XPS and the flow hash.
+ * Without XPS, spread unhashed flows by the sending CPU instead of piling
+ * them all up on the first queue.
+ */
+static u16
+ngknet_select_queue(struct net_device *ndev, struct sk_buff *skb,
+                    struct net_device *sb_dev)
+{
+    if (ndev->real_num_tx_queues <= 1) {
+        return 0;
+    }
+
+#ifndef CONFIG_XPS
+    if (!netdev_get_num_tc(ndev) && !skb->l4_hash && !skb->sk) {
+        return raw_smp_processor_id() % ndev->real_num_tx_queues;
+    }
+#endif
+
+    return netdev_pick_tx(ndev, skb, sb_dev);
+}
+#endif
+
 /*!
  * Start transmission
  */
@@ -1319,8 +1481,10 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
     struct ngknet_dev *dev = priv->bkn_dev;
     struct pdma_dev *pdev = &dev->pdma_dev;
     struct sk_buff *bskb = skb;
+    struct pkt_buf *pkb = NULL;
     uint32_t len = skb->len;
-    int queue;
+    int more = kal_xmit_more(skb);
+    int queue, txq;
     int rv;
 
     DBG_VERB(("Tx packet from ndev%d (%d bytes).\n", priv->netif.id, skb->len));
@@ -1330,7 +1494,7 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 
     /* Do not transmit on base device */
     if (priv->netif.id <= 0) {
-        priv->stats.tx_dropped++;
+        NGKNET_NETIF_STATS_ADD(priv, tx_dropped, 1);
         dev_kfree_skb_any(skb);
         return NETDEV_TX_OK;
     }
@@ -1340,15 +1504,18 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
         ngknet_pkt_stats(pdev, PDMA_Q_TX);
     }
 
-    queue = skb->queue_mapping;
+    queue = txq = skb->queue_mapping;
 
     /* Handle one outgoing packet */
     rv = ngknet_tx_frame_process(ndev, &skb);
     if (SHR_FAILURE(rv)) {
-        priv->stats.tx_dropped++;
+        NGKNET_NETIF_STATS_ADD(priv, tx_dropped, 1);
         if (skb) {
             dev_kfree_skb_any(skb);
         }
+        if (!more) {
+            bcmcnet_pdma_tx_queue_kick(pdev, txq);
+        }
         return NETDEV_TX_OK;
     }
 
@@ -1356,6 +1523,17 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
     ngknet_tx_queue_schedule(dev, skb, &queue);
     skb->queue_mapping = queue;
 
+    /*
+     * Leave the DMA kick to the next packet of the batch. Only do this on
+     * the queue picked by the stack, which ends every batch on it.
+     */
+    pkb = (struct pkt_buf *)skb->data;
+    if (more && queue == txq) {
+        pkb->pkh.attrs |= PDMA_TX_XMIT_MORE;
+    } else {
+        pkb->pkh.attrs &= ~PDMA_TX_XMIT_MORE;
+    }
+
     DBG_VERB(("Tx packet (%d bytes).\n", skb->len));
     if (debug & DBG_LVL_PDMP) {
         ngknet_pkt_dump(skb->data, skb->len);
@@ -1370,17 +1548,22 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 
     rv = pdev->pkt_xmit(pdev, queue, skb);
 
+    /* Kick off what earlier packets of the batch left pending */
+    if (rv == SHR_E_BUSY || (!more && (rv != SHR_E_NONE || queue != txq))) {
+        bcmcnet_pdma_tx_queue_kick(pdev, txq);
+    }
+
     if (rv == SHR_E_BUSY) {
         DBG_WARN(("Tx suspend: DMA device is busy and temporarily "
                   "unavailable.\n"));
-        priv->stats.tx_fifo_errors++;
+        NGKNET_NETIF_STATS_ADD(priv, tx_fifo_errors, 1);
         if (skb != bskb) {
             dev_kfree_skb_any(skb);
         }
         return NETDEV_TX_BUSY;
     } else if (rv != SHR_E_NONE) {
         DBG_WARN(("Tx drop: DMA device not ready or not supported.\n"));
-        priv->stats.tx_dropped++;
+        NGKNET_NETIF_STATS_ADD(priv, tx_dropped, 1);
         if (skb != bskb) {
             dev_kfree_skb_any(skb);
         }
@@ -1393,22 +1576,103 @@ ngknet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
     }
 
     /* Update accounting */
-    priv->stats.tx_packets++;
-    priv->stats.tx_bytes += len;
+    NGKNET_NETIF_STATS_ADD(priv, tx_packets, 1);
+    NGKNET_NETIF_STATS_ADD(priv, tx_bytes, len);
 
     return NETDEV_TX_OK;
 }
 
 /*!
- * Get network device stats
+ * Initialize network device
+ */
+static int
+ngknet_enet_init(struct net_device *ndev)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    int cpu;
+
+    priv->stats = alloc_percpu(struct ngknet_pcpu_stats);
+    if (!priv->stats) {
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        u64_stats_init(&per_cpu_ptr(priv->stats, cpu)->syncp);
+    }
+
+    return 0;
+}
+
+/*!
+ * Uninitialize network device
  */
-static struct net_device_stats *
-ngknet_get_stats(struct net_device *ndev)
+static void
+ngknet_enet_uninit(struct net_device *ndev)
 {
     struct ngknet_private *priv = netdev_priv(ndev);
 
-    return &priv->stats;
+#if NGKNET_XDP
+    ngknet_xdp_cleanup(ndev);
+#endif
+    free_percpu(priv->stats);
+    priv->stats = NULL;
+}
+
+void
+ngknet_netif_stats_get(struct net_device *ndev, struct rtnl_link_stats64 *stats)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    struct ngknet_pcpu_stats *ps;
+    u64 rx_packets, rx_bytes, rx_dropped;
+    u64 tx_packets, tx_bytes, tx_dropped, tx_fifo_errors;
+    unsigned int start;
+    int cpu;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!priv->stats) {
+        return;
+    }
+
+    for_each_possible_cpu(cpu) {
+        ps = per_cpu_ptr(priv->stats, cpu);
+        do {
+            start = u64_stats_fetch_begin(&ps->syncp);
+            rx_packets = ps->rx_packets;
+            rx_bytes = ps->rx_bytes;
+            rx_dropped = ps->rx_dropped;
+            tx_packets = ps->tx_packets;
+            tx_bytes = ps->tx_bytes;
+            tx_dropped = ps->tx_dropped;
+            tx_fifo_errors = ps->tx_fifo_errors;
+        } while (u64_stats_fetch_retry(&ps->syncp, start));
+        stats->rx_packets += rx_packets;
+        stats->rx_bytes += rx_bytes;
+        stats->rx_dropped += rx_dropped;
+        stats->tx_packets += tx_packets;
+        stats->tx_bytes += tx_bytes;
+        stats->tx_dropped += tx_dropped;
+        stats->tx_fifo_errors += tx_fifo_errors;
+    }
+    stats->tx_errors = stats->tx_fifo_errors;
+}
+
+/*!
+ * Get network device stats
+ */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+static void
+ngknet_get_stats64(struct net_device *ndev, struct rtnl_link_stats64 *stats)
+{
+    ngknet_netif_stats_get(ndev, stats);
+}
+#else
+static struct rtnl_link_stats64 *
+ngknet_get_stats64(struct net_device *ndev, struct rtnl_link_stats64 *stats)
+{
+    ngknet_netif_stats_get(ndev, stats);
+
+    return stats;
 }
+#endif
 
 /*!
  * Set network device MC list
@@ -1550,7 +1814,12 @@ static const struct net_device_ops ngknet_netdev_ops = {
     .ndo_open            = ngknet_enet_open,
     .ndo_stop            = ngknet_enet_stop,
     .ndo_start_xmit      = ngknet_start_xmit,
-    .ndo_get_stats       = ngknet_get_stats,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0))
+    .ndo_select_queue    = ngknet_select_queue,
+#endif
+    .ndo_init            = ngknet_enet_init,
+    .ndo_uninit          = ngknet_enet_uninit,
+    .ndo_get_stats64     = ngknet_get_stats64,
     .ndo_validate_addr   = eth_validate_addr,
     .ndo_set_rx_mode     = ngknet_set_multicast_list,
     .ndo_set_mac_address = ngknet_set_mac_address,
@@ -1558,6 +1827,9 @@ static const struct net_device_ops ngknet_netdev_ops = {
     .ndo_set_features    = NULL,
     .ndo_do_ioctl        = ngknet_do_ioctl,
     .ndo_tx_timeout      = NULL,
+#if NGKNET_XDP
+    .ndo_bpf             = ngknet_xdp_bpf,
+#endif
 #ifdef CONFIG_NET_POLL_CONTROLLER
     .ndo_poll_controller = ngknet_poll_controller,
 #endif
@@ -1774,8 +2046,13 @@ ngknet_pdev_init(struct ngknet_dev *dev)
     pdev->intr_mask = ngknet_intr_disable;
     pdev->xnet_wait = ngknet_dev_hnet_wait;
     pdev->xnet_wake = ngknet_dev_vnet_wake;
-    pdev->sys_p2v = ngknet_sys_p2v;
-    pdev->sys_v2p = ngknet_sys_v2p;
+    if (ngknet_dev_is_sim(dev)) {
+        pdev->sys_p2v = ngknet_sim_p2v;
+        pdev->sys_v2p = ngknet_sim_v2p;
+    } else {
+        pdev->sys_p2v = ngknet_sys_p2v;
+        pdev->sys_v2p = ngknet_sys_v2p;
+    }
 
     pdev->flags |= PDMA_GROUP_INTR;
     if (tx_polling) {
@@ -1784,6 +2061,9 @@ ngknet_pdev_init(struct ngknet_dev *dev)
     if (rx_batching || pdev->mode == DEV_MODE_HNET) {
         pdev->flags |= PDMA_RX_BATCHING;
     }
+    if (intr_moderation) {
+        pdev->flags |= PDMA_INTR_DIM;
+    }
 
     /* Attach PDMA driver */
     rv = drv_ops[pdev->dev_type]->drv_attach(pdev);
@@ -1817,11 +2097,20 @@ ngknet_dev_info_get(int dn)
 {
     struct ngknet_dev *dev = &ngknet_devices[dn];
 
-    dev->base_addr = ngbde_kapi_pio_membase(dn);
-    dev->dev = ngbde_kapi_dma_dev_get(dn);
+    if (ngknet_dev_is_sim(dev)) {
+        /* No registers, only host memory for DMA */
+        dev->base_addr = NULL;
+        dev->dev = ngknet_sim_dma_dev_get();
+        if (!dev->dev) {
+            return SHR_E_ACCESS;
+        }
+    } else {
+        dev->base_addr = ngbde_kapi_pio_membase(dn);
+        dev->dev = ngbde_kapi_dma_dev_get(dn);
 
-    if (!dev->base_addr || !dev->dev) {
-        return SHR_E_ACCESS;
+        if (!dev->base_addr || !dev->dev) {
+            return SHR_E_ACCESS;
+        }
     }
 
     dev->dev_info.dev_no = dn;
@@ -1914,6 +2203,7 @@ ngknet_dev_probe(int dn, ngknet_netif_t *netif)
         for (qi = 0; qi < pdev->grp_queues; qi++) {
             hdl = &pdev->ctrl.grp[gi].intr_hdl[qi];
             priv_hdl[hdl->unit][hdl->chan].hdl = hdl;
+            INIT_LIST_HEAD(&priv_hdl[hdl->unit][hdl->chan].rx_list);
             hdl->priv = &priv_hdl[hdl->unit][hdl->chan];
             netif_napi_add(ndev, (struct napi_struct *)hdl->priv,
                            ngknet_poll);
@@ -1927,6 +2217,9 @@ ngknet_dev_probe(int dn, ngknet_netif_t *netif)
     ngknet_callback_control_get(&dev->cbc);
 
     INIT_LIST_HEAD(&dev->filt_list);
+    RCU_INIT_POINTER(dev->filt_tbl, NULL);
+    mutex_init(&dev->filt_lock);
+    ngknet_rx_class_rate_limit_init(dev);
     spin_lock_init(&dev->lock);
     init_waitqueue_head(&dev->wq);
     if (pdev->mode == DEV_MODE_HNET) {
@@ -1955,7 +2248,9 @@ ngknet_dev_probe(int dn, ngknet_netif_t *netif)
     DBG_NDEV(("Running with NAPI enabled\n"));
 
     /* Register handler for BDE events. */
-    ngbde_kapi_knet_connect(dn, ngknet_bde_event_handler, dev);
+    if (!ngknet_dev_is_sim(dev)) {
+        ngbde_kapi_knet_connect(dn, ngknet_bde_event_handler, dev);
+    }
 
     return SHR_E_NONE;
 }
@@ -1982,12 +2277,18 @@ ngknet_dev_remove(int dn)
     int rv;
 
     if (!(dev->flags & NGKNET_DEV_ACTIVE)) {
-        ngbde_kapi_knet_disconnect(dn);
+        if (!ngknet_dev_is_sim(dev)) {
+            ngbde_kapi_knet_disconnect(dn);
+        }
         return SHR_E_NONE;
     }
 
     DBG_VERB(("%s: dev %d\n",__FUNCTION__, dn));
 
+    if (ngknet_dev_is_sim(dev)) {
+        ngknet_sim_gen_stop(dev);
+    }
+
     dev->flags &= ~NGKNET_DEV_ACTIVE;
 
     skb_queue_purge(&dev->ptp_tx_queue);
@@ -2047,7 +2348,9 @@ ngknet_dev_remove(int dn)
     if (SHR_FAILURE(rv)) {
         DBG_WARN(("Detach DMA driver failed.\n"));
     }
-    ngbde_kapi_knet_disconnect(dn);
+    if (!ngknet_dev_is_sim(dev)) {
+        ngbde_kapi_knet_disconnect(dn);
+    }
 
     return rv;
 }
@@ -2153,7 +2456,6 @@ ngknet_netif_destroy(struct ngknet_dev *dev, int id)
     struct ngknet_private *priv = NULL;
     unsigned long flags;
     int num;
-    DECLARE_WAITQUEUE(wait, current);
 
     if (id <= 0 || id > NUM_VDEV_MAX) {
         return SHR_E_PARAM;
@@ -2168,23 +2470,11 @@ ngknet_netif_destroy(struct ngknet_dev *dev, int id)
     }
     priv = netdev_priv(ndev);
 
-    add_wait_queue(&dev->wq, &wait);
-
-    while (priv->users) {
-        priv->wait = 1;
-        set_current_state(TASK_INTERRUPTIBLE);
-        spin_unlock_irqrestore(&dev->lock, flags);
-        schedule();
-        spin_lock_irqsave(&dev->lock, flags);
-        priv->wait = 0;
-        set_current_state(TASK_RUNNING);
-    }
-
     if (priv->netif.flags & NGKNET_NETIF_F_BIND_CHAN) {
-        dev->bdev[priv->netif.chan] = NULL;
+        WRITE_ONCE(dev->bdev[priv->netif.chan], NULL);
     }
 
-    dev->vdev[id] = NULL;
+    WRITE_ONCE(dev->vdev[id], NULL);
     num = (long)dev->vdev[0];
     while (num-- == id--) {
         if (dev->vdev[id]) {
@@ -2195,7 +2485,9 @@ ngknet_netif_destroy(struct ngknet_dev *dev, int id)
 
     spin_unlock_irqrestore(&dev->lock, flags);
 
-    remove_wait_queue(&dev->wq, &wait);
+    /* Wait for the Rx lookups which might have picked up this interface */
+    synchronize_rcu();
+    wait_event(dev->wq, atomic_read(&priv->users) == 0);
 
     /* Optional netif destroy callback handle */
     if (dev->cbc->netif_destroy_cb) {
@@ -2288,6 +2580,53 @@ ngknet_rx_rate_limit_set(int rate_limit)
     rx_rate_limit = rate_limit;
 }
 
+int
+ngknet_rx_batch_stats_get(void)
+{
+    return rx_batch_stats;
+}
+
+void
+ngknet_rx_batch_stats_set(int enable)
+{
+    struct ngknet_dev *dev;
+    int di;
+
+    if (enable && !rx_batch_stats) {
+        /* Start a new measurement */
+        for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+            dev = &ngknet_devices[di];
+            memset(dev->rx_batch_stats, 0, sizeof(dev->rx_batch_stats));
+        }
+    }
+    rx_batch_stats = enable ? 1 : 0;
+}
+
+int
+ngknet_intr_moderation_get(void)
+{
+    return intr_moderation;
+}
+
+void
+ngknet_intr_moderation_set(int enable)
+{
+    struct ngknet_dev *dev;
+    int di;
+
+    intr_moderation = enable ? 1 : 0;
+
+    /* Queues pick up the change at their next interrupt event */
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (intr_moderation) {
+            dev->pdma_dev.flags |= PDMA_INTR_DIM;
+        } else {
+            dev->pdma_dev.flags &= ~PDMA_INTR_DIM;
+        }
+    }
+}
+
 int
 ngknet_page_buffer_mode_get(void)
 {
@@ -2322,11 +2661,13 @@ ngknet_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
         ngknet_chan_cfg_t chan_cfg;
         ngknet_netif_t netif;
         ngknet_filter_t filter;
+        ngknet_rate_limit_t rate_limit;
     } iod;
     ngknet_dev_cfg_t *dev_cfg = &iod.dev_cfg;
     ngknet_chan_cfg_t *chan_cfg = &iod.chan_cfg;
     ngknet_netif_t *netif = &iod.netif;
     ngknet_filter_t *filter = &iod.filter;
+    ngknet_rate_limit_t *rate_limit = &iod.rate_limit;
     char *data = NULL;
     int dt, gi, qi;
 
@@ -2368,6 +2709,25 @@ ngknet_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             ioc.iarg[1] = ngknet_rx_rate_limit_get();
         }
         break;
+    case NGKNET_RX_CLASS_LIMIT:
+        DBG_CMD(("NGKNET_RX_CLASS_LIMIT\n"));
+        if (kal_copy_from_user(rate_limit, (void *)(unsigned long)ioc.op.data.buf,
+                               sizeof(*rate_limit), ioc.op.data.len)) {
+            return -EFAULT;
+        }
+        if (ioc.iarg[0]) {
+            ioc.rc = ngknet_rx_class_rate_limit_set(dev, rate_limit);
+            break;
+        }
+        ioc.rc = ngknet_rx_class_rate_limit_get(dev, rate_limit);
+        if (SHR_FAILURE((int)ioc.rc)) {
+            break;
+        }
+        if (kal_copy_to_user((void *)(unsigned long)ioc.op.data.buf, rate_limit,
+                             ioc.op.data.len, sizeof(*rate_limit))) {
+            return -EFAULT;
+        }
+        break;
     case NGKNET_DEV_INIT:
         DBG_CMD(("NGKNET_DEV_INIT\n"));
         if (dev->flags & NGKNET_DEV_ACTIVE) {
@@ -2730,6 +3090,14 @@ ngknet_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             return -EFAULT;
         }
         break;
+    case NGKNET_FILT_BPF:
+        DBG_CMD(("NGKNET_FILT_BPF\n"));
+#if NGKNET_FILTER_BPF
+        ioc.rc = ngknet_filter_bpf_set(dev, ioc.iarg[0], ioc.iarg[1]);
+#else
+        ioc.rc = SHR_E_UNAVAIL;
+#endif
+        break;
     case NGKNET_PTP_DEV_CTRL:
         DBG_CMD(("NGKNET_PTP_DEV_CTRL\n"));
         if (ioc.op.data.len) {
@@ -2812,6 +3180,12 @@ ngknet_init_module(void)
         ngknet_dev_mac[0] &= ~0x01;
     }
 
+    /* Initialize simulated device support */
+    if (SHR_FAILURE(ngknet_sim_init())) {
+        printk(KERN_WARNING "%s: Simulated device not available\n",
+               NGKNET_MODULE_NAME);
+    }
+
     /* Initialize procfs */
     ngknet_procfs_init();
 
@@ -2837,6 +3211,12 @@ ngknet_exit_module(void)
         ngknet_dev_remove(idx);
     }
 
+    /* Wait for the deferred frees of filters */
+    rcu_barrier();
+
+    /* Cleanup simulated device support */
+    ngknet_sim_cleanup();
+
     unregister_chrdev(NGKNET_MODULE_MAJOR, NGKNET_MODULE_NAME);
 }
 
@@ -25,6 +25,7 @@
 
 #include <linux/ethtool.h>
 #include <linux/netdevice.h>
+#include <linux/u64_stats_sync.h>
 #include <lkm/lkm.h>
 #include <lkm/ngknet_dev.h>
 #include <bcmcnet/bcmcnet_core.h>
@@ -58,6 +59,70 @@
 #define DBG_RATE(_s)        do { if (debug & DBG_LVL_RATE) printk _s; } while (0)
 #define DBG_LINK(_s)        do { if (debug & DBG_LVL_LINK) printk _s; } while (0)
 
+struct page_pool;
+
+/*!
+ * Rx buffer stats per queue
+ */
+struct ngknet_rx_buf_stats {
+    /*! Buffers newly allocated from the page pool or the kernel */
+    uint64_t allocs;
+
+    /*! Buffer allocation failures */
+    uint64_t alloc_fails;
+
+    /*! Half pages flipped and reused in place */
+    uint64_t reuses;
+
+    /*! Pages handed over to the stack instead of being reused in place */
+    uint64_t releases;
+};
+
+/*!
+ * Rx batch stats per queue
+ *
+ * Collected only while the measurement mode is enabled.
+ */
+struct ngknet_rx_batch_stats {
+    /*! NAPI polls which delivered packets */
+    uint64_t polls;
+
+    /*! Packets delivered to the stack */
+    uint64_t pkts;
+
+    /*! Maximum packets delivered in one poll */
+    uint64_t max_batch;
+};
+
+/*!
+ * Rx token bucket
+ *
+ * Tokens are counted in packets scaled by NSEC_PER_SEC, so that a refill
+ * over elapsed nanoseconds is a single multiplication by the rate.
+ */
+struct ngknet_rx_tbf {
+    /*! Bucket lock */
+    spinlock_t lock;
+
+    /*! Rate in packets per second, 0 for no limit */
+    uint32_t rate;
+
+    /*! Bucket depth in packets */
+    uint32_t burst;
+
+    /*! Available tokens */
+    uint64_t tokens;
+
+    /*! Last refill time (ns) */
+    uint64_t last_ns;
+
+    /*! Packets passed while limited */
+    uint64_t passed;
+
+    /*! Packets dropped */
+    uint64_t dropped;
+};
+
 /*!
  * Device description
  */
@@ -92,6 +157,12 @@ struct ngknet_dev {
     /*! Filter control, 0 is reserved */
     void *fc[NUM_FILTER_MAX + 1];
 
+    /*! Compiled filter table for Rx lookup */
+    struct filt_table __rcu *filt_tbl;
+
+    /*! Filter configuration lock */
+    struct mutex filt_lock;
+
     /*! Callback control */
     struct ngknet_callback_ctrl *cbc;
 
@@ -128,12 +199,66 @@ struct ngknet_dev {
     /*! PTP Tx work */
     struct work_struct ptp_tx_work;
 
+    /*! Rx page pools per queue */
+    struct page_pool *rx_pool[NUM_Q_MAX];
+
+    /*! Rx buffer stats per queue */
+    struct ngknet_rx_buf_stats rx_buf_stats[NUM_Q_MAX];
+
+    /*! Rx batch stats per queue */
+    struct ngknet_rx_batch_stats rx_batch_stats[NUM_Q_MAX];
+
+    /*! Rx token buckets per channel */
+    struct ngknet_rx_tbf rx_tbf[NUM_Q_MAX];
+
     /*! Flags */
     int flags;
     /*! NGKNET device is active */
 #define NGKNET_DEV_ACTIVE      (1 << 0)
 };
 
+/*!
+ * Per-CPU network interface stats
+ *
+ * Counters are only summed up when read through ndo_get_stats64 or procfs.
+ */
+struct ngknet_pcpu_stats {
+    /*! Rx packets */
+    u64 rx_packets;
+
+    /*! Rx bytes */
+    u64 rx_bytes;
+
+    /*! Rx dropped packets */
+    u64 rx_dropped;
+
+    /*! Tx packets */
+    u64 tx_packets;
+
+    /*! Tx bytes */
+    u64 tx_bytes;
+
+    /*! Tx dropped packets */
+    u64 tx_dropped;
+
+    /*! Tx FIFO errors */
+    u64 tx_fifo_errors;
+
+    /*! Sync for 64-bit counters on 32-bit hosts */
+    struct u64_stats_sync syncp;
+};
+
+/*!
+ * Update a counter of network interface stats on the local CPU.
+ */
+#define NGKNET_NETIF_STATS_ADD(_priv, _cnt, _val)                   \
+    do {                                                            \
+        struct ngknet_pcpu_stats *_ps = this_cpu_ptr((_priv)->stats); \
+        u64_stats_update_begin(&_ps->syncp);                        \
+        _ps->_cnt += (_val);                                        \
+        u64_stats_update_end(&_ps->syncp);                          \
+    } while (0)
+
 /*!
  * Network interface specific private data
  */
@@ -142,7 +267,7 @@ struct ngknet_private {
     struct net_device *net_dev;
 
     /*! Network stats */
-    struct net_device_stats stats;
+    struct ngknet_pcpu_stats __percpu *stats;
 
     /*! NGKNET device */
     struct ngknet_dev *bkn_dev;
@@ -151,10 +276,7 @@ struct ngknet_private {
     ngknet_netif_t netif;
 
     /*! Users of this network interface */
-    int users;
-
-    /*! Wait for this network interface free */
-    int wait;
+    atomic_t users;
 
     /*! HW timestamp Rx filter */
     int hwts_rx_filter;
@@ -162,12 +284,20 @@ struct ngknet_private {
     /*! HW timestamp Tx type */
     int hwts_tx_type;
 
+    /*! Tx queue count the default XPS maps were set up for */
+    int xps_txq;
+
 #if NGKNET_ETHTOOL_LINK_SETTINGS
     /* Link settings */
     struct ethtool_link_settings link_settings;
 #endif
         /*! Matched callback filter */
     struct ngknet_filter_s *filt_cb;
+
+#if NGKNET_XDP
+    /*! XDP program attached in driver mode */
+    struct bpf_prog __rcu *xdp_prog;
+#endif
 };
 
 /*!
@@ -219,6 +349,17 @@ ngknet_netif_get(struct ngknet_dev *dev, int id, ngknet_netif_t *netif);
 extern int
 ngknet_netif_get_next(struct ngknet_dev *dev, ngknet_netif_t *netif);
 
+/*!
+ * \brief Get network interface stats.
+ *
+ * Sum up the per-CPU counters of a network interface.
+ *
+ * \param [in] ndev Network device structure point.
+ * \param [out] stats Network interface stats.
+ */
+extern void
+ngknet_netif_stats_get(struct net_device *ndev, struct rtnl_link_stats64 *stats);
+
 /*!
  * \brief Get debug level.
  *
@@ -251,6 +392,42 @@ ngknet_rx_rate_limit_get(void);
 extern void
 ngknet_rx_rate_limit_set(int rate_limit);
 
+/*!
+ * \brief Get Rx batch measurement mode.
+ *
+ * \retval 1 Measurement enabled.
+ * \retval 0 Measurement disabled.
+ */
+extern int
+ngknet_rx_batch_stats_get(void);
+
+/*!
+ * \brief Set Rx batch measurement mode.
+ *
+ * Enabling the measurement clears the previous results.
+ *
+ * \param [in] enable Enable or disable the measurement.
+ */
+extern void
+ngknet_rx_batch_stats_set(int enable);
+
+/*!
+ * \brief Get dynamic interrupt moderation mode.
+ *
+ * \retval 1 Moderation enabled.
+ * \retval 0 Moderation disabled.
+ */
+extern int
+ngknet_intr_moderation_get(void);
+
+/*!
+ * \brief Set dynamic interrupt moderation mode.
+ *
+ * \param [in] enable Enable or disable the moderation.
+ */
+extern void
+ngknet_intr_moderation_set(int enable);
+
 /*!
  * \brief Get page buffer mode.
  *
@@ -21,9 +21,15 @@
  */
 
 #include <lkm/lkm.h>
+#include <linux/math64.h>
 #include <lkm/ngknet_ioctl.h>
+#include <bcmcnet/bcmcnet_core.h>
+#include <bcmcnet/bcmcnet_rxtx.h>
 #include "ngknet_main.h"
 #include "ngknet_extra.h"
+#include "ngknet_xdp.h"
+#include "ngknet_bpf.h"
+#include "ngknet_sim.h"
 
 extern struct ngknet_dev ngknet_devices[];
 
@@ -187,6 +193,7 @@ proc_filter_info_show(struct seq_file *m, void *v)
 {
     struct ngknet_dev *dev;
     ngknet_filter_t filt = {0};
+    ngknet_rate_limit_t rl;
     int di, dn = 0, fn = 0;
     int rv;
 
@@ -230,7 +237,25 @@ proc_filter_info_show(struct seq_file *m, void *v)
             proc_data_show(m, filt.mask.b, filt.oob_data_size + filt.pkt_data_size);
             seq_printf(m, "user_data:      ");
             proc_data_show(m, filt.user_data, NGKNET_FILTER_USER_DATA);
-            seq_printf(m, "hits:           %llu\n", ((struct filt_ctrl *)dev->fc[filt.id])->hits);
+            seq_printf(m, "hits:           %llu\n",
+                       (unsigned long long)ngknet_filter_hits_get(dev->fc[filt.id]));
+#if NGKNET_FILTER_BPF
+            if (filt.dest_type == NGKNET_FILTER_DEST_T_CB) {
+                seq_printf(m, "bpf_prog:       %u\n",
+                           ngknet_filter_bpf_prog_id(dev, filt.id));
+            }
+#endif
+            rl.class_type = NGKNET_RL_CLASS_FILTER;
+            rl.id = filt.id;
+            if (SHR_SUCCESS(ngknet_rx_class_rate_limit_get(dev, &rl)) &&
+                rl.rate) {
+                seq_printf(m, "rate_limit:     %u pps, burst %u\n",
+                           rl.rate, rl.burst);
+                seq_printf(m, "rate_passed:    %llu\n",
+                           (unsigned long long)rl.passed);
+                seq_printf(m, "rate_dropped:   %llu\n",
+                           (unsigned long long)rl.dropped);
+            }
         } while (filt.next);
     }
 
@@ -269,8 +294,8 @@ proc_netif_info_show(struct seq_file *m, void *v)
 {
     struct ngknet_dev *dev;
     struct net_device *ndev;
-    struct ngknet_private *priv;
     ngknet_netif_t netif = {0};
+    struct rtnl_link_stats64 stats;
     int di, ma, dn = 0, nn = 0;
     int rv;
 
@@ -289,7 +314,6 @@ proc_netif_info_show(struct seq_file *m, void *v)
             }
             nn++;
             ndev = netif.id == 0 ? dev->net_dev : dev->vdev[netif.id];
-            priv = netdev_priv(ndev);
 
             seq_printf(m, "\n");
             seq_printf(m, "dev_no:         %d\n",   di);
@@ -307,6 +331,11 @@ proc_netif_info_show(struct seq_file *m, void *v)
                 }
             }
             seq_printf(m, "mtu:            %d\n",   netif.mtu);
+            seq_printf(m, "gro:            %s\n",
+                       ndev->features & NETIF_F_GRO ? "on" : "off");
+#if NGKNET_XDP
+            seq_printf(m, "xdp_prog:       %u\n",   ngknet_xdp_prog_id(ndev));
+#endif
             seq_printf(m, "chan:           %d\n",   netif.chan);
             seq_printf(m, "name:           %s\n",   netif.name);
             seq_printf(m, "meta_off:       %d\n",   netif.meta_off);
@@ -315,14 +344,15 @@ proc_netif_info_show(struct seq_file *m, void *v)
             proc_data_show(m, netif.meta_data, netif.meta_len);
             seq_printf(m, "user_data:      ");
             proc_data_show(m, netif.user_data, NGKNET_NETIF_USER_DATA);
-            seq_printf(m, "rx_packets:     %lu\n",  priv->stats.rx_packets);
-            seq_printf(m, "rx_bytes:       %lu\n",  priv->stats.rx_bytes);
-            seq_printf(m, "rx_dropped:     %lu\n",  priv->stats.rx_dropped);
-            seq_printf(m, "rx_errors:      %lu\n",  priv->stats.rx_errors);
-            seq_printf(m, "tx_packets:     %lu\n",  priv->stats.tx_packets);
-            seq_printf(m, "tx_bytes:       %lu\n",  priv->stats.tx_bytes);
-            seq_printf(m, "tx_dropped:     %lu\n",  priv->stats.tx_dropped);
-            seq_printf(m, "tx_errors:      %lu\n",  priv->stats.tx_errors);
+            ngknet_netif_stats_get(ndev, &stats);
+            seq_printf(m, "rx_packets:     %llu\n", (unsigned long long)stats.rx_packets);
+            seq_printf(m, "rx_bytes:       %llu\n", (unsigned long long)stats.rx_bytes);
+            seq_printf(m, "rx_dropped:     %llu\n", (unsigned long long)stats.rx_dropped);
+            seq_printf(m, "rx_errors:      %llu\n", (unsigned long long)stats.rx_errors);
+            seq_printf(m, "tx_packets:     %llu\n", (unsigned long long)stats.tx_packets);
+            seq_printf(m, "tx_bytes:       %llu\n", (unsigned long long)stats.tx_bytes);
+            seq_printf(m, "tx_dropped:     %llu\n", (unsigned long long)stats.tx_dropped);
+            seq_printf(m, "tx_errors:      %llu\n", (unsigned long long)stats.tx_errors);
         } while (netif.next);
     }
 
@@ -399,6 +429,10 @@ proc_pkt_stats_show(struct seq_file *m, void *v)
         seq_printf(m, "tx_dropped:     %llu\n", (unsigned long long)stats->tx_dropped);
         seq_printf(m, "tx_errors:      %llu\n", (unsigned long long)stats->tx_errors);
         seq_printf(m, "tx_xoffs:       %llu\n", (unsigned long long)stats->tx_xoffs);
+        seq_printf(m, "tx_kicks:       %llu\n", (unsigned long long)stats->tx_kicks);
+        for (qi = 0; qi < dev->pdma_dev.ctrl.nb_txq; qi++) {
+            seq_printf(m, "tx_kicks[%d]:    %llu\n", qi, (unsigned long long)stats->txq_kicks[qi]);
+        }
         seq_printf(m, "interrupts:     %llu\n", (unsigned long long)stats->intrs);
     }
 
@@ -435,8 +469,32 @@ static struct proc_ops proc_pkt_stats_fops = {
 static int
 proc_rate_limit_show(struct seq_file *m, void *v)
 {
+    struct ngknet_dev *dev;
+    ngknet_rate_limit_t rl;
+    int di, ci;
+
     seq_printf(m, "Rx rate limit: %d pps\n", ngknet_rx_rate_limit_get());
 
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (!(dev->flags & NGKNET_DEV_ACTIVE)) {
+            continue;
+        }
+        for (ci = 0; ci < NUM_Q_MAX; ci++) {
+            rl.class_type = NGKNET_RL_CLASS_RX_CHAN;
+            rl.id = ci;
+            if (SHR_FAILURE(ngknet_rx_class_rate_limit_get(dev, &rl)) ||
+                !rl.rate) {
+                continue;
+            }
+            seq_printf(m, "dev%d chan%d: rate %u pps, burst %u, "
+                          "passed %llu, dropped %llu\n",
+                       di, ci, rl.rate, rl.burst,
+                       (unsigned long long)rl.passed,
+                       (unsigned long long)rl.dropped);
+        }
+    }
+
     return 0;
 }
 
@@ -446,20 +504,56 @@ proc_rate_limit_open(struct inode *inode, struct file *file)
     return single_open(file, proc_rate_limit_show, NULL);
 }
 
+/*
+ * Accepted input:
+ *   <rate>                                  global Rx rate limit
+ *   chan <dev> <chan> <rate> [<burst>]      Rx channel rate limit
+ *   filter <dev> <id> <rate> [<burst>]      filter rate limit
+ */
 static ssize_t
 proc_rate_limit_write(struct file *file, const char *buf,
                       size_t count, loff_t *loff)
 {
-    char limit_str[9] = {0};
+    char limit_str[64] = {0};
+    char class_str[8] = {0};
+    ngknet_rate_limit_t rl = {0};
+    unsigned int di, id, rate, burst = 0;
     int rate_limit;
+    int rv;
 
-    if (copy_from_user(limit_str, buf, sizeof(limit_str) - 1)) {
+    if (copy_from_user(limit_str, buf, min(count, sizeof(limit_str) - 1))) {
         return -EFAULT;
     }
-    rate_limit = simple_strtol(limit_str, NULL, 10);
 
-    ngknet_rx_rate_limit_set(rate_limit);
-    printk("Rx rate limit set to: %d pps\n", rate_limit);
+    if (sscanf(limit_str, "%7s %u %u %u %u",
+               class_str, &di, &id, &rate, &burst) < 4) {
+        rate_limit = simple_strtol(limit_str, NULL, 10);
+        ngknet_rx_rate_limit_set(rate_limit);
+        printk("Rx rate limit set to: %d pps\n", rate_limit);
+        return count;
+    }
+
+    if (!strcmp(class_str, "chan")) {
+        rl.class_type = NGKNET_RL_CLASS_RX_CHAN;
+    } else if (!strcmp(class_str, "filter")) {
+        rl.class_type = NGKNET_RL_CLASS_FILTER;
+    } else {
+        return -EINVAL;
+    }
+    if (di >= NUM_PDMA_DEV_MAX ||
+        !(ngknet_devices[di].flags & NGKNET_DEV_ACTIVE)) {
+        return -ENODEV;
+    }
+    rl.id = id;
+    rl.rate = rate;
+    rl.burst = burst;
+
+    rv = ngknet_rx_class_rate_limit_set(&ngknet_devices[di], &rl);
+    if (SHR_FAILURE(rv)) {
+        return -EINVAL;
+    }
+    printk("Rx rate limit of dev%u %s%u set to: %u pps\n",
+           di, class_str, id, rate);
 
     return count;
 }
@@ -583,6 +677,447 @@ static struct proc_ops proc_ring_status_fops = {
     .proc_release =     proc_ring_status_release,
 };
 
+static int
+proc_rx_buf_stats_show(struct seq_file *m, void *v)
+{
+    struct ngknet_dev *dev;
+    struct pdma_rx_queue *rxq;
+    struct ngknet_rx_buf_stats *bs;
+#if NGKNET_PAGE_POOL_STATS
+    struct page_pool_stats pps;
+#endif
+    int di, qi, ai = 0;
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (!(dev->flags & NGKNET_DEV_ACTIVE)) {
+            continue;
+        }
+        ai++;
+
+        for (qi = 0; qi < dev->pdma_dev.ctrl.nb_rxq; qi++) {
+            rxq = (struct pdma_rx_queue *)dev->pdma_dev.ctrl.rx_queue[qi];
+            if (!rxq) {
+                continue;
+            }
+            bs = &dev->rx_buf_stats[qi];
+            seq_printf(m, "\n");
+            seq_printf(m, "dev_no:         %d\n", di);
+            seq_printf(m, "queue:          %d\n", qi);
+            seq_printf(m, "buf_mode:       %s\n",
+                       rxq->buf_mode == PDMA_BUF_MODE_PAGE ? "page" : "skb");
+            seq_printf(m, "page_pool:      %s\n",
+                       dev->rx_pool[qi] ? "yes" : "no");
+            seq_printf(m, "allocs:         %llu\n", (unsigned long long)bs->allocs);
+            seq_printf(m, "alloc_fails:    %llu\n", (unsigned long long)bs->alloc_fails);
+            seq_printf(m, "reuses:         %llu\n", (unsigned long long)bs->reuses);
+            seq_printf(m, "releases:       %llu\n", (unsigned long long)bs->releases);
+#if NGKNET_PAGE_POOL_STATS
+            /* Pages actually returned to the pool, and those it gave up */
+            memset(&pps, 0, sizeof(pps));
+            if (dev->rx_pool[qi] && page_pool_get_stats(dev->rx_pool[qi], &pps)) {
+                seq_printf(m, "recycles:       %llu\n",
+                           (unsigned long long)(pps.recycle_stats.cached +
+                                                pps.recycle_stats.ring));
+                seq_printf(m, "recycle_fails:  %llu\n",
+                           (unsigned long long)(pps.recycle_stats.cache_full +
+                                                pps.recycle_stats.ring_full +
+                                                pps.recycle_stats.released_refcnt));
+            }
+#endif
+        }
+    }
+
+    if (!ai) {
+        seq_printf(m, "%s\n", "No active device");
+    } else {
+        seq_printf(m, "------------------------\n");
+        seq_printf(m, "Total %d devices\n", ai);
+    }
+
+    return 0;
+}
+
+static int
+proc_rx_buf_stats_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_rx_buf_stats_show, NULL);
+}
+
+static int
+proc_rx_buf_stats_release(struct inode *inode, struct file *file)
+{
+    return single_release(inode, file);
+}
+
+static struct proc_ops proc_rx_buf_stats_fops = {
+    PROC_OWNER(THIS_MODULE)
+    .proc_open =        proc_rx_buf_stats_open,
+    .proc_read =        seq_read,
+    .proc_lseek =       seq_lseek,
+    .proc_release =     proc_rx_buf_stats_release,
+};
+
+static int
+proc_rx_batch_stats_show(struct seq_file *m, void *v)
+{
+    struct ngknet_dev *dev;
+    struct ngknet_rx_batch_stats *bs;
+    uint64_t avg;
+    int di, qi, ai = 0;
+
+    seq_printf(m, "Rx batch measurement: %s\n",
+               ngknet_rx_batch_stats_get() ? "enabled" : "disabled");
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (!(dev->flags & NGKNET_DEV_ACTIVE)) {
+            continue;
+        }
+        ai++;
+
+        for (qi = 0; qi < NUM_Q_MAX; qi++) {
+            bs = &dev->rx_batch_stats[qi];
+            if (!bs->polls) {
+                continue;
+            }
+            /* Average in hundredths */
+            avg = div64_u64(bs->pkts * 100, bs->polls);
+            seq_printf(m, "\n");
+            seq_printf(m, "dev_no:         %d\n", di);
+            seq_printf(m, "chan:           %d\n", qi);
+            seq_printf(m, "polls:          %llu\n", (unsigned long long)bs->polls);
+            seq_printf(m, "pkts:           %llu\n", (unsigned long long)bs->pkts);
+            seq_printf(m, "avg_batch:      %llu.%02llu\n",
+                       (unsigned long long)div64_u64(avg, 100),
+                       (unsigned long long)(avg - div64_u64(avg, 100) * 100));
+            seq_printf(m, "max_batch:      %llu\n", (unsigned long long)bs->max_batch);
+        }
+    }
+
+    if (!ai) {
+        seq_printf(m, "%s\n", "No active device");
+    } else {
+        seq_printf(m, "------------------------\n");
+        seq_printf(m, "Total %d devices\n", ai);
+    }
+
+    return 0;
+}
+
+static int
+proc_rx_batch_stats_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_rx_batch_stats_show, NULL);
+}
+
+static ssize_t
+proc_rx_batch_stats_write(struct file *file, const char *buf,
+                          size_t count, loff_t *loff)
+{
+    char enable_str[9] = {0};
+    int enable;
+
+    if (copy_from_user(enable_str, buf, min(count, sizeof(enable_str) - 1))) {
+        return -EFAULT;
+    }
+    enable = simple_strtol(enable_str, NULL, 10);
+
+    ngknet_rx_batch_stats_set(enable);
+    printk("Rx batch measurement %s\n", enable ? "enabled" : "disabled");
+
+    return count;
+}
+
+static int
+proc_rx_batch_stats_release(struct inode *inode, struct file *file)
+{
+    return single_release(inode, file);
+}
+
+static struct proc_ops proc_rx_batch_stats_fops = {
+    PROC_OWNER(THIS_MODULE)
+    .proc_open =        proc_rx_batch_stats_open,
+    .proc_read =        seq_read,
+    .proc_write =       proc_rx_batch_stats_write,
+    .proc_lseek =       seq_lseek,
+    .proc_release =     proc_rx_batch_stats_release,
+};
+
+static void
+proc_intr_moderation_queue_show(struct seq_file *m, int di, int qi,
+                                const char *dir, struct pdma_dim *dim,
+                                uint32_t ic_val)
+{
+    static const char *state_str[] = {"parked", "tired", "right", "left"};
+
+    seq_printf(m, "\n");
+    seq_printf(m, "dev_no:         %d\n", di);
+    seq_printf(m, "queue:          %d\n", qi);
+    seq_printf(m, "dir:            %s\n", dir);
+    seq_printf(m, "profile:        %d\n", dim->profile);
+    seq_printf(m, "count:          %u\n", ic_val >> 16);
+    seq_printf(m, "timer:          %u\n", ic_val & 0xffff);
+    seq_printf(m, "state:          %s\n", state_str[dim->state & 3]);
+    seq_printf(m, "changes:        %llu\n", (unsigned long long)dim->changes);
+    seq_printf(m, "pkts_per_ms:    %u\n", dim->rates.ppms);
+    seq_printf(m, "bytes_per_ms:   %u\n", dim->rates.bpms);
+    seq_printf(m, "intrs_per_ms:   %u\n", dim->rates.epms);
+}
+
+static int
+proc_intr_moderation_show(struct seq_file *m, void *v)
+{
+    struct ngknet_dev *dev;
+    struct pdma_rx_queue *rxq;
+    struct pdma_tx_queue *txq;
+    int di, qi, ai = 0;
+
+    seq_printf(m, "Interrupt moderation: %s\n",
+               ngknet_intr_moderation_get() ? "enabled" : "disabled");
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (!(dev->flags & NGKNET_DEV_ACTIVE)) {
+            continue;
+        }
+        ai++;
+
+        for (qi = 0; qi < dev->pdma_dev.ctrl.nb_rxq; qi++) {
+            rxq = (struct pdma_rx_queue *)dev->pdma_dev.ctrl.rx_queue[qi];
+            if (!rxq || !rxq->dim.active) {
+                continue;
+            }
+            proc_intr_moderation_queue_show(m, di, qi, "rx", &rxq->dim,
+                                            rxq->ic_val);
+        }
+
+        for (qi = 0; qi < dev->pdma_dev.ctrl.nb_txq; qi++) {
+            txq = (struct pdma_tx_queue *)dev->pdma_dev.ctrl.tx_queue[qi];
+            if (!txq || !txq->dim.active) {
+                continue;
+            }
+            proc_intr_moderation_queue_show(m, di, qi, "tx", &txq->dim,
+                                            txq->ic_val);
+        }
+    }
+
+    if (!ai) {
+        seq_printf(m, "%s\n", "No active device");
+    } else {
+        seq_printf(m, "------------------------\n");
+        seq_printf(m, "Total %d devices\n", ai);
+    }
+
+    return 0;
+}
+
+static int
+proc_intr_moderation_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_intr_moderation_show, NULL);
+}
+
+static ssize_t
+proc_intr_moderation_write(struct file *file, const char *buf,
+                           size_t count, loff_t *loff)
+{
+    char enable_str[9] = {0};
+    int enable;
+
+    if (copy_from_user(enable_str, buf, min(count, sizeof(enable_str) - 1))) {
+        return -EFAULT;
+    }
+    enable = simple_strtol(enable_str, NULL, 10);
+
+    ngknet_intr_moderation_set(enable);
+    printk("Interrupt moderation %s\n", enable ? "enabled" : "disabled");
+
+    return count;
+}
+
+static int
+proc_intr_moderation_release(struct inode *inode, struct file *file)
+{
+    return single_release(inode, file);
+}
+
+static struct proc_ops proc_intr_moderation_fops = {
+    PROC_OWNER(THIS_MODULE)
+    .proc_open =        proc_intr_moderation_open,
+    .proc_read =        seq_read,
+    .proc_write =       proc_intr_moderation_write,
+    .proc_lseek =       seq_lseek,
+    .proc_release =     proc_intr_moderation_release,
+};
+
+#ifdef NGKNET_SIM
+static int
+proc_sim_show(struct seq_file *m, void *v)
+{
+    struct ngknet_dev *dev;
+    struct ngknet_sim_bench bench;
+    uint64_t descs, bytes, pps, ns;
+    int di, ci, ai = 0;
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        dev = &ngknet_devices[di];
+        if (!(dev->flags & NGKNET_DEV_ACTIVE) || !ngknet_dev_is_sim(dev)) {
+            continue;
+        }
+        ai++;
+        seq_printf(m, "dev%d:\n", di);
+        if (SHR_SUCCESS(ngknet_sim_bench_get(dev, &bench))) {
+            pps = bench.elapsed_ns ?
+                  div64_u64(bench.processed * NSEC_PER_SEC, bench.elapsed_ns) : 0;
+            ns = bench.processed && bench.cpu_ns > bench.gen_ns ?
+                 div64_u64(bench.cpu_ns - bench.gen_ns, bench.processed) : 0;
+            seq_printf(m, "  gen:       chan %d, size %u, rate %u, burst %u, "
+                          "count %llu, %s\n",
+                       bench.cfg.chan, bench.cfg.size, bench.cfg.rate,
+                       bench.cfg.burst, (unsigned long long)bench.cfg.count,
+                       bench.running ? "running" : "stopped");
+            seq_printf(m, "  elapsed:   %llu ns\n",
+                       (unsigned long long)bench.elapsed_ns);
+            seq_printf(m, "  injected:  %llu\n",
+                       (unsigned long long)bench.injected);
+            seq_printf(m, "  dropped:   %llu\n",
+                       (unsigned long long)bench.dropped);
+            seq_printf(m, "  processed: %llu\n",
+                       (unsigned long long)bench.processed);
+            seq_printf(m, "  rate:      %llu pps\n", (unsigned long long)pps);
+            seq_printf(m, "  cpu:       %llu ns/pkt\n", (unsigned long long)ns);
+        }
+        for (ci = 0; ci < SIM_PDMA_CHAN_MAX; ci++) {
+            if (SHR_FAILURE(bcmcnet_sim_pdma_chan_stats_get(&dev->pdma_dev, ci,
+                                                            &descs, &bytes)) ||
+                !descs) {
+                continue;
+            }
+            seq_printf(m, "  chan%d:     descs %llu, bytes %llu\n", ci,
+                       (unsigned long long)descs, (unsigned long long)bytes);
+        }
+    }
+
+    if (!ai) {
+        seq_printf(m, "%s\n", "No active simulated device");
+    }
+
+    return 0;
+}
+
+static int
+proc_sim_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, proc_sim_show, NULL);
+}
+
+/*
+ * Accepted input:
+ *   start <dev> [chan=<n>] [size=<n>] [rate=<pps>] [burst=<n>] [count=<n>]
+ *               [meta=<hex>]
+ *   stop <dev>
+ */
+static ssize_t
+proc_sim_write(struct file *file, const char *buf,
+               size_t count, loff_t *loff)
+{
+    char sim_str[256] = {0};
+    char *str = sim_str, *tok, *val;
+    struct ngknet_sim_gen_cfg cfg = {0};
+    struct ngknet_dev *dev;
+    unsigned int di;
+    int start, len;
+    int rv;
+
+    if (copy_from_user(sim_str, buf, min(count, sizeof(sim_str) - 1))) {
+        return -EFAULT;
+    }
+
+    tok = strsep(&str, " \t\n");
+    if (!tok) {
+        return -EINVAL;
+    }
+    if (!strcmp(tok, "start")) {
+        start = 1;
+    } else if (!strcmp(tok, "stop")) {
+        start = 0;
+    } else {
+        return -EINVAL;
+    }
+
+    tok = strsep(&str, " \t\n");
+    if (!tok || kstrtouint(tok, 0, &di) || di >= NUM_PDMA_DEV_MAX) {
+        return -EINVAL;
+    }
+    dev = &ngknet_devices[di];
+    if (!(dev->flags & NGKNET_DEV_ACTIVE) || !ngknet_dev_is_sim(dev)) {
+        return -ENODEV;
+    }
+
+    if (!start) {
+        ngknet_sim_gen_stop(dev);
+        return count;
+    }
+
+    cfg.size = ETH_ZLEN + ETH_FCS_LEN;
+    while ((tok = strsep(&str, " \t\n")) != NULL) {
+        if (!*tok) {
+            continue;
+        }
+        val = strchr(tok, '=');
+        if (!val) {
+            return -EINVAL;
+        }
+        *val++ = '\0';
+        if (!strcmp(tok, "chan")) {
+            rv = kstrtoint(val, 0, &cfg.chan);
+        } else if (!strcmp(tok, "size")) {
+            rv = kstrtou32(val, 0, &cfg.size);
+        } else if (!strcmp(tok, "rate")) {
+            rv = kstrtou32(val, 0, &cfg.rate);
+        } else if (!strcmp(tok, "burst")) {
+            rv = kstrtou32(val, 0, &cfg.burst);
+        } else if (!strcmp(tok, "count")) {
+            rv = kstrtou64(val, 0, &cfg.count);
+        } else if (!strcmp(tok, "meta")) {
+            len = strlen(val);
+            if (len & 1 || len / 2 > sizeof(cfg.meta)) {
+                return -EINVAL;
+            }
+            rv = hex2bin(cfg.meta, val, len / 2);
+        } else {
+            rv = -EINVAL;
+        }
+        if (rv) {
+            return -EINVAL;
+        }
+    }
+
+    rv = ngknet_sim_gen_start(dev, &cfg);
+    if (SHR_FAILURE(rv)) {
+        return -EINVAL;
+    }
+
+    return count;
+}
+
+static int
+proc_sim_release(struct inode *inode, struct file *file)
+{
+    return single_release(inode, file);
+}
+
+static struct proc_ops proc_sim_fops = {
+    PROC_OWNER(THIS_MODULE)
+    .proc_open =        proc_sim_open,
+    .proc_read =        seq_read,
+    .proc_write =       proc_sim_write,
+    .proc_lseek =       seq_lseek,
+    .proc_release =     proc_sim_release,
+};
+#endif /* NGKNET_SIM */
+
 int
 ngknet_procfs_init(void)
 {
@@ -612,6 +1147,12 @@ ngknet_procfs_init(void)
         return -1;
     }
 
+    PROC_CREATE(entry, "intr_moderation", 0666, proc_root, &proc_intr_moderation_fops);
+    if (entry == NULL) {
+        printk(KERN_ERR "ngknet: proc_create failed\n");
+        return -1;
+    }
+
     PROC_CREATE(entry, "netif_info", 0444, proc_root, &proc_netif_info_fops);
     if (entry == NULL) {
         printk(KERN_ERR "ngknet: proc_create failed\n");
@@ -642,6 +1183,26 @@ ngknet_procfs_init(void)
         return -1;
     }
 
+    PROC_CREATE(entry, "rx_batch_stats", 0666, proc_root, &proc_rx_batch_stats_fops);
+    if (entry == NULL) {
+        printk(KERN_ERR "ngknet: proc_create failed\n");
+        return -1;
+    }
+
+    PROC_CREATE(entry, "rx_buf_stats", 0444, proc_root, &proc_rx_buf_stats_fops);
+    if (entry == NULL) {
+        printk(KERN_ERR "ngknet: proc_create failed\n");
+        return -1;
+    }
+
+#ifdef NGKNET_SIM
+    PROC_CREATE(entry, "sim", 0666, proc_root, &proc_sim_fops);
+    if (entry == NULL) {
+        printk(KERN_ERR "ngknet: proc_create failed\n");
+        return -1;
+    }
+#endif
+
     return 0;
 }
 
@@ -651,11 +1212,17 @@ ngknet_procfs_cleanup(void)
     remove_proc_entry("debug_level", proc_root);
     remove_proc_entry("device_info", proc_root);
     remove_proc_entry("filter_info", proc_root);
+    remove_proc_entry("intr_moderation", proc_root);
     remove_proc_entry("netif_info", proc_root);
     remove_proc_entry("pkt_stats", proc_root);
     remove_proc_entry("rate_limit", proc_root);
     remove_proc_entry("reg_status", proc_root);
     remove_proc_entry("ring_status", proc_root);
+    remove_proc_entry("rx_batch_stats", proc_root);
+    remove_proc_entry("rx_buf_stats", proc_root);
+#ifdef NGKNET_SIM
+    remove_proc_entry("sim", proc_root);
+#endif
 
     remove_proc_entry(NGKNET_MODULE_NAME, NULL);
 
@@ -0,0 +1,524 @@
+/*! \file ngknet_sim.c
+ *
+ * Simulated device support for NGKNET module.
+ *
+ * A simulated device runs the complete NGKNET packet path (BCMCNET rings,
+ * buffer management, filters, network interfaces) on top of the software
+ * PDMA engine. Packets are fed by an Rx traffic generator which also
+ * measures the packet rate and the CPU cost per packet.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <lkm/lkm.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/etherdevice.h>
+#include <linux/dma-mapping.h>
+#include <linux/irq_work.h>
+#include <linux/kernel_stat.h>
+#include <linux/platform_device.h>
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+#include <linux/sched/task.h>
+#endif
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0))
+#include <linux/dma-direct.h>
+#endif
+#include <bcmcnet/bcmcnet_rxtx.h>
+#include "ngknet_sim.h"
+
+/*! Default generator burst */
+#define SIM_GEN_BURST_DEF       32
+
+/*! Ethernet type of generated packets (local experimental) */
+#define SIM_GEN_ETH_TYPE        0x88b5
+
+/*!
+ * Simulated device control
+ */
+struct ngknet_sim_ctrl {
+    /*! Interrupt work */
+    struct irq_work irq_work;
+
+    /*! Interrupt handler */
+    int (*isr)(void *);
+
+    /*! Interrupt handler data */
+    void *isr_data;
+
+    /*! Generator lock */
+    struct mutex lock;
+
+    /*! Generator task */
+    struct task_struct *task;
+
+    /*! Device structure point */
+    struct ngknet_dev *dev;
+
+    /*! Generator configuration */
+    struct ngknet_sim_gen_cfg cfg;
+
+    /*! Generated frame */
+    uint8_t *frame;
+
+    /*! Generated frame length */
+    uint32_t frame_len;
+
+    /*! Generator done */
+    int done;
+
+    /*! Packets received by the simulated HW */
+    uint64_t injected;
+
+    /*! Packets dropped by the simulated HW */
+    uint64_t dropped;
+
+    /*! Start time (ns) */
+    uint64_t start_ns;
+
+    /*! Stop time (ns) */
+    uint64_t stop_ns;
+
+    /*! Rx queue packets at start */
+    uint64_t start_pkts;
+
+    /*! Rx queue packets at stop */
+    uint64_t stop_pkts;
+
+    /*! CPU time at start (ns) */
+    uint64_t start_cpu;
+
+    /*! CPU time at stop (ns) */
+    uint64_t stop_cpu;
+
+    /*! Generator CPU time (ns) */
+    uint64_t gen_ns;
+};
+
+static struct ngknet_sim_ctrl sim_ctrl[NUM_PDMA_DEV_MAX];
+
+static struct platform_device *sim_pdev;
+
+/*!
+ * Get CPU time spent in kernel and interrupts on all CPUs
+ */
+static uint64_t
+ngknet_sim_cpu_ns(void)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+    struct kernel_cpustat *kcs;
+    uint64_t ns = 0;
+    int cpu;
+
+    for_each_online_cpu(cpu) {
+        kcs = &kcpustat_cpu(cpu);
+        ns += kcs->cpustat[CPUTIME_SYSTEM] +
+              kcs->cpustat[CPUTIME_SOFTIRQ] +
+              kcs->cpustat[CPUTIME_IRQ];
+    }
+
+    return ns;
+#else
+    return 0;
+#endif
+}
+
+/*!
+ * Get packets processed on the generator Rx queue
+ */
+static uint64_t
+ngknet_sim_rx_pkts(struct ngknet_sim_ctrl *sc)
+{
+    struct pdma_dev *pdev = &sc->dev->pdma_dev;
+    struct pdma_rx_queue *rxq;
+    int queue, dir;
+
+    if (SHR_FAILURE(bcmcnet_pdma_dev_chan_to_queue(pdev, sc->cfg.chan,
+                                                   &queue, &dir)) ||
+        dir != PDMA_Q_RX) {
+        return 0;
+    }
+    rxq = (struct pdma_rx_queue *)pdev->ctrl.rx_queue[queue];
+
+    return rxq ? READ_ONCE(rxq->stats.packets) : 0;
+}
+
+/*!
+ * Deliver simulated interrupt
+ */
+static void
+ngknet_sim_irq_work(struct irq_work *work)
+{
+    struct ngknet_sim_ctrl *sc = container_of(work, struct ngknet_sim_ctrl, irq_work);
+    int (*isr)(void *) = READ_ONCE(sc->isr);
+
+    if (isr) {
+        isr(sc->isr_data);
+    }
+}
+
+/*!
+ * Raise simulated interrupt
+ */
+static void
+ngknet_sim_intr_raise(void *data)
+{
+    struct ngknet_sim_ctrl *sc = data;
+
+    irq_work_queue(&sc->irq_work);
+}
+
+/*!
+ * Build the generated frame
+ */
+static int
+ngknet_sim_frame_build(struct ngknet_sim_ctrl *sc)
+{
+    struct ngknet_sim_gen_cfg *cfg = &sc->cfg;
+    struct ethhdr *eth;
+    uint8_t *pkt;
+    uint32_t i;
+
+    sc->frame_len = SIM_RX_PKT_HDR_SIZE + cfg->size;
+    sc->frame = kzalloc(sc->frame_len, GFP_KERNEL);
+    if (!sc->frame) {
+        return SHR_E_MEMORY;
+    }
+
+    memcpy(sc->frame, cfg->meta, SIM_RX_PKT_HDR_SIZE);
+
+    pkt = sc->frame + SIM_RX_PKT_HDR_SIZE;
+    eth = (struct ethhdr *)pkt;
+    eth_broadcast_addr(eth->h_dest);
+    eth_zero_addr(eth->h_source);
+    eth->h_source[0] = 0x02;
+    eth->h_source[5] = 0x01;
+    eth->h_proto = htons(SIM_GEN_ETH_TYPE);
+
+    /* Leave the FCS as zero */
+    for (i = ETH_HLEN; i < cfg->size - ETH_FCS_LEN; i++) {
+        pkt[i] = (uint8_t)i;
+    }
+
+    return SHR_E_NONE;
+}
+
+/*!
+ * Rx traffic generator thread
+ */
+static int
+ngknet_sim_gen_thread(void *data)
+{
+    struct ngknet_sim_ctrl *sc = data;
+    struct ngknet_sim_gen_cfg *cfg = &sc->cfg;
+    struct pdma_dev *pdev = &sc->dev->pdma_dev;
+    uint64_t sent = 0, due, now;
+    uint32_t burst;
+    int rv;
+
+    while (!kthread_should_stop()) {
+        if (cfg->count && sent >= cfg->count) {
+            break;
+        }
+
+        burst = cfg->burst;
+        if (cfg->count && cfg->count - sent < burst) {
+            burst = cfg->count - sent;
+        }
+
+        /* Pace the bursts to the configured rate */
+        if (cfg->rate) {
+            now = ktime_get_ns() - sc->start_ns;
+            due = div_u64(sent * NSEC_PER_SEC, cfg->rate);
+            if (due > now) {
+                if (due - now > 20 * NSEC_PER_USEC) {
+                    usleep_range(div_u64(due - now, NSEC_PER_USEC),
+                                 div_u64(due - now, NSEC_PER_USEC) + 10);
+                } else {
+                    cond_resched();
+                }
+                continue;
+            }
+        }
+
+        rv = bcmcnet_sim_pdma_rx_inject(pdev, cfg->chan, sc->frame,
+                                        sc->frame_len, burst);
+        if (rv < 0) {
+            break;
+        }
+        WRITE_ONCE(sc->injected, sc->injected + rv);
+
+        if (cfg->rate) {
+            /* Packets not fitting in the ring are lost as on the wire */
+            WRITE_ONCE(sc->dropped, sc->dropped + burst - rv);
+            sent += burst;
+        } else {
+            /* Back off while the driver catches up */
+            sent += rv;
+            if ((uint32_t)rv < burst) {
+                cond_resched();
+            }
+        }
+    }
+
+    sc->stop_ns = ktime_get_ns();
+    sc->stop_pkts = ngknet_sim_rx_pkts(sc);
+    sc->stop_cpu = ngknet_sim_cpu_ns();
+    sc->gen_ns = current->se.sum_exec_runtime;
+    smp_store_release(&sc->done, 1);
+
+    /* Wait to be stopped */
+    set_current_state(TASK_INTERRUPTIBLE);
+    while (!kthread_should_stop()) {
+        schedule();
+        set_current_state(TASK_INTERRUPTIBLE);
+    }
+    __set_current_state(TASK_RUNNING);
+
+    return 0;
+}
+
+/*!
+ * Stop the generator with the lock held
+ */
+static void
+ngknet_sim_gen_stop_locked(struct ngknet_sim_ctrl *sc)
+{
+    if (!sc->task) {
+        return;
+    }
+
+    kthread_stop(sc->task);
+    put_task_struct(sc->task);
+    sc->task = NULL;
+
+    kfree(sc->frame);
+    sc->frame = NULL;
+}
+
+struct device *
+ngknet_sim_dma_dev_get(void)
+{
+    return sim_pdev ? &sim_pdev->dev : NULL;
+}
+
+void *
+ngknet_sim_p2v(struct pdma_dev *pdev, uint64_t paddr)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0))
+    return phys_to_virt(dma_to_phys(&sim_pdev->dev, (dma_addr_t)paddr));
+#else
+    return phys_to_virt((phys_addr_t)paddr);
+#endif
+}
+
+uint64_t
+ngknet_sim_v2p(struct pdma_dev *pdev, void *vaddr)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0))
+    return (uint64_t)phys_to_dma(&sim_pdev->dev, virt_to_phys(vaddr));
+#else
+    return (uint64_t)virt_to_phys(vaddr);
+#endif
+}
+
+int
+ngknet_sim_intr_connect(struct ngknet_dev *dev, int (*isr)(void *), void *data)
+{
+    struct ngknet_sim_ctrl *sc = &sim_ctrl[dev->dev_info.dev_no];
+
+    sc->isr_data = data;
+    WRITE_ONCE(sc->isr, isr);
+
+    return bcmcnet_sim_pdma_intr_connect(&dev->pdma_dev, ngknet_sim_intr_raise, sc);
+}
+
+void
+ngknet_sim_intr_disconnect(struct ngknet_dev *dev)
+{
+    struct ngknet_sim_ctrl *sc = &sim_ctrl[dev->dev_info.dev_no];
+
+    bcmcnet_sim_pdma_intr_connect(&dev->pdma_dev, NULL, NULL);
+    WRITE_ONCE(sc->isr, NULL);
+    irq_work_sync(&sc->irq_work);
+}
+
+int
+ngknet_sim_gen_start(struct ngknet_dev *dev, struct ngknet_sim_gen_cfg *cfg)
+{
+    struct ngknet_sim_ctrl *sc = &sim_ctrl[dev->dev_info.dev_no];
+    struct task_struct *task;
+    int queue, dir;
+    int rv;
+
+    if (!ngknet_dev_is_sim(dev) || !(dev->flags & NGKNET_DEV_ACTIVE)) {
+        return SHR_E_UNAVAIL;
+    }
+
+    rv = bcmcnet_pdma_dev_chan_to_queue(&dev->pdma_dev, cfg->chan, &queue, &dir);
+    if (SHR_FAILURE(rv) || dir != PDMA_Q_RX) {
+        return SHR_E_PARAM;
+    }
+    if (cfg->size < ETH_ZLEN + ETH_FCS_LEN ||
+        cfg->size > dev->pdma_dev.ctrl.rx_buf_size - SIM_RX_PKT_HDR_SIZE) {
+        return SHR_E_PARAM;
+    }
+    if (!cfg->burst) {
+        cfg->burst = SIM_GEN_BURST_DEF;
+    }
+
+    mutex_lock(&sc->lock);
+
+    ngknet_sim_gen_stop_locked(sc);
+
+    sc->dev = dev;
+    sc->cfg = *cfg;
+    rv = ngknet_sim_frame_build(sc);
+    if (SHR_FAILURE(rv)) {
+        mutex_unlock(&sc->lock);
+        return rv;
+    }
+
+    sc->done = 0;
+    sc->injected = 0;
+    sc->dropped = 0;
+    sc->start_ns = ktime_get_ns();
+    sc->start_pkts = ngknet_sim_rx_pkts(sc);
+    sc->start_cpu = ngknet_sim_cpu_ns();
+
+    task = kthread_create(ngknet_sim_gen_thread, sc, "ngknet_sim%d",
+                          dev->dev_info.dev_no);
+    if (IS_ERR(task)) {
+        kfree(sc->frame);
+        sc->frame = NULL;
+        mutex_unlock(&sc->lock);
+        return SHR_E_INTERNAL;
+    }
+    get_task_struct(task);
+    sc->task = task;
+    wake_up_process(task);
+
+    mutex_unlock(&sc->lock);
+
+    return SHR_E_NONE;
+}
+
+int
+ngknet_sim_gen_stop(struct ngknet_dev *dev)
+{
+    struct ngknet_sim_ctrl *sc = &sim_ctrl[dev->dev_info.dev_no];
+
+    mutex_lock(&sc->lock);
+    ngknet_sim_gen_stop_locked(sc);
+    mutex_unlock(&sc->lock);
+
+    return SHR_E_NONE;
+}
+
+int
+ngknet_sim_bench_get(struct ngknet_dev *dev, struct ngknet_sim_bench *bench)
+{
+    struct ngknet_sim_ctrl *sc = &sim_ctrl[dev->dev_info.dev_no];
+    uint64_t stop_ns, stop_pkts, stop_cpu, gen_ns;
+
+    memset(bench, 0, sizeof(*bench));
+
+    mutex_lock(&sc->lock);
+
+    if (!sc->dev || sc->dev != dev) {
+        mutex_unlock(&sc->lock);
+        return SHR_E_UNAVAIL;
+    }
+
+    bench->cfg = sc->cfg;
+    bench->running = sc->task && !smp_load_acquire(&sc->done);
+    if (bench->running) {
+        stop_ns = ktime_get_ns();
+        stop_pkts = ngknet_sim_rx_pkts(sc);
+        stop_cpu = ngknet_sim_cpu_ns();
+        gen_ns = sc->task->se.sum_exec_runtime;
+    } else {
+        stop_ns = sc->stop_ns;
+        stop_pkts = sc->stop_pkts;
+        stop_cpu = sc->stop_cpu;
+        gen_ns = sc->gen_ns;
+    }
+
+    /* The generator was stopped before finishing */
+    if (!bench->running && !sc->done) {
+        mutex_unlock(&sc->lock);
+        return SHR_E_NONE;
+    }
+
+    bench->elapsed_ns = stop_ns - sc->start_ns;
+    bench->injected = READ_ONCE(sc->injected);
+    bench->dropped = READ_ONCE(sc->dropped);
+    bench->processed = stop_pkts - sc->start_pkts;
+    bench->cpu_ns = stop_cpu - sc->start_cpu;
+    bench->gen_ns = gen_ns;
+
+    mutex_unlock(&sc->lock);
+
+    return SHR_E_NONE;
+}
+
+int
+ngknet_sim_init(void)
+{
+    int di;
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        init_irq_work(&sim_ctrl[di].irq_work, ngknet_sim_irq_work);
+        mutex_init(&sim_ctrl[di].lock);
+    }
+
+    sim_pdev = platform_device_register_simple("ngknet-sim", -1, NULL, 0);
+    if (IS_ERR(sim_pdev)) {
+        sim_pdev = NULL;
+        return SHR_E_FAIL;
+    }
+
+    if (dma_coerce_mask_and_coherent(&sim_pdev->dev, DMA_BIT_MASK(64))) {
+        platform_device_unregister(sim_pdev);
+        sim_pdev = NULL;
+        return SHR_E_FAIL;
+    }
+
+    return SHR_E_NONE;
+}
+
+void
+ngknet_sim_cleanup(void)
+{
+    int di;
+
+    for (di = 0; di < NUM_PDMA_DEV_MAX; di++) {
+        mutex_lock(&sim_ctrl[di].lock);
+        ngknet_sim_gen_stop_locked(&sim_ctrl[di]);
+        mutex_unlock(&sim_ctrl[di].lock);
+    }
+
+    if (sim_pdev) {
+        platform_device_unregister(sim_pdev);
+        sim_pdev = NULL;
+    }
+}
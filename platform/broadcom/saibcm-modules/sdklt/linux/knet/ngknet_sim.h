@@ -0,0 +1,274 @@
+/*! \file ngknet_sim.h
+ *
+ * Simulated device support for NGKNET module.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef NGKNET_SIM_H
+#define NGKNET_SIM_H
+
+#include <bcmcnet/bcmcnet_sim.h>
+#include "ngknet_main.h"
+
+/*!
+ * \brief Rx traffic generator configuration.
+ */
+struct ngknet_sim_gen_cfg {
+    /*! Rx channel */
+    int chan;
+
+    /*! Packet size including FCS */
+    uint32_t size;
+
+    /*! Rate in packets per second, 0 for as fast as possible */
+    uint32_t rate;
+
+    /*! Packets per injection */
+    uint32_t burst;
+
+    /*! Packets to send, 0 for no limit */
+    uint64_t count;
+
+    /*! Rx packet header (metadata) */
+    uint8_t meta[SIM_RX_PKT_HDR_SIZE];
+};
+
+/*!
+ * \brief Rx traffic generator benchmark.
+ */
+struct ngknet_sim_bench {
+    /*! Generator configuration */
+    struct ngknet_sim_gen_cfg cfg;
+
+    /*! Generator running */
+    int running;
+
+    /*! Elapsed time (ns) */
+    uint64_t elapsed_ns;
+
+    /*! Packets received by the simulated HW */
+    uint64_t injected;
+
+    /*! Packets dropped by the simulated HW for no Rx descriptor */
+    uint64_t dropped;
+
+    /*! Packets processed by the driver */
+    uint64_t processed;
+
+    /*! CPU time spent in kernel and interrupts on all CPUs (ns) */
+    uint64_t cpu_ns;
+
+    /*! CPU time spent by the generator itself (ns) */
+    uint64_t gen_ns;
+};
+
+#ifdef NGKNET_SIM
+
+/*!
+ * \brief Check if a device is simulated.
+ *
+ * \param [in] dev Device structure point.
+ *
+ * \retval true Simulated device.
+ */
+static inline bool
+ngknet_dev_is_sim(struct ngknet_dev *dev)
+{
+    return dev->pdma_dev.dev_type == NGKNET_DEV_T_SIM;
+}
+
+/*!
+ * \brief Get the DMA device for simulated devices.
+ *
+ * \return Device pointer or NULL if not available.
+ */
+extern struct device *
+ngknet_sim_dma_dev_get(void);
+
+/*!
+ * \brief Convert bus address to virtual address.
+ *
+ * \param [in] pdev Packet DMA device structure point.
+ * \param [in] paddr Bus address.
+ *
+ * \return Virtual address.
+ */
+extern void *
+ngknet_sim_p2v(struct pdma_dev *pdev, uint64_t paddr);
+
+/*!
+ * \brief Convert virtual address to bus address.
+ *
+ * \param [in] pdev Packet DMA device structure point.
+ * \param [in] vaddr Virtual address.
+ *
+ * \return Bus address.
+ */
+extern uint64_t
+ngknet_sim_v2p(struct pdma_dev *pdev, void *vaddr);
+
+/*!
+ * \brief Connect interrupt handler of a simulated device.
+ *
+ * The handler runs in hard interrupt context like a real one.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] isr Interrupt handler.
+ * \param [in] data Handler data.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_sim_intr_connect(struct ngknet_dev *dev, int (*isr)(void *), void *data);
+
+/*!
+ * \brief Disconnect interrupt handler of a simulated device.
+ *
+ * \param [in] dev Device structure point.
+ */
+extern void
+ngknet_sim_intr_disconnect(struct ngknet_dev *dev);
+
+/*!
+ * \brief Start Rx traffic generator.
+ *
+ * \param [in] dev Device structure point.
+ * \param [in] cfg Generator configuration.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_sim_gen_start(struct ngknet_dev *dev, struct ngknet_sim_gen_cfg *cfg);
+
+/*!
+ * \brief Stop Rx traffic generator.
+ *
+ * \param [in] dev Device structure point.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_sim_gen_stop(struct ngknet_dev *dev);
+
+/*!
+ * \brief Get Rx traffic generator benchmark.
+ *
+ * Results are for the ongoing run or the last one.
+ *
+ * \param [in] dev Device structure point.
+ * \param [out] bench Benchmark results.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_sim_bench_get(struct ngknet_dev *dev, struct ngknet_sim_bench *bench);
+
+/*!
+ * \brief Initialize simulated device support.
+ *
+ * \retval SHR_E_NONE No errors.
+ * \retval SHR_E_XXXX Operation failed.
+ */
+extern int
+ngknet_sim_init(void);
+
+/*!
+ * \brief Clean up simulated device support.
+ */
+extern void
+ngknet_sim_cleanup(void);
+
+#else /* !NGKNET_SIM */
+
+/*
+ * Simulated device support is only built with NGKNET_SIM=1 so that
+ * production modules do not register the platform device or expose the
+ * traffic generator.
+ */
+static inline bool
+ngknet_dev_is_sim(struct ngknet_dev *dev)
+{
+    return false;
+}
+
+static inline struct device *
+ngknet_sim_dma_dev_get(void)
+{
+    return NULL;
+}
+
+static inline void *
+ngknet_sim_p2v(struct pdma_dev *pdev, uint64_t paddr)
+{
+    return NULL;
+}
+
+static inline uint64_t
+ngknet_sim_v2p(struct pdma_dev *pdev, void *vaddr)
+{
+    return 0;
+}
+
+static inline int
+ngknet_sim_intr_connect(struct ngknet_dev *dev, int (*isr)(void *), void *data)
+{
+    return SHR_E_UNAVAIL;
+}
+
+static inline void
+ngknet_sim_intr_disconnect(struct ngknet_dev *dev)
+{
+}
+
+static inline int
+ngknet_sim_gen_start(struct ngknet_dev *dev, struct ngknet_sim_gen_cfg *cfg)
+{
+    return SHR_E_UNAVAIL;
+}
+
+static inline int
+ngknet_sim_gen_stop(struct ngknet_dev *dev)
+{
+    return SHR_E_UNAVAIL;
+}
+
+static inline int
+ngknet_sim_bench_get(struct ngknet_dev *dev, struct ngknet_sim_bench *bench)
+{
+    return SHR_E_UNAVAIL;
+}
+
+static inline int
+ngknet_sim_init(void)
+{
+    return SHR_E_NONE;
+}
+
+static inline void
+ngknet_sim_cleanup(void)
+{
+}
+
+#endif /* NGKNET_SIM */
+
+#endif /* NGKNET_SIM_H */
@@ -0,0 +1,132 @@
+/*! \file ngknet_xdp.c
+ *
+ * Utility routines for XDP.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include "ngknet_xdp.h"
+
+#if NGKNET_XDP
+
+/*
+ * Rx buffers are owned by the BCMCNET buffer manager and reach the netif as
+ * SKBs, so the program runs on the SKB through the generic XDP helpers. This
+ * still happens in the driver, before GRO and the stack, and XDP_REDIRECT to
+ * an XSKMAP feeds AF_XDP sockets in copy mode.
+ */
+
+static int
+ngknet_xdp_setup(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    struct bpf_prog *old_prog;
+
+    old_prog = rtnl_dereference(priv->xdp_prog);
+    rcu_assign_pointer(priv->xdp_prog, bpf->prog);
+    if (old_prog) {
+        bpf_prog_put(old_prog);
+    }
+
+    return 0;
+}
+
+int
+ngknet_xdp_bpf(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+    switch (bpf->command) {
+    case XDP_SETUP_PROG:
+        return ngknet_xdp_setup(ndev, bpf);
+    default:
+        return -EINVAL;
+    }
+}
+
+int
+ngknet_xdp_rx(struct net_device *ndev, struct sk_buff **oskb)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    struct bpf_prog *prog;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    struct bpf_net_context __bpf_net_ctx, *bpf_net_ctx;
+#endif
+    u32 act;
+
+    rcu_read_lock();
+    prog = rcu_dereference(priv->xdp_prog);
+    if (!prog) {
+        rcu_read_unlock();
+        return SHR_E_NONE;
+    }
+
+    /* The HNET path runs in process context */
+    local_bh_disable();
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    bpf_net_ctx = bpf_net_ctx_set(&__bpf_net_ctx);
+#endif
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,9,0))
+    act = do_xdp_generic(prog, oskb);
+#else
+    act = do_xdp_generic(prog, *oskb);
+#endif
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6,11,0))
+    bpf_net_ctx_clear(bpf_net_ctx);
+#endif
+    local_bh_enable();
+    rcu_read_unlock();
+
+    if (act != XDP_PASS) {
+        *oskb = NULL;
+        return SHR_E_UNAVAIL;
+    }
+
+    return SHR_E_NONE;
+}
+
+void
+ngknet_xdp_cleanup(struct net_device *ndev)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    struct bpf_prog *prog;
+
+    /* Normally detached by the core while unregistering */
+    prog = rcu_dereference_protected(priv->xdp_prog, 1);
+    RCU_INIT_POINTER(priv->xdp_prog, NULL);
+    if (prog) {
+        bpf_prog_put(prog);
+    }
+}
+
+uint32_t
+ngknet_xdp_prog_id(struct net_device *ndev)
+{
+    struct ngknet_private *priv = netdev_priv(ndev);
+    struct bpf_prog *prog;
+    uint32_t id = 0;
+
+    rcu_read_lock();
+    prog = rcu_dereference(priv->xdp_prog);
+    if (prog) {
+        id = prog->aux->id;
+    }
+    rcu_read_unlock();
+
+    return id;
+}
+
+#endif /* NGKNET_XDP */
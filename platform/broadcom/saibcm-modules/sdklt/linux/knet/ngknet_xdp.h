@@ -0,0 +1,82 @@
+/*! \file ngknet_xdp.h
+ *
+ * Definitions and APIs declaration for XDP.
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#ifndef NGKNET_XDP_H
+#define NGKNET_XDP_H
+
+#include <linux/skbuff.h>
+#include "ngknet_main.h"
+
+#if NGKNET_XDP
+
+/*!
+ * \brief Configure XDP for a network interface.
+ *
+ * Handler of ndo_bpf. Only XDP_SETUP_PROG is supported. AF_XDP sockets
+ * are served in copy mode through XDP_REDIRECT to an XSKMAP.
+ *
+ * \param [in] ndev Network device structure point.
+ * \param [in] bpf BPF command.
+ *
+ * \retval 0 No errors.
+ * \retval -EXXX Operation failed.
+ */
+extern int
+ngknet_xdp_bpf(struct net_device *ndev, struct netdev_bpf *bpf);
+
+/*!
+ * \brief Run the XDP program of a network interface on an Rx packet.
+ *
+ * The packet must have gone through eth_type_trans(). If the program does
+ * not return XDP_PASS, the packet has been consumed (dropped, transmitted
+ * or redirected) and the SKB pointer is set to NULL.
+ *
+ * \param [in] ndev Network device structure point.
+ * \param [in] oskb Rx packet SKB.
+ *
+ * \retval SHR_E_NONE Packet passed to the network stack.
+ * \retval SHR_E_UNAVAIL Packet consumed by XDP.
+ */
+extern int
+ngknet_xdp_rx(struct net_device *ndev, struct sk_buff **oskb);
+
+/*!
+ * \brief Release the XDP program of a network interface.
+ *
+ * \param [in] ndev Network device structure point.
+ */
+extern void
+ngknet_xdp_cleanup(struct net_device *ndev);
+
+/*!
+ * \brief Get the XDP program attached to a network interface.
+ *
+ * \param [in] ndev Network device structure point.
+ *
+ * \return XDP program ID or 0 if none.
+ */
+extern uint32_t
+ngknet_xdp_prog_id(struct net_device *ndev);
+
+#endif /* NGKNET_XDP */
+
+#endif /* NGKNET_XDP_H */
@@ -0,0 +1,241 @@
+/*! \file bcmcnet_dim_test.c
+ *
+ * User space test of the BCMCNET dynamic interrupt moderation engine.
+ *
+ * A single Rx queue is sampled with a fake clock and synthetic traffic,
+ * and the profiles the engine programs through the interrupt coalescing
+ * API are checked: sparse traffic stays on the lightest profile right
+ * up to the threshold, rates do not wrap at high traffic volumes, the
+ * walk settles on the best profile of a throughput model, and disabling
+ * moderation falls back to the lightest profile.
+ *
+ *     bcmcnet_dim_test
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bcmcnet/bcmcnet_core.h>
+#include <bcmcnet/bcmcnet_dev.h>
+#include <bcmcnet/bcmcnet_rxtx.h>
+#include <bcmcnet/bcmcnet_dim.h>
+
+static struct pdma_dev dev;
+static struct pdma_rx_queue rxq;
+static struct intr_handle hdl;
+
+static unsigned long now_usecs;
+static int coal_count = -1;
+static int coal_timer = -1;
+static int coal_calls;
+static int errs;
+
+#define CHECK(_c, _fmt, _args...)                                   \
+    do {                                                            \
+        if (!(_c)) {                                                \
+            fprintf(stderr, "%s:%d: " _fmt "\n",                    \
+                    __func__, __LINE__, ##_args);                   \
+            errs++;                                                 \
+        }                                                           \
+    } while (0)
+
+unsigned long
+sal_time_usecs(void)
+{
+    return now_usecs;
+}
+
+int
+bcmcnet_pdma_rx_queue_int_coalesce(struct pdma_dev *pdev, int queue,
+                                   int count, int timer)
+{
+    coal_count = count;
+    coal_timer = timer;
+    coal_calls++;
+    return SHR_E_NONE;
+}
+
+int
+bcmcnet_pdma_tx_queue_int_coalesce(struct pdma_dev *pdev, int queue,
+                                   int count, int timer)
+{
+    return SHR_E_NONE;
+}
+
+static void
+queue_setup(uint32_t nb_desc)
+{
+    memset(&dev, 0, sizeof(dev));
+    memset(&rxq, 0, sizeof(rxq));
+    memset(&hdl, 0, sizeof(hdl));
+    dev.started = true;
+    dev.flags = PDMA_INTR_DIM;
+    dev.ctrl.rx_queue[0] = &rxq;
+    rxq.state = PDMA_RX_QUEUE_ACTIVE;
+    rxq.nb_desc = nb_desc;
+    hdl.queue = 0;
+    hdl.dir = PDMA_Q_RX;
+    now_usecs = 1000;
+    coal_count = coal_timer = -1;
+    coal_calls = 0;
+
+    /* The first sample activates moderation on the lightest profile */
+    bcmcnet_queue_dim_sample(&dev, &hdl);
+}
+
+/*!
+ * Run interrupt events until the engine has evaluated one window.
+ */
+static void
+window_run(uint64_t pkts, uint64_t bytes, unsigned long usecs)
+{
+    int events = PDMA_DIM_NEVENTS;
+    int ei;
+
+    for (ei = 0; ei < events; ei++) {
+        now_usecs += usecs / events;
+        rxq.stats.packets += pkts / events;
+        rxq.stats.bytes += bytes / events;
+        bcmcnet_queue_dim_sample(&dev, &hdl);
+    }
+}
+
+static void
+test_profiles(void)
+{
+    const struct pdma_dim_profile *prof;
+
+    prof = bcmcnet_dim_profile_get(PDMA_Q_RX, 0);
+    CHECK(prof && prof->count == 1 && prof->timer == 0,
+          "lightest Rx profile must interrupt per packet");
+    CHECK(bcmcnet_dim_profile_get(PDMA_Q_RX, -1) == NULL, "profile -1");
+    CHECK(bcmcnet_dim_profile_get(PDMA_Q_TX, PDMA_DIM_PROFILES) == NULL,
+          "profile %d", PDMA_DIM_PROFILES);
+}
+
+static void
+test_sparse(void)
+{
+    unsigned long usecs = PDMA_DIM_NEVENTS * 1000;
+    uint64_t below = (PDMA_DIM_SPARSE_PPMS - 1) * (usecs / 1000);
+    uint64_t at = PDMA_DIM_SPARSE_PPMS * (usecs / 1000);
+    int wi;
+
+    queue_setup(1024);
+    CHECK(coal_calls == 1 && coal_count == 1 && coal_timer == 0,
+          "activation programmed %d/%d", coal_count, coal_timer);
+
+    /* Idle and just below the threshold stay on the lightest profile */
+    window_run(0, 0, usecs);
+    for (wi = 0; wi < 20; wi++) {
+        window_run(below, below * 64, usecs);
+    }
+    CHECK(rxq.dim.profile == 0, "profile %d below threshold", rxq.dim.profile);
+    CHECK(rxq.dim.changes == 0, "%d changes below threshold",
+          (int)rxq.dim.changes);
+    CHECK(coal_calls == 1, "%d coalesce updates below threshold", coal_calls);
+
+    /* At the threshold the engine starts tuning */
+    window_run(at, at * 64, usecs);
+    CHECK(rxq.dim.profile == 1, "profile %d at threshold", rxq.dim.profile);
+    CHECK(coal_count == 4 && coal_timer == 16,
+          "programmed %d/%d at threshold", coal_count, coal_timer);
+
+    /* Dropping below it goes straight back to the lightest profile */
+    window_run(below, below * 64, usecs);
+    CHECK(rxq.dim.profile == 0, "profile %d after drop", rxq.dim.profile);
+    CHECK(rxq.dim.state == PDMA_DIM_PARKING_ON_TOP, "state %d after drop",
+          rxq.dim.state);
+    CHECK(coal_count == 1 && coal_timer == 0,
+          "programmed %d/%d after drop", coal_count, coal_timer);
+}
+
+static void
+test_high_rate(void)
+{
+    /* 400 Gbps (50000 bytes per us) for a full window, over 32 bits */
+    unsigned long usecs = PDMA_DIM_WINDOW_USECS / PDMA_DIM_NEVENTS *
+                          PDMA_DIM_NEVENTS;
+    uint64_t bytes = 50000ULL * usecs;
+    uint64_t pkts = bytes / 1500 / PDMA_DIM_NEVENTS * PDMA_DIM_NEVENTS;
+
+    queue_setup(1024);
+    window_run(pkts, bytes, usecs);
+    CHECK(bytes > 0xffffffffULL, "window bytes fit in 32 bits");
+    CHECK(rxq.dim.rates.bpms == 50000000, "bpms %u", rxq.dim.rates.bpms);
+    CHECK(rxq.dim.rates.ppms == (uint32_t)(pkts * 1000 / usecs),
+          "ppms %u expected %llu", rxq.dim.rates.ppms,
+          (unsigned long long)(pkts * 1000 / usecs));
+    CHECK(rxq.dim.profile == 1, "profile %d", rxq.dim.profile);
+
+    /* Rates beyond 32 bits per ms saturate instead of wrapping */
+    queue_setup(1024);
+    window_run(1ULL << 20, 1ULL << 50, PDMA_DIM_NEVENTS);
+    CHECK(rxq.dim.rates.bpms == (uint32_t)-1, "bpms %u not saturated",
+          rxq.dim.rates.bpms);
+}
+
+/*!
+ * Throughput model: heavier moderation moves more traffic up to
+ * profile 3, profile 4 moves the same as profile 3.
+ */
+static void
+test_walk(void)
+{
+    static const uint64_t gain[PDMA_DIM_PROFILES] = { 10, 20, 30, 40, 40 };
+    unsigned long usecs = PDMA_DIM_NEVENTS * 100;
+    uint64_t pkts;
+    int wi;
+
+    /* A small ring caps the interrupt threshold at half its size */
+    queue_setup(32);
+    for (wi = 0; wi < 40; wi++) {
+        pkts = gain[rxq.dim.profile] * 1000;
+        window_run(pkts, pkts * 256, usecs);
+    }
+    CHECK(rxq.dim.profile >= 3, "settled on profile %d", rxq.dim.profile);
+    CHECK(rxq.dim.state == PDMA_DIM_PARKING_ON_TOP ||
+          rxq.dim.state == PDMA_DIM_PARKING_TIRED,
+          "state %d after settling", rxq.dim.state);
+    CHECK(coal_count > 0 && coal_count <= 16, "count %d with 32 descriptors",
+          coal_count);
+
+    /* Disabling moderation restores the lightest profile */
+    dev.flags &= ~PDMA_INTR_DIM;
+    window_run(1000, 256000, usecs);
+    CHECK(!rxq.dim.active && rxq.dim.profile == 0,
+          "profile %d after disable", rxq.dim.profile);
+    CHECK(coal_count == 1 && coal_timer == 0,
+          "programmed %d/%d after disable", coal_count, coal_timer);
+}
+
+int
+main(int argc, char *argv[])
+{
+    test_profiles();
+    test_sparse();
+    test_high_rate();
+    test_walk();
+
+    printf("bcmcnet dim: %d errors\n", errs);
+
+    return errs ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Minimal <bcmcnet/bcmcnet_dep.h> for building BCMCNET units in user
+ * space. In the kernel build this is ngknet_dep.h.
+ */
+
+#ifndef COMPAT_BCMCNET_DEP_H
+#define COMPAT_BCMCNET_DEP_H
+
+#include <stdbool.h>
+#include <string.h>
+#include <linux/types.h>
+#include <shr/shr_error.h>
+
+#define MEMORY_BARRIER      __sync_synchronize()
+
+#define CNET_INFO(unit, fmt, args...)   do { } while (0)
+#define CNET_ERROR(unit, fmt, args...)  do { } while (0)
+
+#define CNET_DIV_U64(n, d)  ((uint64_t)(n) / (uint32_t)(d))
+
+typedef void *sal_spinlock_t;
+typedef void *sal_sem_t;
+
+#define sal_memset          memset
+
+/* Provided by the test */
+extern unsigned long
+sal_time_usecs(void);
+
+struct pdma_dev;
+
+#endif /* COMPAT_BCMCNET_DEP_H */
@@ -0,0 +1,14 @@
+/*
+ * Minimal <linux/kernel.h> for building NGKNET units in user space.
+ */
+
+#ifndef COMPAT_LINUX_KERNEL_H
+#define COMPAT_LINUX_KERNEL_H
+
+#include <limits.h>
+#include <linux/types.h>
+
+#define likely(x)       __builtin_expect(!!(x), 1)
+#define unlikely(x)     __builtin_expect(!!(x), 0)
+
+#endif /* COMPAT_LINUX_KERNEL_H */
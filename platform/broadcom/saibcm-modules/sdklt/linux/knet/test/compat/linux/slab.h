@@ -0,0 +1,17 @@
+/*
+ * Minimal <linux/slab.h> for building NGKNET units in user space.
+ */
+
+#ifndef COMPAT_LINUX_SLAB_H
+#define COMPAT_LINUX_SLAB_H
+
+#include <stdlib.h>
+
+#define GFP_KERNEL      0
+#define GFP_ATOMIC      0
+
+#define kzalloc(size, flags)    calloc(1, size)
+#define kmalloc(size, flags)    malloc(size)
+#define kfree(ptr)              free(ptr)
+
+#endif /* COMPAT_LINUX_SLAB_H */
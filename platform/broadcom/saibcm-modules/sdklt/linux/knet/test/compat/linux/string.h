@@ -0,0 +1,10 @@
+/*
+ * Minimal <linux/string.h> for building NGKNET units in user space.
+ */
+
+#ifndef COMPAT_LINUX_STRING_H
+#define COMPAT_LINUX_STRING_H
+
+#include <string.h>
+
+#endif /* COMPAT_LINUX_STRING_H */
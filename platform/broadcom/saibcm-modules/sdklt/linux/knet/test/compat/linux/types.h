@@ -0,0 +1,26 @@
+/*
+ * Minimal <linux/types.h> for building NGKNET units in user space.
+ */
+
+#ifndef COMPAT_LINUX_TYPES_H
+#define COMPAT_LINUX_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef uint64_t dma_addr_t;
+typedef uint64_t phys_addr_t;
+
+struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+};
+
+#endif /* COMPAT_LINUX_TYPES_H */
@@ -0,0 +1,374 @@
+/*! \file ngknet_filt_test.c
+ *
+ * User space test and benchmark of the NGKNET Rx filter classifier.
+ *
+ * Random filter sets shaped like the trap filters a NOS installs are
+ * compiled into a filter table, and synthetic packets with metadata are
+ * looked up both in the table and with the plain priority-ordered list
+ * walk the classifier replaced. The results must be identical.
+ *
+ *     ngknet_filt_test [-s seed] [-n pkts] [-b]
+ *
+ */
+/*
+ * $Copyright: Copyright 2018-2022 Broadcom. All rights reserved.
+ * The term 'Broadcom' refers to Broadcom Inc. and/or its subsidiaries.
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License 
+ * version 2 as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * A copy of the GNU General Public License version 2 (GPLv2) can
+ * be found in the LICENSES folder.$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <linux/slab.h>
+
+#include "ngknet_filt.h"
+
+#define OOB_SIZE        64
+#define PKT_SIZE        128
+#define NUM_CHANS       8
+
+struct test_pkt {
+    uint8_t oob[OOB_SIZE];
+    uint8_t pkt[PKT_SIZE];
+    int chan;
+};
+
+static uint32_t
+rand32(uint32_t *s)
+{
+    uint32_t x = *s;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+/*!
+ * Reference lookup: walk the filters in priority order.
+ */
+static ngknet_filter_t *
+ref_lookup(ngknet_filter_t *filts, int num, const struct test_pkt *tp,
+           ngknet_filter_t **cb_filt)
+{
+    ngknet_filter_t *filt, *filt_cb = NULL;
+    uint8_t scratch[NGKNET_FILTER_BYTES_MAX];
+    uint32_t w;
+    int idx, wsize, fi;
+
+    *cb_filt = NULL;
+
+    for (fi = 0; fi < num; fi++) {
+        filt = &filts[fi];
+        if (filt->flags & NGKNET_FILTER_F_ANY_DATA) {
+            *cb_filt = filt_cb;
+            return filt;
+        }
+        if (filt->flags & NGKNET_FILTER_F_MATCH_CHAN && filt->chan != tp->chan) {
+            continue;
+        }
+        memset(scratch, 0, sizeof(scratch));
+        memcpy(&scratch[0], &tp->oob[filt->oob_data_offset],
+               filt->oob_data_size);
+        memcpy(&scratch[filt->oob_data_size],
+               &tp->pkt[filt->pkt_data_offset], filt->pkt_data_size);
+        wsize = NGKNET_BYTES2WORDS(filt->oob_data_size + filt->pkt_data_size);
+        for (idx = 0; idx < wsize; idx++) {
+            memcpy(&w, &scratch[idx * 4], 4);
+            if ((w & filt->mask.w[idx]) != filt->data.w[idx]) {
+                break;
+            }
+        }
+        if (idx == wsize) {
+            if (filt->dest_type == NGKNET_FILTER_DEST_T_CB) {
+                filt_cb = filt;
+                continue;
+            }
+            *cb_filt = filt_cb;
+            return filt;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Filter shapes seen on a switch CPU port: ethertype (ARP, LACP, LLDP),
+ * IP protocol and L4 port (BGP, DHCP), trap reason in the metadata, and
+ * reason plus ethertype.
+ */
+static const struct {
+    uint16_t oob_off, oob_size, pkt_off, pkt_size;
+    uint8_t mask[16];
+} shapes[] = {
+    { 0, 0, 12, 2, { 0xff, 0xff } },
+    { 0, 0, 12, 12, { 0xff, 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff } },
+    { 0, 0, 23, 14, { 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff } },
+    { 4, 4, 0, 0, { 0xff, 0x0f, 0, 0 } },
+    { 8, 2, 12, 2, { 0x3f, 0xff, 0xff, 0xff } },
+    { 16, 8, 0, 0, { 0, 0, 0, 0x80, 0xff, 0xff, 0, 0 } },
+};
+
+#define NUM_SHAPES      (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+static void
+filter_gen(ngknet_filter_t *filt, int id, uint32_t *seed)
+{
+    int si = rand32(seed) % NUM_SHAPES;
+    int size, idx;
+
+    memset(filt, 0, sizeof(*filt));
+    filt->id = id;
+    filt->dest_type = NGKNET_FILTER_DEST_T_NETIF;
+    filt->oob_data_offset = shapes[si].oob_off;
+    filt->oob_data_size = shapes[si].oob_size;
+    filt->pkt_data_offset = shapes[si].pkt_off;
+    filt->pkt_data_size = shapes[si].pkt_size;
+    size = filt->oob_data_size + filt->pkt_data_size;
+    for (idx = 0; idx < size; idx++) {
+        filt->mask.b[idx] = shapes[si].mask[idx];
+        filt->data.b[idx] = rand32(seed) & filt->mask.b[idx];
+    }
+    if (rand32(seed) % 4 == 0) {
+        filt->flags |= NGKNET_FILTER_F_MATCH_CHAN;
+        filt->chan = rand32(seed) % NUM_CHANS;
+    }
+    if (rand32(seed) % 8 == 0) {
+        filt->dest_type = NGKNET_FILTER_DEST_T_CB;
+    }
+    if (rand32(seed) % 64 == 0) {
+        /* Can never match, must never be returned */
+        filt->data.b[0] |= ~filt->mask.b[0];
+    }
+}
+
+static void
+filters_gen(ngknet_filter_t *filts, int num, uint32_t *seed)
+{
+    int fi;
+
+    for (fi = 0; fi < num; fi++) {
+        filter_gen(&filts[fi], fi + 1, seed);
+    }
+    /* Sometimes end with a catch-all */
+    if (rand32(seed) % 2) {
+        filts[num - 1].flags = NGKNET_FILTER_F_ANY_DATA;
+    }
+}
+
+/*!
+ * Generate a packet, often built from one of the filters so it hits.
+ */
+static void
+pkt_gen(struct test_pkt *tp, ngknet_filter_t *filts, int num, uint32_t *seed)
+{
+    ngknet_filter_t *filt;
+    int idx;
+
+    for (idx = 0; idx < OOB_SIZE; idx++) {
+        tp->oob[idx] = rand32(seed);
+    }
+    for (idx = 0; idx < PKT_SIZE; idx++) {
+        tp->pkt[idx] = rand32(seed);
+    }
+    tp->chan = rand32(seed) % NUM_CHANS;
+
+    if (rand32(seed) % 4 == 0) {
+        return;
+    }
+    filt = &filts[rand32(seed) % num];
+    for (idx = 0; idx < filt->oob_data_size; idx++) {
+        tp->oob[filt->oob_data_offset + idx] &= ~filt->mask.b[idx];
+        tp->oob[filt->oob_data_offset + idx] |= filt->data.b[idx];
+    }
+    for (idx = 0; idx < filt->pkt_data_size; idx++) {
+        int bi = filt->oob_data_size + idx;
+        tp->pkt[filt->pkt_data_offset + idx] &= ~filt->mask.b[bi];
+        tp->pkt[filt->pkt_data_offset + idx] |= filt->data.b[bi];
+    }
+    if (filt->flags & NGKNET_FILTER_F_MATCH_CHAN) {
+        tp->chan = filt->chan;
+    }
+}
+
+static struct filt_table *
+table_build(ngknet_filter_t *filts, int num)
+{
+    struct filt_table *ft;
+    int fi;
+
+    ft = ngknet_filt_table_alloc(num);
+    if (!ft) {
+        return NULL;
+    }
+    for (fi = 0; fi < num; fi++) {
+        ngknet_filt_table_add(ft, &filts[fi], &filts[fi]);
+    }
+    ngknet_filt_table_finalize(ft);
+
+    return ft;
+}
+
+static int
+test_run(int num, int pkts, uint32_t seed)
+{
+    ngknet_filter_t *filts, *ref, *ref_cb;
+    struct filt_table *ft;
+    struct test_pkt tp;
+    void *fc, *cb_fc;
+    int pi, hits = 0, errs = 0;
+
+    filts = calloc(num, sizeof(*filts));
+    if (!filts) {
+        return -1;
+    }
+    filters_gen(filts, num, &seed);
+    ft = table_build(filts, num);
+    if (!ft) {
+        free(filts);
+        return -1;
+    }
+
+    for (pi = 0; pi < pkts; pi++) {
+        pkt_gen(&tp, filts, num, &seed);
+        ref = ref_lookup(filts, num, &tp, &ref_cb);
+        fc = ngknet_filt_lookup(ft, tp.oob, tp.pkt, tp.chan, &cb_fc);
+        if (ref) {
+            hits++;
+        }
+        if (fc != ref || (ref && cb_fc != ref_cb)) {
+            if (errs++ < 10) {
+                fprintf(stderr, "filters %d pkt %d: got %d/%d expected %d/%d\n",
+                        num, pi,
+                        fc ? ((ngknet_filter_t *)fc)->id : 0,
+                        cb_fc ? ((ngknet_filter_t *)cb_fc)->id : 0,
+                        ref ? ref->id : 0, ref_cb ? ref_cb->id : 0);
+            }
+        }
+    }
+
+    printf("filters %3d shapes %d: %d pkts, %d hits, %d mismatches\n",
+           num, ft->num_shapes, pkts, hits, errs);
+
+    kfree(ft);
+    free(filts);
+
+    return errs ? -1 : 0;
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+bench_run(int num, int pkts, uint32_t seed)
+{
+    ngknet_filter_t *filts, *cb;
+    struct filt_table *ft;
+    struct test_pkt *tps;
+    void *cb_fc;
+    uint64_t t0, ref_ns, tbl_ns;
+    uintptr_t sum = 0;
+    int pi;
+
+    filts = calloc(num, sizeof(*filts));
+    tps = calloc(pkts, sizeof(*tps));
+    if (!filts || !tps) {
+        free(filts);
+        free(tps);
+        return -1;
+    }
+    filters_gen(filts, num, &seed);
+    for (pi = 0; pi < pkts; pi++) {
+        pkt_gen(&tps[pi], filts, num, &seed);
+    }
+    ft = table_build(filts, num);
+    if (!ft) {
+        free(filts);
+        free(tps);
+        return -1;
+    }
+
+    t0 = now_ns();
+    for (pi = 0; pi < pkts; pi++) {
+        sum += (uintptr_t)ref_lookup(filts, num, &tps[pi], &cb);
+    }
+    ref_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (pi = 0; pi < pkts; pi++) {
+        sum += (uintptr_t)ngknet_filt_lookup(ft, tps[pi].oob, tps[pi].pkt,
+                                             tps[pi].chan, &cb_fc);
+    }
+    tbl_ns = now_ns() - t0;
+
+    printf("filters %3d shapes %d: list walk %6.1f ns/pkt, "
+           "table %6.1f ns/pkt (%lx)\n",
+           num, ft->num_shapes, (double)ref_ns / pkts,
+           (double)tbl_ns / pkts, (unsigned long)(sum & 0xf));
+
+    kfree(ft);
+    free(filts);
+    free(tps);
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int nums[] = { 1, 2, 8, 32, 128 };
+    uint32_t seed = 0x9e3779b9;
+    int pkts = 100000, bench = 0;
+    int opt, ni, rv = 0;
+
+    while ((opt = getopt(argc, argv, "s:n:b")) != -1) {
+        switch (opt) {
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            pkts = strtol(optarg, NULL, 0);
+            break;
+        case 'b':
+            bench = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-n pkts] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!seed || pkts <= 0) {
+        fprintf(stderr, "invalid seed or packet count\n");
+        return 1;
+    }
+
+    for (ni = 0; ni < (int)(sizeof(nums) / sizeof(nums[0])); ni++) {
+        if (bench) {
+            rv |= bench_run(nums[ni], pkts, seed + ni);
+        } else {
+            rv |= test_run(nums[ni], pkts, seed + ni);
+        }
+    }
+
+    return rv ? 1 : 0;
+}
@@ -477,13 +477,13 @@ ngknetcb_init_module(void)
                 NGKNETCB_MODULE_NAME);
     }
 
-    ngknet_rx_cb_register(ngknet_rx_cb);
-    ngknet_tx_cb_register(ngknet_tx_cb);
-
 #ifdef PSAMPLE_SUPPORT
     psample_init();
 #endif
 
+    ngknet_rx_cb_register(ngknet_rx_cb);
+    ngknet_tx_cb_register(ngknet_tx_cb);
+
     ngknet_netif_create_cb_register(ngknet_netif_create_cb);
     ngknet_netif_destroy_cb_register(ngknet_netif_destroy_cb);
     return 0;
@@ -495,13 +495,13 @@ ngknetcb_exit_module(void)
     ngknet_netif_create_cb_unregister(ngknet_netif_create_cb);
     ngknet_netif_destroy_cb_unregister(ngknet_netif_destroy_cb);
 
+    ngknet_rx_cb_unregister(ngknet_rx_cb);
+    ngknet_tx_cb_unregister(ngknet_tx_cb);
+
 #ifdef PSAMPLE_SUPPORT
     psample_cleanup();
 #endif
 
-    ngknet_rx_cb_unregister(ngknet_rx_cb);
-    ngknet_tx_cb_unregister(ngknet_tx_cb);
-
     remove_proc_entry(NGKNETCB_MODULE_NAME, NULL);
 
     unregister_chrdev(NGKNETCB_MODULE_MAJOR, NGKNETCB_MODULE_NAME);
@@ -73,7 +73,26 @@ MODULE_PARM_DESC(psample_size,
 static int psample_qlen = PSAMPLE_QLEN_DFLT;
 module_param(psample_qlen, int, 0);
 MODULE_PARM_DESC(psample_qlen,
-"psample queue length (default 1024 buffers)");
+"psample queue length per CPU (default 1024 buffers)");
+
+#define PSAMPLE_BATCH_DFLT 64
+static int psample_batch = PSAMPLE_BATCH_DFLT;
+module_param(psample_batch, int, 0);
+MODULE_PARM_DESC(psample_batch,
+"psample pkts delivered per queue per worker run (default 64)");
+
+static int psample_coalesce_usecs = 0;
+module_param(psample_coalesce_usecs, int, 0);
+MODULE_PARM_DESC(psample_coalesce_usecs,
+"psample delivery coalescing delay in usecs (default 0, disabled)");
+
+static int psample_rate_max = 0;
+module_param(psample_rate_max, int, 0);
+MODULE_PARM_DESC(psample_rate_max,
+"psample max pkts per second sent to psample module (default 0, unlimited)");
+
+/* Logical ports with a direct lookup entry */
+#define PSAMPLE_PORT_MAX 1024
 
 #if !IS_ENABLED(CONFIG_PSAMPLE)
 inline struct 
@@ -91,6 +110,9 @@ static struct proc_dir_entry *knet_cb_proc_root = NULL;
 typedef struct {
     struct list_head netif_list;
     int netif_count;
+    /* RCU protected lookup tables for the Rx path */
+    psample_netif_t __rcu *id_map[NUM_VDEV_MAX + 1];
+    psample_netif_t __rcu *port_map[PSAMPLE_PORT_MAX];
     struct net *netns;
     spinlock_t lock;
     int dcb_type;
@@ -104,7 +126,6 @@ typedef struct psample_stats_s {
     unsigned long pkts_f_handled;
     unsigned long pkts_f_pass_through;
     unsigned long pkts_f_dst_mc;
-    unsigned long pkts_c_qlen_cur;
     unsigned long pkts_c_qlen_hi;
     unsigned long pkts_d_qlen_max;
     unsigned long pkts_d_no_mem;
@@ -117,6 +138,10 @@ typedef struct psample_stats_s {
     unsigned long pkts_d_meta_srcport;
     unsigned long pkts_d_meta_dstport;
     unsigned long pkts_d_invalid_size;
+    unsigned long pkts_d_rate_max;
+    unsigned long pkts_f_buf_alloc;
+    unsigned long pkts_f_batch;
+    unsigned long pkts_c_batch_hi;
 } psample_stats_t;
 static psample_stats_t g_psample_stats = {0};
 
@@ -127,60 +152,54 @@ typedef struct psample_meta_s {
     int sample_rate;
 } psample_meta_t;
 
+/*
+ * Sampled pkts are queued on per-CPU rings of preallocated buffers. Each
+ * ring has a single producer (the Rx path of its CPU) and a single consumer
+ * (the psample worker), so no lock is needed on either side.
+ */
 typedef struct psample_pkt_s {
-    struct list_head list;
     struct psample_group *group;
     psample_meta_t meta;
     struct sk_buff *skb;
+    struct sk_buff *skb_ext;
 } psample_pkt_t;
 
+typedef struct psample_ring_s {
+    unsigned int head ____cacheline_aligned_in_smp;
+    unsigned int tail ____cacheline_aligned_in_smp;
+    psample_pkt_t *pkts;
+} psample_ring_t;
+
 typedef struct psample_work_s {
-    struct list_head pkt_list;
-    struct work_struct wq;
-    spinlock_t lock;
+    psample_ring_t __percpu *rings;
+    unsigned int ring_size;
+    unsigned int buf_size;
+    struct delayed_work wq;
+    u64 tokens;
+    u64 last_ns;
 } psample_work_t;
 static psample_work_t g_psample_work = {0};
 
+/* Caller must hold rcu_read_lock() */
 static psample_netif_t*
-psample_netif_lookup_by_ifindex(int ifindex)
+psample_netif_lookup_by_id(int id)
 {
-    struct list_head *list;
-    psample_netif_t *psample_netif = NULL;
-    unsigned long flags;
-
-    /* look for port from list of available net_devices */
-    spin_lock_irqsave(&g_psample_info.lock, flags);
-    list_for_each(list, &g_psample_info.netif_list) {
-        psample_netif = (psample_netif_t*)list;
-        if (psample_netif->dev->ifindex == ifindex) {
-            spin_unlock_irqrestore(&g_psample_info.lock, flags);
-            return psample_netif;
-        }
+    if (id < 0 || id > NUM_VDEV_MAX) {
+        return (NULL);
     }
-    spin_unlock_irqrestore(&g_psample_info.lock, flags);
-    return (NULL);
+    return rcu_dereference(g_psample_info.id_map[id]);
 }
-        
+
+/* Caller must hold rcu_read_lock() */
 static psample_netif_t*
 psample_netif_lookup_by_port(int port)  __attribute__ ((unused));
 static psample_netif_t*
 psample_netif_lookup_by_port(int port)
 {
-    struct list_head *list;
-    psample_netif_t *psample_netif = NULL;
-    unsigned long flags;
-
-    /* look for port from list of available net_devices */
-    spin_lock_irqsave(&g_psample_info.lock, flags);
-    list_for_each(list, &g_psample_info.netif_list) {
-        psample_netif = (psample_netif_t*)list;
-        if (psample_netif->port == port) {
-            spin_unlock_irqrestore(&g_psample_info.lock, flags);
-            return psample_netif;
-        }
+    if (port < 0 || port >= PSAMPLE_PORT_MAX) {
+        return (NULL);
     }
-    spin_unlock_irqrestore(&g_psample_info.lock, flags);
-    return (NULL);
+    return rcu_dereference(g_psample_info.port_map[port]);
 }
 
 static int
@@ -195,15 +214,17 @@ psample_meta_get(struct sk_buff *skb, psample_meta_t *sflow_meta)
     memset(sflow_meta, 0, sizeof(psample_meta_t));    
 
     /* find src port */
-    if ((psample_netif = psample_netif_lookup_by_ifindex(netif->id))) {
+    rcu_read_lock();
+    if ((psample_netif = psample_netif_lookup_by_id(netif->id))) {
         src_ifindex = psample_netif->dev->ifindex;
-        sample_rate = psample_netif->sample_rate;
-        sample_size = psample_netif->sample_size;
+        sample_rate = READ_ONCE(psample_netif->sample_rate);
+        sample_size = READ_ONCE(psample_netif->sample_size);
     } else {
         g_psample_stats.pkts_d_meta_srcport++;
         PSAMPLE_CB_DBG_PRINT("%s: could not find psample netif for src dev %s (ifidx %d)\n", 
                              __func__, netif->name, netif->id);
     }
+    rcu_read_unlock();
 
     sflow_meta->src_ifindex = src_ifindex;
     sflow_meta->trunc_size  = sample_size;
@@ -211,58 +232,220 @@ psample_meta_get(struct sk_buff *skb, psample_meta_t *sflow_meta)
     return (0);
 }
 
+static unsigned int
+psample_qlen_get(void)
+{
+    psample_ring_t *ring;
+    unsigned int qlen = 0;
+    int cpu;
+
+    if (!g_psample_work.rings) {
+        return 0;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        qlen += READ_ONCE(ring->head) - READ_ONCE(ring->tail);
+    }
+    return qlen;
+}
+
+/*
+ * Token bucket limiting the pkts sent to the psample module. Only the
+ * worker touches it. Tokens are kept in units of 1/NSEC_PER_SEC pkt and
+ * at most one batch may go out back-to-back.
+ */
+static int
+psample_rate_conform(psample_work_t *psample_work, int rate)
+{
+    u64 now = ktime_get_ns();
+    u64 elapsed = now - psample_work->last_ns;
+    u64 burst = (u64)psample_batch * NSEC_PER_SEC;
+
+    if (elapsed > NSEC_PER_SEC) {
+        elapsed = NSEC_PER_SEC;
+    }
+    psample_work->last_ns = now;
+    psample_work->tokens += elapsed * rate;
+    if (psample_work->tokens > burst) {
+        psample_work->tokens = burst;
+    }
+    if (psample_work->tokens < NSEC_PER_SEC) {
+        return 0;
+    }
+    psample_work->tokens -= NSEC_PER_SEC;
+    return 1;
+}
+
 static void
-psample_task(struct work_struct *work)
+psample_pkt_send(psample_work_t *psample_work, psample_pkt_t *pkt)
 {
-    psample_work_t *psample_work = container_of(work, psample_work_t, wq);
-    unsigned long flags;
-    struct list_head *list_ptr, *list_next;
-    psample_pkt_t *pkt;
+    struct sk_buff *skb = pkt->skb_ext ? pkt->skb_ext : pkt->skb;
+    int rate_max = READ_ONCE(psample_rate_max);
 
-    spin_lock_irqsave(&psample_work->lock, flags);
-    list_for_each_safe(list_ptr, list_next, &psample_work->pkt_list) {
-        /* dequeue pkt from list */
-        pkt = list_entry(list_ptr, psample_pkt_t, list);
-        list_del(list_ptr);
-        g_psample_stats.pkts_c_qlen_cur--;
-        spin_unlock_irqrestore(&psample_work->lock, flags);
- 
-        /* send to psample */
-        if (pkt) {
+    if (rate_max > 0 && !psample_rate_conform(psample_work, rate_max)) {
+        g_psample_stats.pkts_d_rate_max++;
+    } else {
 #if ((IS_ENABLED(CONFIG_PSAMPLE) && LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0)) || \
      (defined PSAMPLE_MD_EXTENDED_ATTR && PSAMPLE_MD_EXTENDED_ATTR))
-            struct psample_metadata md = {0};
-            md.trunc_size = pkt->meta.trunc_size;
-            md.in_ifindex = pkt->meta.src_ifindex;
-            md.out_ifindex = pkt->meta.dst_ifindex;
+        struct psample_metadata md = {0};
+        md.trunc_size = pkt->meta.trunc_size;
+        md.in_ifindex = pkt->meta.src_ifindex;
+        md.out_ifindex = pkt->meta.dst_ifindex;
 #endif
-            PSAMPLE_CB_DBG_PRINT("%s: group 0x%x, trunc_size %d, src_ifdx 0x%x, dst_ifdx 0x%x, sample_rate %d\n",
-                    __func__, pkt->group->group_num, 
-                    pkt->meta.trunc_size, pkt->meta.src_ifindex, 
-                    pkt->meta.dst_ifindex, pkt->meta.sample_rate);
+        PSAMPLE_CB_DBG_PRINT("%s: group 0x%x, trunc_size %d, src_ifdx 0x%x, dst_ifdx 0x%x, sample_rate %d\n",
+                __func__, pkt->group->group_num, 
+                pkt->meta.trunc_size, pkt->meta.src_ifindex, 
+                pkt->meta.dst_ifindex, pkt->meta.sample_rate);
 
 #if ((IS_ENABLED(CONFIG_PSAMPLE) && LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0)) || \
      (defined PSAMPLE_MD_EXTENDED_ATTR && PSAMPLE_MD_EXTENDED_ATTR))
-            psample_sample_packet(pkt->group, 
-                                  pkt->skb,
-                                  pkt->meta.sample_rate,
-                                  &md);
+        psample_sample_packet(pkt->group, 
+                              skb,
+                              pkt->meta.sample_rate,
+                              &md);
 #else
-            psample_sample_packet(pkt->group, 
-                                  pkt->skb, 
-                                  pkt->meta.trunc_size,
-                                  pkt->meta.src_ifindex,
-                                  pkt->meta.dst_ifindex,
-                                  pkt->meta.sample_rate);
+        psample_sample_packet(pkt->group, 
+                              skb, 
+                              pkt->meta.trunc_size,
+                              pkt->meta.src_ifindex,
+                              pkt->meta.dst_ifindex,
+                              pkt->meta.sample_rate);
 #endif
-            g_psample_stats.pkts_f_psample_mod++;
- 
-            dev_kfree_skb_any(pkt->skb);
-            kfree(pkt);
+        g_psample_stats.pkts_f_psample_mod++;
+    }
+
+    /* psample copies the data, so the buffer can be recycled */
+    if (pkt->skb_ext) {
+        dev_kfree_skb_any(pkt->skb_ext);
+        pkt->skb_ext = NULL;
+    } else {
+        skb_trim(pkt->skb, 0);
+    }
+}
+
+static void
+psample_task(struct work_struct *work)
+{
+    psample_work_t *psample_work =
+        container_of(to_delayed_work(work), psample_work_t, wq);
+    psample_ring_t *ring;
+    unsigned int mask = psample_work->ring_size - 1;
+    unsigned int head, tail, done = 0, batch;
+    int cpu, budget = psample_batch > 0 ? psample_batch : PSAMPLE_BATCH_DFLT;
+
+    /* drain up to one batch from each ring */
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(psample_work->rings, cpu);
+        tail = ring->tail;
+        head = smp_load_acquire(&ring->head);
+        for (batch = 0; tail != head && batch < budget; batch++, tail++) {
+            psample_pkt_send(psample_work, &ring->pkts[tail & mask]);
+        }
+        if (batch) {
+            smp_store_release(&ring->tail, tail);
+            done += batch;
         }
-        spin_lock_irqsave(&psample_work->lock, flags);
     }
-    spin_unlock_irqrestore(&psample_work->lock, flags);
+
+    g_psample_stats.pkts_f_batch++;
+    if (done > g_psample_stats.pkts_c_batch_hi) {
+        g_psample_stats.pkts_c_batch_hi = done;
+    }
+
+    /*
+     * Pairs with the barrier in psample_rx_cb(). Either we see a pkt queued
+     * after our snapshot, or the producer sees the ring drained and kicks.
+     */
+    smp_mb();
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(psample_work->rings, cpu);
+        if (READ_ONCE(ring->head) != ring->tail) {
+            schedule_delayed_work(&psample_work->wq, 0);
+            break;
+        }
+    }
+}
+
+static void
+psample_work_kick(unsigned int qlen)
+{
+    int usecs = READ_ONCE(psample_coalesce_usecs);
+
+    if (usecs <= 0) {
+        schedule_delayed_work(&g_psample_work.wq, 0);
+    } else if (qlen >= g_psample_work.ring_size / 2) {
+        /* flush early rather than let the ring overflow */
+        mod_delayed_work(system_wq, &g_psample_work.wq, 0);
+    } else {
+        schedule_delayed_work(&g_psample_work.wq, usecs_to_jiffies(usecs));
+    }
+}
+
+static void
+psample_rings_free(void)
+{
+    psample_ring_t *ring;
+    psample_pkt_t *pkt;
+    unsigned int i;
+    int cpu;
+
+    if (!g_psample_work.rings) {
+        return;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        if (!ring->pkts) {
+            continue;
+        }
+        for (i = 0; i < g_psample_work.ring_size; i++) {
+            pkt = &ring->pkts[i];
+            if (pkt->skb) {
+                dev_kfree_skb_any(pkt->skb);
+            }
+            if (pkt->skb_ext) {
+                dev_kfree_skb_any(pkt->skb_ext);
+            }
+        }
+        kfree(ring->pkts);
+    }
+    free_percpu(g_psample_work.rings);
+    g_psample_work.rings = NULL;
+}
+
+static int
+psample_rings_alloc(void)
+{
+    psample_ring_t *ring;
+    unsigned int i;
+    int cpu;
+
+    g_psample_work.ring_size =
+        roundup_pow_of_two(psample_qlen > 0 ? psample_qlen : PSAMPLE_QLEN_DFLT);
+    g_psample_work.buf_size = psample_size > 0 ? psample_size : PSAMPLE_SIZE_DFLT;
+
+    g_psample_work.rings = alloc_percpu(psample_ring_t);
+    if (!g_psample_work.rings) {
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        ring->pkts = kcalloc_node(g_psample_work.ring_size, sizeof(psample_pkt_t),
+                                  GFP_KERNEL, cpu_to_node(cpu));
+        if (!ring->pkts) {
+            goto error;
+        }
+        for (i = 0; i < g_psample_work.ring_size; i++) {
+            ring->pkts[i].skb = __dev_alloc_skb(g_psample_work.buf_size, GFP_KERNEL);
+            if (!ring->pkts[i].skb) {
+                goto error;
+            }
+        }
+    }
+    return 0;
+
+error:
+    psample_rings_free();
+    return -ENOMEM;
 }
 
 struct sk_buff*
@@ -364,46 +547,66 @@ psample_rx_cb(struct net_device *dev, struct sk_buff *skb)
 
     /* drop if configured sample rate is 0 */
     if (meta.sample_rate > 0) {
-        unsigned long flags;
+        psample_ring_t *ring;
         psample_pkt_t *psample_pkt;
         struct sk_buff *skb_psample;
+        unsigned int head, qlen;
+        int kick;
 
-        if (g_psample_stats.pkts_c_qlen_cur >= psample_qlen) {
-            printk("%s: tail drop due to max qlen %d reached\n", __func__, psample_qlen);
-            g_psample_stats.pkts_d_qlen_max++;
+        if (!g_psample_work.rings) {
+            g_psample_stats.pkts_d_not_ready++;
             goto PSAMPLE_FILTER_CB_PKT_HANDLED;
         }
 
-        if ((psample_pkt = kmalloc(sizeof(psample_pkt_t), GFP_ATOMIC)) == NULL) {
-            printk("%s: failed to alloc psample mem for pkt\n", __func__);
-            g_psample_stats.pkts_d_no_mem++;
+        /* keep a single producer per ring */
+        local_bh_disable();
+        ring = this_cpu_ptr(g_psample_work.rings);
+        head = ring->head;
+        qlen = head - smp_load_acquire(&ring->tail);
+        if (qlen >= g_psample_work.ring_size) {
+            local_bh_enable();
+            PSAMPLE_CB_DBG_PRINT("%s: tail drop due to max qlen %d reached\n", __func__, psample_qlen);
+            g_psample_stats.pkts_d_qlen_max++;
             goto PSAMPLE_FILTER_CB_PKT_HANDLED;
         }
-        memcpy(&psample_pkt->meta, &meta, sizeof(psample_meta_t));
-        psample_pkt->group = group;
 
-        if ((skb_psample = dev_alloc_skb(meta.trunc_size)) == NULL) {
-            printk("%s: failed to alloc psample mem for pkt skb\n", __func__);
-            g_psample_stats.pkts_d_no_mem++;
-            goto PSAMPLE_FILTER_CB_PKT_HANDLED;
+        psample_pkt = &ring->pkts[head & (g_psample_work.ring_size - 1)];
+        skb_psample = psample_pkt->skb;
+        if (meta.trunc_size > g_psample_work.buf_size) {
+            /* larger than the preallocated buffers */
+            if ((skb_psample = dev_alloc_skb(meta.trunc_size)) == NULL) {
+                local_bh_enable();
+                printk("%s: failed to alloc psample mem for pkt skb\n", __func__);
+                g_psample_stats.pkts_d_no_mem++;
+                goto PSAMPLE_FILTER_CB_PKT_HANDLED;
+            }
+            psample_pkt->skb_ext = skb_psample;
+            g_psample_stats.pkts_f_buf_alloc++;
         }
+        memcpy(&psample_pkt->meta, &meta, sizeof(psample_meta_t));
+        psample_pkt->group = group;
 
         /* setup skb to point to pkt */
         memcpy(skb_psample->data, skb->data, meta.trunc_size);
         skb_put(skb_psample, meta.trunc_size);
-        skb_psample->len = meta.trunc_size;
-        psample_pkt->skb = skb_psample;
 
-        spin_lock_irqsave(&g_psample_work.lock, flags);
-        list_add_tail(&psample_pkt->list, &g_psample_work.pkt_list); 
+        smp_store_release(&ring->head, head + 1);
 
-        g_psample_stats.pkts_c_qlen_cur++;
-        if (g_psample_stats.pkts_c_qlen_cur > g_psample_stats.pkts_c_qlen_hi) {
-            g_psample_stats.pkts_c_qlen_hi = g_psample_stats.pkts_c_qlen_cur;
-        }
+        /*
+         * Pairs with the barrier in psample_task(). Kick the worker if it
+         * has already drained everything queued before this pkt.
+         */
+        smp_mb();
+        kick = READ_ONCE(ring->tail) == head ||
+               qlen + 1 == g_psample_work.ring_size / 2;
+        local_bh_enable();
 
-        schedule_work(&g_psample_work.wq);
-        spin_unlock_irqrestore(&g_psample_work.lock, flags);
+        if (qlen + 1 > g_psample_stats.pkts_c_qlen_hi) {
+            g_psample_stats.pkts_c_qlen_hi = qlen + 1;
+        }
+        if (kick) {
+            psample_work_kick(qlen + 1);
+        }
     } else {
         g_psample_stats.pkts_d_sampling_disabled++;
     }
@@ -428,7 +631,7 @@ psample_netif_create_cb(struct net_device *dev)
     }
     netif = netdev_priv(dev);
 
-    if ((psample_netif = kmalloc(sizeof(psample_netif_t), GFP_ATOMIC)) == NULL) {
+    if ((psample_netif = kzalloc(sizeof(psample_netif_t), GFP_ATOMIC)) == NULL) {
         printk("%s: failed to alloc psample mem for netif '%s'\n", 
                 __func__, dev->name);
         return (-1);
@@ -466,6 +669,15 @@ psample_netif_create_cb(struct net_device *dev)
         /* No holes - add to end of list */
         list_add_tail(&psample_netif->list, &g_psample_info.netif_list);
     }
+
+    /* publish to the Rx path */
+    if (psample_netif->id <= NUM_VDEV_MAX) {
+        rcu_assign_pointer(g_psample_info.id_map[psample_netif->id], psample_netif);
+    }
+    if (netif->netif.type == NGKNET_NETIF_T_PORT &&
+        psample_netif->port < PSAMPLE_PORT_MAX) {
+        rcu_assign_pointer(g_psample_info.port_map[psample_netif->port], psample_netif);
+    }
    
     spin_unlock_irqrestore(&g_psample_info.lock, flags);
 
@@ -476,7 +688,7 @@ psample_netif_create_cb(struct net_device *dev)
 int
 psample_netif_destroy_cb(struct net_device *dev)
 {
-    int found;
+    int found = 0;
     struct list_head *list;
     psample_netif_t *psample_netif;
     unsigned long flags; 
@@ -495,8 +707,16 @@ psample_netif_destroy_cb(struct net_device *dev)
         if (netif->netif.id == psample_netif->id) {
             found = 1; 
             list_del(&psample_netif->list);
+            if (psample_netif->id <= NUM_VDEV_MAX &&
+                rcu_access_pointer(g_psample_info.id_map[psample_netif->id]) == psample_netif) {
+                RCU_INIT_POINTER(g_psample_info.id_map[psample_netif->id], NULL);
+            }
+            if (psample_netif->port < PSAMPLE_PORT_MAX &&
+                rcu_access_pointer(g_psample_info.port_map[psample_netif->port]) == psample_netif) {
+                RCU_INIT_POINTER(g_psample_info.port_map[psample_netif->port], NULL);
+            }
             PSAMPLE_CB_DBG_PRINT("%s: removing psample netif '%s'\n", __func__, dev->name);
-            kfree(psample_netif);
+            kfree_rcu(psample_netif, rcu);
             g_psample_info.netif_count--; 
             break;
         }
@@ -761,7 +981,11 @@ psample_proc_debug_show(struct seq_file *m, void *v)
     seq_printf(m, "  debug:           0x%x\n", debug);
     seq_printf(m, "  dcb_type:        %d\n",   g_psample_info.dcb_type);
     seq_printf(m, "  netif_count:     %d\n",   g_psample_info.netif_count);
-    seq_printf(m, "  queue length:    %d\n",   psample_qlen);
+    seq_printf(m, "  queue length:    %d\n",   g_psample_work.ring_size);
+    seq_printf(m, "  buffer size:     %d\n",   g_psample_work.buf_size);
+    seq_printf(m, "  batch:           %d\n",   psample_batch);
+    seq_printf(m, "  coalesce_usecs:  %d\n",   psample_coalesce_usecs);
+    seq_printf(m, "  rate_max:        %d\n",   psample_rate_max);
 
     return 0;
 }
@@ -778,10 +1002,16 @@ psample_proc_debug_open(struct inode * inode, struct file * file)
  *   Syntax:
  *   debug=<mask>
  *
- *   Where <mask> corresponds to the debug module parameter.
+ *   coalesce_usecs=<usecs>
+ *   rate_max=<pkts per second>
+ *
+ *   Where <mask> corresponds to the debug module parameter. The other
+ *   settings correspond to the psample_coalesce_usecs and psample_rate_max
+ *   module parameters.
  *
  *   Examples:
  *   debug=0x1
+ *   coalesce_usecs=1000
  */
 static ssize_t
 psample_proc_debug_write(struct file *file, const char *buf,
@@ -790,17 +1020,23 @@ psample_proc_debug_write(struct file *file, const char *buf,
     char debug_str[40];
     char *ptr;
 
-    if (count > sizeof(debug_str)) {
+    if (count >= sizeof(debug_str)) {
         count = sizeof(debug_str) - 1;
-        debug_str[count] = '\0';
     }
     if (copy_from_user(debug_str, buf, count)) {
         return -EFAULT;
     }
+    debug_str[count] = '\0';
 
     if ((ptr = strstr(debug_str, "debug=")) != NULL) {
         ptr += 6;
         debug = simple_strtol(ptr, NULL, 0);
+    } else if ((ptr = strstr(debug_str, "coalesce_usecs=")) != NULL) {
+        ptr += 15;
+        WRITE_ONCE(psample_coalesce_usecs, simple_strtol(ptr, NULL, 0));
+    } else if ((ptr = strstr(debug_str, "rate_max=")) != NULL) {
+        ptr += 9;
+        WRITE_ONCE(psample_rate_max, simple_strtol(ptr, NULL, 0));
     } else {
         printk("Warning: unknown configuration setting\n");
     }
@@ -827,7 +1063,7 @@ psample_proc_stats_show(struct seq_file *m, void *v)
     seq_printf(m, "  pkts handled by psample        %10lu\n", g_psample_stats.pkts_f_handled);
     seq_printf(m, "  pkts pass through              %10lu\n", g_psample_stats.pkts_f_pass_through);
     seq_printf(m, "  pkts with mc destination       %10lu\n", g_psample_stats.pkts_f_dst_mc);
-    seq_printf(m, "  pkts current queue length      %10lu\n", g_psample_stats.pkts_c_qlen_cur);
+    seq_printf(m, "  pkts current queue length      %10u\n",  psample_qlen_get());
     seq_printf(m, "  pkts high queue length         %10lu\n", g_psample_stats.pkts_c_qlen_hi);
     seq_printf(m, "  pkts drop max queue length     %10lu\n", g_psample_stats.pkts_d_qlen_max);
     seq_printf(m, "  pkts drop no memory            %10lu\n", g_psample_stats.pkts_d_no_mem);
@@ -840,6 +1076,10 @@ psample_proc_stats_show(struct seq_file *m, void *v)
     seq_printf(m, "  pkts with invalid src port     %10lu\n", g_psample_stats.pkts_d_meta_srcport);
     seq_printf(m, "  pkts with invalid dst port     %10lu\n", g_psample_stats.pkts_d_meta_dstport);
     seq_printf(m, "  pkts with invalid orig pkt sz  %10lu\n", g_psample_stats.pkts_d_invalid_size);
+    seq_printf(m, "  pkts drop max rate             %10lu\n", g_psample_stats.pkts_d_rate_max);
+    seq_printf(m, "  pkts with oversize buffer      %10lu\n", g_psample_stats.pkts_f_buf_alloc);
+    seq_printf(m, "  worker batches                 %10lu\n", g_psample_stats.pkts_f_batch);
+    seq_printf(m, "  worker high batch size         %10lu\n", g_psample_stats.pkts_c_batch_hi);
     return 0;
 }
 
@@ -859,14 +1099,7 @@ static ssize_t
 psample_proc_stats_write(struct file *file, const char *buf,
                     size_t count, loff_t *loff)
 {
-    int qlen_cur = 0;
-    unsigned long flags;
-
-    spin_lock_irqsave(&g_psample_work.lock, flags);
-    qlen_cur = g_psample_stats.pkts_c_qlen_cur;
     memset(&g_psample_stats, 0, sizeof(psample_stats_t));
-    g_psample_stats.pkts_c_qlen_cur = qlen_cur;
-    spin_unlock_irqrestore(&g_psample_work.lock, flags);
 
     return count;
 }
@@ -881,7 +1114,11 @@ struct proc_ops psample_proc_stats_file_ops = {
 
 int psample_cleanup(void)
 {
-    cancel_work_sync(&g_psample_work.wq);
+    /* wait for in-flight Rx callbacks and deferred netif frees */
+    synchronize_net();
+    rcu_barrier();
+    cancel_delayed_work_sync(&g_psample_work.wq);
+    psample_rings_free();
     remove_proc_entry("stats", psample_proc_root);
     remove_proc_entry("rate",  psample_proc_root);
     remove_proc_entry("size",  psample_proc_root);
@@ -956,9 +1193,11 @@ int psample_init(void)
     spin_lock_init(&g_psample_info.lock);
 
     /* setup psample work queue */
-    spin_lock_init(&g_psample_work.lock); 
-    INIT_LIST_HEAD(&g_psample_work.pkt_list); 
-    INIT_WORK(&g_psample_work.wq, psample_task);
+    INIT_DELAYED_WORK(&g_psample_work.wq, psample_task);
+    if (psample_rings_alloc() < 0) {
+        printk("%s: failed to alloc psample queues\n", __func__);
+        return (-1);
+    }
 
     /* get net namespace */ 
     g_psample_info.netns = get_net_ns_by_pid(current->pid);
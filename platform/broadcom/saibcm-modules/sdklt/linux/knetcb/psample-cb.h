@@ -46,6 +46,7 @@ typedef struct {
     uint16_t qnum;
     uint32_t sample_rate;
     uint32_t sample_size;
+    struct rcu_head rcu;
 } psample_netif_t;
 
 extern int
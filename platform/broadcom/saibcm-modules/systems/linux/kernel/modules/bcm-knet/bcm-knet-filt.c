@@ -0,0 +1,328 @@
+/*
+ * Copyright 2007-2020 Broadcom Inc. All rights reserved.
+ * 
+ * Permission is granted to use, copy, modify and/or distribute this
+ * software under either one of the licenses below.
+ * 
+ * License Option 1: GPL
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as
+ * published by the Free Software Foundation (the "GPL").
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 (GPLv2) for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 (GPLv2) along with this source code.
+ * 
+ * 
+ * License Option 2: Broadcom Open Network Switch APIs (OpenNSA) license
+ * 
+ * This software is governed by the Broadcom Open Network Switch APIs license:
+ * https://www.broadcom.com/products/ethernet-connectivity/software/opennsa
+ */
+/*
+ * $Id: bcm-knet-filt.c Broadcom SDK $
+ * $Copyright: (c) 2005 Broadcom Corp.
+ * All Rights Reserved.$
+ *
+ * File:    bcm-knet-filt.c
+ * Purpose: Compiled Rx filter table used by the BCM KNET driver
+ *
+ * The table is built from the priority-ordered filter list with
+ * bkn_filter_table_alloc, bkn_filter_table_add for each filter and
+ * bkn_filter_table_finalize. A finalized table is read-only, so the
+ * owner may publish it through RCU and match packets against it
+ * without locking.
+ */
+
+#include <gmodule.h> /* Must be included first */
+#include <bcm-knet-filt.h>
+
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+
+static int
+bkn_filter_shape_match(bkn_filter_shape_t *fs, kcom_filter_t *kf, int wsize)
+{
+    return fs->oob_data_offset == kf->oob_data_offset &&
+           fs->oob_data_size == kf->oob_data_size &&
+           fs->pkt_data_offset == kf->pkt_data_offset &&
+           fs->pkt_data_size == kf->pkt_data_size &&
+           memcmp(fs->mask, kf->mask.w, wsize * sizeof(uint32)) == 0;
+}
+
+/*
+ * Allocate an empty filter table with room for max_filters filters.
+ */
+bkn_filter_table_t *
+bkn_filter_table_alloc(int max_filters)
+{
+    bkn_filter_table_t *ft;
+
+    /* A shape never needs more than four buckets per entry */
+    ft = kzalloc(sizeof(*ft) +
+                 max_filters * sizeof(bkn_filter_shape_t) +
+                 max_filters * sizeof(bkn_filter_entry_t) +
+                 max_filters * 4 * sizeof(int), GFP_ATOMIC);
+    if (ft == NULL) {
+        return NULL;
+    }
+    ft->max_filters = max_filters;
+    ft->shapes = (bkn_filter_shape_t *)(ft + 1);
+    ft->entries = (bkn_filter_entry_t *)(ft->shapes + max_filters);
+    ft->bkts = (int *)(ft->entries + max_filters);
+
+    return ft;
+}
+
+/*
+ * Add the next filter in priority order.
+ * The filter data must stay unchanged while the table is in use.
+ */
+void
+bkn_filter_table_add(bkn_filter_table_t *ft, kcom_filter_t *kf, void *priv)
+{
+    bkn_filter_shape_t *fs = NULL;
+    bkn_filter_entry_t *fe;
+    int rank, wsize, si, idx;
+
+    if (ft->num_ranks >= ft->max_filters) {
+        return;
+    }
+    rank = ft->num_ranks++;
+
+    wsize = BYTES2WORDS(kf->oob_data_size + kf->pkt_data_size);
+    /* Skip filters which can never match */
+    for (idx = 0; idx < wsize; idx++) {
+        if (kf->data.w[idx] & ~kf->mask.w[idx]) {
+            return;
+        }
+    }
+    /* Shapes are created in rank order, i.e. sorted by lowest rank */
+    for (si = 0; si < ft->num_shapes; si++) {
+        fs = &ft->shapes[si];
+        if (bkn_filter_shape_match(fs, kf, wsize)) {
+            break;
+        }
+    }
+    if (si == ft->num_shapes) {
+        fs = &ft->shapes[ft->num_shapes++];
+        fs->oob_data_offset = kf->oob_data_offset;
+        fs->oob_data_size = kf->oob_data_size;
+        fs->pkt_data_offset = kf->pkt_data_offset;
+        fs->pkt_data_size = kf->pkt_data_size;
+        fs->wsize = wsize;
+        fs->mask = kf->mask.w;
+        fs->min_rank = rank;
+    }
+    fe = &ft->entries[ft->num_entries++];
+    fe->kf = kf;
+    fe->priv = priv;
+    fe->rank = rank;
+    fe->cb = (kf->dest_type == KCOM_DEST_T_CB);
+    fe->hash = jhash2(kf->data.w, wsize, 0);
+    fe->shape = si;
+    fe->next = -1;
+    fs->num_entries++;
+    if (fe->cb) {
+        fs->num_cb++;
+        ft->num_cb++;
+    }
+}
+
+/*
+ * Build the hash buckets once all filters have been added.
+ */
+void
+bkn_filter_table_finalize(bkn_filter_table_t *ft)
+{
+    bkn_filter_shape_t *fs;
+    bkn_filter_entry_t *fe;
+    int num_bkts = 0;
+    int si, ei, bi;
+
+    for (si = 0; si < ft->num_shapes; si++) {
+        fs = &ft->shapes[si];
+        fs->bkt_mask = roundup_pow_of_two(fs->num_entries * 2) - 1;
+        fs->bkts = &ft->bkts[num_bkts];
+        num_bkts += fs->bkt_mask + 1;
+        for (bi = 0; bi <= fs->bkt_mask; bi++) {
+            fs->bkts[bi] = -1;
+        }
+    }
+    for (ei = ft->num_entries - 1; ei >= 0; ei--) {
+        fe = &ft->entries[ei];
+        fs = &ft->shapes[fe->shape];
+        bi = fe->hash & fs->bkt_mask;
+        /* Insert backwards to keep the chains in priority order */
+        fe->next = fs->bkts[bi];
+        fs->bkts[bi] = ei;
+    }
+}
+
+/*
+ * Extract the masked key of a shape from the packet.
+ */
+static void
+bkn_filter_key_get(bkn_filter_shape_t *fs, uint8 *pkt, uint8 *oob,
+                   uint32 *key, bkn_filter_lookup_t *lu)
+{
+    int idx;
+
+    if (fs->wsize == 0) {
+        return;
+    }
+    key[fs->wsize - 1] = 0;
+    memcpy(key, &oob[fs->oob_data_offset], fs->oob_data_size);
+    memcpy((uint8 *)key + fs->oob_data_size,
+           &pkt[fs->pkt_data_offset], fs->pkt_data_size);
+    for (idx = 0; idx < fs->wsize; idx++) {
+        key[idx] &= fs->mask[idx];
+    }
+    if (lu->key_dump) {
+        lu->key_dump(lu->ctx, fs, key);
+    }
+}
+
+/*
+ * Find the matched entry with the lowest rank within (min_rank, max_rank).
+ * Only callback filters are considered if cb is set, only other filters
+ * otherwise.
+ */
+static bkn_filter_entry_t *
+bkn_filter_table_lookup(bkn_filter_table_t *ft, uint8 *pkt, int pktlen,
+                        uint8 *oob, int cb, int min_rank, int max_rank,
+                        bkn_filter_lookup_t *lu)
+{
+    bkn_filter_shape_t *fs;
+    bkn_filter_entry_t *fe, *match = NULL;
+    uint32 key[KCOM_FILTER_WORDS_MAX];
+    uint32 hash;
+    int si, ei;
+
+    for (si = 0; si < ft->num_shapes; si++) {
+        fs = &ft->shapes[si];
+        if (fs->min_rank >= max_rank) {
+            break;
+        }
+        if (cb ? fs->num_cb == 0 : fs->num_cb == fs->num_entries) {
+            continue;
+        }
+        if (fs->pkt_data_offset + fs->pkt_data_size > pktlen) {
+            continue;
+        }
+        bkn_filter_key_get(fs, pkt, oob, key, lu);
+        hash = jhash2(key, fs->wsize, 0);
+        for (ei = fs->bkts[hash & fs->bkt_mask]; ei >= 0; ei = fe->next) {
+            fe = &ft->entries[ei];
+            if (fe->rank >= max_rank) {
+                break;
+            }
+            if (fe->rank <= min_rank || fe->cb != cb || fe->hash != hash) {
+                continue;
+            }
+            if (lu->chan_match && !lu->chan_match(lu->ctx, fe->kf)) {
+                continue;
+            }
+            if (memcmp(key, fe->kf->data.w,
+                       fs->wsize * sizeof(uint32)) != 0) {
+                continue;
+            }
+            match = fe;
+            max_rank = fe->rank;
+            break;
+        }
+    }
+
+    return match;
+}
+
+/*
+ * Walk the entries in priority order. Hashing does not pay off for
+ * short filter lists.
+ */
+static bkn_filter_entry_t *
+bkn_filter_table_walk(bkn_filter_table_t *ft, uint8 *pkt, int pktlen,
+                      uint8 *oob, bkn_filter_lookup_t *lu)
+{
+    bkn_filter_shape_t *fs, *ks = NULL;
+    bkn_filter_entry_t *fe;
+    uint32 key[KCOM_FILTER_WORDS_MAX];
+    int ei, idx;
+
+    for (ei = 0; ei < ft->num_entries; ei++) {
+        fe = &ft->entries[ei];
+        fs = &ft->shapes[fe->shape];
+        if (fe->cb && lu->filter_cb == NULL) {
+            continue;
+        }
+        if (fs->pkt_data_offset + fs->pkt_data_size > pktlen) {
+            continue;
+        }
+        /* Reuse the key while consecutive entries share a shape */
+        if (fs != ks) {
+            bkn_filter_key_get(fs, pkt, oob, key, lu);
+            ks = fs;
+        }
+        for (idx = 0; idx < fs->wsize; idx++) {
+            if (key[idx] != fe->kf->data.w[idx]) {
+                break;
+            }
+        }
+        if (idx < fs->wsize) {
+            continue;
+        }
+        if (lu->chan_match && !lu->chan_match(lu->ctx, fe->kf)) {
+            continue;
+        }
+        if (fe->cb && !lu->filter_cb(lu->ctx, fe->kf)) {
+            continue;
+        }
+        return fe;
+    }
+
+    return NULL;
+}
+
+/*
+ * Match a packet as the priority-ordered filter list walk would: the
+ * first matching filter wins, except that a matching callback filter
+ * only wins if filter_cb accepts the packet.
+ */
+bkn_filter_entry_t *
+bkn_filter_table_match(bkn_filter_table_t *ft, uint8 *pkt, int pktlen,
+                       uint8 *oob, bkn_filter_lookup_t *lu)
+{
+    bkn_filter_entry_t *fe, *cbe;
+    int cb_rank = -1;
+
+    if (ft->num_entries == 0) {
+        return NULL;
+    }
+    if (ft->num_ranks < BKN_FILTER_TABLE_HASH_MIN) {
+        return bkn_filter_table_walk(ft, pkt, pktlen, oob, lu);
+    }
+
+    /* First matched filter other than callback filters */
+    fe = bkn_filter_table_lookup(ft, pkt, pktlen, oob, 0, -1, INT_MAX, lu);
+
+    /* Callback filters ahead of it are tried in priority order */
+    while (ft->num_cb && lu->filter_cb) {
+        cbe = bkn_filter_table_lookup(ft, pkt, pktlen, oob, 1, cb_rank,
+                                      fe ? fe->rank : INT_MAX, lu);
+        if (cbe == NULL) {
+            break;
+        }
+        if (lu->filter_cb(lu->ctx, cbe->kf)) {
+            return cbe;
+        }
+        cb_rank = cbe->rank;
+    }
+
+    return fe;
+}
@@ -59,6 +59,7 @@
 #include <linux-bde.h>
 #include <kcom.h>
 #include <bcm-knet.h>
+#include <bcm-knet-filt.h>
 
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
@@ -67,6 +68,8 @@
 #include <linux/seq_file.h>
 #include <linux/if_vlan.h>
 #include <linux/nsproxy.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
 
 
 MODULE_AUTHOR("Broadcom Corporation");
@@ -575,6 +578,7 @@ typedef struct bkn_switch_info_s {
     struct net_device **ndevs;  /* Indexed array of ndev_list */
     int ndev_max;               /* Size of indexed array */
     struct list_head rxpf_list; /* Associated Rx packet filters */
+    struct bkn_filter_table_s __rcu *rxpf_tbl; /* Compiled Rx filters */
     volatile void *base_addr;   /* Base address for PCI register access */
     struct BKN_DMA_DEV *dma_dev;    /* Required for DMA memory control */
     struct pci_dev *pdev;       /* Required for DMA memory control */
@@ -975,11 +979,13 @@ typedef struct bkn_priv_s {
 typedef struct bkn_filter_s {
     struct list_head list;
     int dev_no;
-    unsigned long hits;
+    unsigned long __percpu *hits;   /* Per-CPU hit counters */
+    struct rcu_head rcu;
     kcom_filter_t kf;
 } bkn_filter_t;
 
 
+
 /*
  * Multiple instance support in KNET
  */
@@ -2629,100 +2635,202 @@ device_is_sand(bkn_switch_info_t *sinfo)
     return (is_dpp | is_dnx);
 }
 
-static bkn_filter_t *
-bkn_match_rx_pkt(bkn_switch_info_t *sinfo, uint8_t *pkt, int pktlen,
-                 void *meta, int chan, bkn_filter_t *cbf)
+static unsigned long
+bkn_filter_hits_get(bkn_filter_t *filter)
+{
+    unsigned long hits = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        hits += *per_cpu_ptr(filter->hits, cpu);
+    }
+    return hits;
+}
+
+static void
+bkn_filter_hits_clear(bkn_filter_t *filter)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        *per_cpu_ptr(filter->hits, cpu) = 0;
+    }
+}
+
+static void
+bkn_filter_free(bkn_filter_t *filter)
+{
+    free_percpu(filter->hits);
+    kfree(filter);
+}
+
+static void
+bkn_filter_free_rcu(struct rcu_head *rcu)
+{
+    bkn_filter_free(container_of(rcu, bkn_filter_t, rcu));
+}
+
+/*
+ * Compile the Rx filter list into a filter table.
+ * Must be called with the device lock held.
+ */
+static bkn_filter_table_t *
+bkn_filter_table_build(bkn_switch_info_t *sinfo)
 {
     struct list_head *list;
     bkn_filter_t *filter;
-    kcom_filter_t scratch, *kf;
-    uint8_t *oob = (uint8_t *)meta;
-    int size, wsize;
-    int idx, match;
+    bkn_filter_table_t *ft;
+    int num_filters = 0;
 
+    list_for_each(list, &sinfo->rxpf_list) {
+        num_filters++;
+    }
+
+    ft = bkn_filter_table_alloc(num_filters);
+    if (ft == NULL) {
+        return NULL;
+    }
     list_for_each(list, &sinfo->rxpf_list) {
         filter = (bkn_filter_t *)list;
-        kf = &filter->kf;
-        if (kf->pkt_data_offset + kf->pkt_data_size > pktlen) {
-            continue;
-        }
-        memcpy(&scratch.data.b[0],
-               &oob[kf->oob_data_offset], kf->oob_data_size);
-        memcpy(&scratch.data.b[kf->oob_data_size],
-               &pkt[kf->pkt_data_offset], kf->pkt_data_size);
-        size = kf->oob_data_size + kf->pkt_data_size;
-        wsize = BYTES2WORDS(size);
-        DBG_VERB(("Filter: size = %d (%d), data = 0x%08x, mask = 0x%08x\n",
-                  size, wsize, kf->data.w[0], kf->mask.w[0]));
+        bkn_filter_table_add(ft, &filter->kf, filter);
+    }
+    bkn_filter_table_finalize(ft);
 
-        if (device_is_sand(sinfo)) {
-            DBG_DUNE(("Filter: size = %d (wsize %d)\n", size, wsize));
-            for (idx = 0; idx < wsize; idx++)
-            {
-                DBG_DUNE(("OOB[%d]: 0x%08x [0x%08x]\n", idx, kf->data.w[idx], kf->mask.w[idx]));
-            }
-            DBG_DUNE(("Meta Data [+ Selected Raw packet data]\n"));
-            for (idx = 0; idx < wsize; idx++)
-            {
-                DBG_DUNE(("Scratch[%d]: 0x%08x\n", idx, scratch.data.w[idx]));
-            }
-        }
+    return ft;
+}
 
-        match = 1;
-        if (match) {
-            if (device_is_dnx(sinfo))
-            {
-                /*
-                 * Mutliple RX channels are enabled on JR2 and above devices
-                 * Bind between priority 0 and RX channel 0 is not checked, then all enabled RX channels can receive packets.
-                 */
-                if (kf->priority && (kf->priority < (num_rx_prio * sinfo->rx_chans))) {
-                    if (kf->priority < (num_rx_prio * chan) ||
-                        kf->priority >= (num_rx_prio * (chan + 1))) {
-                        match = 0;
-                    }
-                }
-            }
-            else {
-                if (kf->priority < (num_rx_prio * sinfo->rx_chans)) {
-                    if (kf->priority < (num_rx_prio * chan) ||
-                        kf->priority >= (num_rx_prio * (chan + 1))) {
-                        match = 0;
-                    }
-                }
-            }
+/*
+ * Rebuild and publish the Rx filter table.
+ * Must be called with the device lock held.
+ */
+static int
+bkn_filter_table_update(bkn_switch_info_t *sinfo)
+{
+    bkn_filter_table_t *ft, *old;
+
+    ft = bkn_filter_table_build(sinfo);
+    if (ft == NULL) {
+        return -ENOMEM;
+    }
+    old = rcu_dereference_protected(sinfo->rxpf_tbl,
+                                    lockdep_is_held(&sinfo->lock));
+    rcu_assign_pointer(sinfo->rxpf_tbl, ft);
+    if (old) {
+        kfree_rcu(old, rcu);
+    }
+    return 0;
+}
+
+/* Context for the filter table lookup hooks */
+typedef struct bkn_rx_match_s {
+    bkn_switch_info_t *sinfo;
+    int chan;
+    uint8_t *pkt;
+    int pktlen;
+    void *meta;
+    bkn_filter_t *cbf;
+} bkn_rx_match_t;
+
+static void
+bkn_filter_dump_dune(void *ctx, bkn_filter_shape_t *fs, uint32 *key)
+{
+    int idx;
+
+    DBG_DUNE(("Filter: size = %d (wsize %d)\n",
+              fs->oob_data_size + fs->pkt_data_size, fs->wsize));
+    for (idx = 0; idx < fs->wsize; idx++) {
+        DBG_DUNE(("Mask[%d]: 0x%08x\n", idx, fs->mask[idx]));
+    }
+    DBG_DUNE(("Meta Data [+ Selected Raw packet data]\n"));
+    for (idx = 0; idx < fs->wsize; idx++) {
+        DBG_DUNE(("Scratch[%d]: 0x%08x\n", idx, key[idx]));
+    }
+}
+
+static int
+bkn_filter_chan_match(void *ctx, kcom_filter_t *kf)
+{
+    bkn_rx_match_t *rxm = (bkn_rx_match_t *)ctx;
+    bkn_switch_info_t *sinfo = rxm->sinfo;
+    int chan = rxm->chan;
+
+    if (device_is_dnx(sinfo)) {
+        /*
+         * Mutliple RX channels are enabled on JR2 and above devices
+         * Bind between priority 0 and RX channel 0 is not checked, then all enabled RX channels can receive packets.
+         */
+        if (kf->priority == 0) {
+            return 1;
         }
-        if (match) {
-            for (idx = 0; idx < wsize; idx++) {
-                scratch.data.w[idx] &= kf->mask.w[idx];
-                if (scratch.data.w[idx] != kf->data.w[idx]) {
-                    match = 0;
-                    break;
-                }
-            }
+    }
+    if (kf->priority < (num_rx_prio * sinfo->rx_chans)) {
+        if (kf->priority < (num_rx_prio * chan) ||
+            kf->priority >= (num_rx_prio * (chan + 1))) {
+            return 0;
         }
-        if (match) {
-            if (kf->dest_type == KCOM_DEST_T_CB) {
-                /* Check for custom filters */
-                if (knet_filter_cb != NULL && cbf != NULL) {
-                    memset(cbf, 0, sizeof(*cbf));
-                    memcpy(&cbf->kf, kf, sizeof(cbf->kf));
-                    if (knet_filter_cb(pkt, pktlen, sinfo->dev_no,
-                                       meta, chan, &cbf->kf)) {
-                        filter->hits++;
-                        return cbf;
-                    }
-                } else {
-                    DBG_FLTR(("Match, but not filter callback\n"));
-                }
-            } else {
-                filter->hits++;
-                return filter;
-            }
+    }
+    return 1;
+}
+
+static int
+bkn_filter_cb_match(void *ctx, kcom_filter_t *kf)
+{
+    bkn_rx_match_t *rxm = (bkn_rx_match_t *)ctx;
+    bkn_filter_t *cbf = rxm->cbf;
+
+    /* Check for custom filters */
+    if (knet_filter_cb != NULL && cbf != NULL) {
+        memset(cbf, 0, sizeof(*cbf));
+        memcpy(&cbf->kf, kf, sizeof(cbf->kf));
+        return knet_filter_cb(rxm->pkt, rxm->pktlen, rxm->sinfo->dev_no,
+                              rxm->meta, rxm->chan, &cbf->kf);
+    }
+    DBG_FLTR(("Match, but not filter callback\n"));
+    return 0;
+}
+
+/*
+ * Must be called with the device lock held.
+ */
+static bkn_filter_t *
+bkn_match_rx_pkt(bkn_switch_info_t *sinfo, uint8_t *pkt, int pktlen,
+                 void *meta, int chan, bkn_filter_t *cbf)
+{
+    bkn_filter_table_t *ft;
+    bkn_filter_entry_t *fe = NULL;
+    bkn_filter_t *filter = NULL;
+    bkn_rx_match_t rxm;
+    bkn_filter_lookup_t lu;
+
+    rxm.sinfo = sinfo;
+    rxm.chan = chan;
+    rxm.pkt = pkt;
+    rxm.pktlen = pktlen;
+    rxm.meta = meta;
+    rxm.cbf = cbf;
+    lu.chan_match = bkn_filter_chan_match;
+    lu.filter_cb = bkn_filter_cb_match;
+    lu.key_dump = NULL;
+    if (unlikely(debug & DBG_LVL_DUNE) && device_is_sand(sinfo)) {
+        lu.key_dump = bkn_filter_dump_dune;
+    }
+    lu.ctx = &rxm;
+
+    rcu_read_lock();
+    ft = rcu_dereference(sinfo->rxpf_tbl);
+    if (ft) {
+        fe = bkn_filter_table_match(ft, pkt, pktlen, (uint8_t *)meta, &lu);
+    }
+    if (fe) {
+        filter = (bkn_filter_t *)fe->priv;
+        this_cpu_inc(*filter->hits);
+        if (fe->cb) {
+            filter = cbf;
         }
     }
+    rcu_read_unlock();
 
-    return NULL;
+    return filter;
 }
 
 static bkn_priv_t *
@@ -7676,7 +7784,8 @@ bkn_proc_stats_show(struct seq_file *m, void *v)
             filter = (bkn_filter_t *)flist;
 
             seq_printf(m, "  Filter %d stats:\n", filter->kf.id);
-            seq_printf(m, "    Hits      %10lu\n", filter->hits);
+            seq_printf(m, "    Hits      %10lu\n",
+                       bkn_filter_hits_get(filter));
         }
 
         unit++;
@@ -7752,7 +7861,7 @@ bkn_proc_stats_write(struct file *file, const char *buf,
         sinfo->napi_not_done = 0;
         list_for_each(flist, &sinfo->rxpf_list) {
             filter = (bkn_filter_t *)flist;
-            filter->hits = 0;
+            bkn_filter_hits_clear(filter);
         }
     }
 
@@ -9025,6 +9134,19 @@ bkn_knet_filter_create(kcom_msg_filter_create_t *kmsg, int len)
         return sizeof(kcom_msg_hdr_t);
     }
 
+    filter = kmalloc(sizeof(*filter), GFP_KERNEL);
+    if (filter == NULL) {
+        kmsg->hdr.status = KCOM_E_RESOURCE;
+        return sizeof(kcom_msg_hdr_t);
+    }
+    memset(filter, 0, sizeof(*filter));
+    filter->hits = alloc_percpu(unsigned long);
+    if (filter->hits == NULL) {
+        kfree(filter);
+        kmsg->hdr.status = KCOM_E_RESOURCE;
+        return sizeof(kcom_msg_hdr_t);
+    }
+
     spin_lock_irqsave(&sinfo->lock, flags);
 
     /*
@@ -9045,16 +9167,10 @@ bkn_knet_filter_create(kcom_msg_filter_create_t *kmsg, int len)
     if (found) {
         /* Too many filters */
         spin_unlock_irqrestore(&sinfo->lock, flags);
+        bkn_filter_free(filter);
         kmsg->hdr.status = KCOM_E_RESOURCE;
         return sizeof(kcom_msg_hdr_t);
     }
-    filter = kmalloc(sizeof(*filter), GFP_ATOMIC);
-    if (filter == NULL) {
-        spin_unlock_irqrestore(&sinfo->lock, flags);
-        kmsg->hdr.status = KCOM_E_PARAM;
-        return sizeof(kcom_msg_hdr_t);
-    }
-    memset(filter, 0, sizeof(*filter));
     memcpy(&filter->kf, &kmsg->filter, sizeof(filter->kf));
     filter->kf.id = id;
 
@@ -9072,6 +9188,15 @@ bkn_knet_filter_create(kcom_msg_filter_create_t *kmsg, int len)
         list_add_tail(&filter->list, &sinfo->rxpf_list);
     }
 
+    /* Publish the new filter to the Rx path */
+    if (bkn_filter_table_update(sinfo) < 0) {
+        list_del(&filter->list);
+        spin_unlock_irqrestore(&sinfo->lock, flags);
+        bkn_filter_free(filter);
+        kmsg->hdr.status = KCOM_E_RESOURCE;
+        return sizeof(kcom_msg_hdr_t);
+    }
+
     kmsg->filter.id = filter->kf.id;
 
     spin_unlock_irqrestore(&sinfo->lock, flags);
@@ -9135,10 +9260,26 @@ bkn_knet_filter_destroy(kcom_msg_filter_destroy_t *kmsg, int len)
 
     list_del(&filter->list);
 
+    if (bkn_filter_table_update(sinfo) < 0) {
+        /*
+         * Stop filtering rather than leave a stale reference to the
+         * removed filter in the Rx path.
+         */
+        bkn_filter_table_t *ft;
+
+        ft = rcu_dereference_protected(sinfo->rxpf_tbl,
+                                       lockdep_is_held(&sinfo->lock));
+        RCU_INIT_POINTER(sinfo->rxpf_tbl, NULL);
+        if (ft) {
+            kfree_rcu(ft, rcu);
+        }
+        gprintk("Failed to rebuild Rx filter table, filtering disabled.\n");
+    }
+
     cfg_api_unlock(sinfo, &flags);
 
     DBG_VERB(("Removing filter ID %d.\n", filter->kf.id));
-    kfree(filter);
+    call_rcu(&filter->rcu, bkn_filter_free_rcu);
 
     return sizeof(kcom_msg_hdr_t);
 }
@@ -9551,16 +9692,21 @@ _cleanup(void)
         cfg_api_unlock(sinfo, &flags);
     }
 
+    /* Wait for deferred Rx filter and filter table frees */
+    rcu_barrier();
+
     /* Destroy all switch devices */
     while (!list_empty(&_sinfo_list)) {
         sinfo = list_entry(_sinfo_list.next, bkn_switch_info_t, list);
 
         /* Destroy all associated Rx packet filters */
+        kfree(rcu_dereference_protected(sinfo->rxpf_tbl, 1));
+        RCU_INIT_POINTER(sinfo->rxpf_tbl, NULL);
         while (!list_empty(&sinfo->rxpf_list)) {
             filter = list_entry(sinfo->rxpf_list.next, bkn_filter_t, list);
             list_del(&filter->list);
             DBG_VERB(("Removing filter ID %d.\n", filter->kf.id));
-            kfree(filter);
+            bkn_filter_free(filter);
         }
 
         /* Destroy all associated virtual net devices */
@@ -0,0 +1,431 @@
+/*
+ * Copyright 2007-2020 Broadcom Inc. All rights reserved.
+ * 
+ * Permission is granted to use, copy, modify and/or distribute this
+ * software under either one of the licenses below.
+ * 
+ * License Option 1: GPL
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as
+ * published by the Free Software Foundation (the "GPL").
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 (GPLv2) for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 (GPLv2) along with this source code.
+ * 
+ * 
+ * License Option 2: Broadcom Open Network Switch APIs (OpenNSA) license
+ * 
+ * This software is governed by the Broadcom Open Network Switch APIs license:
+ * https://www.broadcom.com/products/ethernet-connectivity/software/opennsa
+ */
+/*
+ * $Id: bcm-knet-filt-test.c Broadcom SDK $
+ * $Copyright: (c) 2005 Broadcom Corp.
+ * All Rights Reserved.$
+ *
+ * File:    bcm-knet-filt-test.c
+ * Purpose: User space test and benchmark of the KNET Rx filter table
+ *
+ * Random filter sets shaped like the trap filters a NOS installs are
+ * compiled into a filter table, and synthetic packets with metadata are
+ * matched both against the table and with the priority-ordered list
+ * walk the table replaced. The results must be identical.
+ *
+ *     bcm-knet-filt-test [-s seed] [-n pkts] [-b]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <gmodule.h>
+#include <linux/slab.h>
+#include <bcm-knet-filt.h>
+
+#define OOB_SIZE        64
+#define PKT_SIZE        128
+#define RX_CHANS        4
+#define RX_PRIO         2
+
+typedef struct test_pkt_s {
+    uint8 oob[OOB_SIZE];
+    uint8 pkt[PKT_SIZE];
+    int pktlen;
+    int chan;
+} test_pkt_t;
+
+static uint32
+rand32(uint32 *s)
+{
+    uint32 x = *s;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+/* Same rule as the driver for a non-DNX device */
+static int
+chan_match(int chan, kcom_filter_t *kf)
+{
+    if (kf->priority < (RX_PRIO * RX_CHANS)) {
+        if (kf->priority < (RX_PRIO * chan) ||
+            kf->priority >= (RX_PRIO * (chan + 1))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Stand-in for knet_filter_cb: takes about half of the packets */
+static int
+filter_cb(test_pkt_t *tp, kcom_filter_t *kf)
+{
+    return (tp->pkt[0] ^ kf->id) & 1;
+}
+
+/*
+ * Reference match: walk the filters in priority order.
+ */
+static kcom_filter_t *
+ref_match(kcom_filter_t *kfs, int num, test_pkt_t *tp)
+{
+    kcom_filter_t scratch, *kf;
+    int fi, idx, wsize;
+
+    for (fi = 0; fi < num; fi++) {
+        kf = &kfs[fi];
+        if (kf->pkt_data_offset + kf->pkt_data_size > tp->pktlen) {
+            continue;
+        }
+        if (!chan_match(tp->chan, kf)) {
+            continue;
+        }
+        memcpy(&scratch.data.b[0],
+               &tp->oob[kf->oob_data_offset], kf->oob_data_size);
+        memcpy(&scratch.data.b[kf->oob_data_size],
+               &tp->pkt[kf->pkt_data_offset], kf->pkt_data_size);
+        wsize = BYTES2WORDS(kf->oob_data_size + kf->pkt_data_size);
+        for (idx = 0; idx < wsize; idx++) {
+            if ((scratch.data.w[idx] & kf->mask.w[idx]) != kf->data.w[idx]) {
+                break;
+            }
+        }
+        if (idx < wsize) {
+            continue;
+        }
+        if (kf->dest_type == KCOM_DEST_T_CB && !filter_cb(tp, kf)) {
+            continue;
+        }
+        return kf;
+    }
+
+    return NULL;
+}
+
+static int
+lu_chan_match(void *ctx, kcom_filter_t *kf)
+{
+    return chan_match(((test_pkt_t *)ctx)->chan, kf);
+}
+
+static int
+lu_filter_cb(void *ctx, kcom_filter_t *kf)
+{
+    return filter_cb((test_pkt_t *)ctx, kf);
+}
+
+static kcom_filter_t *
+tbl_match(bkn_filter_table_t *ft, test_pkt_t *tp)
+{
+    bkn_filter_lookup_t lu;
+    bkn_filter_entry_t *fe;
+
+    lu.chan_match = lu_chan_match;
+    lu.filter_cb = lu_filter_cb;
+    lu.key_dump = NULL;
+    lu.ctx = tp;
+    fe = bkn_filter_table_match(ft, tp->pkt, tp->pktlen, tp->oob, &lu);
+
+    return fe ? fe->kf : NULL;
+}
+
+/*
+ * Filter shapes seen on a switch CPU port: ethertype (ARP, LACP, LLDP),
+ * IP protocol and L4 port (BGP, DHCP), trap reason in the metadata, and
+ * reason plus ethertype.
+ */
+static const struct {
+    uint16 oob_off, oob_size, pkt_off, pkt_size;
+    uint8 mask[16];
+} shapes[] = {
+    { 0, 0, 12, 2, { 0xff, 0xff } },
+    { 0, 0, 12, 12, { 0xff, 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff } },
+    { 0, 0, 23, 14, { 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff } },
+    { 4, 4, 0, 0, { 0xff, 0x0f, 0, 0 } },
+    { 8, 2, 12, 2, { 0x3f, 0xff, 0xff, 0xff } },
+    { 16, 8, 0, 0, { 0, 0, 0, 0x80, 0xff, 0xff, 0, 0 } },
+};
+
+#define NUM_SHAPES      COUNTOF(shapes)
+
+static void
+filter_gen(kcom_filter_t *kf, int id, uint32 *seed)
+{
+    int si = rand32(seed) % NUM_SHAPES;
+    int size, idx;
+
+    memset(kf, 0, sizeof(*kf));
+    kf->id = id;
+    kf->type = KCOM_FILTER_T_RX_PKT;
+    kf->dest_type = KCOM_DEST_T_NETIF;
+    /* Mostly unbound, sometimes bound to a channel */
+    kf->priority = RX_PRIO * RX_CHANS + rand32(seed) % 4;
+    if (rand32(seed) % 4 == 0) {
+        kf->priority = rand32(seed) % (RX_PRIO * RX_CHANS);
+    }
+    kf->oob_data_offset = shapes[si].oob_off;
+    kf->oob_data_size = shapes[si].oob_size;
+    kf->pkt_data_offset = shapes[si].pkt_off;
+    kf->pkt_data_size = shapes[si].pkt_size;
+    size = kf->oob_data_size + kf->pkt_data_size;
+    for (idx = 0; idx < size; idx++) {
+        kf->mask.b[idx] = shapes[si].mask[idx];
+        kf->data.b[idx] = rand32(seed) & kf->mask.b[idx];
+    }
+    if (rand32(seed) % 8 == 0) {
+        kf->dest_type = KCOM_DEST_T_CB;
+    }
+    if (rand32(seed) % 64 == 0) {
+        /* Can never match, must never be returned */
+        kf->data.b[0] |= ~kf->mask.b[0];
+    }
+}
+
+/*
+ * Generate a packet, often built from one of the filters so it hits.
+ */
+static void
+pkt_gen(test_pkt_t *tp, kcom_filter_t *kfs, int num, uint32 *seed)
+{
+    kcom_filter_t *kf;
+    int idx, bi;
+
+    for (idx = 0; idx < OOB_SIZE; idx++) {
+        tp->oob[idx] = rand32(seed);
+    }
+    for (idx = 0; idx < PKT_SIZE; idx++) {
+        tp->pkt[idx] = rand32(seed);
+    }
+    tp->pktlen = 24 + rand32(seed) % (PKT_SIZE - 24);
+    tp->chan = rand32(seed) % RX_CHANS;
+
+    if (rand32(seed) % 4 == 0) {
+        return;
+    }
+    kf = &kfs[rand32(seed) % num];
+    for (idx = 0; idx < kf->oob_data_size; idx++) {
+        tp->oob[kf->oob_data_offset + idx] &= ~kf->mask.b[idx];
+        tp->oob[kf->oob_data_offset + idx] |= kf->data.b[idx];
+    }
+    for (idx = 0; idx < kf->pkt_data_size; idx++) {
+        bi = kf->oob_data_size + idx;
+        tp->pkt[kf->pkt_data_offset + idx] &= ~kf->mask.b[bi];
+        tp->pkt[kf->pkt_data_offset + idx] |= kf->data.b[bi];
+    }
+    if (kf->priority < (RX_PRIO * RX_CHANS)) {
+        tp->chan = kf->priority / RX_PRIO;
+    }
+}
+
+static void
+filters_gen(kcom_filter_t *kfs, int num, uint32 *seed)
+{
+    kcom_filter_t *kf;
+    int fi;
+
+    for (fi = 0; fi < num; fi++) {
+        filter_gen(&kfs[fi], fi + 1, seed);
+    }
+    /* Sometimes end with a catch-all */
+    if (rand32(seed) % 2) {
+        kf = &kfs[num - 1];
+        kf->oob_data_size = 0;
+        kf->pkt_data_size = 0;
+        memset(&kf->mask, 0, sizeof(kf->mask));
+        memset(&kf->data, 0, sizeof(kf->data));
+    }
+}
+
+static bkn_filter_table_t *
+table_build(kcom_filter_t *kfs, int num)
+{
+    bkn_filter_table_t *ft;
+    int fi;
+
+    ft = bkn_filter_table_alloc(num);
+    if (ft == NULL) {
+        return NULL;
+    }
+    for (fi = 0; fi < num; fi++) {
+        bkn_filter_table_add(ft, &kfs[fi], NULL);
+    }
+    bkn_filter_table_finalize(ft);
+
+    return ft;
+}
+
+static int
+test_run(int num, int pkts, uint32 seed)
+{
+    kcom_filter_t *kfs, *ref, *kf;
+    bkn_filter_table_t *ft;
+    test_pkt_t tp;
+    int pi, hits = 0, errs = 0;
+
+    kfs = calloc(num, sizeof(*kfs));
+    if (kfs == NULL) {
+        return -1;
+    }
+    filters_gen(kfs, num, &seed);
+    ft = table_build(kfs, num);
+    if (ft == NULL) {
+        free(kfs);
+        return -1;
+    }
+
+    for (pi = 0; pi < pkts; pi++) {
+        pkt_gen(&tp, kfs, num, &seed);
+        ref = ref_match(kfs, num, &tp);
+        kf = tbl_match(ft, &tp);
+        if (ref) {
+            hits++;
+        }
+        if (kf != ref && errs++ < 10) {
+            fprintf(stderr, "filters %d pkt %d: got %d expected %d\n",
+                    num, pi, kf ? kf->id : 0, ref ? ref->id : 0);
+        }
+    }
+
+    printf("filters %3d shapes %d %s: %d pkts, %d hits, %d mismatches\n",
+           num, ft->num_shapes,
+           num < BKN_FILTER_TABLE_HASH_MIN ? "walk" : "hash",
+           pkts, hits, errs);
+
+    kfree(ft);
+    free(kfs);
+
+    return errs ? -1 : 0;
+}
+
+static uint64
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+bench_run(int num, int pkts, uint32 seed)
+{
+    kcom_filter_t *kfs;
+    bkn_filter_table_t *ft;
+    test_pkt_t *tps;
+    uint64 t0, ref_ns, tbl_ns;
+    unsigned long sum = 0;
+    int pi;
+
+    kfs = calloc(num, sizeof(*kfs));
+    tps = calloc(pkts, sizeof(*tps));
+    if (kfs == NULL || tps == NULL) {
+        free(kfs);
+        free(tps);
+        return -1;
+    }
+    filters_gen(kfs, num, &seed);
+    for (pi = 0; pi < pkts; pi++) {
+        pkt_gen(&tps[pi], kfs, num, &seed);
+    }
+    ft = table_build(kfs, num);
+    if (ft == NULL) {
+        free(kfs);
+        free(tps);
+        return -1;
+    }
+
+    t0 = now_ns();
+    for (pi = 0; pi < pkts; pi++) {
+        sum += (unsigned long)ref_match(kfs, num, &tps[pi]);
+    }
+    ref_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (pi = 0; pi < pkts; pi++) {
+        sum += (unsigned long)tbl_match(ft, &tps[pi]);
+    }
+    tbl_ns = now_ns() - t0;
+
+    printf("filters %3d shapes %d %s: list walk %6.1f ns/pkt, "
+           "table %6.1f ns/pkt (%lx)\n",
+           num, ft->num_shapes,
+           num < BKN_FILTER_TABLE_HASH_MIN ? "walk" : "hash",
+           (double)ref_ns / pkts,
+           (double)tbl_ns / pkts, sum & 0xf);
+
+    kfree(ft);
+    free(kfs);
+    free(tps);
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int nums[] = { 1, 2, 8, 31, 32, 128, 256 };
+    uint32 seed = 0x9e3779b9;
+    int pkts = 100000, bench = 0;
+    int opt, ni, rv = 0;
+
+    while ((opt = getopt(argc, argv, "s:n:b")) != -1) {
+        switch (opt) {
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            pkts = strtol(optarg, NULL, 0);
+            break;
+        case 'b':
+            bench = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-n pkts] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (seed == 0 || pkts <= 0) {
+        fprintf(stderr, "invalid seed or packet count\n");
+        return 1;
+    }
+
+    for (ni = 0; ni < COUNTOF(nums); ni++) {
+        if (bench) {
+            rv |= bench_run(nums[ni], pkts, seed + ni);
+        } else {
+            rv |= test_run(nums[ni], pkts, seed + ni);
+        }
+    }
+
+    return rv ? 1 : 0;
+}
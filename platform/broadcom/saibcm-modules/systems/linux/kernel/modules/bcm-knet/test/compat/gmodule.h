@@ -0,0 +1,12 @@
+/*
+ * Minimal <gmodule.h> for building KNET units in user space.
+ */
+
+#ifndef COMPAT_GMODULE_H
+#define COMPAT_GMODULE_H
+
+#include <limits.h>
+#include <string.h>
+#include <linux/types.h>
+
+#endif /* COMPAT_GMODULE_H */
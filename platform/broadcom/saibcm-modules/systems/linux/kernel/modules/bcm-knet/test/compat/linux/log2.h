@@ -0,0 +1,14 @@
+/*
+ * Minimal <linux/log2.h> for building KNET units in user space.
+ */
+
+#ifndef COMPAT_LINUX_LOG2_H
+#define COMPAT_LINUX_LOG2_H
+
+static inline unsigned long
+roundup_pow_of_two(unsigned long n)
+{
+    return n <= 1 ? 1 : 1UL << (64 - __builtin_clzl(n - 1));
+}
+
+#endif /* COMPAT_LINUX_LOG2_H */
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007-2020 Broadcom Inc. All rights reserved.
+ * 
+ * Permission is granted to use, copy, modify and/or distribute this
+ * software under either one of the licenses below.
+ * 
+ * License Option 1: GPL
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as
+ * published by the Free Software Foundation (the "GPL").
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 (GPLv2) for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 (GPLv2) along with this source code.
+ * 
+ * 
+ * License Option 2: Broadcom Open Network Switch APIs (OpenNSA) license
+ * 
+ * This software is governed by the Broadcom Open Network Switch APIs license:
+ * https://www.broadcom.com/products/ethernet-connectivity/software/opennsa
+ */
+/*
+ * $Id: bcm-knet-filt.h Broadcom SDK $
+ * $Copyright: (c) 2005 Broadcom Corp.
+ * All Rights Reserved.$
+ *
+ * File:    bcm-knet-filt.h
+ * Purpose: Compiled Rx filter table used by the BCM KNET driver
+ */
+#ifndef __LINUX_BCM_KNET_FILT_H__
+#define __LINUX_BCM_KNET_FILT_H__
+
+#include <kcom.h>
+
+/*
+ * Rx filter table
+ *
+ * Filters with identical data offsets, sizes and mask are grouped into
+ * one shape. The masked key of a packet is extracted and hashed once per
+ * shape, and the filters of a shape are hashed by their data. Bucket
+ * chains are kept in filter priority order (rank). The table is rebuilt
+ * whenever a filter is created or destroyed and published through RCU.
+ *
+ * Tables with fewer than BKN_FILTER_TABLE_HASH_MIN filters are matched
+ * by walking the entries in priority order instead.
+ */
+#define BKN_FILTER_TABLE_HASH_MIN   32
+
+typedef struct bkn_filter_entry_s {
+    kcom_filter_t *kf;
+    void *priv;                 /* Owner of kf, opaque to the table */
+    int rank;                   /* Position in priority-ordered list */
+    int cb;                     /* Destination is filter callback */
+    uint32 hash;
+    int shape;                  /* Index of shape */
+    int next;                   /* Next entry in bucket, -1 if none */
+} bkn_filter_entry_t;
+
+typedef struct bkn_filter_shape_s {
+    uint16 oob_data_offset;
+    uint16 oob_data_size;
+    uint16 pkt_data_offset;
+    uint16 pkt_data_size;
+    int wsize;
+    const uint32 *mask;         /* Shared with first filter of shape */
+    int min_rank;
+    int num_cb;
+    int num_entries;
+    uint32 bkt_mask;
+    int *bkts;                  /* First entry per bucket, -1 if empty */
+} bkn_filter_shape_t;
+
+typedef struct bkn_filter_table_s {
+    struct rcu_head rcu;
+    int max_filters;
+    int num_ranks;
+    int num_shapes;
+    int num_entries;
+    int num_cb;
+    int *bkts;
+    bkn_filter_shape_t *shapes;
+    bkn_filter_entry_t *entries;
+} bkn_filter_table_t;
+
+/*
+ * Per-lookup hooks. chan_match rejects an otherwise matching filter and
+ * filter_cb decides whether a matching callback filter takes the packet;
+ * callback filters never match if it is NULL. key_dump (optional) is
+ * called with the masked key of each shape.
+ */
+typedef struct bkn_filter_lookup_s {
+    int (*chan_match)(void *ctx, kcom_filter_t *kf);
+    int (*filter_cb)(void *ctx, kcom_filter_t *kf);
+    void (*key_dump)(void *ctx, bkn_filter_shape_t *fs, uint32 *key);
+    void *ctx;
+} bkn_filter_lookup_t;
+
+extern bkn_filter_table_t *
+bkn_filter_table_alloc(int max_filters);
+
+extern void
+bkn_filter_table_add(bkn_filter_table_t *ft, kcom_filter_t *kf, void *priv);
+
+extern void
+bkn_filter_table_finalize(bkn_filter_table_t *ft);
+
+extern bkn_filter_entry_t *
+bkn_filter_table_match(bkn_filter_table_t *ft, uint8 *pkt, int pktlen,
+                       uint8 *oob, bkn_filter_lookup_t *lu);
+
+#endif /* __LINUX_BCM_KNET_FILT_H__ */
@@ -40,6 +40,8 @@
 #include <bcm-knet.h>
 #include <linux/if_vlan.h>
 #include <linux/skbuff.h>
+#include <linux/percpu.h>
+#include <linux/log2.h>
 #include <linux/sched.h>
 #include <linux/netdevice.h>
 #include <net/net_namespace.h>
@@ -96,7 +98,13 @@ MODULE_PARM_DESC(psample_size,
 static int psample_qlen = PSAMPLE_QLEN_DFLT;
 LKM_MOD_PARAM(psample_qlen, "i", int, 0);
 MODULE_PARM_DESC(psample_qlen,
-"psample queue length (default 1024 buffers)");
+"psample queue length per CPU (default 1024 buffers)");
+
+#define PSAMPLE_BATCH_DFLT 64
+static int psample_batch = PSAMPLE_BATCH_DFLT;
+LKM_MOD_PARAM(psample_batch, "i", int, 0);
+MODULE_PARM_DESC(psample_batch,
+"psample pkts delivered per queue per worker run (default 64)");
 
 #if !IS_ENABLED(CONFIG_PSAMPLE)
 inline struct 
@@ -127,7 +135,6 @@ typedef struct psample_stats_s {
     unsigned long pkts_f_handled;
     unsigned long pkts_f_pass_through;
     unsigned long pkts_f_dst_mc;
-    unsigned long pkts_c_qlen_cur;
     unsigned long pkts_c_qlen_hi;
     unsigned long pkts_d_qlen_max;
     unsigned long pkts_d_no_mem;
@@ -138,6 +145,9 @@ typedef struct psample_stats_s {
     unsigned long pkts_d_meta_srcport;
     unsigned long pkts_d_meta_dstport;
     unsigned long pkts_d_invalid_size;
+    unsigned long pkts_f_buf_alloc;
+    unsigned long pkts_f_batch;
+    unsigned long pkts_c_batch_hi;
 } psample_stats_t;
 static psample_stats_t g_psample_stats = {0};
 
@@ -148,17 +158,29 @@ typedef struct psample_meta_s {
     int sample_rate;
 } psample_meta_t;
 
+/*
+ * Sampled pkts are queued on per-CPU rings of preallocated buffers. Each
+ * ring has a single producer (the Rx path of its CPU) and a single consumer
+ * (the psample worker), so no lock is needed on either side.
+ */
 typedef struct psample_pkt_s {
-    struct list_head list;
     struct psample_group *group;
     psample_meta_t meta;
     struct sk_buff *skb;
+    struct sk_buff *skb_ext;
 } psample_pkt_t;
 
+typedef struct psample_ring_s {
+    unsigned int head ____cacheline_aligned_in_smp;
+    unsigned int tail ____cacheline_aligned_in_smp;
+    psample_pkt_t *pkts;
+} psample_ring_t;
+
 typedef struct psample_work_s {
-    struct list_head pkt_list;
+    psample_ring_t __percpu *rings;
+    unsigned int ring_size;
+    unsigned int buf_size;
     struct work_struct wq;
-    spinlock_t lock;
 } psample_work_t;
 static psample_work_t g_psample_work = {0};
 
@@ -395,58 +417,172 @@ psample_meta_get(int unit, uint8_t *pkt, void *pkt_meta, psample_meta_t *sflow_m
     return (0);
 }
 
-static void
-psample_task(struct work_struct *work)
+static unsigned int
+psample_qlen_get(void)
 {
-    psample_work_t *psample_work = container_of(work, psample_work_t, wq);
-    unsigned long flags;
-    struct list_head *list_ptr, *list_next;
-    psample_pkt_t *pkt;
+    psample_ring_t *ring;
+    unsigned int qlen = 0;
+    int cpu;
 
-    spin_lock_irqsave(&psample_work->lock, flags);
-    list_for_each_safe(list_ptr, list_next, &psample_work->pkt_list) {
-        /* dequeue pkt from list */
-        pkt = list_entry(list_ptr, psample_pkt_t, list);
-        list_del(list_ptr);
-        g_psample_stats.pkts_c_qlen_cur--;
-        spin_unlock_irqrestore(&psample_work->lock, flags);
- 
-        /* send to psample */
-        if (pkt) {
+    if (!g_psample_work.rings) {
+        return 0;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        qlen += READ_ONCE(ring->head) - READ_ONCE(ring->tail);
+    }
+    return qlen;
+}
+
+static void
+psample_pkt_send(psample_pkt_t *pkt)
+{
+    struct sk_buff *skb = pkt->skb_ext ? pkt->skb_ext : pkt->skb;
 #if ((IS_ENABLED(CONFIG_PSAMPLE) && LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0)) || \
      (defined PSAMPLE_MD_EXTENDED_ATTR && PSAMPLE_MD_EXTENDED_ATTR))
-            struct psample_metadata md = {0};
-            md.trunc_size = pkt->meta.trunc_size;
-            md.in_ifindex = pkt->meta.src_ifindex;
-            md.out_ifindex = pkt->meta.dst_ifindex;
+    struct psample_metadata md = {0};
+    md.trunc_size = pkt->meta.trunc_size;
+    md.in_ifindex = pkt->meta.src_ifindex;
+    md.out_ifindex = pkt->meta.dst_ifindex;
 #endif
-            PSAMPLE_CB_DBG_PRINT("%s: group 0x%x, trunc_size %d, src_ifdx 0x%x, dst_ifdx 0x%x, sample_rate %d\n",
-                    __func__, pkt->group->group_num, 
-                    pkt->meta.trunc_size, pkt->meta.src_ifindex, 
-                    pkt->meta.dst_ifindex, pkt->meta.sample_rate);
+    PSAMPLE_CB_DBG_PRINT("%s: group 0x%x, trunc_size %d, src_ifdx 0x%x, dst_ifdx 0x%x, sample_rate %d\n",
+            __func__, pkt->group->group_num, 
+            pkt->meta.trunc_size, pkt->meta.src_ifindex, 
+            pkt->meta.dst_ifindex, pkt->meta.sample_rate);
 
 #if ((IS_ENABLED(CONFIG_PSAMPLE) && LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0)) || \
      (defined PSAMPLE_MD_EXTENDED_ATTR && PSAMPLE_MD_EXTENDED_ATTR))
-            psample_sample_packet(pkt->group, 
-                                  pkt->skb,
-                                  pkt->meta.sample_rate,
-                                  &md);
+    psample_sample_packet(pkt->group, 
+                          skb,
+                          pkt->meta.sample_rate,
+                          &md);
 #else
-            psample_sample_packet(pkt->group, 
-                                  pkt->skb, 
-                                  pkt->meta.trunc_size,
-                                  pkt->meta.src_ifindex,
-                                  pkt->meta.dst_ifindex,
-                                  pkt->meta.sample_rate);
+    psample_sample_packet(pkt->group, 
+                          skb, 
+                          pkt->meta.trunc_size,
+                          pkt->meta.src_ifindex,
+                          pkt->meta.dst_ifindex,
+                          pkt->meta.sample_rate);
 #endif
-            g_psample_stats.pkts_f_psample_mod++;
- 
-            dev_kfree_skb_any(pkt->skb);
-            kfree(pkt);
+    g_psample_stats.pkts_f_psample_mod++;
+
+    /* psample copies the data, so the buffer can be recycled */
+    if (pkt->skb_ext) {
+        dev_kfree_skb_any(pkt->skb_ext);
+        pkt->skb_ext = NULL;
+    } else {
+        skb_trim(pkt->skb, 0);
+    }
+}
+
+static void
+psample_task(struct work_struct *work)
+{
+    psample_work_t *psample_work = container_of(work, psample_work_t, wq);
+    psample_ring_t *ring;
+    unsigned int mask = psample_work->ring_size - 1;
+    unsigned int head, tail, done = 0, batch;
+    int cpu, budget = psample_batch > 0 ? psample_batch : PSAMPLE_BATCH_DFLT;
+
+    /* drain up to one batch from each ring */
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(psample_work->rings, cpu);
+        tail = ring->tail;
+        head = smp_load_acquire(&ring->head);
+        for (batch = 0; tail != head && batch < budget; batch++, tail++) {
+            psample_pkt_send(&ring->pkts[tail & mask]);
+        }
+        if (batch) {
+            smp_store_release(&ring->tail, tail);
+            done += batch;
+        }
+    }
+
+    g_psample_stats.pkts_f_batch++;
+    if (done > g_psample_stats.pkts_c_batch_hi) {
+        g_psample_stats.pkts_c_batch_hi = done;
+    }
+
+    /*
+     * Pairs with the barrier in psample_filter_cb(). Either we see a pkt
+     * queued after our snapshot, or the producer sees the ring drained
+     * and kicks.
+     */
+    smp_mb();
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(psample_work->rings, cpu);
+        if (READ_ONCE(ring->head) != ring->tail) {
+            schedule_work(&psample_work->wq);
+            break;
+        }
+    }
+}
+
+static void
+psample_rings_free(void)
+{
+    psample_ring_t *ring;
+    psample_pkt_t *pkt;
+    unsigned int i;
+    int cpu;
+
+    if (!g_psample_work.rings) {
+        return;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        if (!ring->pkts) {
+            continue;
         }
-        spin_lock_irqsave(&psample_work->lock, flags);
+        for (i = 0; i < g_psample_work.ring_size; i++) {
+            pkt = &ring->pkts[i];
+            if (pkt->skb) {
+                dev_kfree_skb_any(pkt->skb);
+            }
+            if (pkt->skb_ext) {
+                dev_kfree_skb_any(pkt->skb_ext);
+            }
+        }
+        kfree(ring->pkts);
     }
-    spin_unlock_irqrestore(&psample_work->lock, flags);
+    free_percpu(g_psample_work.rings);
+    g_psample_work.rings = NULL;
+}
+
+static int
+psample_rings_alloc(void)
+{
+    psample_ring_t *ring;
+    unsigned int i;
+    int cpu;
+
+    g_psample_work.ring_size =
+        roundup_pow_of_two(psample_qlen > 0 ? psample_qlen : PSAMPLE_QLEN_DFLT);
+    g_psample_work.buf_size = psample_size > 0 ? psample_size : PSAMPLE_SIZE_DFLT;
+
+    g_psample_work.rings = alloc_percpu(psample_ring_t);
+    if (!g_psample_work.rings) {
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        ring = per_cpu_ptr(g_psample_work.rings, cpu);
+        ring->pkts = kcalloc_node(g_psample_work.ring_size, sizeof(psample_pkt_t),
+                                  GFP_KERNEL, cpu_to_node(cpu));
+        if (!ring->pkts) {
+            goto error;
+        }
+        for (i = 0; i < g_psample_work.ring_size; i++) {
+            ring->pkts[i].skb = __dev_alloc_skb(g_psample_work.buf_size, GFP_KERNEL);
+            if (!ring->pkts[i].skb) {
+                goto error;
+            }
+        }
+    }
+    return 0;
+
+error:
+    psample_rings_free();
+    return -ENOMEM;
 }
 
 int 
@@ -506,45 +642,69 @@ psample_filter_cb(uint8_t * pkt, int size, int dev_no, void *pkt_meta,
     /* drop if configured sample rate is 0 */
     if (meta.sample_rate > 0) {
         unsigned long flags;
+        psample_ring_t *ring;
         psample_pkt_t *psample_pkt;
         struct sk_buff *skb;
+        unsigned int head, qlen;
+        int kick;
 
-        if (g_psample_stats.pkts_c_qlen_cur >= psample_qlen) {
-            gprintk("%s: tail drop due to max qlen %d reached\n", __func__, psample_qlen);
-            g_psample_stats.pkts_d_qlen_max++;
+        if (!g_psample_work.rings) {
+            g_psample_stats.pkts_d_not_ready++;
             goto PSAMPLE_FILTER_CB_PKT_HANDLED;
         }
 
-        if ((psample_pkt = kmalloc(sizeof(psample_pkt_t), GFP_ATOMIC)) == NULL) {
-            gprintk("%s: failed to alloc psample mem for pkt\n", __func__);
-            g_psample_stats.pkts_d_no_mem++;
+        /*
+         * Keep a single producer per ring. The KNET Rx path may call us
+         * with interrupts already disabled, so bottom halves cannot be
+         * used for this.
+         */
+        local_irq_save(flags);
+        ring = this_cpu_ptr(g_psample_work.rings);
+        head = ring->head;
+        qlen = head - smp_load_acquire(&ring->tail);
+        if (qlen >= g_psample_work.ring_size) {
+            local_irq_restore(flags);
+            PSAMPLE_CB_DBG_PRINT("%s: tail drop due to max qlen %u reached\n", __func__, g_psample_work.ring_size);
+            g_psample_stats.pkts_d_qlen_max++;
             goto PSAMPLE_FILTER_CB_PKT_HANDLED;
         }
-        memcpy(&psample_pkt->meta, &meta, sizeof(psample_meta_t));
-        psample_pkt->group = group;
 
-        if ((skb = dev_alloc_skb(meta.trunc_size)) == NULL) {
-            gprintk("%s: failed to alloc psample mem for pkt skb\n", __func__);
-            g_psample_stats.pkts_d_no_mem++;
-            goto PSAMPLE_FILTER_CB_PKT_HANDLED;
+        psample_pkt = &ring->pkts[head & (g_psample_work.ring_size - 1)];
+        skb = psample_pkt->skb;
+        if (meta.trunc_size > g_psample_work.buf_size) {
+            /* larger than the preallocated buffers */
+            if ((skb = dev_alloc_skb(meta.trunc_size)) == NULL) {
+                local_irq_restore(flags);
+                gprintk("%s: failed to alloc psample mem for pkt skb\n", __func__);
+                g_psample_stats.pkts_d_no_mem++;
+                goto PSAMPLE_FILTER_CB_PKT_HANDLED;
+            }
+            psample_pkt->skb_ext = skb;
+            g_psample_stats.pkts_f_buf_alloc++;
         }
+        memcpy(&psample_pkt->meta, &meta, sizeof(psample_meta_t));
+        psample_pkt->group = group;
 
         /* setup skb to point to pkt */
         memcpy(skb->data, pkt, meta.trunc_size);
         skb_put(skb, meta.trunc_size);
-        skb->len = meta.trunc_size;
-        psample_pkt->skb = skb;
 
-        spin_lock_irqsave(&g_psample_work.lock, flags);
-        list_add_tail(&psample_pkt->list, &g_psample_work.pkt_list); 
-        
-        g_psample_stats.pkts_c_qlen_cur++;
-        if (g_psample_stats.pkts_c_qlen_cur > g_psample_stats.pkts_c_qlen_hi) {
-            g_psample_stats.pkts_c_qlen_hi = g_psample_stats.pkts_c_qlen_cur;
-        }
+        smp_store_release(&ring->head, head + 1);
+
+        /*
+         * Pairs with the barrier in psample_task(). Kick the worker if it
+         * has already drained everything queued before this pkt.
+         */
+        smp_mb();
+        kick = READ_ONCE(ring->tail) == head;
+        local_irq_restore(flags);
 
-        schedule_work(&g_psample_work.wq);
-        spin_unlock_irqrestore(&g_psample_work.lock, flags);
+        if (qlen + 1 > g_psample_stats.pkts_c_qlen_hi) {
+            g_psample_stats.pkts_c_qlen_hi = qlen + 1;
+        }
+        if (kick) {
+            schedule_work(&g_psample_work.wq);
+        }
     } else {
         g_psample_stats.pkts_d_sampling_disabled++;
     }    
@@ -900,7 +1060,9 @@ psample_proc_debug_show(struct seq_file *m, void *v)
     seq_printf(m, "  pkt_hdr_size:    %d\n",   g_psample_info.hw.pkt_hdr_size);
     seq_printf(m, "  cdma_channels:   %d\n",   g_psample_info.hw.cdma_channels);
     seq_printf(m, "  netif_count:     %d\n",   g_psample_info.netif_count);
-    seq_printf(m, "  queue length:    %d\n",   psample_qlen);
+    seq_printf(m, "  queue length:    %d\n",   g_psample_work.ring_size);
+    seq_printf(m, "  buffer size:     %d\n",   g_psample_work.buf_size);
+    seq_printf(m, "  batch:           %d\n",   psample_batch);
 
     return 0;
 }
@@ -966,7 +1128,7 @@ psample_proc_stats_show(struct seq_file *m, void *v)
     seq_printf(m, "  pkts handled by psample        %10lu\n", g_psample_stats.pkts_f_handled);
     seq_printf(m, "  pkts pass through              %10lu\n", g_psample_stats.pkts_f_pass_through);
     seq_printf(m, "  pkts with mc destination       %10lu\n", g_psample_stats.pkts_f_dst_mc);
-    seq_printf(m, "  pkts current queue length      %10lu\n", g_psample_stats.pkts_c_qlen_cur);
+    seq_printf(m, "  pkts current queue length      %10u\n",  psample_qlen_get());
     seq_printf(m, "  pkts high queue length         %10lu\n", g_psample_stats.pkts_c_qlen_hi);
     seq_printf(m, "  pkts drop max queue length     %10lu\n", g_psample_stats.pkts_d_qlen_max);
     seq_printf(m, "  pkts drop no memory            %10lu\n", g_psample_stats.pkts_d_no_mem);
@@ -977,6 +1139,9 @@ psample_proc_stats_show(struct seq_file *m, void *v)
     seq_printf(m, "  pkts with invalid src port     %10lu\n", g_psample_stats.pkts_d_meta_srcport);
     seq_printf(m, "  pkts with invalid dst port     %10lu\n", g_psample_stats.pkts_d_meta_dstport);
     seq_printf(m, "  pkts with invalid orig pkt sz  %10lu\n", g_psample_stats.pkts_d_invalid_size);
+    seq_printf(m, "  pkts with oversize buffer      %10lu\n", g_psample_stats.pkts_f_buf_alloc);
+    seq_printf(m, "  worker batches                 %10lu\n", g_psample_stats.pkts_f_batch);
+    seq_printf(m, "  worker high batch size         %10lu\n", g_psample_stats.pkts_c_batch_hi);
     return 0;
 }
 
@@ -996,14 +1161,7 @@ static ssize_t
 psample_proc_stats_write(struct file *file, const char *buf,
                     size_t count, loff_t *loff)
 {
-    int qlen_cur = 0;
-    unsigned long flags;
-
-    spin_lock_irqsave(&g_psample_work.lock, flags);
-    qlen_cur = g_psample_stats.pkts_c_qlen_cur;
     memset(&g_psample_stats, 0, sizeof(psample_stats_t));
-    g_psample_stats.pkts_c_qlen_cur = qlen_cur;
-    spin_unlock_irqrestore(&g_psample_work.lock, flags);
 
     return count;
 }
@@ -1018,7 +1176,10 @@ struct proc_ops psample_proc_stats_file_ops = {
 
 int psample_cleanup(void)
 {
+    /* wait for in-flight Rx callbacks */
+    synchronize_net();
     cancel_work_sync(&g_psample_work.wq);
+    psample_rings_free();
     remove_proc_entry("stats", psample_proc_root);
     remove_proc_entry("rate",  psample_proc_root);
     remove_proc_entry("size",  psample_proc_root);
@@ -1086,9 +1247,11 @@ int psample_init(void)
     spin_lock_init(&g_psample_info.lock);
 
     /* setup psample work queue */
-    spin_lock_init(&g_psample_work.lock);
-    INIT_LIST_HEAD(&g_psample_work.pkt_list);
     INIT_WORK(&g_psample_work.wq, psample_task);
+    if (psample_rings_alloc() < 0) {
+        gprintk("%s: failed to alloc psample queues\n", __func__);
+        return (-1);
+    }
 
     /* get net namespace */
     g_psample_info.netns = get_net_ns_by_pid(current->pid);
@@ -29,8 +29,16 @@
 #include <linux/dmi.h>
 #include <linux/kobject.h>
 #include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
 #include "pddf_client_defs.h"
 
+#define CREATE_TRACE_POINTS
+#include "pddf_trace.h"
+
 
 
 NEW_DEV_ATTR pddf_data={0};
@@ -200,15 +208,9 @@ EXPORT_SYMBOL(store_pddf_data);
 
 DEFINE_HASHTABLE(htable, 8);
 
-int get_hash(char *name)
+u32 get_hash(char *name)
 {
-    int i=0;
-    int hash=0;
-    for(i=0; i<strlen(name); i++)
-    {
-        hash+=name[i];
-    }
-    return hash;
+    return jhash(name, strlen(name), 0);
 }
 
 void init_device_table(void)
@@ -230,9 +232,8 @@ EXPORT_SYMBOL(add_device_table);
 void* get_device_table(char *name)
 {
     PDEVICE *dev=NULL;
-    int i=0;
     
-    hash_for_each(htable, i, dev, node) {
+    hash_for_each_possible(htable, dev, node, get_hash(name)) {
         if(strcmp(dev->name, name)==0) {
             return (void *)dev->data;
         }
@@ -245,12 +246,13 @@ EXPORT_SYMBOL(get_device_table);
 void delete_device_table(char *name)
 {
     PDEVICE *dev=NULL;
-    int i=0;
+    struct hlist_node *tmp;
     
-    hash_for_each(htable, i, dev, node) {
+    hash_for_each_possible_safe(htable, dev, tmp, node, get_hash(name)) {
         if(strcmp(dev->name, name)==0) {
             pddf_dbg(CLIENT, KERN_ERR "found entry to delete: %s  0x%p\n", dev->name, dev->data);
             hash_del(&(dev->node));
+            kfree(dev);
         }
     }
     return;
@@ -268,8 +270,321 @@ void traverse_device_table(void )
 }
 EXPORT_SYMBOL(traverse_device_table);
 
+/*
+ * I2C transaction statistics, per device (bus, addr) and per bus. The
+ * entries are created on the first transaction and live until the module
+ * exit, the counters are updated without lock.
+ */
+#define PDDF_STATS_HASH_BITS 7
+#define PDDF_STATS_HASH_SIZE (1 << PDDF_STATS_HASH_BITS)
+#define PDDF_STATS_BUCKETS 16       // latency < 16us, < 32us, ..., >= 262144us
+#define PDDF_STATS_LINE_LEN 256
+
+struct pddf_stats_entry {
+    struct hlist_node node;
+    u32 key;
+    int bus;
+    unsigned short addr;
+    int traced;                     // bus entries, transactions recorded by the adapter
+    char name[I2C_NAME_SIZE];
+    atomic64_t count;
+    atomic64_t errors;
+    atomic64_t retries;
+    atomic64_t total_ns;
+    atomic64_t max_ns;
+    atomic64_t hist[PDDF_STATS_BUCKETS];
+};
+
+static DEFINE_HASHTABLE(pddf_stats_dev_table, PDDF_STATS_HASH_BITS);
+static DEFINE_HASHTABLE(pddf_stats_bus_table, PDDF_STATS_HASH_BITS);
+static DEFINE_SPINLOCK(pddf_stats_lock);
+static int pddf_stats_enable = 1;
+
+static struct pddf_stats_entry *pddf_stats_get(struct hlist_head *table, u32 key, int bus,
+                                               unsigned short addr, const char *name)
+{
+    struct pddf_stats_entry *entry;
+    unsigned long flags;
+
+    hlist_for_each_entry_rcu(entry, &table[hash_min(key, PDDF_STATS_HASH_BITS)], node) {
+        if (entry->key == key)
+            return entry;
+    }
+
+    spin_lock_irqsave(&pddf_stats_lock, flags);
+    hlist_for_each_entry(entry, &table[hash_min(key, PDDF_STATS_HASH_BITS)], node) {
+        if (entry->key == key)
+            goto unlock;
+    }
+    entry = kzalloc(sizeof(struct pddf_stats_entry), GFP_ATOMIC);
+    if (entry) {
+        entry->key = key;
+        entry->bus = bus;
+        entry->addr = addr;
+        if (name)
+            strscpy(entry->name, name, sizeof(entry->name));
+        hlist_add_head_rcu(&entry->node, &table[hash_min(key, PDDF_STATS_HASH_BITS)]);
+    }
+unlock:
+    spin_unlock_irqrestore(&pddf_stats_lock, flags);
+    return entry;
+}
+
+/* Name the devices first seen by their adapter, which does not know the names */
+static void pddf_stats_name(struct pddf_stats_entry *entry, const char *name)
+{
+    unsigned long flags;
+
+    if (!name || !name[0] || READ_ONCE(entry->name[0]))
+        return;
+
+    spin_lock_irqsave(&pddf_stats_lock, flags);
+    if (!entry->name[0])
+        strscpy(entry->name, name, sizeof(entry->name));
+    spin_unlock_irqrestore(&pddf_stats_lock, flags);
+}
+
+static void pddf_stats_account(struct pddf_stats_entry *entry, int ret, u64 latency_ns)
+{
+    u64 us = div_u64(latency_ns, NSEC_PER_USEC);
+    u64 max;
+    int bucket = 0;
+
+    if (us >= 16)
+        bucket = min_t(int, ilog2(us) - 3, PDDF_STATS_BUCKETS - 1);
+
+    atomic64_inc(&entry->count);
+    if (ret < 0)
+        atomic64_inc(&entry->errors);
+    atomic64_add(latency_ns, &entry->total_ns);
+    atomic64_inc(&entry->hist[bucket]);
+
+    max = atomic64_read(&entry->max_ns);
+    while (latency_ns > max) {
+        u64 old = atomic64_cmpxchg(&entry->max_ns, max, latency_ns);
+        if (old == max)
+            break;
+        max = old;
+    }
+}
+
+void pddf_stats_xfer(struct i2c_adapter *adap, unsigned short addr, const char *name, int ret, u64 start_ns, unsigned int flags)
+{
+    struct pddf_stats_entry *dev, *bus;
+    u64 latency_ns = ktime_get_ns() - start_ns;
+
+    trace_pddf_i2c_xfer(adap->nr, addr, name, ret, latency_ns, flags);
+    if (!READ_ONCE(pddf_stats_enable))
+        return;
+
+    rcu_read_lock();
+    bus = pddf_stats_get(pddf_stats_bus_table, adap->nr, adap->nr, 0, adap->name);
+    dev = pddf_stats_get(pddf_stats_dev_table, (adap->nr << 16) | addr, adap->nr, addr, name);
+    if (dev)
+        pddf_stats_name(dev, name);
+    /* The adapter already counted the transactions of its bus */
+    if (bus && (!bus->traced || (flags & PDDF_STATS_ADAPTER))) {
+        pddf_stats_account(bus, ret, latency_ns);
+        if (dev)
+            pddf_stats_account(dev, ret, latency_ns);
+    }
+    rcu_read_unlock();
+}
+EXPORT_SYMBOL(pddf_stats_xfer);
+
+void pddf_stats_retry(struct i2c_adapter *adap, unsigned short addr, const char *name)
+{
+    struct pddf_stats_entry *entry;
+
+    trace_pddf_i2c_retry(adap->nr, addr, name);
+    if (!READ_ONCE(pddf_stats_enable))
+        return;
+
+    rcu_read_lock();
+    entry = pddf_stats_get(pddf_stats_bus_table, adap->nr, adap->nr, 0, adap->name);
+    if (entry)
+        atomic64_inc(&entry->retries);
+    entry = pddf_stats_get(pddf_stats_dev_table, (adap->nr << 16) | addr, adap->nr, addr, name);
+    if (entry) {
+        pddf_stats_name(entry, name);
+        atomic64_inc(&entry->retries);
+    }
+    rcu_read_unlock();
+}
+EXPORT_SYMBOL(pddf_stats_retry);
+
+void pddf_stats_adapter_traced(struct i2c_adapter *adap)
+{
+    struct pddf_stats_entry *entry;
+
+    rcu_read_lock();
+    entry = pddf_stats_get(pddf_stats_bus_table, adap->nr, adap->nr, 0, adap->name);
+    if (entry)
+        entry->traced = 1;
+    rcu_read_unlock();
+}
+EXPORT_SYMBOL(pddf_stats_adapter_traced);
+
+static int pddf_stats_format(struct pddf_stats_entry *entry, int is_dev, char *buf, size_t size)
+{
+    u64 count = atomic64_read(&entry->count);
+    int len, i;
+
+    if (is_dev)
+        len = scnprintf(buf, size, "%-4d 0x%02x %-20s", entry->bus, entry->addr, entry->name[0] ? entry->name : "-");
+    else
+        len = scnprintf(buf, size, "%-4d %-25s", entry->bus, entry->name[0] ? entry->name : "-");
+    len += scnprintf(buf + len, size - len, " %10llu %8llu %8llu %8llu %8llu",
+                     (unsigned long long)count, (unsigned long long)atomic64_read(&entry->errors),
+                     (unsigned long long)atomic64_read(&entry->retries),
+                     count ? (unsigned long long)div64_u64(atomic64_read(&entry->total_ns), count * NSEC_PER_USEC) : 0,
+                     (unsigned long long)div_u64(atomic64_read(&entry->max_ns), NSEC_PER_USEC));
+    for (i = 0; i < PDDF_STATS_BUCKETS; i++)
+        len += scnprintf(buf + len, size - len, " %llu", (unsigned long long)atomic64_read(&entry->hist[i]));
+    len += scnprintf(buf + len, size - len, "\n");
+    return len;
+}
+
+/* The tables do not fit in a page, they are read as binary files */
+static ssize_t pddf_stats_table_read(struct hlist_head *table, int is_dev, char *buf, loff_t off, size_t count)
+{
+    struct pddf_stats_entry *entry;
+    char *text;
+    size_t size, len = 0;
+    int bkt, num = 0, i;
+
+    rcu_read_lock();
+    for (bkt = 0; bkt < PDDF_STATS_HASH_SIZE; bkt++) {
+        hlist_for_each_entry_rcu(entry, &table[bkt], node)
+            num++;
+    }
+    rcu_read_unlock();
+
+    size = (num + 2) * PDDF_STATS_LINE_LEN;
+    text = kvzalloc(size, GFP_KERNEL);
+    if (!text)
+        return -ENOMEM;
+
+    len = scnprintf(text, size, is_dev ? "#bus addr name                 " : "#bus name                     ");
+    len += scnprintf(text + len, size - len, "      count   errors  retries   avg_us   max_us");
+    for (i = 0; i < PDDF_STATS_BUCKETS - 1; i++)
+        len += scnprintf(text + len, size - len, " <%luus", 16UL << i);
+    len += scnprintf(text + len, size - len, " more\n");
+
+    rcu_read_lock();
+    for (bkt = 0; bkt < PDDF_STATS_HASH_SIZE; bkt++) {
+        hlist_for_each_entry_rcu(entry, &table[bkt], node) {
+            if (size - len < PDDF_STATS_LINE_LEN)
+                break;
+            len += pddf_stats_format(entry, is_dev, text + len, size - len);
+        }
+    }
+    rcu_read_unlock();
+
+    if (off >= len) {
+        count = 0;
+    } else {
+        count = min_t(size_t, count, len - off);
+        memcpy(buf, text + off, count);
+    }
+    kvfree(text);
+    return count;
+}
+
+static ssize_t devices_read(struct file *filp, struct kobject *kobj, struct bin_attribute *attr,
+                            char *buf, loff_t off, size_t count)
+{
+    return pddf_stats_table_read(pddf_stats_dev_table, 1, buf, off, count);
+}
+
+static ssize_t buses_read(struct file *filp, struct kobject *kobj, struct bin_attribute *attr,
+                          char *buf, loff_t off, size_t count)
+{
+    return pddf_stats_table_read(pddf_stats_bus_table, 0, buf, off, count);
+}
+
+static void pddf_stats_clear_table(struct hlist_head *table)
+{
+    struct pddf_stats_entry *entry;
+    int bkt, i;
+
+    rcu_read_lock();
+    for (bkt = 0; bkt < PDDF_STATS_HASH_SIZE; bkt++) {
+        hlist_for_each_entry_rcu(entry, &table[bkt], node) {
+            atomic64_set(&entry->count, 0);
+            atomic64_set(&entry->errors, 0);
+            atomic64_set(&entry->retries, 0);
+            atomic64_set(&entry->total_ns, 0);
+            atomic64_set(&entry->max_ns, 0);
+            for (i = 0; i < PDDF_STATS_BUCKETS; i++)
+                atomic64_set(&entry->hist[i], 0);
+        }
+    }
+    rcu_read_unlock();
+}
+
+static ssize_t clear_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count)
+{
+    pddf_stats_clear_table(pddf_stats_dev_table);
+    pddf_stats_clear_table(pddf_stats_bus_table);
+    return count;
+}
+
+static ssize_t enable_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%d\n", READ_ONCE(pddf_stats_enable));
+}
+
+static ssize_t enable_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count)
+{
+    int val, ret;
+
+    ret = kstrtoint(buf, 10, &val);
+    if (ret)
+        return ret;
+    WRITE_ONCE(pddf_stats_enable, !!val);
+    return count;
+}
+
+static struct kobj_attribute pddf_stats_clear_attr = __ATTR_WO(clear);
+static struct kobj_attribute pddf_stats_enable_attr = __ATTR_RW(enable);
+static BIN_ATTR_RO(devices, 0);
+static BIN_ATTR_RO(buses, 0);
+
+static struct attribute *pddf_stats_attributes[] = {
+    &pddf_stats_clear_attr.attr,
+    &pddf_stats_enable_attr.attr,
+    NULL
+};
+
+static struct bin_attribute *pddf_stats_bin_attributes[] = {
+    &bin_attr_devices,
+    &bin_attr_buses,
+    NULL
+};
+
+static struct attribute_group pddf_stats_group = {
+    .attrs = pddf_stats_attributes,
+    .bin_attrs = pddf_stats_bin_attributes,
+};
+
+static void pddf_stats_free_table(struct hlist_head *table)
+{
+    struct pddf_stats_entry *entry;
+    struct hlist_node *tmp;
+    int bkt;
+
+    for (bkt = 0; bkt < PDDF_STATS_HASH_SIZE; bkt++) {
+        hlist_for_each_entry_safe(entry, tmp, &table[bkt], node) {
+            hlist_del(&entry->node);
+            kfree(entry);
+        }
+    }
+}
+
 struct kobject *device_kobj;
 static struct kobject *pddf_kobj;
+static struct kobject *stats_kobj;
 
 struct kobject *get_device_i2c_kobj(void)
 {
@@ -304,6 +619,10 @@ int __init pddf_data_init(void)
     }
     pddf_dbg(CLIENT, "CREATED PDDF ALLCLIENTS CREATION SYSFS GROUP\n");
 
+    stats_kobj = kobject_create_and_add("stats", pddf_kobj);
+    if (!stats_kobj || sysfs_create_group(stats_kobj, &pddf_stats_group))
+        printk(KERN_ERR "%s: Unable to create the I2C statistics\n", __FUNCTION__);
+
 
 
     return ret;
@@ -314,6 +633,12 @@ void __exit pddf_data_exit(void)
 
     pddf_dbg(CLIENT, "PDDF_DATA MODULE.. exit\n");
     sysfs_remove_group(device_kobj, &pddf_allclients_data_group);
+    if (stats_kobj) {
+        sysfs_remove_group(stats_kobj, &pddf_stats_group);
+        kobject_put(stats_kobj);
+    }
+    pddf_stats_free_table(pddf_stats_dev_table);
+    pddf_stats_free_table(pddf_stats_bus_table);
 
     kobject_put(device_kobj);
     kobject_put(pddf_kobj);
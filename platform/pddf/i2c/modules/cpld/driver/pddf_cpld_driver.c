@@ -19,117 +19,298 @@
 #include <linux/i2c.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/rwsem.h>
 #include <linux/dmi.h>
+#include <linux/ktime.h>
+#include <linux/seqlock.h>
+#include "pddf_client_defs.h"
 #include "pddf_cpld_defs.h"
 
 extern PDDF_CPLD_DATA pddf_cpld_data;
 
 
-static LIST_HEAD(cpld_client_list);
-static struct mutex	 list_lock;
+/*
+ * CPLD clients are hashed by (name, addr), and by addr for the accessors
+ * without a name. The table lock only guards the lookup, the accesses are
+ * serialized per CPLD. Any change of the table bumps its generation, which
+ * drops the client nodes cached in the callers' handles.
+ */
+#define CPLD_CLIENT_HASH_BITS 6
+
+static DEFINE_HASHTABLE(cpld_name_table, CPLD_CLIENT_HASH_BITS);
+static DEFINE_HASHTABLE(cpld_addr_table, CPLD_CLIENT_HASH_BITS);
+static DECLARE_RWSEM(cpld_table_lock);
+static unsigned int cpld_table_gen = 1;
 
 struct cpld_client_node {
 	struct i2c_client *client;
 	char name[CPLD_CLIENT_NAME_LEN];
-	struct list_head   list;
+	struct mutex lock;
+	struct hlist_node name_node;
+	struct hlist_node addr_node;
 };
 
-int board_i2c_cpld_read_new(unsigned short cpld_addr, char *name, u8 reg)
+static u32 cpld_name_hash(const char *name, unsigned short cpld_addr)
 {
-	struct list_head   *list_node = NULL;
-	struct cpld_client_node *cpld_node = NULL;
-	int ret = -EPERM;
-
-	mutex_lock(&list_lock);
+	return jhash(name, strlen(name), cpld_addr);
+}
 
-	list_for_each(list_node, &cpld_client_list)
-	{
-		cpld_node = list_entry(list_node, struct cpld_client_node, list);
+/* Called with cpld_table_lock held */
+static struct cpld_client_node *cpld_node_find(unsigned short cpld_addr, const char *name)
+{
+	struct cpld_client_node *node;
 
-		if ((cpld_node->client->addr == cpld_addr) && (strncmp(cpld_node->name, name, strlen(name)) == 0)) {
-			ret = i2c_smbus_read_byte_data(cpld_node->client, reg);
-			break;
+	if (name == NULL) {
+		hash_for_each_possible(cpld_addr_table, node, addr_node, cpld_addr) {
+			if (node->client->addr == cpld_addr)
+				return node;
 		}
+		return NULL;
 	}
 
-	mutex_unlock(&list_lock);
+	hash_for_each_possible(cpld_name_table, node, name_node, cpld_name_hash(name, cpld_addr)) {
+		if ((node->client->addr == cpld_addr) && (strcmp(node->name, name) == 0))
+			return node;
+	}
+	return NULL;
+}
+
+/* Called with cpld_table_lock held, the node stays valid until it is released */
+static struct cpld_client_node *cpld_node_get(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, const char *name)
+{
+	struct cpld_client_node *node;
+
+	if (handle && (READ_ONCE(handle->gen) == cpld_table_gen)) {
+		smp_rmb();
+		return READ_ONCE(handle->node);
+	}
+
+	node = cpld_node_find(cpld_addr, name);
+	if (handle && node) {
+		WRITE_ONCE(handle->node, node);
+		smp_wmb();
+		WRITE_ONCE(handle->gen, cpld_table_gen);
+	}
+	return node;
+}
+
+static int cpld_client_read(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, const char *name, u8 reg)
+{
+	struct cpld_client_node *node;
+	int ret = -EPERM;
+
+	down_read(&cpld_table_lock);
+	node = cpld_node_get(handle, cpld_addr, name);
+	if (node) {
+		u64 start_ns;
+
+		mutex_lock(&node->lock);
+		start_ns = ktime_get_ns();
+		ret = i2c_smbus_read_byte_data(node->client, reg);
+		pddf_stats_xfer(node->client->adapter, node->client->addr, node->name, ret, start_ns, 0);
+		mutex_unlock(&node->lock);
+	}
+	up_read(&cpld_table_lock);
 
 	return ret;
 }
-EXPORT_SYMBOL(board_i2c_cpld_read_new);
 
-int board_i2c_cpld_write_new(unsigned short cpld_addr, char *name, u8 reg, u8 value)
+static int cpld_client_write(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, const char *name, u8 reg, u8 value)
 {
-	struct list_head   *list_node = NULL;
-	struct cpld_client_node *cpld_node = NULL;
+	struct cpld_client_node *node;
 	int ret = -EIO;
 
-	mutex_lock(&list_lock);
-
-	list_for_each(list_node, &cpld_client_list)
-	{
-		cpld_node = list_entry(list_node, struct cpld_client_node, list);
+	down_read(&cpld_table_lock);
+	node = cpld_node_get(handle, cpld_addr, name);
+	if (node) {
+		u64 start_ns;
 
-		if ((cpld_node->client->addr == cpld_addr) && (strncmp(cpld_node->name, name, strlen(name)) == 0)){
-			ret = i2c_smbus_write_byte_data(cpld_node->client, reg, value);
-			break;
-		}
+		mutex_lock(&node->lock);
+		start_ns = ktime_get_ns();
+		ret = i2c_smbus_write_byte_data(node->client, reg, value);
+		pddf_stats_xfer(node->client->adapter, node->client->addr, node->name, ret, start_ns, 0);
+		mutex_unlock(&node->lock);
 	}
-
-	mutex_unlock(&list_lock);
+	up_read(&cpld_table_lock);
 
 	return ret;
 }
-EXPORT_SYMBOL(board_i2c_cpld_write_new);
 
-int board_i2c_cpld_read(unsigned short cpld_addr, u8 reg)
+int board_i2c_cpld_handle_init(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name)
 {
-	struct list_head   *list_node = NULL;
-	struct cpld_client_node *cpld_node = NULL;
-	int ret = -EPERM;
-	
-	//hw_preaccess_func_cpld_mux_default((uint32_t)cpld_addr, NULL);
+	struct cpld_client_node *node;
 
-	mutex_lock(&list_lock);
+	handle->node = NULL;
+	handle->gen = 0;
 
-	list_for_each(list_node, &cpld_client_list)
-	{
-		cpld_node = list_entry(list_node, struct cpld_client_node, list);
-		
-		if (cpld_node->client->addr == cpld_addr) {
-			ret = i2c_smbus_read_byte_data(cpld_node->client, reg);
-			break;
+	down_read(&cpld_table_lock);
+	node = cpld_node_get(handle, cpld_addr, name);
+	up_read(&cpld_table_lock);
+
+	return node ? 0 : -ENODEV;
+}
+EXPORT_SYMBOL(board_i2c_cpld_handle_init);
+
+int board_i2c_cpld_read_cached(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name, u8 reg)
+{
+	return cpld_client_read(handle, cpld_addr, name, reg);
+}
+EXPORT_SYMBOL(board_i2c_cpld_read_cached);
+
+int board_i2c_cpld_write_cached(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name, u8 reg, u8 value)
+{
+	return cpld_client_write(handle, cpld_addr, name, reg, value);
+}
+EXPORT_SYMBOL(board_i2c_cpld_write_cached);
+
+/*
+ * Register windows let the periodic samplers read the registers of a CPLD
+ * with a few block transfers instead of one transfer per attribute. Only
+ * adjacent registers are merged, so no register the caller did not ask for
+ * is read (some CPLD registers are clear-on-read).
+ */
+int board_i2c_cpld_window_add(PDDF_CPLD_WINDOW *win, int *num, int max, unsigned short cpld_addr, u8 reg)
+{
+	int i;
+
+	for (i = 0; i < *num; i++) {
+		if (win[i].addr != cpld_addr)
+			continue;
+		if ((reg >= win[i].start) && (reg < win[i].start + win[i].len))
+			return i;
+		if (win[i].len >= CPLD_WINDOW_MAX_LEN)
+			continue;
+		if (reg == win[i].start + win[i].len) {
+			win[i].len++;
+			return i;
+		}
+		if (reg + 1 == win[i].start) {
+			win[i].start = reg;
+			win[i].len++;
+			return i;
 		}
 	}
-	
-	mutex_unlock(&list_lock);
+	if (*num >= max)
+		return -ENOSPC;
+
+	memset(&win[*num], 0, sizeof(PDDF_CPLD_WINDOW));
+	win[*num].addr = cpld_addr;
+	win[*num].start = reg;
+	win[*num].len = 1;
+	seqcount_init(&win[*num].seq);
+	return (*num)++;
+}
+EXPORT_SYMBOL(board_i2c_cpld_window_add);
 
-	return ret;
+static void cpld_window_publish(PDDF_CPLD_WINDOW *win, const u8 *buf, int valid)
+{
+	preempt_disable();
+	write_seqcount_begin(&win->seq);
+	if (valid)
+		memcpy(win->buf, buf, win->len);
+	win->valid = valid;
+	write_seqcount_end(&win->seq);
+	preempt_enable();
 }
-EXPORT_SYMBOL(board_i2c_cpld_read);
 
-int board_i2c_cpld_write(unsigned short cpld_addr, u8 reg, u8 value)
+int board_i2c_cpld_window_fill(PDDF_CPLD_WINDOW *win)
 {
-	struct list_head   *list_node = NULL;
-	struct cpld_client_node *cpld_node = NULL;
-	int ret = -EIO;
-	
+	struct cpld_client_node *node;
+	u8 buf[CPLD_WINDOW_MAX_LEN];
+	int ret = -EPERM;
 
-	mutex_lock(&list_lock);
+	down_read(&cpld_table_lock);
+	node = cpld_node_get(&win->cpld, win->addr, NULL);
+	if (node) {
+		u64 start_ns;
+
+		mutex_lock(&node->lock);
+		start_ns = ktime_get_ns();
+		if (win->len == 1)
+			ret = i2c_smbus_read_byte_data(node->client, win->start);
+		else if (i2c_check_functionality(node->client->adapter, I2C_FUNC_SMBUS_READ_I2C_BLOCK))
+			ret = i2c_smbus_read_i2c_block_data(node->client, win->start, win->len, buf);
+		else
+			ret = -EOPNOTSUPP;
+		if (ret != -EOPNOTSUPP)
+			pddf_stats_xfer(node->client->adapter, node->client->addr, node->name, ret, start_ns, 0);
+		mutex_unlock(&node->lock);
+	}
+	up_read(&cpld_table_lock);
 
-	list_for_each(list_node, &cpld_client_list)
-	{
-		cpld_node = list_entry(list_node, struct cpld_client_node, list);
-		
-		if (cpld_node->client->addr == cpld_addr) {
-			ret = i2c_smbus_write_byte_data(cpld_node->client, reg, value);
-			break;
-		}
+	if ((ret >= 0) && (win->len == 1)) {
+		buf[0] = ret;
+		ret = 1;
 	}
-	
-	mutex_unlock(&list_lock);
+	if ((ret >= 0) && (ret != win->len))
+		ret = -EIO;
+	cpld_window_publish(win, buf, ret >= 0);
+	return (ret < 0) ? ret : 0;
+}
+EXPORT_SYMBOL(board_i2c_cpld_window_fill);
 
-	return ret;
+/* Drop the registers of the last fill */
+void board_i2c_cpld_window_invalidate(PDDF_CPLD_WINDOW *win)
+{
+	cpld_window_publish(win, NULL, 0);
+}
+EXPORT_SYMBOL(board_i2c_cpld_window_invalidate);
+
+/* Register value from the last fill, -ENODATA if the window does not have it */
+int board_i2c_cpld_window_read(PDDF_CPLD_WINDOW *win, unsigned short cpld_addr, u8 reg)
+{
+	unsigned int seq;
+	int val;
+
+	if (!win || (win->addr != cpld_addr) ||
+		(reg < win->start) || (reg >= win->start + win->len))
+		return -ENODATA;
+	do {
+		seq = read_seqcount_begin(&win->seq);
+		val = win->valid ? win->buf[reg - win->start] : -ENODATA;
+	} while (read_seqcount_retry(&win->seq, seq));
+	return val;
+}
+EXPORT_SYMBOL(board_i2c_cpld_window_read);
+
+/* Account a retry of the caller on the CPLD, see pddf_stats_retry() */
+void board_i2c_cpld_retry(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name)
+{
+	struct cpld_client_node *node;
+
+	down_read(&cpld_table_lock);
+	node = cpld_node_get(handle, cpld_addr, name);
+	if (node)
+		pddf_stats_retry(node->client->adapter, node->client->addr, node->name);
+	up_read(&cpld_table_lock);
+}
+EXPORT_SYMBOL(board_i2c_cpld_retry);
+
+int board_i2c_cpld_read_new(unsigned short cpld_addr, char *name, u8 reg)
+{
+	return cpld_client_read(NULL, cpld_addr, name, reg);
+}
+EXPORT_SYMBOL(board_i2c_cpld_read_new);
+
+int board_i2c_cpld_write_new(unsigned short cpld_addr, char *name, u8 reg, u8 value)
+{
+	return cpld_client_write(NULL, cpld_addr, name, reg, value);
+}
+EXPORT_SYMBOL(board_i2c_cpld_write_new);
+
+int board_i2c_cpld_read(unsigned short cpld_addr, u8 reg)
+{
+	//hw_preaccess_func_cpld_mux_default((uint32_t)cpld_addr, NULL);
+
+	return cpld_client_read(NULL, cpld_addr, NULL, reg);
+}
+EXPORT_SYMBOL(board_i2c_cpld_read);
+
+int board_i2c_cpld_write(unsigned short cpld_addr, u8 reg, u8 value)
+{
+	return cpld_client_write(NULL, cpld_addr, NULL, reg, value);
 }
 EXPORT_SYMBOL(board_i2c_cpld_write);
 
@@ -177,26 +358,26 @@ static void board_i2c_cpld_add_client(struct i2c_client *client)
 	}
 	
 	node->client = client;
-	strcpy(node->name, (char *)client->dev.platform_data);
-	dev_dbg(&client->dev, "Adding %s to the cpld client list\n", node->name);
-
-	mutex_lock(&list_lock);
-	list_add(&node->list, &cpld_client_list);
-	mutex_unlock(&list_lock);
+	strscpy(node->name, (char *)client->dev.platform_data, CPLD_CLIENT_NAME_LEN);
+	mutex_init(&node->lock);
+	dev_dbg(&client->dev, "Adding %s to the cpld client table\n", node->name);
+
+	down_write(&cpld_table_lock);
+	hash_add(cpld_name_table, &node->name_node, cpld_name_hash(node->name, client->addr));
+	hash_add(cpld_addr_table, &node->addr_node, client->addr);
+	cpld_table_gen++;
+	up_write(&cpld_table_lock);
 }
 
 static void board_i2c_cpld_remove_client(struct i2c_client *client)
 {
-	struct list_head		*list_node = NULL;
 	struct cpld_client_node *cpld_node = NULL;
 	int found = 0;
 	
-	mutex_lock(&list_lock);
+	down_write(&cpld_table_lock);
 
-	list_for_each(list_node, &cpld_client_list)
+	hash_for_each_possible(cpld_addr_table, cpld_node, addr_node, client->addr)
 	{
-		cpld_node = list_entry(list_node, struct cpld_client_node, list);
-		
 		if (cpld_node->client == client) {
 			found = 1;
 			break;
@@ -204,11 +385,15 @@ static void board_i2c_cpld_remove_client(struct i2c_client *client)
 	}
 	
 	if (found) {
-		list_del(list_node);
-		kfree(cpld_node);
+		hash_del(&cpld_node->name_node);
+		hash_del(&cpld_node->addr_node);
+		cpld_table_gen++;
 	}
 	
-	mutex_unlock(&list_lock);
+	up_write(&cpld_table_lock);
+
+	if (found)
+		kfree(cpld_node);
 }
 
 static int board_i2c_cpld_probe(struct i2c_client *client,
@@ -269,7 +454,6 @@ static struct i2c_driver board_i2c_cpld_driver = {
 
 static int __init board_i2c_cpld_init(void)
 {
-	mutex_init(&list_lock);
 	return i2c_add_driver(&board_i2c_cpld_driver);
 }
 
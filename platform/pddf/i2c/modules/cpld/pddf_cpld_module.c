@@ -29,6 +29,7 @@
 #include <linux/delay.h>
 #include <linux/dmi.h>
 #include <linux/kobject.h>
+#include <linux/gpio.h>
 #include "pddf_client_defs.h"
 #include "pddf_cpld_defs.h"
 
@@ -42,16 +43,26 @@ static ssize_t show_pddf_cpld_data(struct device *dev, struct device_attribute *
 extern void *get_device_table(char *name);
 extern void delete_device_table(char *name);
 
+/* GPIOs claimed for the interrupt output of the CPLD clients */
+#define CPLD_INTR_GPIO_MAX 8
+static struct
+{
+	struct i2c_client *client;
+	int gpio;
+} cpld_intr_gpios[CPLD_INTR_GPIO_MAX];
+
 
 /* MUX CLIENT DATA */
 PDDF_DATA_ATTR(dev_ops, S_IWUSR, NULL, do_device_operation, PDDF_CHAR, 8, NULL, (void*)&pddf_data);
 PDDF_DATA_ATTR(reg_addr, S_IWUSR|S_IRUGO, show_pddf_cpld_data, store_pddf_cpld_data, PDDF_USHORT, sizeof(unsigned short), (void*)&pddf_cpld_data.reg_addr, NULL);
+PDDF_DATA_ATTR(intr_gpio, S_IWUSR|S_IRUGO, show_pddf_data, store_pddf_data, PDDF_INT_DEC, sizeof(int), (void*)&pddf_cpld_data.intr_gpio, NULL);
 
 
 
 static struct attribute *cpld_attributes[] = {
 	&attr_dev_ops.dev_attr.attr,
 	&attr_reg_addr.dev_attr.attr,
+	&attr_intr_gpio.dev_attr.attr,
 	NULL
 };
 
@@ -91,6 +102,51 @@ static ssize_t show_pddf_cpld_data(struct device *dev, struct device_attribute *
     return ret;
 }
 
+/* Returns the slot of client, or a free slot if client is NULL, -1 if none */
+static int cpld_intr_gpio_slot(struct i2c_client *client)
+{
+	int i;
+
+	for (i = 0; i < CPLD_INTR_GPIO_MAX; i++)
+	{
+		if (cpld_intr_gpios[i].client == client)
+			return i;
+	}
+	return -1;
+}
+
+/* Claim the gpio as an input, returns its irq */
+static int cpld_intr_gpio_request(int gpio)
+{
+	int ret;
+
+	if (cpld_intr_gpio_slot(NULL) < 0)
+		return -ENOSPC;
+
+	ret = gpio_request(gpio, "pddf_cpld_intr");
+	if (ret)
+		return ret;
+	ret = gpio_direction_input(gpio);
+	if (ret == 0)
+		ret = gpio_to_irq(gpio);
+	if (ret <= 0)
+	{
+		gpio_free(gpio);
+		return ret ? ret : -ENXIO;
+	}
+	return ret;
+}
+
+static void cpld_intr_gpio_free(struct i2c_client *client)
+{
+	int i = cpld_intr_gpio_slot(client);
+
+	if (i < 0)
+		return;
+	gpio_free(cpld_intr_gpios[i].gpio);
+	cpld_intr_gpios[i].client = NULL;
+}
+
 static ssize_t do_device_operation(struct device *dev, struct device_attribute *da, const char *buf, size_t count)
 {
 	PDDF_ATTR *ptr = (PDDF_ATTR *)da;
@@ -99,6 +155,7 @@ static ssize_t do_device_operation(struct device *dev, struct device_attribute *
 	static struct i2c_board_info board_info;
 	struct i2c_client *client_ptr;
 	char *pddf_cpld_name = NULL;
+	int gpio = -1, irq, slot;
 
 	if (strncmp(buf, "add", strlen(buf)-1)==0)
 	{
@@ -116,15 +173,37 @@ static ssize_t do_device_operation(struct device *dev, struct device_attribute *
 			board_info.addr = device_ptr->dev_addr;
 			strcpy(board_info.type, device_ptr->dev_type);
 
+			/* Interrupt output of the CPLD, picked up by the xcvr driver */
+			if (pddf_cpld_data.intr_gpio >= 0)
+			{
+				irq = cpld_intr_gpio_request(pddf_cpld_data.intr_gpio);
+				if (irq > 0)
+				{
+					gpio = pddf_cpld_data.intr_gpio;
+					board_info.irq = irq;
+				}
+				else
+					printk(KERN_ERR "%s: No irq for %s gpio %d, %d\n", __FUNCTION__, device_ptr->i2c_name, pddf_cpld_data.intr_gpio, irq);
+				pddf_cpld_data.intr_gpio = -1;
+			}
+
 			client_ptr = i2c_new_client_device(adapter, &board_info);
 
 			if (!IS_ERR(client_ptr)) {
 				i2c_put_adapter(adapter);
 				pddf_dbg(CPLD, KERN_ERR "Created %s client: 0x%p\n", device_ptr->i2c_name, (void *)client_ptr);
 				add_device_table(device_ptr->i2c_name, (void*)client_ptr);
+				if (gpio >= 0)
+				{
+					slot = cpld_intr_gpio_slot(NULL);
+					cpld_intr_gpios[slot].client = client_ptr;
+					cpld_intr_gpios[slot].gpio = gpio;
+				}
 			}
 			else {
 				i2c_put_adapter(adapter);
+				if (gpio >= 0)
+					gpio_free(gpio);
 				goto free_data;
 			}
 
@@ -142,6 +221,7 @@ static ssize_t do_device_operation(struct device *dev, struct device_attribute *
 		{
 			pddf_dbg(CPLD, KERN_ERR "Removing %s client: 0x%p\n", device_ptr->i2c_name, (void *)client_ptr);
 			i2c_unregister_device(client_ptr);
+			cpld_intr_gpio_free(client_ptr);
 			delete_device_table(device_ptr->i2c_name);
 		}
 		else
@@ -194,6 +274,7 @@ int __init cpld_data_init(void)
     pddf_dbg(CPLD, "CREATED PDDF I2C CLIENTS CREATION SYSFS GROUP\n");
 
     mutex_init(&pddf_cpld_data.cpld_lock);
+    pddf_cpld_data.intr_gpio = -1;
 
     ret = sysfs_create_group(cpld_kobj, &pddf_cpld_client_data_group);
     if (ret)
@@ -28,6 +28,9 @@
 #include <linux/sysfs.h>
 #include <linux/slab.h>
 #include <linux/dmi.h>
+#include <linux/ktime.h>
+#include <linux/bitmap.h>
+#include "pddf_client_defs.h"
 #include "pddf_fan_defs.h"
 #include "pddf_fan_driver.h"
 
@@ -40,6 +43,9 @@
 
 extern void *get_device_table(char *name);
 
+ssize_t fan_show_default(struct device *dev, struct device_attribute *da, char *buf);
+int fan_sample_period_set(struct i2c_client *client, unsigned int period_ms);
+
 uint32_t pddf_fan_dc_to_pwm_default(uint32_t dc)
 {
     return ((dc*100)/625 - 1);
@@ -162,11 +168,43 @@ int fan_update_hw(struct device *dev, struct fan_attr_info *info, FAN_DATA_ATTR
     return 0;
 }
 
+/* Run the get functions of an attribute, the value goes to info->val */
+static int fan_attr_get(struct i2c_client *client, FAN_DATA_ATTR *udata, struct fan_attr_info *info)
+{
+	int status = 0, ret = 0;
+	FAN_SYSFS_ATTR_DATA *sysfs_attr_data = udata->access_data;
+
+	if (sysfs_attr_data->pre_get != NULL)
+	{
+		status = (sysfs_attr_data->pre_get)(client, udata, info);
+		if (status!=0)
+			dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
+	}
+	if (sysfs_attr_data->do_get != NULL)
+	{
+		u64 start_ns = ktime_get_ns();
+
+		ret = status = (sysfs_attr_data->do_get)(client, udata, info);
+		/* The CPLD and FPGA accessors account their own transactions */
+		if ((strcmp(udata->devtype, "cpld") != 0) && (strcmp(udata->devtype, "fpgai2c") != 0))
+			pddf_stats_xfer(client->adapter, client->addr, client->name, status, start_ns, 0);
+		if (status!=0)
+			dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
+
+	}
+	if (sysfs_attr_data->post_get != NULL)
+	{
+		status = (sysfs_attr_data->post_get)(client, udata, info);
+		if (status!=0)
+			dev_warn(&client->dev, "%s: post_get function fails for %s attribute.ret %d\n", __FUNCTION__, udata->aname, status);
+	}
+
+	return ret;
+}
+
 int fan_update_attr(struct device *dev, struct fan_attr_info *info, FAN_DATA_ATTR *udata)
 {
-	int status = 0;
     struct i2c_client *client = to_i2c_client(dev);
-	FAN_SYSFS_ATTR_DATA *sysfs_attr_data = NULL;
 
 
     mutex_lock(&info->update_lock);
@@ -176,28 +214,8 @@ int fan_update_attr(struct device *dev, struct fan_attr_info *info, FAN_DATA_ATT
         dev_dbg(&client->dev, "Starting pddf_fan update\n");
         info->valid = 0;
 
-		sysfs_attr_data = udata->access_data;
-		if (sysfs_attr_data->pre_get != NULL)
-		{
-			status = (sysfs_attr_data->pre_get)(client, udata, info);
-			if (status!=0)
-				dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
-		}
-		if (sysfs_attr_data->do_get != NULL)
-		{
-			status = (sysfs_attr_data->do_get)(client, udata, info);
-			if (status!=0)
-				dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
-
-		}
-		if (sysfs_attr_data->post_get != NULL)
-		{
-			status = (sysfs_attr_data->post_get)(client, udata, info);
-			if (status!=0)
-				dev_warn(&client->dev, "%s: post_get function fails for %s attribute.ret %d\n", __FUNCTION__, udata->aname, status);
-		}
+		fan_attr_get(client, udata, info);
 
-		
         info->last_updated = jiffies;
         info->valid = 1;
     }
@@ -207,6 +225,189 @@ int fan_update_attr(struct device *dev, struct fan_attr_info *info, FAN_DATA_ATT
     return 0;
 }
 
+/* Attributes read by the sweeps, the strings and derived ones are read on demand */
+static int fan_attr_sampled(FAN_DATA_ATTR *udata)
+{
+	FAN_SYSFS_ATTR_DATA *ptr = (FAN_SYSFS_ATTR_DATA *)udata->access_data;
+
+	return (ptr != NULL) && (ptr->show == fan_show_default) && (ptr->do_get != NULL);
+}
+
+/* Lockless read of an attribute from the last sweep */
+static int fan_sample_read(struct fan_sampler *sampler, int idx, union fan_attr_val *val)
+{
+	struct fan_sample_snapshot *snap;
+	unsigned int seq;
+	int valid;
+
+	if (!READ_ONCE(sampler->period_ms))
+		return -ENODATA;
+
+	do {
+		snap = &sampler->snap[smp_load_acquire(&sampler->cur)];
+		seq = read_seqcount_begin(&snap->seq);
+		valid = test_bit(idx, snap->valid);
+		*val = snap->val[idx];
+	} while (read_seqcount_retry(&snap->seq, seq));
+
+	return valid ? 0 : -ENODATA;
+}
+
+static void fan_sample_sweep(struct i2c_client *client)
+{
+	struct fan_data *data = i2c_get_clientdata(client);
+	FAN_PDATA *pdata = (FAN_PDATA *)(client->dev.platform_data);
+	struct fan_sampler *sampler = &data->sampler;
+	struct fan_sample_snapshot *snap;
+	struct fan_attr_info scratch;
+	int i, back;
+
+	mutex_lock(&sampler->lock);
+
+	for (i = 0; i < sampler->num_window; i++)
+		board_i2c_cpld_window_fill(&sampler->window[i]);
+
+	back = !sampler->cur;
+	snap = &sampler->snap[back];
+	write_seqcount_begin(&snap->seq);
+	bitmap_zero(snap->valid, MAX_FAN_ATTRS);
+	for (i = 0; i < data->num_attr; i++)
+	{
+		if (!fan_attr_sampled(&pdata->fan_attrs[i]))
+			continue;
+		memset(&scratch.val, 0, sizeof(scratch.val));
+		if (fan_attr_get(client, &pdata->fan_attrs[i], &scratch) == 0)
+		{
+			snap->val[i] = scratch.val;
+			set_bit(i, snap->valid);
+		}
+	}
+	snap->timestamp = ktime_get_ns();
+	write_seqcount_end(&snap->seq);
+	smp_store_release(&sampler->cur, back);
+	sampler->sweeps++;
+
+	/* The windows only serve this sweep */
+	for (i = 0; i < sampler->num_window; i++)
+		board_i2c_cpld_window_invalidate(&sampler->window[i]);
+
+	mutex_unlock(&sampler->lock);
+}
+
+static void fan_sample_work(struct work_struct *work)
+{
+	struct fan_sampler *sampler = container_of(to_delayed_work(work), struct fan_sampler, work);
+	unsigned int period_ms;
+
+	fan_sample_sweep(sampler->client);
+
+	period_ms = READ_ONCE(sampler->period_ms);
+	if (period_ms)
+		schedule_delayed_work(&sampler->work, msecs_to_jiffies(period_ms));
+}
+
+/* Drop the served values after a write, and sample again */
+static void fan_sample_invalidate(struct fan_data *data)
+{
+	struct fan_sampler *sampler = &data->sampler;
+	struct fan_sample_snapshot *snap;
+
+	if (!READ_ONCE(sampler->period_ms))
+		return;
+
+	mutex_lock(&sampler->lock);
+	snap = &sampler->snap[sampler->cur];
+	write_seqcount_begin(&snap->seq);
+	bitmap_zero(snap->valid, MAX_FAN_ATTRS);
+	write_seqcount_end(&snap->seq);
+	mutex_unlock(&sampler->lock);
+
+	mod_delayed_work(system_wq, &sampler->work, 0);
+}
+
+void fan_sample_init(struct i2c_client *client, unsigned int period_ms)
+{
+	struct fan_data *data = i2c_get_clientdata(client);
+	FAN_PDATA *pdata = (FAN_PDATA *)(client->dev.platform_data);
+	struct fan_sampler *sampler = &data->sampler;
+	FAN_DATA_ATTR *udata;
+	int i, w;
+
+	sampler->client = client;
+	mutex_init(&sampler->lock);
+	seqcount_mutex_init(&sampler->snap[0].seq, &sampler->lock);
+	seqcount_mutex_init(&sampler->snap[1].seq, &sampler->lock);
+	INIT_DELAYED_WORK(&sampler->work, fan_sample_work);
+
+	/* Group the single byte CPLD registers into block reads */
+	for (i = 0; i < data->num_attr; i++)
+	{
+		udata = &pdata->fan_attrs[i];
+		udata->window = NULL;
+		if (!fan_attr_sampled(udata) || (strcmp(udata->devtype, "cpld") != 0) || (udata->len != 1))
+			continue;
+		w = board_i2c_cpld_window_add(sampler->window, &sampler->num_window, FAN_SAMPLE_WINDOWS,
+				udata->devaddr, udata->offset);
+		if (w >= 0)
+			udata->window = &sampler->window[w];
+	}
+
+	fan_sample_period_set(client, period_ms);
+}
+EXPORT_SYMBOL(fan_sample_init);
+
+int fan_sample_period_set(struct i2c_client *client, unsigned int period_ms)
+{
+	struct fan_data *data = i2c_get_clientdata(client);
+	struct fan_sampler *sampler = &data->sampler;
+
+	WRITE_ONCE(sampler->period_ms, period_ms);
+	if (period_ms)
+		mod_delayed_work(system_wq, &sampler->work, 0);
+	else
+		cancel_delayed_work_sync(&sampler->work);
+
+	return 0;
+}
+EXPORT_SYMBOL(fan_sample_period_set);
+
+/* Time of the last sweep in ktime_get_ns() (CLOCK_MONOTONIC) ns, 0 if none */
+u64 fan_sample_timestamp(struct i2c_client *client)
+{
+	struct fan_data *data = i2c_get_clientdata(client);
+	struct fan_sampler *sampler = &data->sampler;
+	struct fan_sample_snapshot *snap;
+	unsigned int seq;
+	u64 timestamp;
+
+	do {
+		snap = &sampler->snap[smp_load_acquire(&sampler->cur)];
+		seq = read_seqcount_begin(&snap->seq);
+		timestamp = snap->timestamp;
+	} while (read_seqcount_retry(&snap->seq, seq));
+
+	return timestamp;
+}
+EXPORT_SYMBOL(fan_sample_timestamp);
+
+void fan_sample_stop(struct i2c_client *client)
+{
+	fan_sample_period_set(client, 0);
+}
+EXPORT_SYMBOL(fan_sample_stop);
+
+/* Value of an attribute from the last sweep, or read now if the sweep has none */
+static void fan_attr_value(struct device *dev, struct fan_attr_info *info, FAN_DATA_ATTR *udata, union fan_attr_val *val)
+{
+	struct fan_data *data = i2c_get_clientdata(to_i2c_client(dev));
+
+	if (fan_sample_read(&data->sampler, info - data->attr_info, val) == 0)
+		return;
+
+	fan_update_attr(dev, info, udata);
+	*val = info->val;
+}
+
 ssize_t fan_show_default(struct device *dev, struct device_attribute *da, char *buf)
 {
     struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
@@ -218,6 +419,7 @@ ssize_t fan_show_default(struct device *dev, struct device_attribute *da, char *
     int i, status=0;
 	char new_str[ATTR_NAME_LEN] = "";
 	FAN_SYSFS_ATTR_DATA *ptr = NULL;
+	union fan_attr_val val;
 
     for (i=0;i<data->num_attr;i++)
     {
@@ -237,7 +439,7 @@ ssize_t fan_show_default(struct device *dev, struct device_attribute *da, char *
 		goto exit;
 	}
 
-    fan_update_attr(dev, attr_info, usr_data);
+    fan_attr_value(dev, attr_info, usr_data, &val);
 
 	/*Decide the o/p based on attribute type */
 	switch(attr->index)
@@ -323,7 +525,7 @@ ssize_t fan_show_default(struct device *dev, struct device_attribute *da, char *
 		case FAN15_FAULT:
 		case FAN16_FAULT:
 		case FAN_DUTY_CYCLE:
-            status = attr_info->val.intval;
+            status = val.intval;
 			break;
 		default:
 			fan_dbg(KERN_ERR "%s: Unable to find the attribute index for %s\n", __FUNCTION__, usr_data->aname);
@@ -411,6 +613,7 @@ ssize_t fan_store_default(struct device *dev, struct device_attribute *da, const
 
 	fan_dbg(KERN_ERR "%s: pwm to be set is %d\n", __FUNCTION__, val);
 	fan_update_hw(dev, attr_info, usr_data);
+	fan_sample_invalidate(data);
 
 exit:
 	return count;
@@ -424,7 +627,9 @@ int fan_cpld_client_read(FAN_DATA_ATTR *udata)
     {
         if (udata->len==1)
         {
-            status = board_i2c_cpld_read(udata->devaddr , udata->offset);
+            status = board_i2c_cpld_window_read(udata->window, udata->devaddr, udata->offset);
+            if (status < 0)
+                status = board_i2c_cpld_read_cached(&udata->cpld, udata->devaddr, NULL, udata->offset);
         }
         else
         {
@@ -455,7 +660,7 @@ int fan_cpld_client_write(FAN_DATA_ATTR *udata, uint32_t val)
 
     if (udata->len==1)
     {
-        status = board_i2c_cpld_write(udata->devaddr, udata->offset, val);
+        status = board_i2c_cpld_write_cached(&udata->cpld, udata->devaddr, NULL, udata->offset, val);
     }
     else
     {
@@ -767,6 +972,7 @@ ssize_t fan_show_status(struct device *dev, struct device_attribute *da, char *b
     char fan_attr[ATTR_NAME_LEN]="";
     char *attr_name, *end;
     int fan_attr_len = 0, presence = 0, speed = 0;
+    union fan_attr_val pres_val, speed_val;
 
 
     /* Find out the fan_id */
@@ -815,12 +1021,12 @@ ssize_t fan_show_status(struct device *dev, struct device_attribute *da, char *b
 	}
     kfree(attr_name);
 
-    fan_update_attr(dev, pres_attr_info, pres_usr_data);
-    fan_update_attr(dev, speed_attr_info, speed_usr_data);
+    fan_attr_value(dev, pres_attr_info, pres_usr_data, &pres_val);
+    fan_attr_value(dev, speed_attr_info, speed_usr_data, &speed_val);
 
 	/*Decide the o/p based on attribute type */
-    presence = pres_attr_info->val.intval;
-    speed = speed_attr_info->val.intval;
+    presence = pres_val.intval;
+    speed = speed_val.intval;
 
     /* As per S3IP spec, 0:Not present, 1:Present and normal, 2:Present and not normal */
     if (presence == 0)
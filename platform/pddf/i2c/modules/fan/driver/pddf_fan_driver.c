@@ -36,6 +36,11 @@
 
 #define DRVNAME "pddf_fan"
 
+/* Default period of the attribute sweeps, 0 reads the attributes on demand */
+static unsigned int sample_period_ms = 0;
+module_param(sample_period_ms, uint, 0644);
+MODULE_PARM_DESC(sample_period_ms, "Default period of the fan attribute sweeps in ms, 0 to disable");
+
 struct pddf_ops_t pddf_fan_ops = {
 	.pre_init = NULL,
 	.post_init = NULL,
@@ -377,6 +382,40 @@ FAN_SYSFS_ATTR_DATA_ENTRY fan_sysfs_attr_data_tbl[]=
     { "fan_hw_version", &data_fan_hw_version},
 };
 
+static ssize_t sample_period_ms_show(struct device *dev, struct device_attribute *da, char *buf)
+{
+    struct fan_data *data = i2c_get_clientdata(to_i2c_client(dev));
+
+    return sprintf(buf, "%u\n", READ_ONCE(data->sampler.period_ms));
+}
+
+static ssize_t sample_period_ms_store(struct device *dev, struct device_attribute *da, const char *buf, size_t count)
+{
+    unsigned int period_ms;
+    int ret;
+
+    ret = kstrtouint(buf, 10, &period_ms);
+    if (ret)
+        return ret;
+
+    fan_sample_period_set(to_i2c_client(dev), period_ms);
+    return count;
+}
+
+static ssize_t sample_timestamp_show(struct device *dev, struct device_attribute *da, char *buf)
+{
+    return sprintf(buf, "%llu\n", (unsigned long long)fan_sample_timestamp(to_i2c_client(dev)));
+}
+
+static DEVICE_ATTR_RW(sample_period_ms);
+static DEVICE_ATTR_RO(sample_timestamp);
+
+static struct attribute *fan_sample_attrs[] = {
+	&dev_attr_sample_period_ms.attr,
+	&dev_attr_sample_timestamp.attr,
+	NULL
+};
+
 void *get_fan_access_data(char *name)
 {
 	int i=0;
@@ -450,6 +489,10 @@ static int pddf_fan_probe(struct i2c_client *client,
 			printk(KERN_ERR "%s: Wrong attribute name provided by user '%s'\n", __FUNCTION__, data_attr->aname);
 			continue;
 		}
+
+        /* Look the CPLD client up once, the accessors use the cached one */
+        if ((strcmp(data_attr->devtype, "cpld") == 0) && (data_attr->len == 1))
+            board_i2c_cpld_handle_init(&data_attr->cpld, data_attr->devaddr, NULL);
 			
 		dy_ptr = (struct sensor_device_attribute *)kzalloc(sizeof(struct sensor_device_attribute)+ATTR_NAME_LEN, GFP_KERNEL);
         dy_ptr->dev_attr.attr.name = (char *)&dy_ptr[1];
@@ -507,8 +550,13 @@ static int pddf_fan_probe(struct i2c_client *client,
 			strcpy(new_default_str, "");
 		}
 	}
-	data->fan_attribute_list[i+j] = NULL;
+	status = pddf_attr_list_append(data->fan_attribute_list, i+j, MAX_FAN_ATTRS, fan_sample_attrs);
+	if (status) {
+		printk(KERN_ERR "%s: No room for the sampler attributes\n", __FUNCTION__);
+		goto exit_free;
+	}
 	data->fan_attribute_group.attrs = data->fan_attribute_list;
+	fan_sample_init(client, 0);
 
     /* Register sysfs hooks */
     status = sysfs_create_group(&client->dev.kobj, &data->fan_attribute_group);
@@ -533,15 +581,22 @@ static int pddf_fan_probe(struct i2c_client *client,
 			goto exit_remove;
 	}
 
+	fan_sample_period_set(client, sample_period_ms);
+
 	return 0;
 
 exit_remove:
     sysfs_remove_group(&client->dev.kobj, &data->fan_attribute_group);
+    fan_sample_stop(client);
 exit_free:
 	/* Free all the allocated attributes */
     for (i=0; data->fan_attribute_list[i]!=NULL; i++)
     {
-        struct sensor_device_attribute *ptr = (struct sensor_device_attribute *)data->fan_attribute_list[i];
+        struct sensor_device_attribute *ptr;
+
+        if (pddf_attr_shared(data->fan_attribute_list[i], fan_sample_attrs))
+            continue;
+        ptr = (struct sensor_device_attribute *)data->fan_attribute_list[i];
         kfree(ptr);
     }
     pddf_dbg(FAN, KERN_ERR "%s: Freed all the memory allocated for attributes\n", __FUNCTION__);
@@ -565,10 +620,13 @@ static void pddf_fan_remove(struct i2c_client *client)
 			printk(KERN_ERR "FAN pre_remove function failed\n");
 	}
 
+    fan_sample_stop(client);
     hwmon_device_unregister(data->hwmon_dev);
     sysfs_remove_group(&client->dev.kobj, &data->fan_attribute_group);
     for (i=0; data->fan_attribute_list[i]!=NULL; i++)
     {
+        if (pddf_attr_shared(data->fan_attribute_list[i], fan_sample_attrs))
+            continue;
         ptr = (struct sensor_device_attribute *)data->fan_attribute_list[i];
         kfree(ptr);
     }
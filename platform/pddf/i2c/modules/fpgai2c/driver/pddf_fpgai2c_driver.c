@@ -19,6 +19,8 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/dmi.h>
+#include <linux/ktime.h>
+#include "pddf_client_defs.h"
 #include "pddf_fpgai2c_defs.h"
 
 extern PDDF_FPGAI2C_DATA pddf_fpgai2c_data;
@@ -46,7 +48,10 @@ int board_i2c_fpga_read(unsigned short fpga_addr, u8 reg)
 		fpga_node = list_entry(list_node, struct fpgai2c_client_node, list);
 
 		if (fpga_node->client->addr == fpga_addr) {
+			u64 start_ns = ktime_get_ns();
+
 			ret = i2c_smbus_read_byte_data(fpga_node->client, reg);
+			pddf_stats_xfer(fpga_node->client->adapter, fpga_addr, fpga_node->client->name, ret, start_ns, 0);
 			break;
 		}
 	}
@@ -71,7 +76,10 @@ int board_i2c_fpga_write(unsigned short fpga_addr, u8 reg, u8 value)
 		fpga_node = list_entry(list_node, struct fpgai2c_client_node, list);
 
 		if (fpga_node->client->addr == fpga_addr) {
+			u64 start_ns = ktime_get_ns();
+
 			ret = i2c_smbus_write_byte_data(fpga_node->client, reg, value);
+			pddf_stats_xfer(fpga_node->client->adapter, fpga_addr, fpga_node->client->name, ret, start_ns, 0);
 			break;
 		}
 	}
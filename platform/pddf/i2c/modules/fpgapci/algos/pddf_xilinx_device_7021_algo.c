@@ -27,12 +27,24 @@
 #include <linux/moduleparam.h>
 #include <linux/delay.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/iopoll.h>
+#include <linux/slab.h>
+#include <linux/sched/signal.h>
 #include <linux/errno.h>
 #include <linux/i2c.h>
 #include "pddf_i2c_algo.h"
 
 #define DEBUG 0
 
+/*
+ * Delay around every register access, only for FPGA images which cannot
+ * take back to back accesses. The transfer waits on the status register.
+ */
+static unsigned int reg_delay_us = 0;
+module_param(reg_delay_us, uint, 0644);
+MODULE_PARM_DESC(reg_delay_us, "Delay in usec around each FPGA I2C register access (default 0)");
+
 enum {
     STATE_DONE = 0,
     STATE_INIT,
@@ -84,8 +96,14 @@ struct fpgalogic_i2c {
     int bus_clock_khz;
     void (*reg_set)(struct fpgalogic_i2c *i2c, int reg, u8 value);
     u8 (*reg_get)(struct fpgalogic_i2c *i2c, int reg);
-    u32 timeout;
+    u32 timeout;            /* usec to wait for a byte transfer */
+    u32 byte_time_us;       /* time of one byte with ack on the wire */
     struct mutex lock;
+    /* transfer statistics, see fpgai2c_stats */
+    u64 stat_xfers;
+    u64 stat_bytes;
+    u64 stat_errors;
+    u64 stat_busy_ns;
 };
 static struct fpgalogic_i2c fpgalogic_i2c[I2C_PCI_MAX_BUS];
 extern void __iomem * fpga_ctl_addr;
@@ -119,15 +137,29 @@ static inline u8 fpgai2c_reg_get_8(struct fpgalogic_i2c *i2c, int reg)
 static inline void fpgai2c_reg_set(struct fpgalogic_i2c *i2c, int reg, u8 value)
 {
     i2c->reg_set(i2c, reg, value);
-    udelay(100);
+    if (unlikely(reg_delay_us))
+        udelay(reg_delay_us);
 }
 
 static inline u8 fpgai2c_reg_get(struct fpgalogic_i2c *i2c, int reg)
 {
-    udelay(100);
+    if (unlikely(reg_delay_us))
+        udelay(reg_delay_us);
     return i2c->reg_get(i2c, reg);
 }
 
+/*
+ * Wait for the byte in flight, sleeping for a fraction of its time on the
+ * wire between the status reads.
+ */
+static int fpgai2c_wait(struct fpgalogic_i2c *i2c)
+{
+    u8 stat;
+
+    return read_poll_timeout(fpgai2c_reg_get, stat, !(stat & FPGAI2C_REG_STAT_TIP),
+                             i2c->byte_time_us, i2c->timeout, false, i2c, FPGAI2C_REG_STATUS);
+}
+
 
 /*
  * i2c_get_mutex must be called prior to calling this function.
@@ -235,17 +267,27 @@ static int fpgai2c_poll(struct fpgalogic_i2c *i2c)
     return 0;
 }
 
-static int fpgai2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+static void fpgai2c_stats_update(struct fpgalogic_i2c *i2c, struct i2c_msg *msgs, int num,
+                                 int ret, u64 start_ns)
+{
+    int i;
+
+    i2c_get_mutex(i2c);
+    i2c->stat_xfers++;
+    i2c->stat_busy_ns += ktime_get_ns() - start_ns;
+    if (ret == num) {
+        for (i = 0; i < num; i++)
+            i2c->stat_bytes += msgs[i].len;
+    } else
+        i2c->stat_errors++;
+    i2c_release_mutex(i2c);
+}
+
+static int fpgai2c_process(struct fpgalogic_i2c *i2c, int num)
 {
-    struct fpgalogic_i2c *i2c = i2c_get_adapdata(adap);
     int ret;
     unsigned long timeout = jiffies + msecs_to_jiffies(1000);
 
-    i2c->msg = msgs;
-    i2c->pos = 0;
-    i2c->nmsgs = num;
-    i2c->state = STATE_INIT;
-
      /* Handle the transfer */
      while (time_before(jiffies, timeout)) {
          i2c_get_mutex(i2c);
@@ -255,10 +297,12 @@ static int fpgai2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
          if (i2c->state == STATE_DONE || i2c->state == STATE_ERROR)
               return (i2c->state == STATE_DONE) ? num : ret;
 
-         if (ret == 0)
+         if (ret == 0) {
               timeout = jiffies + HZ;
-
-         usleep_range(5, 15);
+              /* A command was issued, the next step can only start once it is done */
+              fpgai2c_wait(i2c);
+         } else
+              usleep_range(i2c->byte_time_us / 4 + 1, i2c->byte_time_us);
      }
      printk("[%s] ERROR STATE_ERROR\n", __FUNCTION__);
 
@@ -268,6 +312,24 @@ static int fpgai2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 
 }
 
+static int fpgai2c_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+    struct fpgalogic_i2c *i2c = i2c_get_adapdata(adap);
+    u64 start_ns = ktime_get_ns();
+    int ret;
+
+    i2c->msg = msgs;
+    i2c->pos = 0;
+    i2c->nmsgs = num;
+    i2c->state = STATE_INIT;
+
+    ret = fpgai2c_process(i2c, num);
+    fpgai2c_stats_update(i2c, msgs, num, ret, start_ns);
+    pddf_stats_xfer(adap, msgs[0].addr, NULL, (ret == num) ? 0 : ret, start_ns, PDDF_STATS_ADAPTER);
+
+    return ret;
+}
+
 static u32 fpgai2c_func(struct i2c_adapter *adap)
 {
 /* a typical full-I2C adapter would use the following  */
@@ -307,6 +369,9 @@ static int fpgai2c_init(struct fpgalogic_i2c *i2c)
         return -EINVAL;
     }
 
+    /* 8 data bits and the ack */
+    i2c->byte_time_us = DIV_ROUND_UP(9 * 1000, i2c->bus_clock_khz);
+
     fpgai2c_reg_set(i2c, FPGAI2C_REG_PRELOW, prescale & 0xff);
     fpgai2c_reg_set(i2c, FPGAI2C_REG_PREHIGH, prescale >> 8);
 
@@ -348,7 +413,7 @@ static int adap_data_init(struct i2c_adapter *adap, int i2c_ch_index)
     /* Initialize driver's itnernal data structures */
     fpgalogic_i2c[i2c_ch_index].reg_shift = 0; /* 8 bit registers */
     fpgalogic_i2c[i2c_ch_index].reg_io_width = 1; /* 8 bit read/write */
-    fpgalogic_i2c[i2c_ch_index].timeout = 500;//1000;//1ms
+    fpgalogic_i2c[i2c_ch_index].timeout = 1000;/* 1ms, ten bytes at 100KHz */
     fpgalogic_i2c[i2c_ch_index].ip_clock_khz = 100000;//100000;/* input clock of 100MHz */
     fpgalogic_i2c[i2c_ch_index].bus_clock_khz = 100;
     fpgalogic_i2c[i2c_ch_index].base = pci_privdata->fpga_i2c_ch_base_addr +
@@ -362,6 +427,100 @@ static int adap_data_init(struct i2c_adapter *adap, int i2c_ch_index)
     return 0;
 }
 
+/*
+ * Benchmark of a bus, under /sys/bus/i2c/devices/i2c-N:
+ *   fpgai2c_stats  transfers, bytes and bytes/sec while busy, write to clear
+ *   fpgai2c_bench  write "<addr> <len> <count>" to read <count> times <len>
+ *                  bytes from offset 0 of the device at <addr>
+ */
+static ssize_t fpgai2c_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct fpgalogic_i2c *i2c = i2c_get_adapdata(to_i2c_adapter(dev));
+    u64 xfers, bytes, errors, busy_ns;
+
+    i2c_get_mutex(i2c);
+    xfers = i2c->stat_xfers;
+    bytes = i2c->stat_bytes;
+    errors = i2c->stat_errors;
+    busy_ns = i2c->stat_busy_ns;
+    i2c_release_mutex(i2c);
+
+    return sprintf(buf, "xfers %llu\nerrors %llu\nbytes %llu\nbusy_us %llu\nbytes_per_sec %llu\n",
+                   xfers, errors, bytes, div_u64(busy_ns, NSEC_PER_USEC),
+                   busy_ns ? div64_u64(bytes * NSEC_PER_SEC, busy_ns) : 0);
+}
+
+static ssize_t fpgai2c_stats_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct fpgalogic_i2c *i2c = i2c_get_adapdata(to_i2c_adapter(dev));
+
+    i2c_get_mutex(i2c);
+    i2c->stat_xfers = 0;
+    i2c->stat_bytes = 0;
+    i2c->stat_errors = 0;
+    i2c->stat_busy_ns = 0;
+    i2c_release_mutex(i2c);
+
+    return count;
+}
+
+static ssize_t fpgai2c_bench_store(struct device *dev, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct i2c_adapter *adap = to_i2c_adapter(dev);
+    struct i2c_msg msgs[2];
+    unsigned int addr, len, loops, i;
+    u8 offset = 0;
+    u8 *data;
+    int ret = 0;
+
+    if (sscanf(buf, "%i %u %u", &addr, &len, &loops) != 3 ||
+        addr > 0x7f || len == 0 || len > 256 || loops == 0)
+        return -EINVAL;
+
+    data = kmalloc(len, GFP_KERNEL);
+    if (!data)
+        return -ENOMEM;
+
+    msgs[0].addr = addr;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &offset;
+    msgs[1].addr = addr;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = len;
+    msgs[1].buf = data;
+
+    for (i = 0; i < loops; i++) {
+        ret = i2c_transfer(adap, msgs, 2);
+        if (ret != 2)
+            break;
+        if (signal_pending(current)) {
+            ret = -EINTR;
+            break;
+        }
+    }
+    kfree(data);
+
+    if (ret != 2)
+        return ret < 0 ? ret : -EIO;
+    return count;
+}
+
+static DEVICE_ATTR(fpgai2c_stats, S_IWUSR|S_IRUGO, fpgai2c_stats_show, fpgai2c_stats_store);
+static DEVICE_ATTR(fpgai2c_bench, S_IWUSR, NULL, fpgai2c_bench_store);
+
+static struct attribute *fpgai2c_attrs[] = {
+    &dev_attr_fpgai2c_stats.attr,
+    &dev_attr_fpgai2c_bench.attr,
+    NULL,
+};
+
+static const struct attribute_group fpgai2c_attr_group = {
+    .attrs = fpgai2c_attrs,
+};
+
 static int pddf_i2c_pci_add_numbered_bus_default (struct i2c_adapter *adap, int i2c_ch_index)
 {
     int ret = 0;
@@ -370,6 +529,11 @@ static int pddf_i2c_pci_add_numbered_bus_default (struct i2c_adapter *adap, int
     adap->algo = &fpgai2c_algorithm;
 
     ret = i2c_add_numbered_adapter(adap);
+    if (ret == 0 && sysfs_create_group(&adap->dev.kobj, &fpgai2c_attr_group))
+        printk("[%s] Unable to add the stats of i2c-%d\n", __FUNCTION__, adap->nr);
+    /* All the transactions of the bus are accounted here, with their latency on the wire */
+    if (ret == 0)
+        pddf_stats_adapter_traced(adap);
     return ret;
 }
 
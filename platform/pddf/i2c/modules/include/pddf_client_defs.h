@@ -134,5 +134,44 @@ typedef struct PDEVICE
 
 void add_device_table(char *name, void *ptr);
 
+/*
+ * Attributes shared by all the clients of a driver, like the sampler
+ * controls, sit in the per client attribute lists next to the allocated
+ * ones. The lists hold at most max entries, the NULL terminator included.
+ */
+static inline int pddf_attr_shared(struct attribute *attr, struct attribute **shared)
+{
+    for (; *shared; shared++)
+        if (attr == *shared)
+            return 1;
+    return 0;
+}
+
+static inline int pddf_attr_list_append(struct attribute **list, int num, int max, struct attribute **shared)
+{
+    int i, cnt = 0;
+
+    while (shared[cnt])
+        cnt++;
+    if (num + cnt >= max)
+        return -ENOSPC;
+    for (i = 0; i < cnt; i++)
+        list[num + i] = shared[i];
+    list[num + cnt] = NULL;
+    return 0;
+}
+
+/*
+ * I2C transaction statistics, /sys/kernel/pddf/stats, and tracepoints.
+ * The access paths record each transaction with the time it started, and
+ * each retry. Buses whose adapter records its transactions are marked as
+ * traced, only the retries of the upper layers are counted on them.
+ */
+#define PDDF_STATS_ADAPTER  0x1     // recorded by the bus adapter
+
+extern void pddf_stats_xfer(struct i2c_adapter *adap, unsigned short addr, const char *name, int ret, u64 start_ns, unsigned int flags);
+extern void pddf_stats_retry(struct i2c_adapter *adap, unsigned short addr, const char *name);
+extern void pddf_stats_adapter_traced(struct i2c_adapter *adap);
+
 
 #endif
@@ -26,7 +26,42 @@ typedef struct CPLD_DATA
 {
     struct mutex cpld_lock;
     uint16_t reg_addr;
+    int intr_gpio;          // CPU gpio of the CPLD interrupt output, -1 if none
 }PDDF_CPLD_DATA;
 
+/* CPLD client cached by the users of the accessors, see board_i2c_cpld_handle_init() */
+typedef struct PDDF_CPLD_HANDLE
+{
+    void *node;             // CPLD client node
+    unsigned int gen;       // client table generation the node belongs to, 0 if none
+}PDDF_CPLD_HANDLE;
+
+extern int board_i2c_cpld_handle_init(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name);
+extern int board_i2c_cpld_read_cached(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name, u8 reg);
+extern int board_i2c_cpld_write_cached(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name, u8 reg, u8 value);
+extern void board_i2c_cpld_retry(PDDF_CPLD_HANDLE *handle, unsigned short cpld_addr, char *name);
+
+#define CPLD_WINDOW_MAX_LEN 32
+/*
+ * Adjacent CPLD registers read with one block transfer, see board_i2c_cpld_window_add().
+ * valid and buf are published under seq, the fills and invalidations of a
+ * window are serialized by its owner.
+ */
+typedef struct PDDF_CPLD_WINDOW
+{
+    PDDF_CPLD_HANDLE cpld;
+    unsigned short addr;    // CPLD address
+    u8 start;               // first register
+    u8 len;                 // number of registers
+    seqcount_t seq;
+    int valid;              // buf holds the registers read by the last fill
+    u8 buf[CPLD_WINDOW_MAX_LEN];
+}PDDF_CPLD_WINDOW;
+
+extern int board_i2c_cpld_window_add(PDDF_CPLD_WINDOW *win, int *num, int max, unsigned short cpld_addr, u8 reg);
+extern int board_i2c_cpld_window_fill(PDDF_CPLD_WINDOW *win);
+extern void board_i2c_cpld_window_invalidate(PDDF_CPLD_WINDOW *win);
+extern int board_i2c_cpld_window_read(PDDF_CPLD_WINDOW *win, unsigned short cpld_addr, u8 reg);
+
 
 #endif
@@ -31,6 +31,11 @@ extern ssize_t fan_store_default(struct device *dev, struct device_attribute *da
 extern ssize_t fan_show_status(struct device *dev, struct device_attribute *da, char *buf);
 extern ssize_t fan_show_string(struct device *dev, struct device_attribute *da, char *buf);
 
+extern void fan_sample_init(struct i2c_client *client, unsigned int period_ms);
+extern void fan_sample_stop(struct i2c_client *client);
+extern int fan_sample_period_set(struct i2c_client *client, unsigned int period_ms);
+extern u64 fan_sample_timestamp(struct i2c_client *client);
+
 
 extern int sonic_i2c_get_fan_present_default(void *client, FAN_DATA_ATTR *adata, void *data);
 extern int sonic_i2c_get_fan_rpm_default(void *client, FAN_DATA_ATTR *adata, void *data);
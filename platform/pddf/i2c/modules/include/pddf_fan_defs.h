@@ -20,6 +20,8 @@
 #ifndef __PDDF_FAN_DEFS_H__
 #define __PDDF_FAN_DEFS_H__
 
+#include "pddf_cpld_defs.h"
+
 
 #define MAX_NUM_FAN 12
 #define MAX_FAN_ATTRS 128
@@ -42,6 +44,8 @@ typedef struct FAN_DATA_ATTR
     uint32_t len;
     int mult;                       // Multiplication factor to get the actual data
     uint8_t is_divisor;                     // Check if the value is a divisor and mult is dividend
+    PDDF_CPLD_HANDLE cpld;          // cached CPLD client for 'cpld' attributes
+    PDDF_CPLD_WINDOW *window;       // sampler block read covering the register, if any
     void *access_data;
 
 }FAN_DATA_ATTR;
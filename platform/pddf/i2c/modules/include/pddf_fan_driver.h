@@ -19,6 +19,9 @@
 #ifndef __PDDF_FAN_DRIVER_H__
 #define __PDDF_FAN_DRIVER_H__
 
+#include <linux/workqueue.h>
+#include <linux/seqlock.h>
+
 enum fan_sysfs_attributes {
     FAN1_PRESENT,
     FAN2_PRESENT,
@@ -123,18 +126,47 @@ enum fan_sysfs_attributes {
     FAN_HW_VERSION,
 	FAN_MAX_ATTR 
 };
+union fan_attr_val {
+    char strval[STR_ATTR_SIZE];
+    int  intval;
+    u16  shortval;
+    u8   charval;
+};
+
 /* Each client has this additional data */
 struct fan_attr_info {
 	char				name[ATTR_NAME_LEN];
     struct mutex		update_lock;
     char				valid;           /* != 0 if registers are valid */
     unsigned long		last_updated;    /* In jiffies */
-	union {
-        char strval[STR_ATTR_SIZE];
-        int  intval;
-        u16  shortval;
-        u8   charval;
-    }val;
+	union fan_attr_val	val;
+};
+
+#define FAN_SAMPLE_WINDOWS 16
+
+/* Attribute values of one sweep */
+struct fan_sample_snapshot {
+    seqcount_mutex_t		seq;
+    u64						timestamp;      /* ktime_get_ns() at the end of the sweep */
+    DECLARE_BITMAP(valid, MAX_FAN_ATTRS);
+    union fan_attr_val		val[MAX_FAN_ATTRS];
+};
+
+/*
+ * Periodic sampling of all the attributes of a client. The sweeps fill the
+ * snapshot not served to the readers, then flip 'cur'; sysfs reads take no
+ * lock and fall back to a direct read for the attributes the sweep missed.
+ */
+struct fan_sampler {
+    struct i2c_client		*client;
+    struct delayed_work		work;
+    struct mutex			lock;           /* serializes the sweeps */
+    unsigned int			period_ms;      /* 0 disables the sampling */
+    int						cur;            /* snapshot served to the readers */
+    struct fan_sample_snapshot snap[2];
+    int						num_window;
+    PDDF_CPLD_WINDOW		window[FAN_SAMPLE_WINDOWS];
+    u64						sweeps;
 };
 
 struct fan_data {
@@ -143,6 +175,7 @@ struct fan_data {
 	struct attribute		*fan_attribute_list[MAX_FAN_ATTRS];
 	struct attribute_group	fan_attribute_group;
 	struct fan_attr_info	attr_info[MAX_FAN_ATTRS];
+	struct fan_sampler		sampler;
 };
 
 #endif
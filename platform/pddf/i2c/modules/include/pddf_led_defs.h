@@ -64,6 +64,14 @@ char*  LED_STATUS_STR[] = {
 };
 
 
+/* Register accessors of an LED devtype, resolved when the LED state is loaded */
+typedef struct
+{
+    const char *devtype;
+    int (*read)(unsigned short addr, u8 reg);
+    int (*write)(unsigned short addr, u8 reg, u8 value);
+}LED_ACCESS_OPS;
+
 typedef struct 
 {
     char bits[NAME_SIZE]; 
@@ -80,6 +88,7 @@ typedef struct
     char value[NAME_SIZE];
     char attr_devtype[NAME_SIZE];
     char attr_devname[NAME_SIZE];
+    const LED_ACCESS_OPS *access;   // accessors of attr_devtype, NULL if unsupported
 } LED_DATA;
 
 typedef struct
@@ -114,6 +123,7 @@ typedef struct
     int swpld_addr_offset;
     char attr_devtype[NAME_SIZE];
     char attr_devname[NAME_SIZE];
+    const LED_ACCESS_OPS *access;   // accessors of attr_devtype, NULL if unsupported
 } LED_OPS_DATA; 
 
 typedef enum{
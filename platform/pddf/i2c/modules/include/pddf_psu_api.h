@@ -28,4 +28,9 @@ extern int sonic_i2c_get_psu_byte_default(void *client, PSU_DATA_ATTR *adata, vo
 extern int sonic_i2c_get_psu_block_default(void *client, PSU_DATA_ATTR *adata, void *data);
 extern int sonic_i2c_get_psu_word_default(void *client, PSU_DATA_ATTR *adata, void *data);
 
+extern void psu_sample_init(struct i2c_client *client, unsigned int period_ms);
+extern void psu_sample_stop(struct i2c_client *client);
+extern int psu_sample_period_set(struct i2c_client *client, unsigned int period_ms);
+extern u64 psu_sample_timestamp(struct i2c_client *client);
+
 #endif
@@ -20,6 +20,8 @@
 #ifndef __PDDF_PSU_DEFS_H__
 #define __PDDF_PSU_DEFS_H__
 
+#include "pddf_cpld_defs.h"
+
 
 #define MAX_NUM_PSU 5
 #define MAX_PSU_ATTRS 32
@@ -40,6 +42,7 @@ typedef struct PSU_DATA_ATTR
     uint32_t mask;
     uint32_t cmpval;
     uint32_t len;
+    PDDF_CPLD_WINDOW *window;       // sampler block read covering the register, if any
     void *access_data;
 
 }PSU_DATA_ATTR;
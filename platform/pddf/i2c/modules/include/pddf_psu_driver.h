@@ -19,6 +19,9 @@
 #ifndef __PDDF_PSU_DRIVER_H__
 #define __PDDF_PSU_DRIVER_H__
 
+#include <linux/workqueue.h>
+#include <linux/seqlock.h>
+
 enum psu_sysfs_attributes {
     PSU_PRESENT,
     PSU_MODEL_NAME,
@@ -42,6 +45,13 @@ enum psu_sysfs_attributes {
 };
 
 
+union psu_attr_val {
+	char strval[STR_ATTR_SIZE];
+	int	 intval;
+	u16	 shortval;
+	u8   charval;
+};
+
 /* Every client has psu_data which is divided into per attribute data */
 struct psu_attr_info {
 	char				name[ATTR_NAME_LEN];
@@ -49,13 +59,35 @@ struct psu_attr_info {
     char                valid;           /* !=0 if registers are valid */
     unsigned long       last_updated;    /* In jiffies */
 	u8					status;
-	union {
-		char strval[STR_ATTR_SIZE];
-		int	 intval;
-		u16	 shortval;
-		u8   charval;
-	}val;
+	union psu_attr_val	val;
+};
+
+#define PSU_SAMPLE_WINDOWS 4
+
+/* Attribute values of one sweep */
+struct psu_sample_snapshot {
+	seqcount_mutex_t		seq;
+	u64						timestamp;      /* ktime_get_ns() at the end of the sweep */
+	DECLARE_BITMAP(valid, MAX_PSU_ATTRS);
+	union psu_attr_val		val[MAX_PSU_ATTRS];
 };
+
+/*
+ * Periodic sampling of the telemetry attributes of a client, see
+ * struct fan_sampler. The strings are static and stay read on demand.
+ */
+struct psu_sampler {
+	struct i2c_client		*client;
+	struct delayed_work		work;
+	struct mutex			lock;           /* serializes the sweeps */
+	unsigned int			period_ms;      /* 0 disables the sampling */
+	int						cur;            /* snapshot served to the readers */
+	struct psu_sample_snapshot snap[2];
+	int						num_window;
+	PDDF_CPLD_WINDOW		window[PSU_SAMPLE_WINDOWS];
+	u64						sweeps;
+};
+
 struct psu_data {
 	struct device			*hwmon_dev;
 	u8						index;
@@ -64,6 +96,7 @@ struct psu_data {
 	struct attribute		*psu_attribute_list[MAX_PSU_ATTRS];
 	struct attribute_group	psu_attribute_group;
 	struct psu_attr_info	attr_info[MAX_PSU_ATTRS];
+	struct psu_sampler		sampler;
 };
 
 
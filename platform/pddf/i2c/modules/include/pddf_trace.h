@@ -0,0 +1,84 @@
+/*
+ * Copyright 2019 Broadcom.
+ * The term “Broadcom” refers to Broadcom Inc. and/or its subsidiaries.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *
+ * Description:
+ *  PDDF I2C transaction tracepoints, /sys/kernel/tracing/events/pddf
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pddf
+
+#if !defined(__PDDF_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __PDDF_TRACE_H__
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(pddf_i2c_xfer,
+
+    TP_PROTO(int bus, unsigned short addr, const char *name, int ret, u64 latency_ns, unsigned int flags),
+
+    TP_ARGS(bus, addr, name, ret, latency_ns, flags),
+
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(unsigned short, addr)
+        __string(name, name ? name : "")
+        __field(int, ret)
+        __field(u64, latency_ns)
+        __field(unsigned int, flags)
+    ),
+
+    TP_fast_assign(
+        __entry->bus = bus;
+        __entry->addr = addr;
+        __assign_str(name, name ? name : "");
+        __entry->ret = ret;
+        __entry->latency_ns = latency_ns;
+        __entry->flags = flags;
+    ),
+
+    TP_printk("i2c-%d 0x%02x %s ret=%d latency_ns=%llu%s",
+        __entry->bus, __entry->addr, __get_str(name), __entry->ret,
+        __entry->latency_ns, (__entry->flags & PDDF_STATS_ADAPTER) ? " adapter" : "")
+);
+
+TRACE_EVENT(pddf_i2c_retry,
+
+    TP_PROTO(int bus, unsigned short addr, const char *name),
+
+    TP_ARGS(bus, addr, name),
+
+    TP_STRUCT__entry(
+        __field(int, bus)
+        __field(unsigned short, addr)
+        __string(name, name ? name : "")
+    ),
+
+    TP_fast_assign(
+        __entry->bus = bus;
+        __entry->addr = addr;
+        __assign_str(name, name ? name : "");
+    ),
+
+    TP_printk("i2c-%d 0x%02x %s", __entry->bus, __entry->addr, __get_str(name))
+);
+
+#endif /* __PDDF_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pddf_trace
+#include <trace/define_trace.h>
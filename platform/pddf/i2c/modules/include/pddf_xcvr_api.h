@@ -30,6 +30,8 @@ extern int sonic_i2c_set_mod_lpmode(struct i2c_client *client, XCVR_ATTR *info,
 extern int sonic_i2c_set_mod_reset(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data);
 extern int sonic_i2c_set_mod_txdisable(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data);
 
+extern int xcvr_attr_resolve(struct i2c_client *client, XCVR_ATTR *info);
+
 extern ssize_t get_module_presence(struct device *dev, struct device_attribute *da, char *buf);
 extern ssize_t get_module_reset(struct device *dev, struct device_attribute *da, char *buf);
 extern ssize_t set_module_reset(struct device *dev, struct device_attribute *da, const char *buf, size_t count);
@@ -41,4 +43,11 @@ extern ssize_t get_module_txdisable(struct device *dev, struct device_attribute
 extern ssize_t set_module_txdisable(struct device *dev, struct device_attribute *da, const char *buf, size_t count);
 extern ssize_t get_module_txfault(struct device *dev, struct device_attribute *da, char *buf);
 
+extern int xcvr_status_register(struct i2c_client *client);
+extern void xcvr_status_unregister(struct i2c_client *client);
+extern int xcvr_status_snapshot_get(XCVR_STATUS_SNAPSHOT *snap);
+extern unsigned int xcvr_status_ttl_get(void);
+extern void xcvr_status_ttl_set(unsigned int ttl);
+extern int xcvr_status_event_handle(void);
+
 #endif
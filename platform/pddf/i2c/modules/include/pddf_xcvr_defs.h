@@ -20,11 +20,22 @@
 #ifndef __PDDF_XCVR_DEFS_H__
 #define __PDDF_XCVR_DEFS_H__
 
+#include "pddf_cpld_defs.h"
+
 
 #define MAX_NUM_XCVR 5
 #define MAX_XCVR_ATTRS 20
 
 
+struct XCVR_ATTR;
+
+/* Register accessors of an attribute devtype, see xcvr_attr_resolve() */
+typedef struct XCVR_ACCESS_OPS
+{
+    int (*read)(struct XCVR_ATTR *info);
+    int (*write)(struct XCVR_ATTR *info, uint32_t val);
+}XCVR_ACCESS_OPS;
+
 typedef struct XCVR_ATTR
 {
     char aname[32];                    // attr name, taken from enum xcvr_sysfs_attributes
@@ -35,6 +46,9 @@ typedef struct XCVR_ATTR
     uint32_t mask;
     uint32_t cmpval;
     uint32_t len;
+    PDDF_CPLD_HANDLE cpld;  // cached CPLD client for 'cpld' attributes
+    const XCVR_ACCESS_OPS *access;  // accessors of the devtype, NULL if none ('eeprom')
+    int index;              // enum xcvr_sysfs_attributes, -1 if unknown
 
     int (*pre_access)(void *client, void *data);
     int (*do_access)(void *client, void *data);
@@ -73,6 +87,17 @@ typedef enum xcvr_port_type_e {
     PDDF_PORT_TYPE_QSFP28
 } xcvr_port_type_t;
 
+enum xcvr_sysfs_attributes {
+    XCVR_PRESENT,
+    XCVR_RESET,
+    XCVR_INTR_STATUS,
+    XCVR_LPMODE,
+    XCVR_RXLOS,
+    XCVR_TXDISABLE,
+    XCVR_TXFAULT,
+    XCVR_ATTR_MAX
+};
+
 /* Each client has this additional data
  */
 struct xcvr_data {
@@ -89,6 +114,7 @@ struct xcvr_data {
     uint32_t            rxlos;
     uint32_t            txdisable;
     uint32_t            txfault;
+    XCVR_ATTR           *attrs[XCVR_ATTR_MAX];  /* platform attribute behind each sysfs attribute */
 };
 
 typedef struct XCVR_SYSFS_ATTR_OPS
@@ -104,16 +130,18 @@ typedef struct XCVR_SYSFS_ATTR_OPS
     int (*post_set)(struct i2c_client *client, XCVR_ATTR *adata, struct xcvr_data *data);
 } XCVR_SYSFS_ATTR_OPS;
 
-enum xcvr_sysfs_attributes {
-    XCVR_PRESENT,
-    XCVR_RESET,
-    XCVR_INTR_STATUS,
-    XCVR_LPMODE,
-    XCVR_RXLOS,
-    XCVR_TXDISABLE,
-    XCVR_TXFAULT,
-    XCVR_ATTR_MAX
-};
+/* Status snapshot of all the xcvr ports, one bit per port and attribute */
+#define XCVR_STATUS_MAX_PORTS   256
+#define XCVR_STATUS_MAP_SIZE    (XCVR_STATUS_MAX_PORTS / 8)
+#define XCVR_STATUS_TTL_DEFAULT 100     /* in msec */
+
+typedef struct XCVR_STATUS_SNAPSHOT
+{
+    uint32_t num_ports;     // highest xcvr index found, bitmaps are valid up to this port
+    uint32_t age;           // msec since the registers were read
+    uint8_t valid[XCVR_ATTR_MAX][XCVR_STATUS_MAP_SIZE];    // bit set if the attribute was read for the port
+    uint8_t value[XCVR_ATTR_MAX][XCVR_STATUS_MAP_SIZE];    // attribute value, indexed by enum xcvr_sysfs_attributes
+}XCVR_STATUS_SNAPSHOT;
 
 extern int board_i2c_cpld_read_new(unsigned short cpld_addr, char *name, u8 reg);
 extern int board_i2c_cpld_write_new(unsigned short cpld_addr, char *name, u8 reg, u8 value);
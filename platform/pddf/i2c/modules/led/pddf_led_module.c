@@ -58,6 +58,11 @@ extern int board_i2c_cpld_write(unsigned short cpld_addr, u8 reg, u8 value);
 extern int board_i2c_fpga_read(unsigned short cpld_addr, u8 reg);
 extern int board_i2c_fpga_write(unsigned short cpld_addr, u8 reg, u8 value);
 
+static const LED_ACCESS_OPS led_access_ops[] = {
+    {"cpld", board_i2c_cpld_read, board_i2c_cpld_write},
+    {"fpgai2c", board_i2c_fpga_read, board_i2c_fpga_write},
+};
+
 extern ssize_t show_pddf_data(struct device *dev, struct device_attribute *da, char *buf);
 extern ssize_t store_pddf_data(struct device *dev, struct device_attribute *da, const char *buf, size_t count);
 extern ssize_t show_pddf_s3ip_data(struct device *dev, struct device_attribute *da, char *buf);
@@ -76,6 +81,17 @@ static LED_STATUS find_state_index(const char* state_str) {
     return MAX_LED_STATUS;
 }
 
+/* Called once per loaded state, the get and set paths use the result */
+static const LED_ACCESS_OPS* led_access_find(const char* devtype)
+{
+    int i;
+    for (i = 0; i < ARRAY_SIZE(led_access_ops); i++) {
+        if (strcmp(devtype, led_access_ops[i].devtype) == 0)
+            return &led_access_ops[i];
+    }
+    return (NULL);
+}
+
 static LED_TYPE get_dev_type(char* name)
 {
     LED_TYPE ret = LED_TYPE_MAX;
@@ -166,9 +182,9 @@ ssize_t get_status_led(struct device_attribute *da)
     struct pddf_data_attribute *_ptr = (struct pddf_data_attribute *)da;
     LED_OPS_DATA* temp_data_ptr=(LED_OPS_DATA*)_ptr->addr;
     LED_OPS_DATA* ops_ptr=find_led_ops_data(da);
-    uint32_t color_val=0, sys_val=0;
+    uint32_t color_val=0;
+    int sys_val=0;
     int state=0;
-    int cpld_type=0;
     int j;
 
     if (!ops_ptr) {
@@ -182,16 +198,12 @@ ssize_t get_status_led(struct device_attribute *da)
         return (-1);
     }
 
-    if (strcmp(ops_ptr->attr_devtype, "cpld") == 0) {
-        cpld_type = 1;
-        sys_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else if (strcmp(ops_ptr->attr_devtype, "fpgai2c") == 0) {
-        sys_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else {
+    if (!ops_ptr->access) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s 0x%x:0x%x not configured\n",__func__,
             ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype, ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
         return (-1);
     }
+    sys_val = ops_ptr->access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
 
     if (sys_val < 0) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s 0x%x:0x%x read failed\n",__func__,
@@ -212,7 +224,7 @@ ssize_t get_status_led(struct device_attribute *da)
 #if DEBUG
     pddf_dbg(LED, KERN_ERR "Get : %s:%d addr/offset:0x%x; 0x%x devtype:%s;%s value=0x%x [%s]\n",
         ops_ptr->device_name, ops_ptr->index, ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset,
-        ops_ptr->attr_devtype, cpld_type? "cpld": "fpgai2c", sys_val, temp_data.cur_state.color);
+        ops_ptr->attr_devtype, ops_ptr->access->devtype, sys_val, temp_data.cur_state.color);
 #endif
     return(ret);
 }
@@ -220,13 +232,14 @@ ssize_t get_status_led(struct device_attribute *da)
 ssize_t set_status_led(struct device_attribute *da)
 {
     int ret=0;
-    uint32_t sys_val=0, new_val=0, read_val=0;
+    int sys_val=0;
+    uint32_t new_val=0, read_val=0;
     LED_STATUS cur_state = MAX_LED_STATUS;
     struct pddf_data_attribute *_ptr = (struct pddf_data_attribute *)da;
     LED_OPS_DATA* temp_data_ptr=(LED_OPS_DATA*)_ptr->addr;
     LED_OPS_DATA* ops_ptr=find_led_ops_data(da);
     char* _buf=temp_data_ptr->cur_state.color;
-    int cpld_type = 0;
+    const LED_ACCESS_OPS* access;
 
     if (!ops_ptr) {
         pddf_dbg(LED, KERN_ERR "PDDF_LED ERROR %s: Cannot find LED Ptr", __func__);
@@ -249,17 +262,14 @@ ssize_t set_status_led(struct device_attribute *da)
         return (-1);
     }
 
+    access = ops_ptr->data[cur_state].access;
     if (ops_ptr->data[cur_state].swpld_addr != 0x0) {
-        if (strcmp(ops_ptr->data[cur_state].attr_devtype, "cpld") == 0) {
-            cpld_type = 1;
-            sys_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-        } else if (strcmp(ops_ptr->data[cur_state].attr_devtype, "fpgai2c") == 0) {
-            sys_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-        } else {
+        if (!access) {
             pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s not configured\n",__func__,
                 ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype);
             return (-1);
         }
+        sys_val = access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
 
         if (sys_val < 0)
             return sys_val;
@@ -273,22 +283,13 @@ ssize_t set_status_led(struct device_attribute *da)
         return (-1);
     }
 
-    if (strcmp(ops_ptr->data[cur_state].attr_devtype, "cpld") == 0) {
-        ret = board_i2c_cpld_write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, new_val);
-        read_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else if (strcmp(ops_ptr->data[cur_state].attr_devtype, "fpgai2c") == 0) {
-        ret = board_i2c_fpga_write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, (uint8_t)new_val);
-        read_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else {
-        pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s not configured\n",__func__,
-            ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype);
-        return (-1);
-    }
+    ret = access->write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, (uint8_t)new_val);
+    read_val = access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
 
 #if DEBUG
     pddf_dbg(LED, KERN_INFO "Set color:%s; 0x%x:0x%x sys_val:0x%x new_val:0x%x devtype:%s w_ret:0x%x read:0x%x devtype:%s\n",
         LED_STATUS_STR[cur_state], ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, sys_val, new_val,
-        cpld_type? "cpld":"fpgai2c", ret, read_val, ops_ptr->data[cur_state].attr_devtype);
+        access->devtype, ret, read_val, ops_ptr->data[cur_state].attr_devtype);
 #endif
 
     return(ret);
@@ -394,9 +395,9 @@ ssize_t show_pddf_s3ip_data(struct device *dev, struct device_attribute *da,
        return -1;
     }
     LED_OPS_DATA* ops_ptr=(LED_OPS_DATA*)_ptr->addr;
-    uint32_t color_val=0, sys_val=0;
+    uint32_t color_val=0;
+    int sys_val=0;
     int state=0, j;
-    int cpld_type=0;
     if (!ops_ptr) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: Cannot find LED Ptr", __func__);
         return (-1);
@@ -406,16 +407,12 @@ ssize_t show_pddf_s3ip_data(struct device *dev, struct device_attribute *da,
             ops_ptr->device_name, ops_ptr->index);
         return (-1);
     }
-    if ( strcmp(ops_ptr->attr_devtype, "cpld") == 0) {
-        cpld_type=1;
-        sys_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else if ( strcmp(ops_ptr->attr_devtype, "fpgai2c") == 0) {
-        sys_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else {
+    if (!ops_ptr->access) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s 0x%x:0x%x not configured\n",__func__,
             ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype, ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
         return (-1);
     }
+    sys_val = ops_ptr->access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
 
     if (sys_val < 0) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s 0x%x:0x%x read failed\n",__func__,
@@ -434,7 +431,7 @@ ssize_t show_pddf_s3ip_data(struct device *dev, struct device_attribute *da,
 #if DEBUG
     pddf_dbg(LED, KERN_ERR "Get : %s:%d addr/offset:0x%x; 0x%x devtype:%s;%s value=0x%x [%d]\n",
         ops_ptr->device_name, ops_ptr->index, ops_ptr->swpld_addr,
-        ops_ptr->swpld_addr_offset, ops_ptr->attr_devtype, cpld_type? "cpld": "fpgai2c", sys_val, state);
+        ops_ptr->swpld_addr_offset, ops_ptr->attr_devtype, ops_ptr->access->devtype, sys_val, state);
 #endif
     return ret;
 }
@@ -443,48 +440,44 @@ ssize_t store_pddf_s3ip_data(struct device *dev, struct device_attribute *da, co
 {
     int ret = 0;
     int cur_state = 0;
-    uint32_t sys_val=0, new_val=0, read_val=0;
-    int cpld_type=0;
+    int sys_val=0;
+    uint32_t new_val=0, read_val=0;
+    const LED_ACCESS_OPS* access;
 
     pddf_dbg(LED, KERN_ERR "%s: %s;%d", __FUNCTION__, buf, cur_state);
     struct pddf_data_attribute *_ptr = (struct pddf_data_attribute *)da;
     ret = kstrtoint(buf,10,&cur_state);
-    if (_ptr == NULL || cur_state >= MAX_LED_STATUS || ret !=0) {
+    if (_ptr == NULL || _ptr->addr == NULL || cur_state < 0 || cur_state >= MAX_LED_STATUS || ret !=0) {
        pddf_dbg(LED, KERN_ERR "%s return", __FUNCTION__);
        return -1;
     }
     LED_OPS_DATA* ops_ptr=(LED_OPS_DATA*)_ptr->addr;
 
-    if ( strcmp(ops_ptr->attr_devtype, "cpld") == 0) {
-        cpld_type=1;
-        sys_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else if ( strcmp(ops_ptr->attr_devtype, "fpgai2c") == 0) {
-        sys_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else {
+    if (!ops_ptr->access) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s 0x%x:0x%x not configured\n",__func__,
             ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype, ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
         return (-1);
     }
+    sys_val = ops_ptr->access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
+    if (sys_val < 0)
+        return sys_val;
 
     new_val = (sys_val & ops_ptr->data[cur_state].bits.mask_bits) |
             (ops_ptr->data[cur_state].reg_values[0] << ops_ptr->data[cur_state].bits.pos);
 
-    if ( strcmp(ops_ptr->data[cur_state].attr_devtype, "cpld") == 0) {
-        ret = board_i2c_cpld_write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, new_val);
-        read_val = board_i2c_cpld_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else if ( strcmp(ops_ptr->data[cur_state].attr_devtype, "fpgai2c") == 0) {
-        ret = board_i2c_fpga_write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, (uint8_t)new_val);
-        read_val = board_i2c_fpga_read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
-    } else {
+    access = ops_ptr->data[cur_state].access;
+    if (!access) {
         pddf_dbg(LED, KERN_ERR "ERROR %s: %s %d devtype:%s not configured\n",__func__,
             ops_ptr->device_name, ops_ptr->index, ops_ptr->attr_devtype);
         return (-1);
     }
+    ret = access->write(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset, (uint8_t)new_val);
+    read_val = access->read(ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset);
 
 #if DEBUG
     pddf_dbg(LED, KERN_INFO "Set color:%s; 0x%x:0x%x sys_val:0x%x new_val:0x%x devtype:%s w_ret:0x%x read:0x%x devtype:%s\n",
         LED_STATUS_STR[cur_state], ops_ptr->swpld_addr, ops_ptr->swpld_addr_offset,
-        sys_val, new_val, cpld_type? "cpld":"fpgai2c", ret, read_val, ops_ptr->data[cur_state].attr_devtype);
+        sys_val, new_val, access->devtype, ret, read_val, ops_ptr->data[cur_state].attr_devtype);
 #endif
     return count;
 }
@@ -530,6 +523,8 @@ static int load_led_ops_data(struct device_attribute *da, LED_STATUS state)
     memcpy(ops_ptr->data[state].attr_devname, ptr->attr_devname, sizeof(ops_ptr->data[state].attr_devname));
     memcpy(ops_ptr->attr_devtype, ptr->attr_devtype, sizeof(ops_ptr->attr_devtype));
     memcpy(ops_ptr->attr_devname, ptr->attr_devname, sizeof(ops_ptr->attr_devname));
+    ops_ptr->data[state].access = led_access_find(ptr->attr_devtype);
+    ops_ptr->access = ops_ptr->data[state].access;
 #ifdef __STDC_LIB_EXT1__
     memset_s(ops_ptr->data[state].reg_values, sizeof(ops_ptr->data[state].reg_values), 0xff, sizeof(ops_ptr->data[state].reg_values));
 #else
@@ -29,8 +29,12 @@
 #include <linux/delay.h>
 #include <linux/dmi.h>
 #include <linux/kobject.h>
+#include <linux/ktime.h>
+#include <linux/bitmap.h>
+#include "pddf_client_defs.h"
 #include "pddf_psu_defs.h"
 #include "pddf_psu_driver.h"
+#include "pddf_psu_api.h"
 
 
 /*#define PSU_DEBUG*/
@@ -111,11 +115,38 @@ int psu_update_hw(struct device *dev, struct psu_attr_info *info, PSU_DATA_ATTR
 }
 
 
+/* Run the get functions of an attribute, the value goes to data->val */
+static int psu_attr_get(struct i2c_client *client, PSU_DATA_ATTR *udata, struct psu_attr_info *data)
+{
+    int status = 0, ret = 0;
+    PSU_SYSFS_ATTR_DATA *sysfs_attr_data = udata->access_data;
+
+    if (sysfs_attr_data->pre_get != NULL)
+    {
+        status = (sysfs_attr_data->pre_get)(client, udata, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
+    }
+    if (sysfs_attr_data->do_get != NULL)
+    {
+        ret = status = (sysfs_attr_data->do_get)(client, udata, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
+
+    }
+    if (sysfs_attr_data->post_get != NULL)
+    {
+        status = (sysfs_attr_data->post_get)(client, udata, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
+    }
+
+    return ret;
+}
+
 int psu_update_attr(struct device *dev, struct psu_attr_info *data, PSU_DATA_ATTR *udata)
 {
-    int status = 0;
     struct i2c_client *client = to_i2c_client(dev);
-    PSU_SYSFS_ATTR_DATA *sysfs_attr_data=NULL;
 
     mutex_lock(&data->update_lock);
 
@@ -123,26 +154,7 @@ int psu_update_attr(struct device *dev, struct psu_attr_info *data, PSU_DATA_ATT
     {
         dev_dbg(&client->dev, "Starting update for %s\n", data->name);
 
-        sysfs_attr_data = udata->access_data;
-        if (sysfs_attr_data->pre_get != NULL)
-        {
-            status = (sysfs_attr_data->pre_get)(client, udata, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
-        }
-        if (sysfs_attr_data->do_get != NULL)
-        {
-            status = (sysfs_attr_data->do_get)(client, udata, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
-
-        }
-        if (sysfs_attr_data->post_get != NULL)
-        {
-            status = (sysfs_attr_data->post_get)(client, udata, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, udata->aname, status);
-        }
+        psu_attr_get(client, udata, data);
 
         data->last_updated = jiffies;
         data->valid = 1;
@@ -152,6 +164,171 @@ int psu_update_attr(struct device *dev, struct psu_attr_info *data, PSU_DATA_ATT
     return 0;
 }
 
+/* Attributes read by the sweeps, the strings are static and read on demand */
+static int psu_attr_sampled(PSU_DATA_ATTR *udata)
+{
+    PSU_SYSFS_ATTR_DATA *ptr = (PSU_SYSFS_ATTR_DATA *)udata->access_data;
+
+    return (ptr != NULL) && (ptr->show == psu_show_default) && (ptr->do_get != NULL) &&
+        (ptr->do_get != sonic_i2c_get_psu_block_default);
+}
+
+/* Lockless read of an attribute from the last sweep */
+static int psu_sample_read(struct psu_sampler *sampler, int idx, union psu_attr_val *val)
+{
+    struct psu_sample_snapshot *snap;
+    unsigned int seq;
+    int valid;
+
+    if (!READ_ONCE(sampler->period_ms))
+        return -ENODATA;
+
+    do {
+        snap = &sampler->snap[smp_load_acquire(&sampler->cur)];
+        seq = read_seqcount_begin(&snap->seq);
+        valid = test_bit(idx, snap->valid);
+        *val = snap->val[idx];
+    } while (read_seqcount_retry(&snap->seq, seq));
+
+    return valid ? 0 : -ENODATA;
+}
+
+static void psu_sample_sweep(struct i2c_client *client)
+{
+    struct psu_data *data = i2c_get_clientdata(client);
+    PSU_PDATA *pdata = (PSU_PDATA *)(client->dev.platform_data);
+    struct psu_sampler *sampler = &data->sampler;
+    struct psu_sample_snapshot *snap;
+    struct psu_attr_info scratch;
+    int i, back;
+
+    mutex_lock(&sampler->lock);
+
+    for (i = 0; i < sampler->num_window; i++)
+        board_i2c_cpld_window_fill(&sampler->window[i]);
+
+    back = !sampler->cur;
+    snap = &sampler->snap[back];
+    write_seqcount_begin(&snap->seq);
+    bitmap_zero(snap->valid, MAX_PSU_ATTRS);
+    for (i = 0; i < data->num_attr; i++)
+    {
+        if (!psu_attr_sampled(&pdata->psu_attrs[i]))
+            continue;
+        memset(&scratch.val, 0, sizeof(scratch.val));
+        if (psu_attr_get(client, &pdata->psu_attrs[i], &scratch) == 0)
+        {
+            snap->val[i] = scratch.val;
+            set_bit(i, snap->valid);
+        }
+    }
+    snap->timestamp = ktime_get_ns();
+    write_seqcount_end(&snap->seq);
+    smp_store_release(&sampler->cur, back);
+    sampler->sweeps++;
+
+    /* The windows only serve this sweep */
+    for (i = 0; i < sampler->num_window; i++)
+        board_i2c_cpld_window_invalidate(&sampler->window[i]);
+
+    mutex_unlock(&sampler->lock);
+}
+
+static void psu_sample_work(struct work_struct *work)
+{
+    struct psu_sampler *sampler = container_of(to_delayed_work(work), struct psu_sampler, work);
+    unsigned int period_ms;
+
+    psu_sample_sweep(sampler->client);
+
+    period_ms = READ_ONCE(sampler->period_ms);
+    if (period_ms)
+        schedule_delayed_work(&sampler->work, msecs_to_jiffies(period_ms));
+}
+
+void psu_sample_init(struct i2c_client *client, unsigned int period_ms)
+{
+    struct psu_data *data = i2c_get_clientdata(client);
+    PSU_PDATA *pdata = (PSU_PDATA *)(client->dev.platform_data);
+    struct psu_sampler *sampler = &data->sampler;
+    PSU_DATA_ATTR *udata;
+    int i, w;
+
+    sampler->client = client;
+    mutex_init(&sampler->lock);
+    seqcount_mutex_init(&sampler->snap[0].seq, &sampler->lock);
+    seqcount_mutex_init(&sampler->snap[1].seq, &sampler->lock);
+    INIT_DELAYED_WORK(&sampler->work, psu_sample_work);
+
+    /* Status bits of the PSUs usually share CPLD registers, read them once */
+    for (i = 0; i < data->num_attr; i++)
+    {
+        udata = &pdata->psu_attrs[i];
+        udata->window = NULL;
+        if (!psu_attr_sampled(udata) || (strncmp(udata->devtype, "cpld", strlen("cpld")) != 0))
+            continue;
+        w = board_i2c_cpld_window_add(sampler->window, &sampler->num_window, PSU_SAMPLE_WINDOWS,
+                udata->devaddr, udata->offset);
+        if (w >= 0)
+            udata->window = &sampler->window[w];
+    }
+
+    psu_sample_period_set(client, period_ms);
+}
+EXPORT_SYMBOL(psu_sample_init);
+
+int psu_sample_period_set(struct i2c_client *client, unsigned int period_ms)
+{
+    struct psu_data *data = i2c_get_clientdata(client);
+    struct psu_sampler *sampler = &data->sampler;
+
+    WRITE_ONCE(sampler->period_ms, period_ms);
+    if (period_ms)
+        mod_delayed_work(system_wq, &sampler->work, 0);
+    else
+        cancel_delayed_work_sync(&sampler->work);
+
+    return 0;
+}
+EXPORT_SYMBOL(psu_sample_period_set);
+
+/* Time of the last sweep in ktime_get_ns() (CLOCK_MONOTONIC) ns, 0 if none */
+u64 psu_sample_timestamp(struct i2c_client *client)
+{
+    struct psu_data *data = i2c_get_clientdata(client);
+    struct psu_sampler *sampler = &data->sampler;
+    struct psu_sample_snapshot *snap;
+    unsigned int seq;
+    u64 timestamp;
+
+    do {
+        snap = &sampler->snap[smp_load_acquire(&sampler->cur)];
+        seq = read_seqcount_begin(&snap->seq);
+        timestamp = snap->timestamp;
+    } while (read_seqcount_retry(&snap->seq, seq));
+
+    return timestamp;
+}
+EXPORT_SYMBOL(psu_sample_timestamp);
+
+void psu_sample_stop(struct i2c_client *client)
+{
+    psu_sample_period_set(client, 0);
+}
+EXPORT_SYMBOL(psu_sample_stop);
+
+/* Value of an attribute from the last sweep, or read now if the sweep has none */
+static void psu_attr_value(struct device *dev, struct psu_attr_info *info, PSU_DATA_ATTR *udata, union psu_attr_val *val)
+{
+    struct psu_data *data = i2c_get_clientdata(to_i2c_client(dev));
+
+    if (psu_sample_read(&data->sampler, info - data->attr_info, val) == 0)
+        return;
+
+    psu_update_attr(dev, info, udata);
+    *val = info->val;
+}
+
 ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *buf)
 {
     struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
@@ -166,6 +343,7 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
     int multiplier = 1000;
     char new_str[ATTR_NAME_LEN] = "";
     PSU_SYSFS_ATTR_DATA *ptr = NULL;
+    union psu_attr_val val;
 
     for (i=0;i<data->num_attr;i++)
     {
@@ -185,20 +363,20 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
         goto exit;
     }
 
-    psu_update_attr(dev, sysfs_attr_info, usr_data);
+    psu_attr_value(dev, sysfs_attr_info, usr_data, &val);
 
     switch(attr->index)
     {
         case PSU_PRESENT:
         case PSU_POWER_GOOD:
-            status = sysfs_attr_info->val.intval;
+            status = val.intval;
             return sprintf(buf, "%d\n", status);
             break;
         case PSU_MODEL_NAME:
         case PSU_MFR_ID:
         case PSU_SERIAL_NUM:
         case PSU_FAN_DIR:
-            return sprintf(buf, "%s\n", sysfs_attr_info->val.strval);
+            return sprintf(buf, "%s\n", val.strval);
             break;
         case PSU_V_OUT:
         case PSU_V_OUT_MIN:
@@ -208,7 +386,7 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
         case PSU_I_IN:
         case PSU_P_OUT_MAX:
             multiplier = 1000;
-            value = sysfs_attr_info->val.shortval;
+            value = val.shortval;
             exponent = two_complement_to_int(value >> 11, 5, 0x1f);
             mantissa = two_complement_to_int(value & 0x7ff, 11, 0x7ff);
             if (exponent >= 0)
@@ -220,7 +398,7 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
         case PSU_P_IN:
         case PSU_P_OUT:
             multiplier = 1000000;
-            value = sysfs_attr_info->val.shortval;
+            value = val.shortval;
             exponent = two_complement_to_int(value >> 11, 5, 0x1f);
             mantissa = two_complement_to_int(value & 0x7ff, 11, 0x7ff);
             if (exponent >= 0)
@@ -230,7 +408,7 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
 
             break;
         case PSU_FAN1_SPEED:
-            value = sysfs_attr_info->val.shortval;
+            value = val.shortval;
             exponent = two_complement_to_int(value >> 11, 5, 0x1f);
             mantissa = two_complement_to_int(value & 0x7ff, 11, 0x7ff);
             if (exponent >= 0)
@@ -242,7 +420,7 @@ ssize_t psu_show_default(struct device *dev, struct device_attribute *da, char *
         case PSU_TEMP1_INPUT:
         case PSU_TEMP1_HIGH_THRESHOLD:
             multiplier = 1000;
-            value = sysfs_attr_info->val.shortval;
+            value = val.shortval;
             exponent = two_complement_to_int(value >> 11, 5, 0x1f);
             mantissa = two_complement_to_int(value & 0x7ff, 11, 0x7ff);
             if (exponent >= 0)
@@ -307,7 +485,9 @@ int sonic_i2c_get_psu_byte_default(void *client, PSU_DATA_ATTR *adata, void *dat
 
     if (strncmp(adata->devtype, "cpld", strlen("cpld")) == 0)
     {
-        val = board_i2c_cpld_read(adata->devaddr , adata->offset);
+        val = board_i2c_cpld_window_read(adata->window, adata->devaddr, adata->offset);
+        if (val < 0)
+            val = board_i2c_cpld_read(adata->devaddr , adata->offset);
         if (val < 0)
             return val;
         padata->val.intval =  ((val & adata->mask) == adata->cmpval);
@@ -327,9 +507,15 @@ int sonic_i2c_get_psu_block_default(void *client, PSU_DATA_ATTR *adata, void *da
 
     while (retry)
     {
+        u64 start_ns = ktime_get_ns();
+
         status = i2c_smbus_read_i2c_block_data((struct i2c_client *)client, offset, data_len-1, buf);
+        pddf_stats_xfer(((struct i2c_client *)client)->adapter, ((struct i2c_client *)client)->addr,
+                        ((struct i2c_client *)client)->name, status, start_ns, 0);
         if (unlikely(status<0))
         {
+            pddf_stats_retry(((struct i2c_client *)client)->adapter, ((struct i2c_client *)client)->addr,
+                             ((struct i2c_client *)client)->name);
             msleep(60);
             retry--;
             continue;
@@ -364,8 +550,14 @@ int sonic_i2c_get_psu_word_default(void *client, PSU_DATA_ATTR *adata, void *dat
     uint8_t offset = (uint8_t)adata->offset;
 
     while (retry) {
+        u64 start_ns = ktime_get_ns();
+
         status = i2c_smbus_read_word_data((struct i2c_client *)client, offset);
+        pddf_stats_xfer(((struct i2c_client *)client)->adapter, ((struct i2c_client *)client)->addr,
+                        ((struct i2c_client *)client)->name, status, start_ns, 0);
         if (unlikely(status < 0)) {
+            pddf_stats_retry(((struct i2c_client *)client)->adapter, ((struct i2c_client *)client)->addr,
+                             ((struct i2c_client *)client)->name);
             msleep(60);
             retry--;
             continue;
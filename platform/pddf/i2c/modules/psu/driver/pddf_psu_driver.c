@@ -37,6 +37,11 @@
 
 static unsigned short normal_i2c[] = { I2C_CLIENT_END };
 
+/* Default period of the attribute sweeps, 0 reads the attributes on demand */
+static unsigned int sample_period_ms = 0;
+module_param(sample_period_ms, uint, 0644);
+MODULE_PARM_DESC(sample_period_ms, "Default period of the psu attribute sweeps in ms, 0 to disable");
+
 struct pddf_ops_t pddf_psu_ops = {
 	.pre_init = NULL,
 	.post_init = NULL,
@@ -129,6 +134,40 @@ PSU_SYSFS_ATTR_DATA_ENTRY psu_sysfs_attr_data_tbl[]=
 	{ "psu_p_in" , &access_psu_p_in}
 };
 
+static ssize_t sample_period_ms_show(struct device *dev, struct device_attribute *da, char *buf)
+{
+	struct psu_data *data = i2c_get_clientdata(to_i2c_client(dev));
+
+	return sprintf(buf, "%u\n", READ_ONCE(data->sampler.period_ms));
+}
+
+static ssize_t sample_period_ms_store(struct device *dev, struct device_attribute *da, const char *buf, size_t count)
+{
+	unsigned int period_ms;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &period_ms);
+	if (ret)
+		return ret;
+
+	psu_sample_period_set(to_i2c_client(dev), period_ms);
+	return count;
+}
+
+static ssize_t sample_timestamp_show(struct device *dev, struct device_attribute *da, char *buf)
+{
+	return sprintf(buf, "%llu\n", (unsigned long long)psu_sample_timestamp(to_i2c_client(dev)));
+}
+
+static DEVICE_ATTR_RW(sample_period_ms);
+static DEVICE_ATTR_RO(sample_timestamp);
+
+static struct attribute *psu_sample_attrs[] = {
+	&dev_attr_sample_period_ms.attr,
+	&dev_attr_sample_timestamp.attr,
+	NULL
+};
+
 void *get_psu_access_data(char *name)
 {
 	int i=0;
@@ -234,8 +273,13 @@ static int psu_probe(struct i2c_client *client,
 			strcpy(new_str,"");
 		}
 	}
-	data->psu_attribute_list[i+j] = NULL;
+	status = pddf_attr_list_append(data->psu_attribute_list, i+j, MAX_PSU_ATTRS, psu_sample_attrs);
+	if (status) {
+		printk(KERN_ERR "%s: No room for the sampler attributes\n", __FUNCTION__);
+		goto exit_free;
+	}
 	data->psu_attribute_group.attrs = data->psu_attribute_list;
+	psu_sample_init(client, 0);
 
     /* Register sysfs hooks */
     status = sysfs_create_group(&client->dev.kobj, &data->psu_attribute_group);
@@ -260,17 +304,21 @@ static int psu_probe(struct i2c_client *client,
             goto exit_remove;
     }
 
+    psu_sample_period_set(client, sample_period_ms);
+
     return 0;
 
 
 exit_remove:
     sysfs_remove_group(&client->dev.kobj, &data->psu_attribute_group);
+    psu_sample_stop(client);
 exit_free:
 	/* Free all the allocated attributes */
 	for (i=0;data->psu_attribute_list[i]!=NULL;i++)
 	{
 		struct sensor_device_attribute *ptr = (struct sensor_device_attribute *)data->psu_attribute_list[i];
-		kfree(ptr);
+		if (!pddf_attr_shared(data->psu_attribute_list[i], psu_sample_attrs))
+			kfree(ptr);
 		data->psu_attribute_list[i] = NULL;
 		pddf_dbg(PSU, KERN_ERR "%s: Freed all the memory allocated for attributes\n", __FUNCTION__);
 	}
@@ -294,12 +342,14 @@ static void psu_remove(struct i2c_client *client)
             printk(KERN_ERR "FAN pre_remove function failed\n");
     }
 
+	psu_sample_stop(client);
 	hwmon_device_unregister(data->hwmon_dev);
 	sysfs_remove_group(&client->dev.kobj, &data->psu_attribute_group);
 	for (i=0; data->psu_attribute_list[i]!=NULL; i++)
     {
         ptr = (struct sensor_device_attribute *)data->psu_attribute_list[i];
-		kfree(ptr);
+		if (!pddf_attr_shared(data->psu_attribute_list[i], psu_sample_attrs))
+			kfree(ptr);
 		data->psu_attribute_list[i] = NULL;
 	}
     pddf_dbg(PSU, KERN_ERR "%s: Freed all the memory allocated for attributes\n", __FUNCTION__);
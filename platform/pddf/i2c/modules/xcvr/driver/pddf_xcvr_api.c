@@ -29,7 +29,10 @@
 #include <linux/delay.h>
 #include <linux/dmi.h>
 #include <linux/kobject.h>
+#include <linux/ktime.h>
+#include "pddf_client_defs.h"
 #include "pddf_xcvr_defs.h"
+#include "pddf_xcvr_api.h"
 
 /*#define SFP_DEBUG*/
 #ifdef SFP_DEBUG
@@ -45,9 +48,6 @@ extern int (*ptr_fpgapci_write)(uint32_t, uint32_t);
 
 
 
-int get_xcvr_module_attr_data(struct i2c_client *client, struct device *dev,
-                            struct device_attribute *da);
-
 int xcvr_i2c_cpld_read(XCVR_ATTR *info)
 {
     int status = -1;
@@ -56,43 +56,57 @@ int xcvr_i2c_cpld_read(XCVR_ATTR *info)
 
     if (info!=NULL)
     {
-        /* Get the I2C client for the CPLD */
-        client_ptr = (struct i2c_client *)get_device_table(info->devname);
-        if (client_ptr)
+        if (info->len==1)
         {
-            if (info->len==1)
+            /* The CPLD client is cached in the attribute, no lookup here */
+            while (retry)
             {
-                while (retry)
+                status = board_i2c_cpld_read_cached(&info->cpld, info->devaddr, info->devname, info->offset);
+                if (unlikely(status == -EPERM))
                 {
-                    status = board_i2c_cpld_read_new(info->devaddr, info->devname, info->offset);
-                    if (unlikely(status < 0))
-                    {
-                        msleep(60);
-                        retry--;
-                        continue;
-                    }
+                    printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
                     break;
                 }
+                if (unlikely(status < 0))
+                {
+                    board_i2c_cpld_retry(&info->cpld, info->devaddr, info->devname);
+                    msleep(60);
+                    retry--;
+                    continue;
+                }
+                break;
             }
-            else if (info->len==2)
+        }
+        else
+        {
+            /* Get the I2C client for the CPLD */
+            client_ptr = (struct i2c_client *)get_device_table(info->devname);
+            if (client_ptr)
             {
-                while(retry)
+                if (info->len==2)
                 {
-                    status = i2c_smbus_read_word_swapped(client_ptr, info->offset);
-                    if (unlikely(status < 0))
+                    while(retry)
                     {
-                        msleep(60);
-                        retry--;
-                        continue;
+                        u64 start_ns = ktime_get_ns();
+
+                        status = i2c_smbus_read_word_swapped(client_ptr, info->offset);
+                        pddf_stats_xfer(client_ptr->adapter, client_ptr->addr, info->devname, status, start_ns, 0);
+                        if (unlikely(status < 0))
+                        {
+                            pddf_stats_retry(client_ptr->adapter, client_ptr->addr, info->devname);
+                            msleep(60);
+                            retry--;
+                            continue;
+                        }
+                        break;
                     }
-                    break;
                 }
+                else
+                    printk(KERN_ERR "PDDF_XCVR: Doesn't support block CPLD read yet");
             }
             else
-                printk(KERN_ERR "PDDF_XCVR: Doesn't support block CPLD read yet");
+                printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
         }
-        else
-            printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
     }
 
     return status;
@@ -106,13 +120,22 @@ int xcvr_i2c_cpld_write(XCVR_ATTR *info, uint32_t val)
     struct i2c_client *client_ptr=NULL;
 
     val_mask = BIT_INDEX(info->mask);
-    /* Get the I2C client for the CPLD */
-    client_ptr = (struct i2c_client *)get_device_table(info->devname);
 
-    if (client_ptr)
+    if (info->len == 1)
     {
-        if (info->len == 1)
-            status = board_i2c_cpld_read_new(info->devaddr, info->devname, info->offset);
+        status = board_i2c_cpld_read_cached(&info->cpld, info->devaddr, info->devname, info->offset);
+        if (status == -EPERM)
+            printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
+    }
+    else
+    {
+        /* Get the I2C client for the CPLD */
+        client_ptr = (struct i2c_client *)get_device_table(info->devname);
+        if (client_ptr == NULL)
+        {
+            printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
+            status = -1;
+        }
         else if (info->len == 2)
             status = i2c_smbus_read_word_swapped(client_ptr, info->offset);
         else
@@ -121,11 +144,6 @@ int xcvr_i2c_cpld_write(XCVR_ATTR *info, uint32_t val)
             status = -1;
         }
     }
-    else
-    {
-        printk(KERN_ERR "Unable to get the client handle for %s\n", info->devname);
-        status = -1;
-    }
 
     if (status < 0)
         return status;
@@ -138,7 +156,7 @@ int xcvr_i2c_cpld_write(XCVR_ATTR *info, uint32_t val)
         else
             reg = dnd_value;
         if (info->len == 1)
-            status = board_i2c_cpld_write_new(info->devaddr, info->devname, info->offset, (uint8_t)reg);
+            status = board_i2c_cpld_write_cached(&info->cpld, info->devaddr, info->devname, info->offset, (uint8_t)reg);
         else if (info->len == 2)
             status = i2c_smbus_write_word_swapped(client_ptr, info->offset, (uint16_t)reg);
         else
@@ -166,9 +184,13 @@ int xcvr_i2c_fpga_read(XCVR_ATTR *info)
             {
                 while(retry)
                 {
+                    u64 start_ns = ktime_get_ns();
+
                     status = i2c_smbus_read_byte_data(client_ptr , info->offset);
+                    pddf_stats_xfer(client_ptr->adapter, client_ptr->addr, info->devname, status, start_ns, 0);
                     if (unlikely(status < 0))
                     {
+                        pddf_stats_retry(client_ptr->adapter, client_ptr->addr, info->devname);
                         msleep(60);
                         retry--;
                         continue;
@@ -181,9 +203,13 @@ int xcvr_i2c_fpga_read(XCVR_ATTR *info)
                 retry = 10;
                 while(retry)
                 {
+                    u64 start_ns = ktime_get_ns();
+
                     status = i2c_smbus_read_word_swapped(client_ptr, info->offset);
+                    pddf_stats_xfer(client_ptr->adapter, client_ptr->addr, info->devname, status, start_ns, 0);
                     if (unlikely(status < 0))
                     {
+                        pddf_stats_retry(client_ptr->adapter, client_ptr->addr, info->devname);
                         msleep(60);
                         retry--;
                         continue;
@@ -293,872 +319,678 @@ int xcvr_fpgapci_write(XCVR_ATTR *info, uint32_t val)
     return status;
 }
 
-int sonic_i2c_get_mod_pres(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+/*
+ * Attribute dispatch.
+ *
+ * The devtype of an attribute is resolved to its register accessors once at
+ * probe time, and every port keeps its attributes indexed by sysfs attribute,
+ * so an access neither walks the attribute list nor compares strings.
+ */
+static const struct
 {
-    int status = 0;
-    uint32_t modpres = 0;
+    const char *devtype;
+    XCVR_ACCESS_OPS ops;
+} xcvr_access_types[] = {
+    {"cpld", {xcvr_i2c_cpld_read, xcvr_i2c_cpld_write}},
+    {"fpgai2c", {xcvr_i2c_fpga_read, xcvr_i2c_fpga_write}},
+    {"fpgapci", {xcvr_fpgapci_read, xcvr_fpgapci_write}},
+};
+
+static const struct
+{
+    const char *aname;
+    int (*do_get)(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data);
+    size_t offset;
+} xcvr_attr_defs[XCVR_ATTR_MAX] = {
+    [XCVR_PRESENT]      = {"xcvr_present", sonic_i2c_get_mod_pres, offsetof(struct xcvr_data, modpres)},
+    [XCVR_RESET]        = {"xcvr_reset", sonic_i2c_get_mod_reset, offsetof(struct xcvr_data, reset)},
+    [XCVR_INTR_STATUS]  = {"xcvr_intr_status", sonic_i2c_get_mod_intr_status, offsetof(struct xcvr_data, intr_status)},
+    [XCVR_LPMODE]       = {"xcvr_lpmode", sonic_i2c_get_mod_lpmode, offsetof(struct xcvr_data, lpmode)},
+    [XCVR_RXLOS]        = {"xcvr_rxlos", sonic_i2c_get_mod_rxlos, offsetof(struct xcvr_data, rxlos)},
+    [XCVR_TXDISABLE]    = {"xcvr_txdisable", sonic_i2c_get_mod_txdisable, offsetof(struct xcvr_data, txdisable)},
+    [XCVR_TXFAULT]      = {"xcvr_txfault", sonic_i2c_get_mod_txfault, offsetof(struct xcvr_data, txfault)},
+};
+
+/* Value of an attribute in the client data */
+#define XCVR_ATTR_VAL(data, idx)    (*(uint32_t *)((char *)(data) + xcvr_attr_defs[idx].offset))
+
+int xcvr_attr_resolve(struct i2c_client *client, XCVR_ATTR *info)
+{
+    struct xcvr_data *data = i2c_get_clientdata(client);
+    int i;
 
-    if ( strcmp(info->devtype, "cpld") == 0)
+    info->index = -1;
+    for (i = 0; i < XCVR_ATTR_MAX; i++)
     {
-        status = xcvr_i2c_cpld_read(info);
-
-        if (status < 0)
-            return status;
-        else
+        if (strcmp(info->aname, xcvr_attr_defs[i].aname) == 0)
         {
-            modpres = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod presence :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
+            info->index = i;
+            break;
         }
     }
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
 
-        if (status < 0)
-            return status;
-        else
-        {
-            modpres = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod presence :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgapci") == 0)
+    info->access = NULL;
+    for (i = 0; i < ARRAY_SIZE(xcvr_access_types); i++)
     {
-        status = xcvr_fpgapci_read(info);
-
-        if (status < 0)
-            return status;
-        else
+        if (strcmp(info->devtype, xcvr_access_types[i].devtype) == 0)
         {
-            modpres = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod presence :0x%x, status= 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
+            info->access = &xcvr_access_types[i].ops;
+            break;
         }
     }
 
-    else if(strcmp(info->devtype, "eeprom") == 0)
-    {
-        /* get client client for eeprom -  Not Applicable */
-    }
-    data->modpres = modpres;
+    /* Look the CPLD client up once, the accessors use the cached one */
+    if ((info->access == &xcvr_access_types[0].ops) && (info->len == 1))
+        board_i2c_cpld_handle_init(&info->cpld, info->devaddr, info->devname);
+
+    if (info->index < 0)
+        return -EINVAL;
+
+    /* The first description of an attribute wins */
+    if (data->attrs[info->index] == NULL)
+        data->attrs[info->index] = info;
 
     return 0;
 }
+EXPORT_SYMBOL(xcvr_attr_resolve);
 
-int sonic_i2c_get_mod_reset(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+/* Read the bit behind an attribute, 'eeprom' attributes read as 0 */
+static int xcvr_attr_bit_read(XCVR_ATTR *info, uint32_t *val)
 {
-    int status = 0;
-    uint32_t modreset=0;
+    int status;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            modreset = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod Reset :0x%x, reg_value = 0x%x\n", modreset, status);
-        }
-    } 
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
+    *val = 0;
+    if (info->access == NULL)
+        return 0;
 
-        if (status < 0)
-            return status;
-        else
-        {
-            modreset = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod reset :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgapci") == 0)
-    {
-        status = xcvr_fpgapci_read(info);
-        sfp_dbg(KERN_INFO "\n[%s] status=%x\n", __FUNCTION__, status);
-        if (status < 0)
-            return status;
-        else
-        {
-            modreset = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nMod reset :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modreset, status, info->devaddr, info->mask, info->offset);
-        }
-    }
-    else if(strcmp(info->devtype, "eeprom") == 0)
+    status = info->access->read(info);
+    if (status < 0)
+        return status;
+
+    *val = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
+    sfp_dbg(KERN_INFO "\n%s :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", info->aname, *val, status, info->devaddr, info->mask, info->offset);
+
+    return 0;
+}
+
+static int xcvr_attr_bit_write(XCVR_ATTR *info, uint32_t val)
+{
+    if (info->access == NULL)
     {
-        /* get client client for eeprom -  Not Applicable */
+        printk(KERN_ERR "Error: Invalid device type (%s) to set %s\n", info->devtype, info->aname);
+        return -1;
     }
 
-    data->reset = modreset;
+    return info->access->write(info, val);
+}
+
+int sonic_i2c_get_mod_pres(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+{
+    uint32_t modpres;
+    int status;
+
+    status = xcvr_attr_bit_read(info, &modpres);
+    if (status < 0)
+        return status;
+
+    data->modpres = modpres;
     return 0;
 }
 
-int sonic_i2c_get_mod_intr_status(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+int sonic_i2c_get_mod_reset(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
-    uint32_t mod_intr = 0;
+    uint32_t modreset;
+    int status;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            mod_intr = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule Interrupt :0x%x, reg_value = 0x%x\n", mod_intr, status);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
+    status = xcvr_attr_bit_read(info, &modreset);
+    if (status < 0)
+        return status;
 
-        if (status < 0)
-            return status;
-        else
-        {
-            mod_intr = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule Interrupt :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgapci") == 0)
-    {
-        status = xcvr_fpgapci_read(info);
-        sfp_dbg(KERN_INFO "\n[%s] status=%x\n", __FUNCTION__, status);
-        if (status < 0)
-            return status;
-        else
-        {
-            mod_intr = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule Interrupt :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", mod_intr, status, info->devaddr, info->mask, info->offset);
-        }
-    }
+    data->reset = modreset;
+    return 0;
+}
 
-    else if(strcmp(info->devtype, "eeprom") == 0)
-    {
-        /* get client client for eeprom -  Not Applicable */
-    }
+int sonic_i2c_get_mod_intr_status(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+{
+    uint32_t mod_intr;
+    int status;
+
+    status = xcvr_attr_bit_read(info, &mod_intr);
+    if (status < 0)
+        return status;
 
     data->intr_status = mod_intr;
     return 0;
 }
 
-
 int sonic_i2c_get_mod_lpmode(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
-    uint32_t lpmode = 0;
+    uint32_t lpmode;
+    int status;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            lpmode = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule LPmode :0x%x, reg_value = 0x%x\n", lpmode, status);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
+    status = xcvr_attr_bit_read(info, &lpmode);
+    if (status < 0)
+        return status;
 
-        if (status < 0)
-            return status;
-        else
-        {
-            lpmode = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule LPmode :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgapci") == 0)
-    {
-        status = xcvr_fpgapci_read(info);
-        sfp_dbg(KERN_INFO "\n[%s] status=%x\n", __FUNCTION__, status);
-        if (status < 0)
-            return status;
-        else
-        {
-            lpmode = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nlpmode :0x%x, reg_val = 0x%x, op=0x%x, mask=0x%x, offset=0x%x\n", lpmode, status, status & BIT_INDEX(info->mask), info->mask, info->offset);
-        }
-    }
-    else if (strcmp(info->devtype, "eeprom") == 0)
-    {
-        /* get client client for eeprom -  Not Applicable */
-    }
-    
     data->lpmode = lpmode;
     return 0;
 }
 
 int sonic_i2c_get_mod_rxlos(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
-    uint32_t rxlos = 0;
+    uint32_t rxlos;
+    int status;
 
+    status = xcvr_attr_bit_read(info, &rxlos);
+    if (status < 0)
+        return status;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            rxlos = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule RxLOS :0x%x, reg_value = 0x%x\n", rxlos, status);
-        }
-    } 
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
-
-        if (status < 0)
-            return status;
-        else
-        {
-            rxlos = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule RxLOS :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
     data->rxlos = rxlos;
-
     return 0;
 }
 
 int sonic_i2c_get_mod_txdisable(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
-    uint32_t txdis = 0;
+    uint32_t txdis;
+    int status;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            txdis = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule TxDisable :0x%x, reg_value = 0x%x\n", txdis, status);
-        }
-    }
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
+    status = xcvr_attr_bit_read(info, &txdis);
+    if (status < 0)
+        return status;
 
-        if (status < 0)
-            return status;
-        else
-        {
-            txdis = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule TxDisable :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
     data->txdisable = txdis;
-
     return 0;
 }
 
 int sonic_i2c_get_mod_txfault(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
-    uint32_t txflt = 0;
-
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_read(info);
-        if (status < 0)
-            return status;
-        else
-        {
-            txflt = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule TxFault :0x%x, reg_value = 0x%x\n", txflt, status);
-        }
+    uint32_t txflt;
+    int status;
 
-    } 
-    else if ( strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_read(info);
+    status = xcvr_attr_bit_read(info, &txflt);
+    if (status < 0)
+        return status;
 
-        if (status < 0)
-            return status;
-        else
-        {
-            txflt = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
-            sfp_dbg(KERN_INFO "\nModule Txfault :0x%x, reg_value = 0x%x, devaddr=0x%x, mask=0x%x, offset=0x%x\n", modpres, status, info->devaddr, info->mask, info->offset);
-        }
-    }
     data->txfault = txflt;
-
     return 0;
 }
 
 int sonic_i2c_set_mod_reset(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
 {
-    int status = 0;
+    return xcvr_attr_bit_write(info, data->reset);
+}
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_write(info, data->reset);
-    }
-    else if (strcmp(info->devtype, "fpgai2c") == 0)
-    {
-        status = xcvr_i2c_fpga_write(info, data->reset);
-    }
-    else if (strcmp(info->devtype, "fpgapci") == 0)
-    {
-        status = xcvr_fpgapci_write(info, data->reset);
-    }
-    else
-    {
-        printk(KERN_ERR "Error: Invalid device type (%s) to set xcvr reset\n", info->devtype);
-        status = -1;
-    }
+int sonic_i2c_set_mod_lpmode(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+{
+    return xcvr_attr_bit_write(info, data->lpmode);
+}
 
-    return status;
+int sonic_i2c_set_mod_txdisable(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+{
+    return xcvr_attr_bit_write(info, data->txdisable);
 }
 
-int sonic_i2c_set_mod_lpmode(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+static ssize_t xcvr_attr_show(struct device *dev, struct device_attribute *da, char *buf)
 {
+    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
+    struct i2c_client *client = to_i2c_client(dev);
+    struct xcvr_data *data = i2c_get_clientdata(client);
+    XCVR_ATTR *attr_data = data->attrs[attr->index];
+    XCVR_SYSFS_ATTR_OPS *attr_ops = &xcvr_ops[attr->index];
+    uint32_t val;
     int status = 0;
 
-    if (strcmp(info->devtype, "cpld") == 0)
-    {
-        status = xcvr_i2c_cpld_write(info, data->lpmode);
-    }
-    else if (strcmp(info->devtype, "fpgai2c") == 0)
+    if (attr_data == NULL)
+        return sprintf(buf, "%s", "");
+
+    mutex_lock(&data->update_lock);
+    if (attr_ops->pre_get != NULL)
     {
-        status = xcvr_i2c_fpga_write(info, data->lpmode);
+        status = (attr_ops->pre_get)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
-    else if (strcmp(info->devtype, "fpgapci") == 0)
+    if (attr_ops->do_get != NULL)
     {
-        status = xcvr_fpgapci_write(info, data->lpmode);
+        status = (attr_ops->do_get)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
-    else
+    if (attr_ops->post_get != NULL)
     {
-        printk(KERN_ERR "Error: Invalid device type (%s) to set xcvr lpmode\n", info->devtype);
-        status = -1;
+        status = (attr_ops->post_get)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
+    val = XCVR_ATTR_VAL(data, attr->index);
+    mutex_unlock(&data->update_lock);
 
-    return status;
+    return sprintf(buf, "%d\n", val);
 }
 
-int sonic_i2c_set_mod_txdisable(struct i2c_client *client, XCVR_ATTR *info, struct xcvr_data *data)
+static ssize_t xcvr_attr_store(struct device *dev, struct device_attribute *da, const char *buf,
+        size_t count)
 {
+    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
+    struct i2c_client *client = to_i2c_client(dev);
+    struct xcvr_data *data = i2c_get_clientdata(client);
+    XCVR_ATTR *attr_data = data->attrs[attr->index];
+    XCVR_SYSFS_ATTR_OPS *attr_ops = &xcvr_ops[attr->index];
+    unsigned int set_value;
     int status = 0;
 
-    if (strcmp(info->devtype, "cpld") == 0)
+    /* As before, only reset rejects writes with no configured accessor */
+    if (attr_data == NULL)
+        return (attr->index == XCVR_RESET) ? -EINVAL : count;
+    if (kstrtouint(buf, 10, &set_value))
+        return -EINVAL;
+    if ((set_value != 1) && (set_value != 0))
+        return -EINVAL;
+
+    mutex_lock(&data->update_lock);
+    XCVR_ATTR_VAL(data, attr->index) = set_value;
+    if (attr_ops->pre_set != NULL)
     {
-        status = xcvr_i2c_cpld_write(info, data->txdisable);
+        status = (attr_ops->pre_set)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: pre_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
-    else if (strcmp(info->devtype, "fpgai2c") == 0)
+    if (attr_ops->do_set != NULL)
     {
-        status = xcvr_i2c_fpga_write(info, data->txdisable);
+        status = (attr_ops->do_set)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: do_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
-    else
+    if (attr_ops->post_set != NULL)
     {
-        printk(KERN_ERR "Error: Invalid device type (%s) to set xcvr txdisable\n", info->devtype);
-        status = -1;
+        status = (attr_ops->post_set)(client, attr_data, data);
+        if (status!=0)
+            dev_warn(&client->dev, "%s: post_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
     }
+    mutex_unlock(&data->update_lock);
 
-    return status;
+    return count;
 }
 
 ssize_t get_module_presence(struct device *dev, struct device_attribute *da,
              char *buf)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    int status = 0, i;
-
-    for (i=0; i<pdata->len; i++)
-    {
-        attr_data = &pdata->xcvr_attrs[i];
-        if (strcmp(attr_data->aname, attr->dev_attr.attr.name) == 0)
-        {
-            attr_ops = &xcvr_ops[attr->index];
-
-            mutex_lock(&data->update_lock);
-            if (attr_ops->pre_get != NULL)
-            {
-                status = (attr_ops->pre_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            } 
-            if (attr_ops->do_get != NULL)
-            {
-                status = (attr_ops->do_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-
-            }
-            if (attr_ops->post_get != NULL)
-            {
-                status = (attr_ops->post_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            }
-            mutex_unlock(&data->update_lock);
-            return sprintf(buf, "%d\n", data->modpres);
-        }
-    }
-    return sprintf(buf, "%s","");
+    return xcvr_attr_show(dev, da, buf);
 }
 
 ssize_t get_module_reset(struct device *dev, struct device_attribute *da,
              char *buf)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    int status = 0, i;
+    return xcvr_attr_show(dev, da, buf);
+}
 
-    for (i=0; i<pdata->len; i++)
-    {
-        attr_data = &pdata->xcvr_attrs[i];
-        if (strcmp(attr_data->aname, attr->dev_attr.attr.name) == 0)
-        {
-            attr_ops = &xcvr_ops[attr->index];
+ssize_t set_module_reset(struct device *dev, struct device_attribute *da, const char *buf,
+        size_t count)
+{
+    return xcvr_attr_store(dev, da, buf, count);
+}
 
-            mutex_lock(&data->update_lock);
-            if (attr_ops->pre_get != NULL)
-            {
-                status = (attr_ops->pre_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: pre_get function fails for %s attribute\n", __FUNCTION__, attr_data->aname);
-            } 
-            if (attr_ops->do_get != NULL)
-            {
-                status = (attr_ops->do_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: do_get function fails for %s attribute\n", __FUNCTION__, attr_data->aname);
+ssize_t get_module_intr_status(struct device *dev, struct device_attribute *da,
+             char *buf)
+{
+    return xcvr_attr_show(dev, da, buf);
+}
 
-            }
-            if (attr_ops->post_get != NULL)
-            {
-                status = (attr_ops->post_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: post_get function fails for %s attribute\n", __FUNCTION__, attr_data->aname);
-            }
+ssize_t get_module_lpmode(struct device *dev, struct device_attribute *da, char *buf)
+{
+    return xcvr_attr_show(dev, da, buf);
+}
 
-            mutex_unlock(&data->update_lock);
+ssize_t set_module_lpmode(struct device *dev, struct device_attribute *da, const char *buf,
+        size_t count)
+{
+    return xcvr_attr_store(dev, da, buf, count);
+}
 
-            return sprintf(buf, "%d\n", data->reset);
-        }
-    }
-    return sprintf(buf, "%s","");
+ssize_t get_module_rxlos(struct device *dev, struct device_attribute *da,
+             char *buf)
+{
+    return xcvr_attr_show(dev, da, buf);
 }
 
-ssize_t set_module_reset(struct device *dev, struct device_attribute *da, const char *buf, 
+ssize_t get_module_txdisable(struct device *dev, struct device_attribute *da,
+             char *buf)
+{
+    return xcvr_attr_show(dev, da, buf);
+}
+
+ssize_t set_module_txdisable(struct device *dev, struct device_attribute *da, const char *buf,
         size_t count)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    int status = 0, i;
-    unsigned int set_value;
+    return xcvr_attr_store(dev, da, buf, count);
+}
 
-    for (i=0; i<pdata->len; i++)
-    {
-        attr_data = &pdata->xcvr_attrs[i];
-        if (strcmp(attr_data->aname, attr->dev_attr.attr.name) == 0)
-        {
-            attr_ops = &xcvr_ops[attr->index];
-            if(kstrtoint(buf, 10, &set_value))
-                return -EINVAL;
-            if ((set_value != 1) && (set_value != 0))
-                return -EINVAL;
+ssize_t get_module_txfault(struct device *dev, struct device_attribute *da,
+             char *buf)
+{
+    return xcvr_attr_show(dev, da, buf);
+}
 
-            data->reset = set_value;
+/*
+ * Status snapshot of all the xcvr ports.
+ *
+ * The CPLD packs the status bits of several ports in one register, so the
+ * registers are read once per pass and shared by all the ports mapped onto
+ * them. The result is cached for a configurable time to absorb the polling
+ * of all the ports in a row.
+ */
+#define XCVR_STATUS_REG_MAX 128
 
-            mutex_lock(&data->update_lock);
-            
-            if (attr_ops->pre_set != NULL)
-            {
-                status = (attr_ops->pre_set)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: pre_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-                }
-            if (attr_ops->do_set != NULL)
-            {
-                status = (attr_ops->do_set)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: do_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+typedef struct XCVR_STATUS_REG
+{
+    XCVR_ATTR *info;    // first attribute mapped onto this register
+    int status;         // register value or error
+}XCVR_STATUS_REG;
 
-            }
-            if (attr_ops->post_set != NULL)
-            {
-                status = (attr_ops->post_set)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: post_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            } 
-            mutex_unlock(&data->update_lock);
+static struct i2c_client *xcvr_status_clients[XCVR_STATUS_MAX_PORTS];
+static XCVR_STATUS_SNAPSHOT xcvr_status_snap;
+static unsigned long xcvr_status_updated;
+static int xcvr_status_valid;
+static unsigned int xcvr_status_ttl = XCVR_STATUS_TTL_DEFAULT;
+static DEFINE_MUTEX(xcvr_status_lock);
 
-            return count;
-        }
-    }
-    return -EINVAL;
+/* Presence and interrupt status last seen by the event handler */
+static XCVR_STATUS_SNAPSHOT xcvr_event_snap;
+
+static void xcvr_status_event_forget(int port)
+{
+    xcvr_event_snap.valid[XCVR_PRESENT][port / 8] &= ~BIT(port % 8);
+    xcvr_event_snap.valid[XCVR_INTR_STATUS][port / 8] &= ~BIT(port % 8);
 }
 
-ssize_t get_module_intr_status(struct device *dev, struct device_attribute *da,
-             char *buf)
+int xcvr_status_register(struct i2c_client *client)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
     struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    int status = 0, i;
 
-    for (i=0; i<pdata->len; i++)
+    if (data->index < 0 || data->index >= XCVR_STATUS_MAX_PORTS)
     {
-        attr_data = &pdata->xcvr_attrs[i];
-        if (strcmp(attr_data->aname, attr->dev_attr.attr.name) == 0)
-        {
-            attr_ops = &xcvr_ops[attr->index];
-
-            mutex_lock(&data->update_lock);
-            if (attr_ops->pre_get != NULL)
-            {
-                status = (attr_ops->pre_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            } 
-            if (attr_ops->do_get != NULL)
-            {
-                status = (attr_ops->do_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+        dev_warn(&client->dev, "%s: xcvr index %d is out of the status snapshot\n", __FUNCTION__, data->index + 1);
+        return -EINVAL;
+    }
 
-            }
-            if (attr_ops->post_get != NULL)
-            {
-                status = (attr_ops->post_get)(client, attr_data, data);
-                if (status!=0)
-                    dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            }
+    mutex_lock(&xcvr_status_lock);
+    xcvr_status_clients[data->index] = client;
+    xcvr_status_event_forget(data->index);
+    xcvr_status_valid = 0;
+    mutex_unlock(&xcvr_status_lock);
 
-            mutex_unlock(&data->update_lock);
-            return sprintf(buf, "%d\n", data->intr_status);
-        }
-    }
-    return sprintf(buf, "%s","");
+    return 0;
 }
 
-int get_xcvr_module_attr_data(struct i2c_client *client, struct device *dev, 
-                            struct device_attribute *da)
+void xcvr_status_unregister(struct i2c_client *client)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    XCVR_ATTR *attr_data = NULL;
-    int i;
+    struct xcvr_data *data = i2c_get_clientdata(client);
 
-    for (i=0; i < pdata->len; i++)
-    {
-        attr_data = &pdata->xcvr_attrs[i];
-        if (strcmp(attr_data->aname, attr->dev_attr.attr.name) == 0)
-        {
-            return i;
-        }
-    }
-    return -1;
+    if (data->index < 0 || data->index >= XCVR_STATUS_MAX_PORTS)
+        return;
+
+    mutex_lock(&xcvr_status_lock);
+    if (xcvr_status_clients[data->index] == client)
+        xcvr_status_clients[data->index] = NULL;
+    xcvr_status_event_forget(data->index);
+    xcvr_status_valid = 0;
+    mutex_unlock(&xcvr_status_lock);
 }
 
-ssize_t get_module_lpmode(struct device *dev, struct device_attribute *da, char *buf)
+static int xcvr_status_reg_match(XCVR_ATTR *a, XCVR_ATTR *b)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    int idx, status = 0;
+    return a->access == b->access && a->devaddr == b->devaddr && a->offset == b->offset &&
+           a->len == b->len && strcmp(a->devname, b->devname) == 0;
+}
 
-    idx = get_xcvr_module_attr_data(client, dev, da);
+/* Read the register behind an attribute, once per pass */
+static int xcvr_status_reg_read(XCVR_ATTR *info, XCVR_STATUS_REG *regs, int *num_regs)
+{
+    int i, status;
 
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
+    for (i = 0; i < *num_regs; i++)
     {
+        if (xcvr_status_reg_match(regs[i].info, info))
+            return regs[i].status;
+    }
 
-        attr_ops = &xcvr_ops[attr->index];
+    if (info->access == NULL)
+        return -EOPNOTSUPP;
+    status = info->access->read(info);
 
-        mutex_lock(&data->update_lock);
-        if (attr_ops->pre_get != NULL)
-        {
-            status = (attr_ops->pre_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        } 
-        if (attr_ops->do_get != NULL)
-        {
-            status = (attr_ops->do_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-
-        }
-        if (attr_ops->post_get != NULL)
-        {
-            status = (attr_ops->post_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        }
-        mutex_unlock(&data->update_lock);
-        return sprintf(buf, "%d\n", data->lpmode);
+    if (*num_regs < XCVR_STATUS_REG_MAX)
+    {
+        regs[*num_regs].info = info;
+        regs[*num_regs].status = status;
+        (*num_regs)++;
     }
-    else
-        return sprintf(buf,"%s","");
+
+    return status;
 }
 
-ssize_t set_module_lpmode(struct device *dev, struct device_attribute *da, const char *buf, 
-        size_t count)
+/* Go through the platform specific handlers of an attribute */
+static int xcvr_status_ops_read(struct i2c_client *client, XCVR_ATTR *info, int idx, uint32_t *val)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
     struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    int idx, status = 0;
-    uint32_t set_value;
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-
-    idx = get_xcvr_module_attr_data(client, dev, da);
-    
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
-    {
-        attr_ops = &xcvr_ops[attr->index];
-        if(kstrtoint(buf, 10, &set_value))
-            return -EINVAL;
-        if ((set_value != 1) && (set_value != 0))
-            return -EINVAL;
+    XCVR_SYSFS_ATTR_OPS *attr_ops = &xcvr_ops[idx];
+    int status = 0;
 
-        data->lpmode = set_value;
+    mutex_lock(&data->update_lock);
+    if (attr_ops->pre_get != NULL)
+        status = (attr_ops->pre_get)(client, info, data);
+    if (status == 0 && attr_ops->do_get != NULL)
+        status = (attr_ops->do_get)(client, info, data);
+    if (status == 0 && attr_ops->post_get != NULL)
+        status = (attr_ops->post_get)(client, info, data);
+    *val = XCVR_ATTR_VAL(data, idx);
+    mutex_unlock(&data->update_lock);
 
-        mutex_lock(&data->update_lock);
-        
-        if (attr_ops->pre_set != NULL)
-        {
-            status = (attr_ops->pre_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            }
-        if (attr_ops->do_set != NULL)
-        {
-            status = (attr_ops->do_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+    return status;
+}
 
-        }
-        if (attr_ops->post_set != NULL)
-        {
-            status = (attr_ops->post_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        } 
-        mutex_unlock(&data->update_lock);
-    }
-    return count;
+/* Read one attribute of a port, directly from the shared register if possible */
+static int xcvr_status_attr_read(struct i2c_client *client, XCVR_ATTR *info, int idx,
+            XCVR_STATUS_REG *regs, int *num_regs, uint32_t *val)
+{
+    XCVR_SYSFS_ATTR_OPS *attr_ops = &xcvr_ops[idx];
+    int status;
+
+    if (attr_ops->pre_get || attr_ops->post_get ||
+        attr_ops->do_get != xcvr_attr_defs[idx].do_get)
+        return xcvr_status_ops_read(client, info, idx, val);
+
+    status = xcvr_status_reg_read(info, regs, num_regs);
+    if (status < 0)
+        return status;
+
+    *val = ((status & BIT_INDEX(info->mask)) == info->cmpval) ? 1 : 0;
+    return 0;
 }
 
-ssize_t get_module_rxlos(struct device *dev, struct device_attribute *da,
-             char *buf)
+static int xcvr_status_update(void)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    int idx, status = 0;
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-
-    idx = get_xcvr_module_attr_data(client, dev, da);
-    
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
+    XCVR_STATUS_SNAPSHOT *snap = &xcvr_status_snap;
+    XCVR_STATUS_REG *regs;
+    struct xcvr_data *data;
+    XCVR_ATTR *info;
+    struct i2c_client *client;
+    int port, idx, num_regs = 0, status;
+    uint32_t val;
+
+    regs = kcalloc(XCVR_STATUS_REG_MAX, sizeof(*regs), GFP_KERNEL);
+    if (!regs)
+        return -ENOMEM;
+
+    memset(snap, 0, sizeof(*snap));
+
+    for (port = 0; port < XCVR_STATUS_MAX_PORTS; port++)
     {
-        attr_ops = &xcvr_ops[attr->index];
+        client = xcvr_status_clients[port];
+        if (!client)
+            continue;
+        snap->num_ports = port + 1;
 
-        mutex_lock(&data->update_lock);
-        if (attr_ops->pre_get != NULL)
+        data = i2c_get_clientdata(client);
+        for (idx = 0; idx < XCVR_ATTR_MAX; idx++)
         {
-            status = (attr_ops->pre_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        } 
-        if (attr_ops->do_get != NULL)
-        {
-            status = (attr_ops->do_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+            info = data->attrs[idx];
+            if (info == NULL)
+                continue;
 
+            status = xcvr_status_attr_read(client, info, idx, regs, &num_regs, &val);
+            if (status < 0)
+            {
+                sfp_dbg(KERN_INFO "%s: port %d %s read failed %d\n", __FUNCTION__, port + 1, info->aname, status);
+                continue;
+            }
+
+            snap->valid[idx][port / 8] |= BIT(port % 8);
+            if (val)
+                snap->value[idx][port / 8] |= BIT(port % 8);
         }
-        if (attr_ops->post_get != NULL)
-        {
-            status = (attr_ops->post_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        }
-        mutex_unlock(&data->update_lock);
-        return sprintf(buf, "%d\n", data->rxlos);
     }
-    else
-        return sprintf(buf,"%s","");
+
+    sfp_dbg(KERN_INFO "%s: %d ports, %d registers read\n", __FUNCTION__, snap->num_ports, num_regs);
+    kfree(regs);
+
+    return 0;
 }
 
-ssize_t get_module_txdisable(struct device *dev, struct device_attribute *da,
-             char *buf)
+int xcvr_status_snapshot_get(XCVR_STATUS_SNAPSHOT *snap)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    int idx, status = 0;
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-    
-    idx = get_xcvr_module_attr_data(client, dev, da);
-    
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
-    {
-        attr_ops = &xcvr_ops[attr->index];
-
-        mutex_lock(&data->update_lock);
-        if (attr_ops->pre_get != NULL)
-        {
-            status = (attr_ops->pre_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        }
-        if (attr_ops->do_get != NULL)
-        {
-            status = (attr_ops->do_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+    int status = 0;
 
-        }
-        if (attr_ops->post_get != NULL)
+    mutex_lock(&xcvr_status_lock);
+    if (!xcvr_status_valid ||
+        time_after_eq(jiffies, xcvr_status_updated + msecs_to_jiffies(xcvr_status_ttl)))
+    {
+        status = xcvr_status_update();
+        if (status == 0)
         {
-            status = (attr_ops->post_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+            xcvr_status_updated = jiffies;
+            xcvr_status_valid = 1;
         }
-        mutex_unlock(&data->update_lock);
-        return sprintf(buf, "%d\n", data->txdisable);
     }
-    else
-        return sprintf(buf,"%s","");
+    if (status == 0)
+    {
+        *snap = xcvr_status_snap;
+        snap->age = jiffies_to_msecs(jiffies - xcvr_status_updated);
+    }
+    mutex_unlock(&xcvr_status_lock);
+
+    return status;
 }
+EXPORT_SYMBOL(xcvr_status_snapshot_get);
 
-ssize_t set_module_txdisable(struct device *dev, struct device_attribute *da, const char *buf, 
-        size_t count)
+unsigned int xcvr_status_ttl_get(void)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    int idx, status = 0;
-    uint32_t set_value;
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-
-    idx = get_xcvr_module_attr_data(client, dev, da);
-    
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
-    {
-        attr_ops = &xcvr_ops[attr->index];
-        if(kstrtoint(buf, 10, &set_value))
-            return -EINVAL;
-        if ((set_value != 1) && (set_value != 0))
-            return -EINVAL;
+    return xcvr_status_ttl;
+}
+EXPORT_SYMBOL(xcvr_status_ttl_get);
 
-        data->txdisable = set_value;
+void xcvr_status_ttl_set(unsigned int ttl)
+{
+    mutex_lock(&xcvr_status_lock);
+    xcvr_status_ttl = ttl;
+    xcvr_status_valid = 0;
+    mutex_unlock(&xcvr_status_lock);
+}
+EXPORT_SYMBOL(xcvr_status_ttl_set);
 
-        mutex_lock(&data->update_lock);
-        
-        if (attr_ops->pre_set != NULL)
-        {
-            status = (attr_ops->pre_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-            }
-        if (attr_ops->do_set != NULL)
-        {
-            status = (attr_ops->do_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+/*
+ * Module interrupt handling.
+ *
+ * Only the presence and interrupt status registers are read again. A port
+ * whose bit changed gets a notification on its own attribute, plus a uevent
+ * for a presence change, while the cached snapshot is patched in place or
+ * dropped when a module came or went.
+ */
+static void xcvr_status_port_notify(struct i2c_client *client, int port, int idx, uint32_t val)
+{
+    char index_env[32], present_env[32];
+    char *envp[] = {index_env, present_env, NULL};
 
-        }
-        if (attr_ops->post_set != NULL)
-        {
-            status = (attr_ops->post_set)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_set function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        } 
-        mutex_unlock(&data->update_lock);
-    }
-    return count;
+    sysfs_notify(&client->dev.kobj, NULL, xcvr_attr_defs[idx].aname);
+    if (idx != XCVR_PRESENT)
+        return;
+
+    snprintf(index_env, sizeof(index_env), "XCVR_INDEX=%d", port + 1);
+    snprintf(present_env, sizeof(present_env), "XCVR_PRESENT=%u", val);
+    kobject_uevent_env(&client->dev.kobj, KOBJ_CHANGE, envp);
 }
 
-ssize_t get_module_txfault(struct device *dev, struct device_attribute *da,
-             char *buf)
+/* Attributes watched by the event handler */
+static const int xcvr_event_attrs[] = {XCVR_PRESENT, XCVR_INTR_STATUS};
+
+int xcvr_status_event_handle(void)
 {
-    struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
-    struct i2c_client *client = to_i2c_client(dev);
-    XCVR_PDATA *pdata = (XCVR_PDATA *)(client->dev.platform_data);
-    struct xcvr_data *data = i2c_get_clientdata(client);
-    int idx, status = 0;
-    XCVR_ATTR *attr_data = NULL;
-    XCVR_SYSFS_ATTR_OPS *attr_ops = NULL;
-
-    idx = get_xcvr_module_attr_data(client, dev, da);
-    
-    if (idx>=0) attr_data = &pdata->xcvr_attrs[idx];
-    
-    if (attr_data!=NULL)
-    {
-        attr_ops = &xcvr_ops[attr->index];
+    XCVR_STATUS_SNAPSHOT *ev = &xcvr_event_snap;
+    XCVR_STATUS_REG *regs;
+    struct xcvr_data *data;
+    XCVR_ATTR *info;
+    struct i2c_client *client;
+    int port, i, idx, num_regs = 0, changes = 0, status;
+    uint8_t bit;
+    uint32_t val;
+
+    regs = kcalloc(XCVR_STATUS_REG_MAX, sizeof(*regs), GFP_KERNEL);
+    if (!regs)
+        return -ENOMEM;
+
+    mutex_lock(&xcvr_status_lock);
+    for (port = 0; port < XCVR_STATUS_MAX_PORTS; port++)
+    {
+        client = xcvr_status_clients[port];
+        if (!client)
+            continue;
+
+        bit = BIT(port % 8);
+        data = i2c_get_clientdata(client);
+        for (i = 0; i < ARRAY_SIZE(xcvr_event_attrs); i++)
+        {
+            idx = xcvr_event_attrs[i];
+            info = data->attrs[idx];
+            if (info == NULL)
+                continue;
+
+            status = xcvr_status_attr_read(client, info, idx, regs, &num_regs, &val);
+            if (status < 0)
+            {
+                sfp_dbg(KERN_INFO "%s: port %d %s read failed %d\n", __FUNCTION__, port + 1, info->aname, status);
+                continue;
+            }
 
-        mutex_lock(&data->update_lock);
-        if (attr_ops->pre_get != NULL)
-        {
-            status = (attr_ops->pre_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: pre_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        } 
-        if (attr_ops->do_get != NULL)
-        {
-            status = (attr_ops->do_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: do_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
+            /* The first read of a port only sets the reference */
+            if ((ev->valid[idx][port / 8] & bit) &&
+                !!(ev->value[idx][port / 8] & bit) != val)
+            {
+                changes++;
+                xcvr_status_port_notify(client, port, idx, val);
+                if (idx == XCVR_PRESENT)
+                    xcvr_status_valid = 0;
+            }
 
+            ev->valid[idx][port / 8] |= bit;
+            if (val)
+                ev->value[idx][port / 8] |= bit;
+            else
+                ev->value[idx][port / 8] &= ~bit;
+
+            if (xcvr_status_valid)
+            {
+                xcvr_status_snap.valid[idx][port / 8] |= bit;
+                if (val)
+                    xcvr_status_snap.value[idx][port / 8] |= bit;
+                else
+                    xcvr_status_snap.value[idx][port / 8] &= ~bit;
+            }
         }
-        if (attr_ops->post_get != NULL)
-        {
-            status = (attr_ops->post_get)(client, attr_data, data);
-            if (status!=0)
-                dev_warn(&client->dev, "%s: post_get function fails for %s attribute. ret %d\n", __FUNCTION__, attr_data->aname, status);
-        }
-        mutex_unlock(&data->update_lock);
-        return sprintf(buf, "%d\n", data->txfault);
     }
-    return sprintf(buf,"%s","");
+    mutex_unlock(&xcvr_status_lock);
+
+    sfp_dbg(KERN_INFO "%s: %d registers read, %d changes\n", __FUNCTION__, num_regs, changes);
+    kfree(regs);
+
+    return changes;
 }
+EXPORT_SYMBOL(xcvr_status_event_handle);
@@ -29,6 +29,8 @@
 #include <linux/delay.h>
 #include <linux/dmi.h>
 #include <linux/kobject.h>
+#include <linux/interrupt.h>
+#include <linux/gpio.h>
 #include "pddf_client_defs.h"
 #include "pddf_xcvr_defs.h"
 #include "pddf_xcvr_api.h"
@@ -87,6 +89,269 @@ static struct sensor_device_attribute *xcvr_attr_list[MAX_XCVR_ATTRS] = {
 
 static struct attribute *xcvr_attributes[MAX_XCVR_ATTRS] = {NULL};
 
+/* Status snapshot of all the ports, under /sys/kernel/pddf/devices/xcvr */
+extern struct kobject *xcvr_kobj;
+
+static ssize_t xcvr_status_all_read(struct file *filp, struct kobject *kobj,
+            struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+    XCVR_STATUS_SNAPSHOT snap;
+    int status;
+
+    if (off >= sizeof(snap))
+        return 0;
+    if (count > sizeof(snap) - off)
+        count = sizeof(snap) - off;
+
+    status = xcvr_status_snapshot_get(&snap);
+    if (status)
+        return status;
+
+    memcpy(buf, (char *)&snap + off, count);
+    return count;
+}
+
+static struct bin_attribute xcvr_status_all_attr = {
+    .attr = {.name = "xcvr_status_all", .mode = S_IRUGO},
+    .size = sizeof(XCVR_STATUS_SNAPSHOT),
+    .read = xcvr_status_all_read,
+};
+
+static ssize_t xcvr_status_ttl_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%u\n", xcvr_status_ttl_get());
+}
+
+static ssize_t xcvr_status_ttl_store(struct kobject *kobj, struct kobj_attribute *attr,
+            const char *buf, size_t count)
+{
+    unsigned int ttl;
+
+    if (kstrtouint(buf, 10, &ttl))
+        return -EINVAL;
+    xcvr_status_ttl_set(ttl);
+    return count;
+}
+
+static struct kobj_attribute xcvr_status_ttl_attr =
+    __ATTR(xcvr_status_ttl, S_IWUSR|S_IRUGO, xcvr_status_ttl_show, xcvr_status_ttl_store);
+
+/*
+ * Module interrupt lines, all of them run the presence check of the ports.
+ * A line is either a CPU GPIO, a raw irq or the irq of a PDDF CPLD client.
+ */
+#define XCVR_INTR_MAX_LINES 4
+
+typedef struct XCVR_INTR_LINE
+{
+    int irq;
+    int gpio;               // requested gpio or -1
+    char desc[48];
+}XCVR_INTR_LINE;
+
+extern void *get_device_table(char *name);
+
+static XCVR_INTR_LINE xcvr_intr_lines[XCVR_INTR_MAX_LINES];
+static int xcvr_intr_num;
+static DEFINE_MUTEX(xcvr_intr_lock);
+static atomic_t xcvr_status_events = ATOMIC_INIT(0);
+
+/*
+ * Edge triggers only. The handler reads the module status but does not
+ * ack the interrupt source, so a level interrupt would keep firing.
+ */
+static const struct
+{
+    const char *name;
+    unsigned long flags;
+} xcvr_intr_triggers[] = {
+    {"rising", IRQF_TRIGGER_RISING},
+    {"falling", IRQF_TRIGGER_FALLING},
+    {"both", IRQF_TRIGGER_RISING|IRQF_TRIGGER_FALLING},
+};
+
+static void xcvr_status_event_check(void)
+{
+    if (xcvr_status_event_handle() > 0)
+    {
+        atomic_inc(&xcvr_status_events);
+        sysfs_notify(xcvr_kobj, NULL, "xcvr_status_event");
+    }
+}
+
+static irqreturn_t xcvr_intr_thread(int irq, void *dev_id)
+{
+    xcvr_status_event_check();
+    return IRQ_HANDLED;
+}
+
+static int xcvr_intr_add(const char *type, char *arg, const char *trigger)
+{
+    XCVR_INTR_LINE *line;
+    struct i2c_client *client;
+    unsigned long flags = IRQF_TRIGGER_NONE;
+    int i, irq = -1, gpio = -1, status;
+
+    if (xcvr_intr_num >= XCVR_INTR_MAX_LINES)
+        return -ENOSPC;
+
+    if (trigger[0])
+    {
+        for (i = 0; i < ARRAY_SIZE(xcvr_intr_triggers); i++)
+        {
+            if (strcmp(trigger, xcvr_intr_triggers[i].name) == 0)
+                break;
+        }
+        if (i == ARRAY_SIZE(xcvr_intr_triggers))
+            return -EINVAL;
+        flags = xcvr_intr_triggers[i].flags;
+    }
+
+    if (strcmp(type, "cpld") == 0)
+    {
+        client = (struct i2c_client *)get_device_table(arg);
+        if (!client)
+            return -ENODEV;
+        if (client->irq <= 0)
+        {
+            printk(KERN_ERR "%s: %s has no interrupt line\n", __FUNCTION__, arg);
+            return -ENXIO;
+        }
+        irq = client->irq;
+    }
+    else if (strcmp(type, "gpio") == 0)
+    {
+        if (kstrtoint(arg, 0, &gpio))
+            return -EINVAL;
+        status = gpio_request(gpio, "pddf_xcvr_intr");
+        if (status)
+            return status;
+        status = gpio_direction_input(gpio);
+        if (status == 0)
+            status = irq = gpio_to_irq(gpio);
+        if (status < 0)
+        {
+            gpio_free(gpio);
+            return status;
+        }
+        if (!trigger[0])
+            flags = IRQF_TRIGGER_FALLING;
+    }
+    else if (strcmp(type, "irq") == 0)
+    {
+        if (kstrtoint(arg, 0, &irq))
+            return -EINVAL;
+    }
+    else
+        return -EINVAL;
+
+    line = &xcvr_intr_lines[xcvr_intr_num];
+    status = request_threaded_irq(irq, NULL, xcvr_intr_thread, flags | IRQF_ONESHOT, "pddf_xcvr", line);
+    if (status)
+    {
+        printk(KERN_ERR "%s: Unable to request irq %d for %s %s, %d\n", __FUNCTION__, irq, type, arg, status);
+        if (gpio >= 0)
+            gpio_free(gpio);
+        return status;
+    }
+
+    line->irq = irq;
+    line->gpio = gpio;
+    snprintf(line->desc, sizeof(line->desc), "%s %s", type, arg);
+    xcvr_intr_num++;
+    pddf_dbg(XCVR, KERN_INFO "%s: %s bound to irq %d\n", __FUNCTION__, line->desc, irq);
+
+    /* Take the reference state, the changes are reported from now on */
+    xcvr_status_event_check();
+
+    return 0;
+}
+
+static void xcvr_intr_release(void)
+{
+    XCVR_INTR_LINE *line;
+
+    while (xcvr_intr_num > 0)
+    {
+        line = &xcvr_intr_lines[--xcvr_intr_num];
+        free_irq(line->irq, line);
+        if (line->gpio >= 0)
+            gpio_free(line->gpio);
+        memset(line, 0, sizeof(*line));
+    }
+}
+
+static ssize_t xcvr_status_intr_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    int i, len = 0;
+
+    mutex_lock(&xcvr_intr_lock);
+    for (i = 0; i < xcvr_intr_num; i++)
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%s irq %d\n", xcvr_intr_lines[i].desc, xcvr_intr_lines[i].irq);
+    mutex_unlock(&xcvr_intr_lock);
+
+    if (len == 0)
+        len = sprintf(buf, "none\n");
+    return len;
+}
+
+/* "cpld <name> [trigger]", "gpio <num> [trigger]", "irq <num> [trigger]" or "none" */
+static ssize_t xcvr_status_intr_store(struct kobject *kobj, struct kobj_attribute *attr,
+            const char *buf, size_t count)
+{
+    char type[8] = "", arg[32] = "", trigger[8] = "";
+    int status = 0;
+
+    if (sscanf(buf, "%7s %31s %7s", type, arg, trigger) < 1)
+        return -EINVAL;
+
+    mutex_lock(&xcvr_intr_lock);
+    if (strcmp(type, "none") == 0)
+        xcvr_intr_release();
+    else if (arg[0])
+        status = xcvr_intr_add(type, arg, trigger);
+    else
+        status = -EINVAL;
+    mutex_unlock(&xcvr_intr_lock);
+
+    return status ? status : count;
+}
+
+static struct kobj_attribute xcvr_status_intr_attr =
+    __ATTR(xcvr_status_intr, S_IWUSR|S_IRUGO, xcvr_status_intr_show, xcvr_status_intr_store);
+
+/* Counts the changes, poll() it to wait for the next one */
+static ssize_t xcvr_status_event_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%u\n", (unsigned int)atomic_read(&xcvr_status_events));
+}
+
+static struct kobj_attribute xcvr_status_event_attr =
+    __ATTR(xcvr_status_event, S_IRUGO, xcvr_status_event_show, NULL);
+
+/* Software interrupt, runs the same check as the interrupt lines */
+static ssize_t xcvr_status_trigger_store(struct kobject *kobj, struct kobj_attribute *attr,
+            const char *buf, size_t count)
+{
+    xcvr_status_event_check();
+    return count;
+}
+
+static struct kobj_attribute xcvr_status_trigger_attr =
+    __ATTR(xcvr_status_trigger, S_IWUSR, NULL, xcvr_status_trigger_store);
+
+static struct attribute *xcvr_status_attributes[] = {
+    &xcvr_status_ttl_attr.attr,
+    &xcvr_status_intr_attr.attr,
+    &xcvr_status_event_attr.attr,
+    &xcvr_status_trigger_attr.attr,
+    NULL
+};
+
+static const struct attribute_group xcvr_status_group = {
+    .attrs = xcvr_status_attributes,
+};
+
 static const struct attribute_group xcvr_group = {
     .attrs = xcvr_attributes,
 };
@@ -150,6 +415,10 @@ static int xcvr_probe(struct i2c_client *client,
         if (j<XCVR_ATTR_MAX)
             xcvr_attributes[i] = &xcvr_attr_list[j]->dev_attr.attr;
 
+        /* Resolve the accessors once, the sysfs handlers dispatch on them */
+        if (xcvr_attr_resolve(client, attr_data))
+            dev_warn(&client->dev, "%s: unknown attribute %s\n", __FUNCTION__, attr_data->aname);
+
     }
     xcvr_attributes[i] = NULL;
 
@@ -167,6 +436,9 @@ static int xcvr_probe(struct i2c_client *client,
 
     dev_info(&client->dev, "%s: xcvr '%s'\n",
          dev_name(data->xdev), client->name);
+
+    /* Not fatal, the port is still served by its own attributes */
+    xcvr_status_register(client);
     
     /* Add a support for post probe function */
     if (pddf_xcvr_ops.post_probe)
@@ -203,6 +475,7 @@ static void xcvr_remove(struct i2c_client *client)
             printk(KERN_ERR "FAN pre_remove function failed\n");
     }
 
+    xcvr_status_unregister(client);
     hwmon_device_unregister(data->xdev);
     sysfs_remove_group(&client->dev.kobj, &xcvr_group);
     kfree(data);
@@ -265,6 +538,20 @@ int xcvr_init(void)
     if (ret!=0)
         return ret;
 
+    ret = sysfs_create_bin_file(xcvr_kobj, &xcvr_status_all_attr);
+    if (ret!=0)
+    {
+        i2c_del_driver(&xcvr_driver);
+        return ret;
+    }
+    ret = sysfs_create_group(xcvr_kobj, &xcvr_status_group);
+    if (ret!=0)
+    {
+        sysfs_remove_bin_file(xcvr_kobj, &xcvr_status_all_attr);
+        i2c_del_driver(&xcvr_driver);
+        return ret;
+    }
+
     if (pddf_xcvr_ops.post_init)
     {
         ret = (pddf_xcvr_ops.post_init)();
@@ -280,6 +567,11 @@ void xcvr_exit(void)
 {
     pddf_dbg(XCVR, "PDDF XCVR DRIVER.. exit\n");
     if (pddf_xcvr_ops.pre_exit) (pddf_xcvr_ops.pre_exit)();
+    sysfs_remove_group(xcvr_kobj, &xcvr_status_group);
+    mutex_lock(&xcvr_intr_lock);
+    xcvr_intr_release();
+    mutex_unlock(&xcvr_intr_lock);
+    sysfs_remove_bin_file(xcvr_kobj, &xcvr_status_all_attr);
     i2c_del_driver(&xcvr_driver);
     if (pddf_xcvr_ops.post_exit) (pddf_xcvr_ops.post_exit)();
 
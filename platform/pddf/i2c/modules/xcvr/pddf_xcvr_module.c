@@ -213,6 +213,7 @@ clear_data:
 }
 
 struct kobject *xcvr_kobj;
+EXPORT_SYMBOL(xcvr_kobj);
 struct kobject *i2c_kobj;
 int __init pddf_data_init(void)
 {
@@ -235,6 +235,11 @@ class PddfParse():
             ret = self.runcmd(cmd)
             if ret != 0:
                 return create_ret.append(ret)
+            if 'dev_attr' in dev['i2c'] and 'intr_gpio' in dev['i2c']['dev_attr']:
+                cmd = "echo '%d' > /sys/kernel/pddf/devices/cpld/intr_gpio" % (int(dev['i2c']['dev_attr']['intr_gpio'], 0))
+                ret = self.runcmd(cmd)
+                if ret != 0:
+                    return create_ret.append(ret)
             # TODO: If attributes are provided then, use 'self.create_device' for them too
             cmd = "echo 'add' > /sys/kernel/pddf/devices/cpld/dev_ops"
             ret = self.runcmd(cmd)
@@ -1753,10 +1758,27 @@ class PddfParse():
             if ret:
                 if ret[0] != 0:
                     return ret[0]
+        self.create_xcvr_intr()
         return create_ret
 
+    def create_xcvr_intr(self):
+        # Optional module interrupt lines, e.g. "cpld SYSCPLD", "gpio 456 falling" or "irq 42 rising".
+        # xcvrd falls back to polling if a line cannot be bound.
+        path = "/sys/kernel/pddf/devices/xcvr/xcvr_status_intr"
+        if 'xcvr_intr' not in self.data['PLATFORM'] or not os.path.exists(path):
+            return
+        for line in self.data['PLATFORM']['xcvr_intr']:
+            cmd = "echo '%s' > %s" % (line, path)
+            if self.runcmd(cmd) != 0:
+                print("Unable to bind xcvr interrupt '%s'" % line)
+
+    def delete_xcvr_intr(self):
+        path = "/sys/kernel/pddf/devices/xcvr/xcvr_status_intr"
+        if 'xcvr_intr' in self.data['PLATFORM'] and os.path.exists(path):
+            self.runcmd("echo 'none' > %s" % path)
 
     def delete_pddf_devices(self):
+        self.delete_xcvr_intr()
         self.dev_parse(self.data['SYSTEM'], {"cmd": "delete", "target": "all", "attr": "all"})
         if 'SYSSTATUS' in self.data:
             self.dev_parse(self.data['SYSSTATUS'], {"cmd": "delete", "target": "all", "attr": "all"})
@@ -0,0 +1,656 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2017 - 2022 Pensando Systems, Inc */
+
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/hashtable.h>
+#include <linux/idr.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "ionic.h"
+#include "ionic_lif.h"
+#include "ionic_adminq_emu.h"
+
+#define IONIC_ADMINQ_EMU_HASH_BITS	10
+
+struct ionic_adminq_emu_filter {
+	struct hlist_node by_key;
+	struct hlist_node by_id;
+	u64 key;
+	u32 filter_id;
+};
+
+struct ionic_adminq_emu {
+	spinlock_t lock;		/* lock for the ring indexes */
+	struct ionic_admin_ctx **ring;
+	unsigned int num_descs;
+	unsigned int head_idx;		/* next slot to post */
+	unsigned int dbell_idx;		/* slots before this were rung */
+	unsigned int tail_idx;		/* next slot to complete */
+	struct work_struct work;
+	unsigned int latency_us;
+
+	/* filter table, only used by the work */
+	DECLARE_HASHTABLE(by_key, IONIC_ADMINQ_EMU_HASH_BITS);
+	DECLARE_HASHTABLE(by_id, IONIC_ADMINQ_EMU_HASH_BITS);
+	struct ida filter_ids;
+	unsigned int nfilters;
+	unsigned int max_filters;
+
+	u64 dbells;
+	u64 cmds;
+};
+
+static u64 ionic_adminq_emu_key(struct ionic_rx_filter_add_cmd *ac)
+{
+	u16 match = le16_to_cpu(ac->match);
+	const u8 *addr;
+	u64 key = 0;
+	int i;
+
+	switch (match) {
+	case IONIC_RX_FILTER_MATCH_VLAN:
+		key = le16_to_cpu(ac->vlan.vlan);
+		break;
+	case IONIC_RX_FILTER_MATCH_MAC:
+	case IONIC_RX_FILTER_MATCH_MAC_VLAN:
+		addr = (match == IONIC_RX_FILTER_MATCH_MAC) ?
+			ac->mac.addr : ac->mac_vlan.addr;
+		for (i = 0; i < ETH_ALEN; i++)
+			key = (key << 8) | addr[i];
+		if (match == IONIC_RX_FILTER_MATCH_MAC_VLAN)
+			key |= (u64)le16_to_cpu(ac->mac_vlan.vlan) << 48;
+		break;
+	default:
+		return U64_MAX;
+	}
+
+	return ((u64)match << 60) | key;
+}
+
+static u8 ionic_adminq_emu_filter_add(struct ionic_adminq_emu *emu,
+				      struct ionic_rx_filter_add_cmd *ac,
+				      struct ionic_rx_filter_add_comp *comp)
+{
+	struct ionic_adminq_emu_filter *f;
+	u64 key;
+	int id;
+
+	key = ionic_adminq_emu_key(ac);
+	if (key == U64_MAX)
+		return IONIC_RC_EINVAL;
+
+	hash_for_each_possible(emu->by_key, f, by_key, key) {
+		if (f->key == key) {
+			comp->filter_id = cpu_to_le32(f->filter_id);
+			return IONIC_RC_EEXIST;
+		}
+	}
+
+	if (emu->nfilters >= emu->max_filters)
+		return IONIC_RC_ENOSPC;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return IONIC_RC_ENOMEM;
+
+	id = ida_alloc(&emu->filter_ids, GFP_KERNEL);
+	if (id < 0) {
+		kfree(f);
+		return IONIC_RC_ENOMEM;
+	}
+
+	f->key = key;
+	f->filter_id = id;
+	hash_add(emu->by_key, &f->by_key, f->key);
+	hash_add(emu->by_id, &f->by_id, f->filter_id);
+	emu->nfilters++;
+
+	comp->filter_id = cpu_to_le32(f->filter_id);
+
+	return IONIC_RC_SUCCESS;
+}
+
+static void ionic_adminq_emu_filter_free(struct ionic_adminq_emu *emu,
+					 struct ionic_adminq_emu_filter *f)
+{
+	hash_del(&f->by_key);
+	hash_del(&f->by_id);
+	ida_free(&emu->filter_ids, f->filter_id);
+	kfree(f);
+	emu->nfilters--;
+}
+
+static u8 ionic_adminq_emu_filter_del(struct ionic_adminq_emu *emu,
+				      struct ionic_rx_filter_del_cmd *dc)
+{
+	struct ionic_adminq_emu_filter *f;
+	u32 filter_id;
+
+	filter_id = le32_to_cpu(dc->filter_id);
+	hash_for_each_possible(emu->by_id, f, by_id, filter_id) {
+		if (f->filter_id == filter_id) {
+			ionic_adminq_emu_filter_free(emu, f);
+			return IONIC_RC_SUCCESS;
+		}
+	}
+
+	return IONIC_RC_ENOENT;
+}
+
+static void ionic_adminq_emu_exec(struct ionic_adminq_emu *emu,
+				  struct ionic_admin_ctx *ctx,
+				  unsigned int index)
+{
+	union ionic_adminq_comp comp = {};
+
+	switch (ctx->cmd.cmd.opcode) {
+	case IONIC_CMD_NOP:
+		comp.comp.status = IONIC_RC_SUCCESS;
+		break;
+	case IONIC_CMD_RX_FILTER_ADD:
+		comp.comp.status =
+			ionic_adminq_emu_filter_add(emu, &ctx->cmd.rx_filter_add,
+						    &comp.rx_filter_add);
+		break;
+	case IONIC_CMD_RX_FILTER_DEL:
+		comp.comp.status =
+			ionic_adminq_emu_filter_del(emu, &ctx->cmd.rx_filter_del);
+		break;
+	default:
+		comp.comp.status = IONIC_RC_EOPCODE;
+		break;
+	}
+	comp.comp.comp_index = cpu_to_le16(index);
+
+	/* the poster may free ctx as soon as it is completed */
+	memcpy(&ctx->comp, &comp, sizeof(comp));
+	complete_all(&ctx->work);
+}
+
+static void ionic_adminq_emu_work(struct work_struct *work)
+{
+	struct ionic_adminq_emu *emu = container_of(work, struct ionic_adminq_emu,
+						    work);
+	unsigned int mask = emu->num_descs - 1;
+	unsigned int dbell_idx;
+	unsigned int idx;
+
+	spin_lock_bh(&emu->lock);
+	while (emu->tail_idx != emu->dbell_idx) {
+		idx = emu->tail_idx;
+		dbell_idx = emu->dbell_idx;
+		spin_unlock_bh(&emu->lock);
+
+		/* one firmware round trip for everything rung so far */
+		if (emu->latency_us)
+			usleep_range(emu->latency_us, emu->latency_us + 10);
+
+		for (; idx != dbell_idx; idx = (idx + 1) & mask) {
+			ionic_adminq_emu_exec(emu, emu->ring[idx], idx);
+			emu->cmds++;
+		}
+
+		spin_lock_bh(&emu->lock);
+		emu->tail_idx = dbell_idx;
+	}
+	spin_unlock_bh(&emu->lock);
+}
+
+struct ionic_adminq_emu *ionic_adminq_emu_create(unsigned int num_descs,
+						 unsigned int latency_us,
+						 unsigned int max_filters)
+{
+	struct ionic_adminq_emu *emu;
+
+	if (!is_power_of_2(num_descs) || num_descs < 2)
+		return NULL;
+
+	emu = kzalloc(sizeof(*emu), GFP_KERNEL);
+	if (!emu)
+		return NULL;
+
+	emu->ring = kcalloc(num_descs, sizeof(*emu->ring), GFP_KERNEL);
+	if (!emu->ring) {
+		kfree(emu);
+		return NULL;
+	}
+
+	spin_lock_init(&emu->lock);
+	INIT_WORK(&emu->work, ionic_adminq_emu_work);
+	hash_init(emu->by_key);
+	hash_init(emu->by_id);
+	ida_init(&emu->filter_ids);
+	emu->num_descs = num_descs;
+	emu->latency_us = latency_us;
+	emu->max_filters = max_filters;
+
+	return emu;
+}
+
+void ionic_adminq_emu_destroy(struct ionic_adminq_emu *emu)
+{
+	struct ionic_adminq_emu_filter *f;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	if (!emu)
+		return;
+
+	flush_work(&emu->work);
+
+	hash_for_each_safe(emu->by_id, i, tmp, f, by_id)
+		ionic_adminq_emu_filter_free(emu, f);
+	ida_destroy(&emu->filter_ids);
+
+	kfree(emu->ring);
+	kfree(emu);
+}
+
+int ionic_adminq_emu_post(struct ionic_adminq_emu *emu,
+			  struct ionic_admin_ctx **ctxs, int n)
+{
+	unsigned int mask = emu->num_descs - 1;
+	unsigned int avail;
+	int i;
+
+	spin_lock_bh(&emu->lock);
+	avail = (emu->tail_idx - emu->head_idx - 1) & mask;
+	n = min_t(int, n, avail);
+	if (!n) {
+		spin_unlock_bh(&emu->lock);
+		return -ENOSPC;
+	}
+
+	for (i = 0; i < n; i++) {
+		emu->ring[emu->head_idx] = ctxs[i];
+		emu->head_idx = (emu->head_idx + 1) & mask;
+	}
+
+	/* ring the doorbell */
+	emu->dbell_idx = emu->head_idx;
+	emu->dbells++;
+	spin_unlock_bh(&emu->lock);
+
+	queue_work(system_unbound_wq, &emu->work);
+
+	return n;
+}
+
+int ionic_adminq_emu_wait(struct ionic_adminq_emu *emu,
+			  struct ionic_admin_ctx *ctx)
+{
+	if (!wait_for_completion_timeout(&ctx->work, HZ * (ulong)devcmd_timeout)) {
+		ctx->comp.comp.status = IONIC_RC_ERROR;
+		return -ETIMEDOUT;
+	}
+
+	return ionic_error_to_errno(ctx->comp.comp.status);
+}
+
+/* A locally administered unicast address per filter, varying in the
+ * bytes the driver's filter hash looks at
+ */
+static void ionic_adminq_emu_addr(u8 *addr, unsigned int i)
+{
+	addr[0] = 0x02;
+	addr[1] = i;
+	addr[2] = i >> 8;
+	addr[3] = i >> 16;
+	addr[4] = i >> 24;
+	addr[5] = 0;
+}
+
+static void ionic_adminq_emu_add_cmd(struct ionic_admin_ctx *ctx,
+				     unsigned int i)
+{
+	struct ionic_rx_filter_add_cmd *ac = &ctx->cmd.rx_filter_add;
+
+	memset(ctx, 0, sizeof(*ctx));
+	init_completion(&ctx->work);
+
+	ac->opcode = IONIC_CMD_RX_FILTER_ADD;
+	ac->match = cpu_to_le16(IONIC_RX_FILTER_MATCH_MAC);
+	ionic_adminq_emu_addr(ac->mac.addr, i);
+}
+
+static void ionic_adminq_emu_del_cmd(struct ionic_admin_ctx *ctx)
+{
+	u32 filter_id = le32_to_cpu(ctx->comp.rx_filter_add.filter_id);
+
+	memset(ctx, 0, sizeof(*ctx));
+	init_completion(&ctx->work);
+
+	ctx->cmd.rx_filter_del.opcode = IONIC_CMD_RX_FILTER_DEL;
+	ctx->cmd.rx_filter_del.filter_id = cpu_to_le32(filter_id);
+}
+
+/* Run the commands through the batched adminq path, up to batch at a time */
+static int ionic_adminq_emu_run(struct ionic_lif *lif,
+				struct ionic_admin_ctx *ctxs,
+				unsigned int n, unsigned int batch)
+{
+	struct ionic_admin_ctx *bctxs[IONIC_ADMINQ_LENGTH];
+	int errs[IONIC_ADMINQ_LENGTH];
+	unsigned int i, j, k;
+	int err = 0;
+
+	for (i = 0; i < n; i += j) {
+		for (j = 0; j < batch && i + j < n; j++)
+			bctxs[j] = &ctxs[i + j];
+
+		ionic_adminq_post_wait_batch(lif, bctxs, errs, j);
+
+		for (k = 0; k < j; k++)
+			if (errs[k] && !err)
+				err = errs[k];
+	}
+
+	return err;
+}
+
+static int ionic_adminq_emu_cmd(struct ionic_lif *lif,
+				struct ionic_admin_ctx *ctx)
+{
+	int err;
+
+	ionic_adminq_post_wait_batch(lif, &ctx, &err, 1);
+
+	return err;
+}
+
+/* Add nfilters filters and delete them again, batch commands at a time */
+static int ionic_adminq_emu_pass(struct ionic_adminq_emu_bench *bench,
+				 struct ionic_lif *lif,
+				 struct ionic_admin_ctx *ctxs,
+				 unsigned int batch, u64 *ns, u64 *dbells)
+{
+	unsigned int n = bench->nfilters;
+	struct ionic_adminq_emu *emu;
+	struct ionic_admin_ctx ctx;
+	u64 extra_dbells;
+	unsigned int i;
+	u64 start;
+	int err;
+
+	emu = ionic_adminq_emu_create(IONIC_ADMINQ_LENGTH, bench->latency_us, n);
+	if (!emu) {
+		bench->failed = "create";
+		return -ENOMEM;
+	}
+	lif->adminq_emu = emu;
+
+	for (i = 0; i < n; i++)
+		ionic_adminq_emu_add_cmd(&ctxs[i], i);
+
+	start = ktime_get_ns();
+	err = ionic_adminq_emu_run(lif, ctxs, n, batch);
+	*ns = ktime_get_ns() - start;
+	*dbells = emu->dbells;
+	if (err) {
+		bench->failed = "add";
+		goto out;
+	}
+	if (emu->nfilters != n) {
+		bench->failed = "add count";
+		err = -EIO;
+		goto out;
+	}
+
+	/* the table is full now, and already has the first filter */
+	extra_dbells = emu->dbells;
+	ionic_adminq_emu_add_cmd(&ctx, 0);
+	err = ionic_adminq_emu_cmd(lif, &ctx);
+	if (err != -EEXIST) {
+		bench->failed = "duplicate add";
+		err = err ?: -EIO;
+		goto out;
+	}
+	ionic_adminq_emu_add_cmd(&ctx, n);
+	err = ionic_adminq_emu_cmd(lif, &ctx);
+	if (err != -ENOSPC) {
+		bench->failed = "add to full table";
+		err = err ?: -EIO;
+		goto out;
+	}
+	extra_dbells = emu->dbells - extra_dbells;
+
+	for (i = 0; i < n; i++)
+		ionic_adminq_emu_del_cmd(&ctxs[i]);
+
+	start = ktime_get_ns();
+	err = ionic_adminq_emu_run(lif, ctxs, n, batch);
+	*ns += ktime_get_ns() - start;
+	*dbells = emu->dbells - extra_dbells;
+	if (err) {
+		bench->failed = "del";
+		goto out;
+	}
+	if (emu->nfilters) {
+		bench->failed = "del count";
+		err = -EIO;
+	}
+
+out:
+	lif->adminq_emu = NULL;
+	ionic_adminq_emu_destroy(emu);
+
+	return err;
+}
+
+/* Count the filters of the LIF in the given state */
+static unsigned int ionic_adminq_emu_lif_filters(struct ionic_lif *lif,
+						 enum ionic_filter_state state)
+{
+	struct ionic_rx_filter *f;
+	unsigned int n = 0;
+	unsigned int i;
+
+	spin_lock_bh(&lif->rx_filters.lock);
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++)
+		hlist_for_each_entry(f, &lif->rx_filters.by_id[i], by_id)
+			if (f->state == state)
+				n++;
+	spin_unlock_bh(&lif->rx_filters.lock);
+
+	return n;
+}
+
+/* Sync nfilters + 1 new MAC filters of a LIF with room for nfilters,
+ * then delete them all and sync again
+ */
+static int ionic_adminq_emu_sync_pass(struct ionic_adminq_emu_bench *bench,
+				      struct ionic_lif *lif)
+{
+	const unsigned int batch = IONIC_ADMINQ_LENGTH - 1;
+	unsigned int n = bench->nfilters;
+	struct ionic_adminq_emu *emu;
+	u8 addr[ETH_ALEN];
+	u64 dbells;
+	unsigned int i;
+	u64 start;
+	int err;
+
+	/* the LIF limit is hit before the emulated firmware's */
+	emu = ionic_adminq_emu_create(IONIC_ADMINQ_LENGTH, bench->latency_us,
+				      n + 1);
+	if (!emu) {
+		bench->failed = "create";
+		return -ENOMEM;
+	}
+	lif->adminq_emu = emu;
+	lif->identity->eth.max_ucast_filters = cpu_to_le32(n);
+
+	for (i = 0; i <= n; i++) {
+		ionic_adminq_emu_addr(addr, i);
+		err = ionic_lif_list_addr(lif, addr, ADD_ADDR);
+		if (err) {
+			bench->failed = "sync list add";
+			goto out;
+		}
+	}
+
+	start = ktime_get_ns();
+	ionic_rx_filter_sync(lif);
+	bench->sync_ns = ktime_get_ns() - start;
+	dbells = emu->dbells;
+	if (emu->nfilters != n || lif->nucast != n ||
+	    ionic_adminq_emu_lif_filters(lif, IONIC_FILTER_STATE_SYNCED) != n) {
+		bench->failed = "sync add count";
+		err = -EIO;
+		goto out;
+	}
+	/* the filter without room waits for a delete, not for a resync */
+	if (ionic_adminq_emu_lif_filters(lif, IONIC_FILTER_STATE_NEW) != 1 ||
+	    test_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state)) {
+		bench->failed = "sync add overflow";
+		err = -EIO;
+		goto out;
+	}
+	if (dbells != DIV_ROUND_UP(n, batch)) {
+		bench->failed = "sync add doorbells";
+		err = -EIO;
+		goto out;
+	}
+
+	for (i = 0; i <= n; i++) {
+		ionic_adminq_emu_addr(addr, i);
+		err = ionic_lif_list_addr(lif, addr, DEL_ADDR);
+		if (err) {
+			bench->failed = "sync list del";
+			goto out;
+		}
+	}
+
+	start = ktime_get_ns();
+	ionic_rx_filter_sync(lif);
+	bench->sync_ns += ktime_get_ns() - start;
+	bench->sync_dbells = emu->dbells;
+	if (emu->nfilters || lif->nucast ||
+	    ionic_adminq_emu_lif_filters(lif, IONIC_FILTER_STATE_OLD) ||
+	    ionic_adminq_emu_lif_filters(lif, IONIC_FILTER_STATE_SYNCED)) {
+		bench->failed = "sync del count";
+		err = -EIO;
+		goto out;
+	}
+	if (emu->dbells - dbells != DIV_ROUND_UP(n, batch)) {
+		bench->failed = "sync del doorbells";
+		err = -EIO;
+	}
+
+out:
+	lif->adminq_emu = NULL;
+	ionic_adminq_emu_destroy(emu);
+
+	return err;
+}
+
+/* Set up a LIF that can go through ionic_rx_filter_sync() and run the
+ * sync pass on it
+ */
+static int ionic_adminq_emu_sync(struct ionic_adminq_emu_bench *bench)
+{
+	struct ionic_lif *lif = NULL;
+	struct ionic *ionic = NULL;
+	struct device *dev;
+	int err = -ENOMEM;
+
+	/* the driver keeps its filters as device managed memory */
+	dev = root_device_register("ionic_adminq_emu");
+	if (IS_ERR(dev)) {
+		bench->failed = "sync device";
+		return PTR_ERR(dev);
+	}
+
+	ionic = kzalloc(sizeof(*ionic), GFP_KERNEL);
+	lif = kzalloc(sizeof(*lif), GFP_KERNEL);
+	if (!ionic || !lif)
+		goto out;
+	lif->identity = kzalloc(sizeof(*lif->identity), GFP_KERNEL);
+	lif->netdev = alloc_etherdev(0);
+	if (!lif->identity || !lif->netdev)
+		goto out;
+
+	ionic->dev = dev;
+	lif->ionic = ionic;
+	ionic_rx_filters_init(lif);
+
+	err = ionic_adminq_emu_sync_pass(bench, lif);
+
+	ionic_rx_filters_deinit(lif);
+out:
+	if (lif) {
+		if (lif->netdev)
+			free_netdev(lif->netdev);
+		kfree(lif->identity);
+	}
+	kfree(lif);
+	kfree(ionic);
+	root_device_unregister(dev);
+
+	return err;
+}
+
+/**
+ * ionic_adminq_emu_bench() - Check and time the batched adminq path
+ * @bench:	Parameters and results
+ *
+ * Adds and deletes bench->nfilters MAC filters on an emulated adminq,
+ * first one command per doorbell, then a full adminq per doorbell, and
+ * finally through ionic_rx_filter_sync().  No DSC is needed, the
+ * commands go through a scratch LIF whose adminq is the emulator.
+ */
+int ionic_adminq_emu_bench(struct ionic_adminq_emu_bench *bench)
+{
+	const unsigned int batch = IONIC_ADMINQ_LENGTH - 1;
+	struct ionic_admin_ctx *ctxs;
+	struct ionic_lif *lif;
+	int err;
+
+	bench->failed = NULL;
+	bench->serial_ns = 0;
+	bench->serial_dbells = 0;
+	bench->batch_ns = 0;
+	bench->batch_dbells = 0;
+	bench->sync_ns = 0;
+	bench->sync_dbells = 0;
+
+	if (!bench->nfilters) {
+		bench->err = -EINVAL;
+		return -EINVAL;
+	}
+
+	lif = kzalloc(sizeof(*lif), GFP_KERNEL);
+	ctxs = kvcalloc(bench->nfilters, sizeof(*ctxs), GFP_KERNEL);
+	if (!lif || !ctxs) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = ionic_adminq_emu_pass(bench, lif, ctxs, 1,
+				    &bench->serial_ns, &bench->serial_dbells);
+	if (err)
+		goto out;
+
+	err = ionic_adminq_emu_pass(bench, lif, ctxs, batch,
+				    &bench->batch_ns, &bench->batch_dbells);
+	if (err)
+		goto out;
+
+	/* each batch must have gone out with a single doorbell */
+	if (bench->batch_dbells != 2 * DIV_ROUND_UP(bench->nfilters, batch)) {
+		bench->failed = "doorbells per batch";
+		err = -EIO;
+		goto out;
+	}
+
+	err = ionic_adminq_emu_sync(bench);
+
+out:
+	kvfree(ctxs);
+	kfree(lif);
+	bench->err = err;
+
+	return err;
+}
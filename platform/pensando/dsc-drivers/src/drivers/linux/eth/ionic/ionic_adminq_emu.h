@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2017 - 2022 Pensando Systems, Inc */
+
+#ifndef _IONIC_ADMINQ_EMU_H_
+#define _IONIC_ADMINQ_EMU_H_
+
+/* The adminq emulator is a software model of the firmware side of an
+ * adminq.  It understands the rx_filter commands only, and exists so the
+ * batched adminq path can be checked and measured without a DSC.  It is
+ * only built with IONIC_ADMINQ_EMU=1, otherwise the adminq never checks
+ * for it.
+ */
+
+#define IONIC_ADMINQ_EMU_MAX_FILTERS	(1 << 20)
+
+struct ionic_adminq_emu;
+
+struct ionic_adminq_emu_bench {
+	/* parameters */
+	unsigned int nfilters;		/* filters added then deleted */
+	unsigned int latency_us;	/* emulated round trip per doorbell */
+
+	/* results */
+	u64 serial_ns;			/* one command per doorbell */
+	u64 serial_dbells;
+	u64 batch_ns;			/* commands batched per doorbell */
+	u64 batch_dbells;
+	u64 sync_ns;			/* ionic_rx_filter_sync() add and del */
+	u64 sync_dbells;
+	const char *failed;		/* failed check, NULL if all passed */
+	int err;
+};
+
+#ifdef IONIC_ADMINQ_EMU
+
+#define ionic_lif_adminq_emu(lif)	((lif)->adminq_emu)
+
+struct ionic_adminq_emu *ionic_adminq_emu_create(unsigned int num_descs,
+						 unsigned int latency_us,
+						 unsigned int max_filters);
+void ionic_adminq_emu_destroy(struct ionic_adminq_emu *emu);
+int ionic_adminq_emu_post(struct ionic_adminq_emu *emu,
+			  struct ionic_admin_ctx **ctxs, int n);
+int ionic_adminq_emu_wait(struct ionic_adminq_emu *emu,
+			  struct ionic_admin_ctx *ctx);
+int ionic_adminq_emu_bench(struct ionic_adminq_emu_bench *bench);
+
+#else
+
+#define ionic_lif_adminq_emu(lif)	((struct ionic_adminq_emu *)NULL)
+
+static inline int ionic_adminq_emu_post(struct ionic_adminq_emu *emu,
+					struct ionic_admin_ctx **ctxs, int n)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int ionic_adminq_emu_wait(struct ionic_adminq_emu *emu,
+					struct ionic_admin_ctx *ctx)
+{
+	return -EOPNOTSUPP;
+}
+
+#endif /* IONIC_ADMINQ_EMU */
+
+#endif /* _IONIC_ADMINQ_EMU_H_ */
@@ -8,15 +8,103 @@
 #include "ionic_lif.h"
 #include "ionic_ethtool.h"
 #include "ionic_debugfs.h"
+#include "ionic_adminq_emu.h"
 #include "kcompat.h"
 
 #ifdef CONFIG_DEBUG_FS
 
 static struct dentry *ionic_dir;
 
+#ifdef IONIC_ADMINQ_EMU
+static DEFINE_MUTEX(adminq_emu_lock);
+static struct ionic_adminq_emu_bench adminq_emu_bench;
+
+static int adminq_emu_show(struct seq_file *seq, void *v)
+{
+	struct ionic_adminq_emu_bench *bench = &adminq_emu_bench;
+
+	mutex_lock(&adminq_emu_lock);
+	if (!bench->nfilters) {
+		seq_puts(seq, "usage: echo <nfilters> [latency_us] > adminq_emu\n");
+		goto out;
+	}
+
+	seq_printf(seq, "nfilters:      %u\n", bench->nfilters);
+	seq_printf(seq, "latency_us:    %u\n", bench->latency_us);
+	seq_printf(seq, "serial_ns:     %llu\n", bench->serial_ns);
+	seq_printf(seq, "serial_dbells: %llu\n", bench->serial_dbells);
+	seq_printf(seq, "batch_ns:      %llu\n", bench->batch_ns);
+	seq_printf(seq, "batch_dbells:  %llu\n", bench->batch_dbells);
+	seq_printf(seq, "sync_ns:       %llu\n", bench->sync_ns);
+	seq_printf(seq, "sync_dbells:   %llu\n", bench->sync_dbells);
+	if (bench->failed)
+		seq_printf(seq, "selftest:      failed %s (%d)\n",
+			   bench->failed, bench->err);
+	else if (bench->err)
+		seq_printf(seq, "selftest:      error %d\n", bench->err);
+	else
+		seq_puts(seq, "selftest:      passed\n");
+out:
+	mutex_unlock(&adminq_emu_lock);
+
+	return 0;
+}
+
+static int adminq_emu_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, adminq_emu_show, inode->i_private);
+}
+
+static ssize_t adminq_emu_write(struct file *file, const char __user *data,
+				size_t count, loff_t *ppos)
+{
+	unsigned int latency_us = 0;
+	unsigned int nfilters;
+	char buf[32];
+	int err;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, data, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u", &nfilters, &latency_us) < 1 ||
+	    !nfilters || nfilters > IONIC_ADMINQ_EMU_MAX_FILTERS ||
+	    latency_us > USEC_PER_SEC)
+		return -EINVAL;
+
+	mutex_lock(&adminq_emu_lock);
+	adminq_emu_bench.nfilters = nfilters;
+	adminq_emu_bench.latency_us = latency_us;
+	err = ionic_adminq_emu_bench(&adminq_emu_bench);
+	mutex_unlock(&adminq_emu_lock);
+
+	/* the results, good or bad, are read back from the file */
+	if (err == -ENOMEM)
+		return err;
+
+	return count;
+}
+
+static const struct file_operations adminq_emu_fops = {
+	.owner = THIS_MODULE,
+	.open = adminq_emu_open,
+	.read = seq_read,
+	.write = adminq_emu_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif /* IONIC_ADMINQ_EMU */
+
 void ionic_debugfs_create(void)
 {
 	ionic_dir = debugfs_create_dir(IONIC_DRV_NAME, NULL);
+
+#ifdef IONIC_ADMINQ_EMU
+	debugfs_create_file("adminq_emu", 0600, ionic_dir, NULL,
+			    &adminq_emu_fops);
+#endif
 }
 
 void ionic_debugfs_destroy(void)
@@ -3610,6 +3610,11 @@ void ionic_lif_free(struct ionic_lif *lif)
 	if (!test_bit(IONIC_LIF_F_FW_RESET, lif->state))
 		ionic_lif_reset(lif);
 
+	/* free filter sync scratch, left behind if deinit was skipped */
+	kvfree(lif->rx_filters.sync_items);
+	lif->rx_filters.sync_items = NULL;
+	lif->rx_filters.sync_items_max = 0;
+
 	/* free lif info */
 	kfree(lif->identity);
 	dma_free_coherent(dev, lif->info_sz, lif->info, lif->info_pa);
@@ -211,6 +211,7 @@ struct ionic_qtype_info {
 };
 
 struct ionic_phc;
+struct ionic_adminq_emu;
 
 #define IONIC_LIF_NAME_MAX_SZ		32
 struct ionic_lif {
@@ -230,6 +231,9 @@ struct ionic_lif {
 
 	struct ionic_qcq *adminqcq;
 	struct ionic_qcq *notifyqcq;
+#ifdef IONIC_ADMINQ_EMU
+	struct ionic_adminq_emu *adminq_emu;	/* software adminq, no FW */
+#endif
 	struct mutex queue_lock;	/* lock for queue structures */
 	struct mutex config_lock;	/* lock for config actions */
 	spinlock_t adminq_lock;		/* lock for AdminQ operations */
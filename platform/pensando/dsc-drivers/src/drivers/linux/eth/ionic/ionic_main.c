@@ -12,6 +12,7 @@
 #include "ionic_bus.h"
 #include "ionic_lif.h"
 #include "ionic_debugfs.h"
+#include "ionic_adminq_emu.h"
 
 bool port_init_up = 1;
 module_param(port_init_up, bool, 0);
@@ -464,6 +465,123 @@ int ionic_adminq_post_wait_nomsg(struct ionic_lif *lif, struct ionic_admin_ctx *
 	return __ionic_adminq_post_wait(lif, ctx, false);
 }
 
+/* Post as many of the commands as there is adminq space for, ringing
+ * the doorbell once after the last one.  Returns the number posted.
+ */
+static int ionic_adminq_post_batch(struct ionic_lif *lif,
+				   struct ionic_admin_ctx **ctxs, int n)
+{
+	struct ionic_adminq_emu *emu = ionic_lif_adminq_emu(lif);
+	struct ionic_desc_info *desc_info;
+	unsigned long irqflags;
+	struct ionic_queue *q;
+	int err;
+	int i;
+
+	if (emu)
+		return ionic_adminq_emu_post(emu, ctxs, n);
+
+	spin_lock_irqsave(&lif->adminq_lock, irqflags);
+	if (!lif->adminqcq) {
+		spin_unlock_irqrestore(&lif->adminq_lock, irqflags);
+		return -EIO;
+	}
+
+	q = &lif->adminqcq->q;
+
+	n = min_t(int, n, ionic_q_space_avail(q));
+	if (!n) {
+		err = -ENOSPC;
+		goto err_out;
+	}
+
+	err = ionic_heartbeat_check(lif->ionic);
+	if (err)
+		goto err_out;
+
+	for (i = 0; i < n; i++) {
+		desc_info = &q->info[q->head_idx];
+		memcpy(desc_info->desc, &ctxs[i]->cmd, sizeof(ctxs[i]->cmd));
+
+		dev_dbg(&lif->netdev->dev, "post admin queue command:\n");
+		dynamic_hex_dump("cmd ", DUMP_PREFIX_OFFSET, 16, 1,
+				 &ctxs[i]->cmd, sizeof(ctxs[i]->cmd), true);
+
+		ionic_q_post(q, i == n - 1, ionic_adminq_cb, ctxs[i]);
+	}
+	err = n;
+
+err_out:
+	spin_unlock_irqrestore(&lif->adminq_lock, irqflags);
+
+	return err;
+}
+
+/**
+ * ionic_adminq_post_wait_batch() - Post a batch of commands and wait for them
+ * @lif:	LIF owning the adminq
+ * @ctxs:	Commands to post
+ * @errs:	Result of each command
+ * @n:		Number of commands
+ *
+ * The commands share doorbells and are all in flight at the same time,
+ * so the batch costs about one adminq round trip per adminq full of
+ * commands instead of one per command.  No error messages are printed,
+ * the caller decides which errors matter.
+ */
+void ionic_adminq_post_wait_batch(struct ionic_lif *lif,
+				  struct ionic_admin_ctx **ctxs, int *errs,
+				  int n)
+{
+	struct ionic_adminq_emu *emu = ionic_lif_adminq_emu(lif);
+	int abort_err = 0;
+	int posted;
+	int done;
+	int i;
+
+	/* if platform dev is resetting, don't bother with AdminQ, it's not there */
+	if (!emu && lif->ionic->pfdev &&
+	    test_bit(IONIC_LIF_F_FW_STOPPING, lif->state)) {
+		memset(errs, 0, n * sizeof(*errs));
+		return;
+	}
+
+	for (done = 0; done < n && !abort_err; done += posted) {
+		posted = ionic_adminq_post_batch(lif, &ctxs[done], n - done);
+		if (posted <= 0) {
+			/* a full adminq is worth another try later */
+			abort_err = (posted == -ENOSPC) ? -EAGAIN : posted;
+			break;
+		}
+
+		for (i = done; i < done + posted; i++) {
+			/* after a timeout or FW reset the adminq is flushed,
+			 * outstanding commands will not be completed
+			 */
+			if (abort_err && !completion_done(&ctxs[i]->work)) {
+				ctxs[i]->comp.comp.status = IONIC_RC_ERROR;
+				errs[i] = abort_err;
+				continue;
+			}
+
+			if (emu)
+				errs[i] = ionic_adminq_emu_wait(emu, ctxs[i]);
+			else
+				errs[i] = ionic_adminq_wait(lif, ctxs[i], 0, false);
+
+			if (errs[i] == -ENXIO && !abort_err)
+				ionic_adminq_flush(lif);
+			if (errs[i] == -ETIMEDOUT || errs[i] == -ENXIO)
+				abort_err = errs[i];
+		}
+	}
+
+	for (i = done; i < n; i++) {
+		ctxs[i]->comp.comp.status = IONIC_RC_ERROR;
+		errs[i] = abort_err;
+	}
+}
+
 static void ionic_dev_cmd_clean(struct ionic *ionic)
 {
 	struct ionic_dev *idev = &ionic->idev;
@@ -118,6 +118,10 @@ void ionic_rx_filters_deinit(struct ionic_lif *lif)
 			ionic_rx_filter_free(lif, f);
 	}
 	spin_unlock_bh(&lif->rx_filters.lock);
+
+	kvfree(lif->rx_filters.sync_items);
+	lif->rx_filters.sync_items = NULL;
+	lif->rx_filters.sync_items_max = 0;
 }
 
 int ionic_rx_filter_save(struct ionic_lif *lif, u32 flow_id, u16 rxq_index,
@@ -301,34 +305,39 @@ int ionic_lif_list_addr(struct ionic_lif *lif, const u8 *addr, bool mode)
 	return 0;
 }
 
-static int ionic_lif_filter_add(struct ionic_lif *lif,
-				struct ionic_rx_filter_add_cmd *ac)
+/* Build the add command for ac and mark its filter as being synced.
+ * Returns 1 if the filter is already synced, -ENOSPC if the FW is known
+ * to be out of room, 0 if the command is to be posted.  pending_vlans
+ * and pending_macs count the adds posted along with this one.
+ */
+static int ionic_lif_filter_add_prep(struct ionic_lif *lif,
+				     struct ionic_admin_ctx *ctx,
+				     struct ionic_rx_filter_add_cmd *ac,
+				     unsigned int pending_vlans,
+				     unsigned int pending_macs)
 {
-	struct ionic_admin_ctx ctx = {
-		.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work),
-	};
 	struct ionic_rx_filter *f;
 	int nfilters;
 	int err = 0;
 
-	ctx.cmd.rx_filter_add = *ac;
-	ctx.cmd.rx_filter_add.opcode = IONIC_CMD_RX_FILTER_ADD,
-	ctx.cmd.rx_filter_add.lif_index = cpu_to_le16(lif->index),
+	ctx->cmd.rx_filter_add = *ac;
+	ctx->cmd.rx_filter_add.opcode = IONIC_CMD_RX_FILTER_ADD,
+	ctx->cmd.rx_filter_add.lif_index = cpu_to_le16(lif->index),
 
 	spin_lock_bh(&lif->rx_filters.lock);
-	f = ionic_rx_filter_find(lif, &ctx.cmd.rx_filter_add);
+	f = ionic_rx_filter_find(lif, &ctx->cmd.rx_filter_add);
 	if (f) {
 		/* don't bother if we already have it and it is sync'd */
 		if (f->state == IONIC_FILTER_STATE_SYNCED) {
 			spin_unlock_bh(&lif->rx_filters.lock);
-			return 0;
+			return 1;
 		}
 
 		/* mark preemptively as sync'd to block any parallel attempts */
 		f->state = IONIC_FILTER_STATE_SYNCED;
 	} else {
 		/* save as SYNCED to catch any DEL requests while processing */
-		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, &ctx,
+		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, ctx,
 					   IONIC_FILTER_STATE_SYNCED);
 	}
 	spin_unlock_bh(&lif->rx_filters.lock);
@@ -340,30 +349,37 @@ static int ionic_lif_filter_add(struct ionic_lif *lif,
 	 * Since the FW doesn't have a way to tell us the vlan limit,
 	 * we start max_vlans at 0 until we hit the ENOSPC error.
 	 */
-	switch (le16_to_cpu(ctx.cmd.rx_filter_add.match)) {
+	switch (le16_to_cpu(ctx->cmd.rx_filter_add.match)) {
 	case IONIC_RX_FILTER_MATCH_VLAN:
 		netdev_dbg(lif->netdev, "%s: rx_filter add VLAN %d\n",
-			   __func__, ctx.cmd.rx_filter_add.vlan.vlan);
-		if (lif->max_vlans && lif->nvlans >= lif->max_vlans)
+			   __func__, ctx->cmd.rx_filter_add.vlan.vlan);
+		if (lif->max_vlans &&
+		    lif->nvlans + pending_vlans >= lif->max_vlans)
 			err = -ENOSPC;
 		break;
 	case IONIC_RX_FILTER_MATCH_MAC:
 		netdev_dbg(lif->netdev, "%s: rx_filter add ADDR %pM\n",
-			   __func__, ctx.cmd.rx_filter_add.mac.addr);
+			   __func__, ctx->cmd.rx_filter_add.mac.addr);
 		nfilters = le32_to_cpu(lif->identity->eth.max_ucast_filters);
-		if ((lif->nucast + lif->nmcast) >= nfilters)
+		if ((lif->nucast + lif->nmcast + pending_macs) >= nfilters)
 			err = -ENOSPC;
 		break;
 	}
 
-	if (err != -ENOSPC)
-		err = ionic_adminq_post_wait_nomsg(lif, &ctx);
+	return err;
+}
+
+/* Account for the result of an add command built by ionic_lif_filter_add_prep */
+static int ionic_lif_filter_add_done(struct ionic_lif *lif,
+				     struct ionic_admin_ctx *ctx, int err)
+{
+	struct ionic_rx_filter *f;
 
 	spin_lock_bh(&lif->rx_filters.lock);
 
 	if (err && err != -EEXIST) {
 		/* set the state back to NEW so we can try again later */
-		f = ionic_rx_filter_find(lif, &ctx.cmd.rx_filter_add);
+		f = ionic_rx_filter_find(lif, &ctx->cmd.rx_filter_add);
 		if (f && f->state == IONIC_FILTER_STATE_SYNCED) {
 			f->state = IONIC_FILTER_STATE_NEW;
 
@@ -378,7 +394,7 @@ static int ionic_lif_filter_add(struct ionic_lif *lif,
 
 		/* store the max_vlans limit that we found */
 		if (err == -ENOSPC &&
-		    le16_to_cpu(ctx.cmd.rx_filter_add.match) == IONIC_RX_FILTER_MATCH_VLAN)
+		    le16_to_cpu(ctx->cmd.rx_filter_add.match) == IONIC_RX_FILTER_MATCH_VLAN)
 			lif->max_vlans = lif->nvlans;
 
 		/* Prevent unnecessary error messages on recoverable
@@ -396,45 +412,45 @@ static int ionic_lif_filter_add(struct ionic_lif *lif,
 			break;
 		}
 
-		ionic_adminq_netdev_err_print(lif, ctx.cmd.cmd.opcode,
-					      ctx.comp.comp.status, err);
-		switch (le16_to_cpu(ctx.cmd.rx_filter_add.match)) {
+		ionic_adminq_netdev_err_print(lif, ctx->cmd.cmd.opcode,
+					      ctx->comp.comp.status, err);
+		switch (le16_to_cpu(ctx->cmd.rx_filter_add.match)) {
 		case IONIC_RX_FILTER_MATCH_VLAN:
 			netdev_info(lif->netdev, "rx_filter add failed: VLAN %d\n",
-				    ctx.cmd.rx_filter_add.vlan.vlan);
+				    ctx->cmd.rx_filter_add.vlan.vlan);
 			break;
 		case IONIC_RX_FILTER_MATCH_MAC:
 			netdev_info(lif->netdev, "rx_filter add failed: ADDR %pM\n",
-				    ctx.cmd.rx_filter_add.mac.addr);
+				    ctx->cmd.rx_filter_add.mac.addr);
 			break;
 		}
 
 		return err;
 	}
 
-	switch (le16_to_cpu(ctx.cmd.rx_filter_add.match)) {
+	switch (le16_to_cpu(ctx->cmd.rx_filter_add.match)) {
 	case IONIC_RX_FILTER_MATCH_VLAN:
 		lif->nvlans++;
 		break;
 	case IONIC_RX_FILTER_MATCH_MAC:
-		if (is_multicast_ether_addr(ctx.cmd.rx_filter_add.mac.addr))
+		if (is_multicast_ether_addr(ctx->cmd.rx_filter_add.mac.addr))
 			lif->nmcast++;
 		else
 			lif->nucast++;
 		break;
 	}
 
-	f = ionic_rx_filter_find(lif, &ctx.cmd.rx_filter_add);
+	f = ionic_rx_filter_find(lif, &ctx->cmd.rx_filter_add);
 	if (f && f->state == IONIC_FILTER_STATE_OLD) {
 		/* Someone requested a delete while we were adding
 		 * so update the filter info with the results from the add
 		 * and the data will be there for the delete on the next
 		 * sync cycle.
 		 */
-		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, &ctx,
+		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, ctx,
 					   IONIC_FILTER_STATE_OLD);
 	} else {
-		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, &ctx,
+		err = ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, ctx,
 					   IONIC_FILTER_STATE_SYNCED);
 	}
 
@@ -443,6 +459,26 @@ static int ionic_lif_filter_add(struct ionic_lif *lif,
 	return err;
 }
 
+static int ionic_lif_filter_add(struct ionic_lif *lif,
+				struct ionic_rx_filter_add_cmd *ac)
+{
+	struct ionic_admin_ctx ctx = {
+		.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work),
+	};
+	int err;
+
+	err = ionic_lif_filter_add_prep(lif, &ctx, ac, 0, 0);
+	if (err > 0)
+		return 0;
+	if (err && err != -ENOSPC)
+		return err;
+
+	if (err != -ENOSPC)
+		err = ionic_adminq_post_wait_nomsg(lif, &ctx);
+
+	return ionic_lif_filter_add_done(lif, &ctx, err);
+}
+
 int ionic_lif_addr_add(struct ionic_lif *lif, const u8 *addr)
 {
 	struct ionic_rx_filter_add_cmd ac = {
@@ -464,19 +500,19 @@ int ionic_lif_vlan_add(struct ionic_lif *lif, const u16 vid)
 	return ionic_lif_filter_add(lif, &ac);
 }
 
-static int ionic_lif_filter_del(struct ionic_lif *lif,
-				struct ionic_rx_filter_add_cmd *ac)
+/* Build the del command for ac and drop the filter from the lists.
+ * Returns 1 if the FW never had the filter, 0 if the command is to be
+ * posted.
+ */
+static int ionic_lif_filter_del_prep(struct ionic_lif *lif,
+				     struct ionic_admin_ctx *ctx,
+				     struct ionic_rx_filter_add_cmd *ac)
 {
-	struct ionic_admin_ctx ctx = {
-		.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work),
-		.cmd.rx_filter_del = {
-			.opcode = IONIC_CMD_RX_FILTER_DEL,
-			.lif_index = cpu_to_le16(lif->index),
-		},
-	};
 	struct ionic_rx_filter *f;
 	int state;
-	int err;
+
+	ctx->cmd.rx_filter_del.opcode = IONIC_CMD_RX_FILTER_DEL;
+	ctx->cmd.rx_filter_del.lif_index = cpu_to_le16(lif->index);
 
 	spin_lock_bh(&lif->rx_filters.lock);
 	f = ionic_rx_filter_find(lif, ac);
@@ -502,33 +538,54 @@ static int ionic_lif_filter_del(struct ionic_lif *lif,
 	}
 
 	state = f->state;
-	ctx.cmd.rx_filter_del.filter_id = cpu_to_le32(f->filter_id);
+	ctx->cmd.rx_filter_del.filter_id = cpu_to_le32(f->filter_id);
 	ionic_rx_filter_free(lif, f);
 
 	spin_unlock_bh(&lif->rx_filters.lock);
 
-	if (state != IONIC_FILTER_STATE_NEW) {
-		err = ionic_adminq_post_wait_nomsg(lif, &ctx);
+	return (state == IONIC_FILTER_STATE_NEW) ? 1 : 0;
+}
 
-		switch (err) {
-			/* ignore these errors */
-		case -EEXIST:
-		case -ENXIO:
-		case -ETIMEDOUT:
-		case -EAGAIN:
-		case -EBUSY:
-		case 0:
-			break;
-		default:
-			ionic_adminq_netdev_err_print(lif, ctx.cmd.cmd.opcode,
-						      ctx.comp.comp.status, err);
-			return err;
-		}
+static int ionic_lif_filter_del_done(struct ionic_lif *lif,
+				     struct ionic_admin_ctx *ctx, int err)
+{
+	switch (err) {
+		/* ignore these errors */
+	case -EEXIST:
+	case -ENXIO:
+	case -ETIMEDOUT:
+	case -EAGAIN:
+	case -EBUSY:
+	case 0:
+		break;
+	default:
+		ionic_adminq_netdev_err_print(lif, ctx->cmd.cmd.opcode,
+					      ctx->comp.comp.status, err);
+		return err;
 	}
 
 	return 0;
 }
 
+static int ionic_lif_filter_del(struct ionic_lif *lif,
+				struct ionic_rx_filter_add_cmd *ac)
+{
+	struct ionic_admin_ctx ctx = {
+		.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work),
+	};
+	int err;
+
+	err = ionic_lif_filter_del_prep(lif, &ctx, ac);
+	if (err < 0)
+		return err;
+	if (err > 0)
+		return 0;
+
+	err = ionic_adminq_post_wait_nomsg(lif, &ctx);
+
+	return ionic_lif_filter_del_done(lif, &ctx, err);
+}
+
 int ionic_lif_addr_del(struct ionic_lif *lif, const u8 *addr)
 {
 	struct ionic_rx_filter_add_cmd ac = {
@@ -550,49 +607,169 @@ int ionic_lif_vlan_del(struct ionic_lif *lif, const u16 vid)
 	return ionic_lif_filter_del(lif, &ac);
 }
 
-struct sync_item {
-	struct list_head list;
-	struct ionic_rx_filter f;
-};
+/* Filter commands posted per adminq doorbell, the adminq keeps one
+ * descriptor free
+ */
+#define IONIC_RX_FILTER_BATCH	(IONIC_ADMINQ_LENGTH - 1)
+
+/* Make room for n sync items, with GFP_KERNEL as the items are sized
+ * before the filter lock is taken
+ */
+static int ionic_rx_filter_sync_items_alloc(struct ionic_lif *lif,
+					    unsigned int n)
+{
+	struct ionic_rx_filter_sync_item *items;
+	unsigned int max;
+
+	if (n <= lif->rx_filters.sync_items_max)
+		return 0;
+
+	max = roundup_pow_of_two(max_t(unsigned int, n, IONIC_RX_FILTER_BATCH + 1));
+	items = kvcalloc(max, sizeof(*items), GFP_KERNEL);
+	if (!items)
+		return -ENOMEM;
+
+	kvfree(lif->rx_filters.sync_items);
+	lif->rx_filters.sync_items = items;
+	lif->rx_filters.sync_items_max = max;
+
+	return 0;
+}
+
+/* Send the adds or deletes of the sync items, a batch per doorbell */
+static void ionic_rx_filter_sync_batch(struct ionic_lif *lif,
+				       struct ionic_rx_filter_sync_item *items,
+				       unsigned int n, bool add)
+{
+	struct ionic_admin_ctx *ctxs[IONIC_RX_FILTER_BATCH];
+	struct ionic_rx_filter_sync_item *item;
+	int errs[IONIC_RX_FILTER_BATCH];
+	unsigned int pending_vlans;
+	unsigned int pending_macs;
+	unsigned int start;
+	unsigned int i;
+	int nposted;
+	int err;
+
+	for (start = 0; start < n; start = i) {
+		pending_vlans = 0;
+		pending_macs = 0;
+		nposted = 0;
+
+		for (i = start; i < n && nposted < IONIC_RX_FILTER_BATCH; i++) {
+			item = &items[i];
+			memset(&item->ctx, 0, sizeof(item->ctx));
+			init_completion(&item->ctx.work);
+
+			if (add)
+				item->err = ionic_lif_filter_add_prep(lif, &item->ctx,
+								      &item->cmd,
+								      pending_vlans,
+								      pending_macs);
+			else
+				item->err = ionic_lif_filter_del_prep(lif, &item->ctx,
+								      &item->cmd);
+			if (item->err)
+				continue;
+
+			switch (le16_to_cpu(item->cmd.match)) {
+			case IONIC_RX_FILTER_MATCH_VLAN:
+				pending_vlans++;
+				break;
+			case IONIC_RX_FILTER_MATCH_MAC:
+				pending_macs++;
+				break;
+			}
+			ctxs[nposted++] = &item->ctx;
+		}
+
+		if (nposted)
+			ionic_adminq_post_wait_batch(lif, ctxs, errs, nposted);
+
+		/* Account for the results in order, the counters and
+		 * limits end up as if the commands were sent one by one
+		 */
+		for (nposted = 0; start < i; start++) {
+			item = &items[start];
+			if (!item->err)
+				err = errs[nposted++];
+			else if (add && item->err == -ENOSPC)
+				err = -ENOSPC;
+			else
+				continue;
+
+			if (add)
+				(void)ionic_lif_filter_add_done(lif, &item->ctx, err);
+			else
+				(void)ionic_lif_filter_del_done(lif, &item->ctx, err);
+		}
+	}
+}
 
+/* Called with the lif config_lock held, which also guards the sync items */
 void ionic_rx_filter_sync(struct ionic_lif *lif)
 {
-	struct device *dev = lif->ionic->dev;
-	struct list_head sync_add_list;
-	struct list_head sync_del_list;
-	struct sync_item *sync_item;
+	struct ionic_rx_filter_sync_item *items;
 	struct ionic_rx_filter *f;
 	struct hlist_head *head;
-	struct hlist_node *tmp;
-	struct sync_item *spos;
+	unsigned int nitems;
+	unsigned int ndel;
+	unsigned int nadd;
 	unsigned int i;
 
-	INIT_LIST_HEAD(&sync_add_list);
-	INIT_LIST_HEAD(&sync_del_list);
-
 	clear_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state);
 
-	/* Copy the filters to be added and deleted
-	 * into a separate local list that needs no locking.
+	/* Count the filters to be added and deleted, the sync items
+	 * are sized for them outside of the lock
 	 */
+	nitems = 0;
 	spin_lock_bh(&lif->rx_filters.lock);
 	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
 		head = &lif->rx_filters.by_id[i];
-		hlist_for_each_entry_safe(f, tmp, head, by_id) {
+		hlist_for_each_entry(f, head, by_id)
 			if (f->state == IONIC_FILTER_STATE_NEW ||
-			    f->state == IONIC_FILTER_STATE_OLD) {
-				sync_item = devm_kzalloc(dev, sizeof(*sync_item),
-							 GFP_ATOMIC);
-				if (!sync_item)
-					goto loop_out;
-
-				sync_item->f = *f;
-
-				if (f->state == IONIC_FILTER_STATE_NEW)
-					list_add(&sync_item->list, &sync_add_list);
-				else
-					list_add(&sync_item->list, &sync_del_list);
+			    f->state == IONIC_FILTER_STATE_OLD)
+				nitems++;
+	}
+	spin_unlock_bh(&lif->rx_filters.lock);
+
+	if (!nitems)
+		return;
+
+	/* On failure make do with the items we have */
+	if (ionic_rx_filter_sync_items_alloc(lif, nitems) &&
+	    !lif->rx_filters.sync_items_max) {
+		set_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state);
+		return;
+	}
+
+	items = lif->rx_filters.sync_items;
+	nitems = lif->rx_filters.sync_items_max;
+
+	/* Copy the filters to be added and deleted into the sync items,
+	 * deletes from the front and adds from the back, so they can be
+	 * sent without the lock.  Filters that changed since they were
+	 * counted and don't fit are left for the next sync.
+	 */
+	ndel = 0;
+	nadd = 0;
+	spin_lock_bh(&lif->rx_filters.lock);
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
+		head = &lif->rx_filters.by_id[i];
+		hlist_for_each_entry(f, head, by_id) {
+			if (f->state != IONIC_FILTER_STATE_NEW &&
+			    f->state != IONIC_FILTER_STATE_OLD)
+				continue;
+
+			if (ndel + nadd == nitems) {
+				set_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state);
+				goto loop_out;
 			}
+
+			if (f->state == IONIC_FILTER_STATE_NEW)
+				items[nitems - ++nadd].cmd = f->cmd;
+			else
+				items[ndel++].cmd = f->cmd;
 		}
 	}
 loop_out:
@@ -603,17 +780,6 @@ loop_out:
 	 * Do the deletes first in case we're in an overflow state and
 	 * they can clear room for some new filters
 	 */
-	list_for_each_entry_safe(sync_item, spos, &sync_del_list, list) {
-		(void)ionic_lif_filter_del(lif, &sync_item->f.cmd);
-
-		list_del(&sync_item->list);
-		devm_kfree(dev, sync_item);
-	}
-
-	list_for_each_entry_safe(sync_item, spos, &sync_add_list, list) {
-		(void)ionic_lif_filter_add(lif, &sync_item->f.cmd);
-
-		list_del(&sync_item->list);
-		devm_kfree(dev, sync_item);
-	}
+	ionic_rx_filter_sync_batch(lif, items, ndel, false);
+	ionic_rx_filter_sync_batch(lif, &items[nitems - nadd], nadd, true);
 }
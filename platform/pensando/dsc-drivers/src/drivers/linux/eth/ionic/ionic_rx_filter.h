@@ -22,6 +22,13 @@ struct ionic_rx_filter {
 	struct hlist_node by_id;
 };
 
+/* Scratch entry for sending a filter command during a sync */
+struct ionic_rx_filter_sync_item {
+	struct ionic_rx_filter_add_cmd cmd;
+	struct ionic_admin_ctx ctx;
+	int err;
+};
+
 #define IONIC_RX_FILTER_HASH_BITS	10
 #define IONIC_RX_FILTER_HLISTS		BIT(IONIC_RX_FILTER_HASH_BITS)
 #define IONIC_RX_FILTER_HLISTS_MASK	(IONIC_RX_FILTER_HLISTS - 1)
@@ -29,6 +36,8 @@ struct ionic_rx_filters {
 	spinlock_t lock;				    /* filter list lock */
 	struct hlist_head by_hash[IONIC_RX_FILTER_HLISTS];  /* by skb hash */
 	struct hlist_head by_id[IONIC_RX_FILTER_HLISTS];    /* by filter_id */
+	struct ionic_rx_filter_sync_item *sync_items;	    /* sync scratch */
+	unsigned int sync_items_max;
 };
 
 void ionic_rx_filter_free(struct ionic_lif *lif, struct ionic_rx_filter *f);
@@ -0,0 +1,507 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2021-2022, Pensando Systems Inc.
+ */
+
+/*
+ * Host userspace "system" for the pciesvc library.
+ *
+ * This provides the same upcalls kpcinterface.c provides for
+ * the kpcimgr module, backed by process memory instead of the
+ * card: a calloc'd shmem, an aligned hwmem, and a sparse register
+ * map standing in for the asic csrs.  Just enough of the pxb
+ * indirect transaction hardware is modeled (ind_info, aximst srams,
+ * ind_rsp) to feed tlps through the library's indirect path.
+ */
+
+#include "pciesvc_impl.h"
+#include "indirect_entry.h"
+#include "pciesvc_host.h"
+
+/* must match the hw layout used by indirect.c */
+#define IND_INFO_BASE           PXB_(STA_TGT_IND_INFO)
+#define IND_INFO_STRIDE         4
+#define IND_RSP_ADDR            PXB_(DHS_TGT_IND_RSP_ENTRY)
+#define IND_RSP_NWORDS          5
+#define AXIMST_BASE             PXB_(DHS_TGT_AXIMST0)
+#define AXIMST_STRIDE           \
+    (ASIC_(PXB_CSR_DHS_TGT_AXIMST1_BYTE_ADDRESS) - \
+     ASIC_(PXB_CSR_DHS_TGT_AXIMST0_BYTE_ADDRESS))
+#define AXIMST_ENTRY_STRIDE     32
+#define AXIMST_PORT_STRIDE      (AXIMST_ENTRY_STRIDE * 16)
+#define AXIMST_NROWS            5
+
+/*****************************************************************
+ * sparse register map
+ *
+ * Open addressed, keyed by (pa | 1) so a zero key marks a free
+ * slot (register addresses are always dword aligned).
+ */
+
+typedef struct regent_s {
+    u_int64_t key;
+    u_int32_t val;
+} regent_t;
+
+typedef struct regmap_s {
+    regent_t *tab;
+    u_int32_t mask;
+    u_int32_t count;
+} regmap_t;
+
+static regmap_t regmap;
+
+static u_int32_t
+regmap_hash(const u_int64_t key)
+{
+    /* 64-bit fibonacci hash */
+    return (u_int32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+static regent_t *
+regmap_lookup(regmap_t *rm, const u_int64_t pa)
+{
+    const u_int64_t key = pa | 1;
+    u_int32_t i;
+
+    for (i = regmap_hash(key) & rm->mask; ; i = (i + 1) & rm->mask) {
+        regent_t *re = &rm->tab[i];
+
+        if (re->key == key || re->key == 0) {
+            return re;
+        }
+    }
+}
+
+static int
+regmap_grow(regmap_t *rm)
+{
+    const u_int32_t osize = rm->mask + 1;
+    regent_t *otab = rm->tab;
+    u_int32_t i;
+
+    rm->tab = calloc(osize * 2, sizeof(regent_t));
+    if (rm->tab == NULL) {
+        rm->tab = otab;
+        return -1;
+    }
+    rm->mask = osize * 2 - 1;
+    for (i = 0; i < osize; i++) {
+        if (otab[i].key) {
+            *regmap_lookup(rm, otab[i].key) = otab[i];
+        }
+    }
+    free(otab);
+    return 0;
+}
+
+static u_int32_t
+regmap_rd(regmap_t *rm, const u_int64_t pa)
+{
+    return regmap_lookup(rm, pa)->val;
+}
+
+static void
+regmap_wr(regmap_t *rm, const u_int64_t pa, const u_int32_t val)
+{
+    regent_t *re = regmap_lookup(rm, pa);
+
+    if (re->key == 0) {
+        /* keep load factor under 1/2 */
+        if ((rm->count + 1) * 2 > rm->mask + 1) {
+            pciesvc_assert(regmap_grow(rm) == 0);
+            re = regmap_lookup(rm, pa);
+        }
+        re->key = pa | 1;
+        rm->count++;
+    }
+    re->val = val;
+}
+
+/*****************************************************************
+ * host state
+ */
+
+static pciehw_shmem_t *host_shmem;
+static pciehw_mem_t *host_hwmem;
+static pciesvc_host_stats_t host_stats;
+static pciesvc_host_cpl_t host_cpl;
+static int host_cpl_valid;
+static int host_verbose;
+
+static int
+hwmem_pa(const u_int64_t pa)
+{
+    return (pa >= PCIESVC_HOST_HWMEM_PA &&
+            pa < PCIESVC_HOST_HWMEM_PA + sizeof(pciehw_mem_t));
+}
+
+static u_int32_t *
+hwmem_va(const u_int64_t pa)
+{
+    return (u_int32_t *)((u_int8_t *)host_hwmem +
+                         (pa - PCIESVC_HOST_HWMEM_PA));
+}
+
+/*
+ * The last word of the ind_rsp entry is the one that carries the
+ * port/cpl_stat fields, the hw sends the completion and drops the
+ * pending indication when that is written.
+ */
+static void
+ind_rsp_written(void)
+{
+    union {
+        struct {
+            u_int32_t data[4];
+            u_int32_t cpl_stat:3;
+            u_int32_t port_id:3;
+            u_int32_t axi_id:7;
+            u_int32_t fetch_rsp:1;
+        } __attribute__((packed));
+        u_int32_t w[IND_RSP_NWORDS];
+    } ind_rsp;
+    int i;
+
+    for (i = 0; i < IND_RSP_NWORDS; i++) {
+        ind_rsp.w[i] = regmap_rd(&regmap, IND_RSP_ADDR + i * 4);
+    }
+    pciesvc_memcpy(host_cpl.data, ind_rsp.data, sizeof(host_cpl.data));
+    host_cpl.cpl_stat = ind_rsp.cpl_stat;
+    host_cpl.port = ind_rsp.port_id;
+    host_cpl.axi_id = ind_rsp.axi_id;
+    host_cpl_valid = 1;
+    host_stats.ind_cpl++;
+
+    regmap_wr(&regmap, IND_INFO_BASE + host_cpl.port * IND_INFO_STRIDE, 0);
+}
+
+/*****************************************************************
+ * pciesvc upcalls
+ */
+
+void
+pciesvc_host_assert_fail(const char *expr, const char *file,
+                         const char *func, const int line)
+{
+    fprintf(stderr, "Assertion failed! %s,%s,%s,line=%d\n",
+            expr, file, func, line);
+    abort();
+}
+
+u_int64_t
+pciesvc_vtop(const void *hwmemva)
+{
+    const u_int8_t *va = hwmemva;
+    const u_int8_t *base = (const u_int8_t *)host_hwmem;
+
+    if (va >= base && va < base + sizeof(pciehw_mem_t)) {
+        return PCIESVC_HOST_HWMEM_PA + (va - base);
+    }
+    return 0;
+}
+
+void *
+pciesvc_hwmem_get(void)
+{
+    return host_hwmem;
+}
+
+void *
+pciesvc_shmem_get(void)
+{
+    return host_shmem;
+}
+
+uint32_t
+pciesvc_reg_rd32(const uint64_t pa)
+{
+    pciesvc_assert((pa & 0x3) == 0);
+    host_stats.reg_rd++;
+    if (hwmem_pa(pa)) {
+        return *hwmem_va(pa);
+    }
+    return regmap_rd(&regmap, pa);
+}
+
+void
+pciesvc_pciepreg_rd32(const uint64_t pa, uint32_t *dest)
+{
+    *dest = pciesvc_reg_rd32(pa);
+}
+
+void
+pciesvc_reg_wr32(const uint64_t pa, const uint32_t val)
+{
+    pciesvc_assert((pa & 0x3) == 0);
+    host_stats.reg_wr++;
+    if (hwmem_pa(pa)) {
+        *hwmem_va(pa) = val;
+        return;
+    }
+    regmap_wr(&regmap, pa, val);
+    if (pa == IND_RSP_ADDR + (IND_RSP_NWORDS - 1) * 4) {
+        ind_rsp_written();
+    }
+}
+
+typedef union {
+    u_int32_t l;
+    u_int16_t h[2];
+    u_int8_t  b[4];
+} iodata_t;
+
+int
+pciesvc_mem_rd(const uint64_t pa, void *buf, const size_t sz)
+{
+    uint64_t pa_aligned;
+    uint8_t idx;
+    iodata_t v;
+
+    switch (sz) {
+    case 1:
+        pa_aligned = pa & ~0x3;
+        idx = pa & 0x3;
+        v.l = pciesvc_reg_rd32(pa_aligned);
+        *(uint8_t *)buf = v.b[idx];
+        break;
+    case 2:
+        pa_aligned = pa & ~0x3;
+        idx = (pa & 0x3) >> 1;
+        v.l = pciesvc_reg_rd32(pa_aligned);
+        *(uint16_t *)buf = v.h[idx];
+        break;
+    case 4:
+    case 8:
+        pciesvc_reg_rd32w(pa, (uint32_t *)buf, sz >> 2);
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+void
+pciesvc_mem_wr(const uint64_t pa, const void *buf, const size_t sz)
+{
+    uint64_t pa_aligned;
+    uint8_t idx;
+    iodata_t v;
+
+    switch (sz) {
+    case 1:
+        pa_aligned = pa & ~0x3;
+        idx = pa & 0x3;
+        v.l = pciesvc_reg_rd32(pa_aligned);
+        v.b[idx] = *(uint8_t *)buf;
+        pciesvc_reg_wr32(pa_aligned, v.l);
+        break;
+    case 2:
+        pa_aligned = pa & ~0x3;
+        idx = (pa & 0x3) >> 1;
+        v.l = pciesvc_reg_rd32(pa_aligned);
+        v.h[idx] = *(uint16_t *)buf;
+        pciesvc_reg_wr32(pa_aligned, v.l);
+        break;
+    case 4:
+    case 8:
+        pciesvc_reg_wr32w(pa, (uint32_t *)buf, sz >> 2);
+        break;
+    default:
+        break;
+    }
+}
+
+void
+pciesvc_mem_barrier(void)
+{
+    __sync_synchronize();
+}
+
+void *
+pciesvc_memset(void *s, int c, size_t n)
+{
+    return memset(s, c, n);
+}
+
+void *
+pciesvc_memcpy(void *dst, const void *src, size_t n)
+{
+    return memcpy(dst, src, n);
+}
+
+void *
+pciesvc_memcpy_toio(void *dsthw, const void *src, size_t n)
+{
+    return memcpy(dsthw, src, n);
+}
+
+void
+pciesvc_log(const char *msg)
+{
+    if (host_verbose) {
+        fputs(msg, stderr);
+    }
+}
+
+int
+pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize)
+{
+    host_stats.events++;
+    if (evsize != sizeof(pciesvc_eventdata_t)) {
+        return -1;
+    }
+    if (host_verbose && evdata->evtype == PCIESVC_EV_LOGMSG) {
+        fprintf(stderr, "%s", evdata->logmsg.msg);
+    }
+    return 0;
+}
+
+void
+pciesvc_debug_cmd(uint32_t *valp)
+{
+    uint32_t delayus = *valp;
+
+    if (delayus) {
+        pciesvc_usleep(delayus);
+    }
+}
+
+/*****************************************************************
+ * harness apis
+ */
+
+int
+pciesvc_host_init(void)
+{
+    const size_t hwmemsz = roundup(sizeof(pciehw_mem_t), PCIEHW_NOTIFYSZ);
+
+    pciesvc_host_fini();
+
+    host_shmem = calloc(1, sizeof(pciehw_shmem_t));
+    host_hwmem = aligned_alloc(PCIEHW_NOTIFYSZ, hwmemsz);
+    regmap.mask = 1024 - 1;
+    regmap.count = 0;
+    regmap.tab = calloc(regmap.mask + 1, sizeof(regent_t));
+    if (host_shmem == NULL || host_hwmem == NULL || regmap.tab == NULL) {
+        pciesvc_host_fini();
+        return -1;
+    }
+    pciesvc_memset(host_hwmem, 0, hwmemsz);
+
+    host_shmem->magic = PCIEHW_MAGIC;
+    host_shmem->version = PCIEHW_VERSION;
+    host_shmem->hwinit = 1;
+    host_hwmem->magic = PCIEHW_MAGIC;
+    host_hwmem->version = PCIEHW_VERSION;
+
+    pciesvc_host_clr_stats();
+    host_cpl_valid = 0;
+    return 0;
+}
+
+void
+pciesvc_host_fini(void)
+{
+    free(host_shmem);
+    free(host_hwmem);
+    free(regmap.tab);
+    host_shmem = NULL;
+    host_hwmem = NULL;
+    regmap.tab = NULL;
+}
+
+void
+pciesvc_host_set_verbose(const int verbose)
+{
+    host_verbose = verbose;
+}
+
+u_int32_t
+pciesvc_host_reg_peek(const u_int64_t pa)
+{
+    if (hwmem_pa(pa)) {
+        return *hwmem_va(pa);
+    }
+    return regmap_rd(&regmap, pa);
+}
+
+void
+pciesvc_host_reg_poke(const u_int64_t pa, const u_int32_t val)
+{
+    if (hwmem_pa(pa)) {
+        *hwmem_va(pa) = val;
+        return;
+    }
+    regmap_wr(&regmap, pa, val);
+}
+
+/*
+ * Inverse of decode_indirect_info() in indirect.c: the raw tlp is
+ * stored byte reversed in the top of the 64 byte tlp area, the aux
+ * info follows in natural order.
+ */
+void
+pciesvc_host_indirect_stage(const int port, const int entry,
+                            const void *rtlp, const size_t rtlpsz,
+                            const tlpauxinfo_t *info)
+{
+    union {
+        u_int8_t b[AXIMST_NROWS * 16];
+        u_int32_t w[AXIMST_NROWS * 4];
+    } buf;
+    const u_int8_t *p = rtlp;
+    u_int64_t pa;
+    int i;
+
+    pciesvc_assert(rtlpsz <= INDIRECT_TLPSZ);
+    pciesvc_memset(&buf, 0, sizeof(buf));
+    for (i = 0; i < rtlpsz; i++) {
+        buf.b[63 - i] = p[i];
+    }
+    pciesvc_memcpy(&buf.b[64], info, sizeof(*info));
+
+    for (i = 0; i < AXIMST_NROWS; i++) {
+        pa = (AXIMST_BASE +
+              ((u_int64_t)i * AXIMST_STRIDE) +
+              ((u_int64_t)port * AXIMST_PORT_STRIDE) +
+              ((u_int64_t)entry * AXIMST_ENTRY_STRIDE));
+        regmap_wr(&regmap, pa + 0x0, buf.w[i * 4 + 0]);
+        regmap_wr(&regmap, pa + 0x4, buf.w[i * 4 + 1]);
+        regmap_wr(&regmap, pa + 0x8, buf.w[i * 4 + 2]);
+        regmap_wr(&regmap, pa + 0xc, buf.w[i * 4 + 3]);
+    }
+
+    /* ind_info: pending:1 entry:4 port:3 */
+    regmap_wr(&regmap, IND_INFO_BASE + port * IND_INFO_STRIDE,
+              1 | ((entry & 0xf) << 1) | ((port & 0x7) << 5));
+    host_cpl_valid = 0;
+}
+
+int
+pciesvc_host_indirect_pending(const int port)
+{
+    return regmap_rd(&regmap, IND_INFO_BASE + port * IND_INFO_STRIDE) & 1;
+}
+
+int
+pciesvc_host_indirect_cpl(pciesvc_host_cpl_t *cpl)
+{
+    if (!host_cpl_valid) {
+        return -1;
+    }
+    *cpl = host_cpl;
+    return 0;
+}
+
+void
+pciesvc_host_get_stats(pciesvc_host_stats_t *stats)
+{
+    *stats = host_stats;
+}
+
+void
+pciesvc_host_clr_stats(void)
+{
+    pciesvc_memset(&host_stats, 0, sizeof(host_stats));
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2021-2022, Pensando Systems Inc.
+ */
+
+#ifndef __PCIESVC_HOST_H__
+#define __PCIESVC_HOST_H__
+
+#include "tlpauxinfo.h"
+
+/*
+ * Fake "physical" address map seen by the pciesvc library
+ * when running in a host process.
+ *
+ * hwmem is backed by a real allocation and is reached through
+ * pciesvc_vtop()/pciesvc_reg_*() at PCIESVC_HOST_HWMEM_PA.
+ * Everything else (asic csrs, bar backing memory) lives in a
+ * sparse 32-bit register map that reads 0 until written.
+ */
+#define PCIESVC_HOST_HWMEM_PA   0x0c0000000ULL
+#define PCIESVC_HOST_BARMEM_PA  0x100000000ULL  /* bar backing memory */
+
+/*
+ * Completion the library posted for the last indirect transaction.
+ */
+typedef struct pciesvc_host_cpl_s {
+    u_int32_t data[4];
+    u_int32_t cpl_stat;                 /* PCIECPL_* */
+    u_int32_t port;
+    u_int32_t axi_id;
+} pciesvc_host_cpl_t;
+
+typedef struct pciesvc_host_stats_s {
+    u_int64_t reg_rd;                   /* 32-bit register reads */
+    u_int64_t reg_wr;                   /* 32-bit register writes */
+    u_int64_t ind_cpl;                  /* indirect completions posted */
+    u_int64_t events;                   /* pciesvc_event_handler() calls */
+} pciesvc_host_stats_t;
+
+int pciesvc_host_init(void);
+void pciesvc_host_fini(void);
+void pciesvc_host_set_verbose(const int verbose);
+
+u_int32_t pciesvc_host_reg_peek(const u_int64_t pa);
+void pciesvc_host_reg_poke(const u_int64_t pa, const u_int32_t val);
+
+/*
+ * Load a raw tlp and its aux info into the indirect srams
+ * of "port" and raise the pending indication, the way the
+ * hardware does before it interrupts (or is polled).
+ */
+void pciesvc_host_indirect_stage(const int port, const int entry,
+                                 const void *rtlp, const size_t rtlpsz,
+                                 const tlpauxinfo_t *info);
+int pciesvc_host_indirect_pending(const int port);
+int pciesvc_host_indirect_cpl(pciesvc_host_cpl_t *cpl);
+
+void pciesvc_host_get_stats(pciesvc_host_stats_t *stats);
+void pciesvc_host_clr_stats(void);
+
+#endif /* __PCIESVC_HOST_H__ */
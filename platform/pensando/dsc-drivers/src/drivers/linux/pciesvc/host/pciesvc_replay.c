@@ -0,0 +1,945 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2021-2022, Pensando Systems Inc.
+ */
+
+/*
+ * pciesvc_host - drive the pciesvc library from a host process.
+ *
+ *     pciesvc_host [-v] test
+ *     pciesvc_host [-v] replay <file|->
+ *     pciesvc_host [-v] bench [-n iters]
+ *
+ * A single PF with a 64-bit memory bar is set up in shmem, then
+ * tlps are encoded, staged in the (fake) indirect srams and handed
+ * to the library through pciesvc_indirect_poll(), exactly as the
+ * kpcimgr poll loop does on the card.  The completion the library
+ * posts is captured and checked or timed.
+ *
+ * Replay files have one transaction per line:
+ *
+ *     cfgrd   <b:d.f> <reg>  <size>        [= <expect>]
+ *     cfgwr   <b:d.f> <reg>  <size> <data>
+ *     memrd   <addr>  <size>               [= <expect>]
+ *     memwr   <addr>  <size> <data>
+ *
+ * memrd64/memwr64 and iord/iowr take the same arguments as memrd/memwr.
+ * Blank lines and lines starting with '#' are ignored.
+ */
+
+#include <time.h>
+#include <getopt.h>
+
+#include "pciesvc_impl.h"
+#include "pciesvc_local.h"
+#include "pcietlp.h"
+#include "indirect_entry.h"
+#include "bdf.h"
+#include "pciesvc_host.h"
+
+#define HOST_PORT       0
+#define HOST_HWDEVH     1
+#define HOST_BDF        0x0000          /* root of port, no bios scan */
+#define HOST_BAR0SZ     0x10000
+
+static int verbose;
+
+/*****************************************************************
+ * device setup
+ */
+
+static void
+cfg_setw(cfgspace_t *cs, const u_int16_t off,
+         const u_int16_t cur, const u_int16_t msk)
+{
+    cs->cur[off + 0] = cur;
+    cs->cur[off + 1] = cur >> 8;
+    cs->msk[off + 0] = msk;
+    cs->msk[off + 1] = msk >> 8;
+}
+
+static void
+cfg_setd(cfgspace_t *cs, const u_int16_t off,
+         const u_int32_t cur, const u_int32_t msk)
+{
+    cfg_setw(cs, off + 0, cur, msk);
+    cfg_setw(cs, off + 2, cur >> 16, msk >> 16);
+}
+
+static int
+pmt_alloc_owned(const int n, const int pri, const int cfgidx)
+{
+    pciehw_spmt_t *spmt;
+    int pmti, i;
+
+    pmti = pmt_alloc(n, pri);
+    if (pmti < 0) return pmti;
+
+    for (i = pmti; i < pmti + n; i++) {
+        spmt = pciesvc_spmt_get(i);
+        spmt->owner = HOST_HWDEVH;
+        spmt->cfgidx = cfgidx;
+        spmt->next = PMT_INVALID;
+        pciesvc_spmt_put(spmt, DIRTY);
+    }
+    return pmti;
+}
+
+/*
+ * Minimal type0 PF: vendor/device, a writable command register,
+ * and a 64-bit non-prefetchable BAR0 handled by the default
+ * (direct memory) bar handler.
+ */
+static int
+host_dev_setup(void)
+{
+    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+    pciesvc_params_t params;
+    pciehwdev_t *phwdev;
+    pciehwbar_t *phwbar;
+    cfgspace_t cs;
+
+    pshmem->allocdev = HOST_HWDEVH + 1;
+    pshmem->rooth[HOST_PORT] = HOST_HWDEVH;
+
+    phwdev = pciehwdev_get(HOST_HWDEVH);
+    pciesvc_snprintf(phwdev->name, sizeof(phwdev->name), "eth0");
+    phwdev->port = HOST_PORT;
+    phwdev->pf = 1;
+    phwdev->bdf = HOST_BDF;
+
+    pciesvc_cfgspace_get(HOST_HWDEVH, &cs);
+    cfg_setd(&cs, PCI_VENDOR_ID, 0x10021dd8, 0);
+    cfg_setw(&cs, PCI_COMMAND, 0, 0x0547);
+    cfg_setd(&cs, PCI_CLASS_REVISION, 0x02000001, 0);
+    cfg_setd(&cs, PCI_BASE_ADDRESS_0,
+             PCI_BASE_ADDRESS_MEM_TYPE_64, ~(HOST_BAR0SZ - 1));
+    cfg_setd(&cs, PCI_BASE_ADDRESS_1, 0, 0xffffffff);
+    pciesvc_cfgspace_put(&cs, DIRTY);
+
+    phwdev->cfghnd[PCI_COMMAND >> 2] = PCIEHW_CFGHND_CMD;
+    phwdev->cfghnd[PCI_BASE_ADDRESS_0 >> 2] = PCIEHW_CFGHND_DEV_BARS;
+    phwdev->cfghnd[PCI_BASE_ADDRESS_1 >> 2] = PCIEHW_CFGHND_DEV_BARS;
+
+    phwdev->pmtb = pmt_alloc_owned(1, PMTPRI_CFG, 0);
+    phwdev->pmtc = 1;
+
+    phwbar = &phwdev->bar[0];
+    phwbar->valid = 1;
+    phwbar->type = PCIEHWBARTYPE_MEM64;
+    phwbar->size = HOST_BAR0SZ;
+    phwbar->cfgidx = 0;
+    phwbar->hnd = PCIEHW_BARHND_NONE;
+    phwbar->pmtb = pmt_alloc_owned(1, PMTPRI_BAR, 0);
+    phwbar->pmtc = 1;
+    pciehwdev_put(phwdev, DIRTY);
+
+    if (phwdev->pmtb < 0 || phwbar->pmtb < 0) {
+        fprintf(stderr, "dev setup: pmt_alloc failed\n");
+        return -1;
+    }
+
+    pciesvc_memset(&params, 0, sizeof(params));
+    params.version = 0;
+    params.params_v0.port = HOST_PORT;
+    params.params_v0.ind_poll = 1;
+    return pciesvc_init(&params);
+}
+
+/*****************************************************************
+ * tlp submit
+ */
+
+typedef struct host_tlp_s {
+    pcie_stlp_t stlp;
+    u_int8_t rtlp[INDIRECT_TLPSZ];
+    int rtlpsz;
+    tlpauxinfo_t info;
+} host_tlp_t;
+
+static int
+stlp_is_cfg(const pcie_stlp_t *stlp)
+{
+    return (stlp->type == PCIE_STLP_CFGRD ||
+            stlp->type == PCIE_STLP_CFGWR);
+}
+
+static int
+stlp_is_rd(const pcie_stlp_t *stlp)
+{
+    switch (stlp->type) {
+    case PCIE_STLP_CFGRD:
+    case PCIE_STLP_MEMRD:
+    case PCIE_STLP_MEMRD64:
+    case PCIE_STLP_IORD:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Encode the tlp and fill in the aux info the pmt/prt lookup
+ * would have produced: the pmt index that hit and the local
+ * address the transaction targets.
+ */
+static int
+host_tlp_prep(host_tlp_t *t)
+{
+    pciehwdev_t *phwdev = pciehwdev_get(HOST_HWDEVH);
+    const pciehwbar_t *phwbar = &phwdev->bar[0];
+    pcie_stlp_t *stlp = &t->stlp;
+    tlpauxinfo_t *info = &t->info;
+    int r = 0;
+
+    pciesvc_memset(t->rtlp, 0, sizeof(t->rtlp));
+    pciesvc_memset(info, 0, sizeof(*info));
+
+    t->rtlpsz = pcietlp_encode(stlp, t->rtlp, sizeof(t->rtlp));
+    if (t->rtlpsz < 0) {
+        fprintf(stderr, "encode: %s\n", pcietlp_get_error());
+        r = -1;
+        goto out;
+    }
+
+    info->is_indirect = 1;
+    info->pmt_hit = 1;
+    info->is_host = 1;
+    info->context_id = stlp->tag;
+    info->direct_size = stlp->size;
+
+    if (stlp_is_cfg(stlp)) {
+        if (stlp->bdf != pciehwdev_get_hostbdf(phwdev)) {
+            fprintf(stderr, "%s: no device\n", pcietlp_str(stlp));
+            r = -1;
+            goto out;
+        }
+        info->pmti = phwdev->pmtb;
+        info->direct_addr = (pciesvc_cfgcur_pa() +
+                             (HOST_HWDEVH << PCIEHW_CFGSHIFT) +
+                             stlp->addr);
+    } else {
+        if (!phwbar->loaded ||
+            stlp->addr < phwbar->addr ||
+            stlp->addr + stlp->size > phwbar->addr + phwbar->size) {
+            fprintf(stderr, "%s: no pmt hit\n", pcietlp_str(stlp));
+            r = -1;
+            goto out;
+        }
+        info->pmti = phwbar->pmtb;
+        info->direct_addr = (PCIESVC_HOST_BARMEM_PA +
+                             (stlp->addr - phwbar->addr));
+    }
+
+ out:
+    pciehwdev_put(phwdev, CLEAN);
+    return r;
+}
+
+static int
+host_tlp_submit(const host_tlp_t *t, pciesvc_host_cpl_t *cpl)
+{
+    pciesvc_host_indirect_stage(HOST_PORT, t->stlp.tag & 0xf,
+                                t->rtlp, t->rtlpsz, &t->info);
+    if (pciesvc_indirect_poll(HOST_PORT) <= 0) {
+        return -1;
+    }
+    return pciesvc_host_indirect_cpl(cpl);
+}
+
+/*
+ * Completion data for a sub-dword read comes back in the byte
+ * lanes of its address, shift it down for display and compare.
+ */
+static u_int64_t
+cpl_value(const host_tlp_t *t, const pciesvc_host_cpl_t *cpl)
+{
+    const u_int32_t size = t->stlp.size;
+    u_int64_t v;
+
+    if (size == 8) {
+        return ((u_int64_t)cpl->data[1] << 32) | cpl->data[0];
+    }
+    v = cpl->data[0];
+    if (t->info.direct_addr & 0x3) {
+        v >>= (t->info.direct_addr & 0x3) * 8;
+    }
+    if (size < 4) {
+        v &= (1ULL << (size * 8)) - 1;
+    }
+    return v;
+}
+
+/*****************************************************************
+ * replay
+ */
+
+static const struct {
+    const char *name;
+    pcie_stlp_type_t type;
+} tlp_ops[] = {
+    { "cfgrd",   PCIE_STLP_CFGRD   },
+    { "cfgwr",   PCIE_STLP_CFGWR   },
+    { "memrd",   PCIE_STLP_MEMRD   },
+    { "memwr",   PCIE_STLP_MEMWR   },
+    { "memrd64", PCIE_STLP_MEMRD64 },
+    { "memwr64", PCIE_STLP_MEMWR64 },
+    { "iord",    PCIE_STLP_IORD    },
+    { "iowr",    PCIE_STLP_IOWR    },
+};
+
+static int
+parse_bdf(const char *s, u_int16_t *bdfp)
+{
+    unsigned int b, d, f;
+
+    if (sscanf(s, "%x:%x.%x", &b, &d, &f) != 3 ||
+        b > 0xff || d > 0x1f || f > 0x7) {
+        return -1;
+    }
+    *bdfp = bdf_make(b, d, f);
+    return 0;
+}
+
+/*
+ * Parse one replay line into "t".
+ * Returns 1 if a tlp was parsed, 0 for blank/comment, <0 on error.
+ */
+static int
+replay_parse(char *line, host_tlp_t *t, int *has_expect, u_int64_t *expect)
+{
+    char *argv[8], *p;
+    int argc, argi, i;
+    pcie_stlp_t *stlp = &t->stlp;
+
+    if ((p = strchr(line, '#')) != NULL) *p = '\0';
+    for (argc = 0, p = strtok(line, " \t\r\n");
+         p && argc < 8;
+         p = strtok(NULL, " \t\r\n")) {
+        argv[argc++] = p;
+    }
+    if (argc == 0) return 0;
+
+    pciesvc_memset(t, 0, sizeof(*t));
+    for (i = 0; i < sizeof(tlp_ops) / sizeof(tlp_ops[0]); i++) {
+        if (strcmp(argv[0], tlp_ops[i].name) == 0) break;
+    }
+    if (i == sizeof(tlp_ops) / sizeof(tlp_ops[0])) return -1;
+    stlp->type = tlp_ops[i].type;
+
+    argi = 1;
+    if (stlp_is_cfg(stlp)) {
+        if (argi >= argc || parse_bdf(argv[argi++], &stlp->bdf) < 0) {
+            return -1;
+        }
+    }
+    if (argc < argi + 2) return -1;
+    stlp->addr = strtoull(argv[argi++], NULL, 0);
+    stlp->size = strtoul(argv[argi++], NULL, 0);
+    if (!stlp_is_rd(stlp)) {
+        if (argi >= argc) return -1;
+        stlp->data = strtoull(argv[argi++], NULL, 0);
+    }
+
+    *has_expect = 0;
+    if (argi < argc) {
+        if (strcmp(argv[argi], "=") != 0 || argi + 2 != argc) return -1;
+        *expect = strtoull(argv[argi + 1], NULL, 0);
+        *has_expect = 1;
+    }
+    return 1;
+}
+
+static int
+replay_fp(FILE *fp, const char *name)
+{
+    pciesvc_host_cpl_t cpl;
+    host_tlp_t t;
+    u_int64_t expect = 0, v;
+    int has_expect, lineno, r, nerr, ntlp;
+    char line[256];
+    u_int16_t tag = 0;
+
+    nerr = 0;
+    ntlp = 0;
+    for (lineno = 1; fgets(line, sizeof(line), fp); lineno++) {
+        r = replay_parse(line, &t, &has_expect, &expect);
+        if (r == 0) continue;
+        if (r < 0) {
+            fprintf(stderr, "%s:%d: parse error\n", name, lineno);
+            nerr++;
+            continue;
+        }
+
+        t.stlp.tag = tag++ & 0x7f;
+        ntlp++;
+        if (host_tlp_prep(&t) < 0 || host_tlp_submit(&t, &cpl) < 0) {
+            fprintf(stderr, "%s:%d: %s: not completed\n",
+                    name, lineno, pcietlp_str(&t.stlp));
+            nerr++;
+            continue;
+        }
+
+        if (cpl.cpl_stat != PCIECPL_SC || cpl.axi_id != t.stlp.tag) {
+            fprintf(stderr, "%s:%d: %s: cpl %d axi_id %d\n",
+                    name, lineno, pcietlp_str(&t.stlp),
+                    cpl.cpl_stat, cpl.axi_id);
+            nerr++;
+            continue;
+        }
+
+        if (!stlp_is_rd(&t.stlp)) {
+            if (verbose) printf("%s\n", pcietlp_str(&t.stlp));
+            continue;
+        }
+
+        v = cpl_value(&t, &cpl);
+        if (verbose || !has_expect) {
+            printf("%s = 0x%0*" PRIx64 "\n",
+                   pcietlp_str(&t.stlp), t.stlp.size * 2, v);
+        }
+        if (has_expect && v != expect) {
+            fprintf(stderr, "%s:%d: %s: got 0x%" PRIx64
+                    " expected 0x%" PRIx64 "\n",
+                    name, lineno, pcietlp_str(&t.stlp), v, expect);
+            nerr++;
+        }
+    }
+
+    printf("%s: %d tlps, %d errors\n", name, ntlp, nerr);
+    return nerr ? -1 : 0;
+}
+
+static int
+cmd_replay(const char *path)
+{
+    FILE *fp;
+    int r;
+
+    if (pciesvc_host_init() < 0 || host_dev_setup() < 0) return -1;
+
+    if (strcmp(path, "-") == 0) {
+        return replay_fp(stdin, "stdin");
+    }
+    if ((fp = fopen(path, "r")) == NULL) {
+        perror(path);
+        return -1;
+    }
+    r = replay_fp(fp, path);
+    fclose(fp);
+    return r;
+}
+
+/*****************************************************************
+ * self test
+ */
+
+static const char test_script[] =
+    "cfgrd   00:00.0 0x00 4 = 0x10021dd8\n"
+    "cfgrd   00:00.0 0x02 2 = 0x1002\n"
+    "cfgrd   00:00.0 0x0b 1 = 0x02\n"
+    /* command register is masked to the writable bits */
+    "cfgwr   00:00.0 0x04 2 0xffff\n"
+    "cfgrd   00:00.0 0x04 2 = 0x0547\n"
+    "cfgwr   00:00.0 0x04 2 0x0000\n"
+    /* bar sizing, then place bar0 */
+    "cfgwr   00:00.0 0x10 4 0xffffffff\n"
+    "cfgrd   00:00.0 0x10 4 = 0xffff0004\n"
+    "cfgwr   00:00.0 0x14 4 0xffffffff\n"
+    "cfgrd   00:00.0 0x14 4 = 0xffffffff\n"
+    "cfgwr   00:00.0 0x10 4 0xe0000000\n"
+    "cfgwr   00:00.0 0x14 4 0x00000001\n"
+    "cfgrd   00:00.0 0x10 4 = 0xe0000004\n"
+    /* mem enable loads the bar pmt */
+    "cfgwr   00:00.0 0x04 2 0x0002\n"
+    "memwr   0x1e0000010 4 0x12345678\n"
+    "memrd   0x1e0000010 4 = 0x12345678\n"
+    "memrd   0x1e0000012 2 = 0x1234\n"
+    "memrd   0x1e0000011 1 = 0x56\n"
+    "memwr64 0x1e0000020 8 0x1122334455667788\n"
+    "memrd64 0x1e0000020 8 = 0x1122334455667788\n"
+    "memrd64 0x1e0000024 4 = 0x11223344\n"
+    "iowr    0x1e0000030 4 0xcafef00d\n"
+    "iord    0x1e0000030 4 = 0xcafef00d\n";
+
+/*
+ * Fetch pmt allocator stats through the debug command interface.
+ */
+static int
+pmt_stats_cmd(pciesvc_cmdres_pmt_stats_t *stats)
+{
+    pciesvc_cmd_t cmd;
+    pciesvc_cmdres_t res;
+
+    pciesvc_memset(&cmd, 0, sizeof(cmd));
+    cmd.pmt_stats.cmd = PCIESVC_CMD_PMT_STATS;
+    if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+        pciesvc_cmd_read((char *)&res, 0, sizeof(res)) != sizeof(res) ||
+        res.pmt_stats.status != PCIESVC_CMDSTATUS_SUCCESS) {
+        fprintf(stderr, "pmt stats: command failed\n");
+        return -1;
+    }
+    *stats = res.pmt_stats;
+    return 0;
+}
+
+static int
+pmt_stats_show(const char *name)
+{
+    pciesvc_cmdres_pmt_stats_t st;
+
+    if (pmt_stats_cmd(&st) < 0) return -1;
+    printf("%s: inuse %u/%u high %u low %u, "
+           "free ranges %u largest %u, allocfail %u frag %u\n",
+           name, st.inuse, st.count, st.high, st.low,
+           st.free_ranges, st.free_largest,
+           st.allocfail, st.allocfail_frag);
+    return 0;
+}
+
+#define PMT_TEST_CHECK(cond)                                    \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "test pmt: %s:%d: %s\n",            \
+                    __FILE__, __LINE__, #cond);                 \
+            return -1;                                          \
+        }                                                       \
+    } while (0)
+
+/*
+ * Freed pmt ranges coalesce and are reused by larger allocations,
+ * and both priority regions shrink back when emptied.
+ */
+static int
+test_pmt(void)
+{
+    pciesvc_cmdres_pmt_stats_t st;
+    int blk[16], hi[4], big, i;
+
+    if (pciesvc_host_init() < 0) return -1;
+
+    for (i = 0; i < 16; i++) {
+        blk[i] = pmt_alloc(8, PMTPRI_LOW);
+        PMT_TEST_CHECK(blk[i] == PMT_COUNT - 8 * (i + 1));
+    }
+    for (i = 0; i < 4; i++) {
+        hi[i] = pmt_alloc(2, PMTPRI_HIGH);
+        PMT_TEST_CHECK(hi[i] == 2 * i);
+    }
+
+    /* two adjacent 8-entry holes serve one 16-entry allocation */
+    pmt_free(blk[4], 8);
+    pmt_free(blk[5], 8);
+    PMT_TEST_CHECK(pmt_stats_cmd(&st) == 0);
+    PMT_TEST_CHECK(st.free_ranges == 2 && st.inuse == 14 * 8 + 4 * 2);
+    big = pmt_alloc(16, PMTPRI_LOW);
+    PMT_TEST_CHECK(big == blk[5]);
+
+    /* a high hole is reused before the high region grows */
+    pmt_free(hi[1], 2);
+    PMT_TEST_CHECK(pmt_alloc(1, PMTPRI_HIGH) == hi[1]);
+    PMT_TEST_CHECK(pmt_alloc(1, PMTPRI_HIGH) == hi[1] + 1);
+
+    /* the gap between the regions cannot fit this */
+    PMT_TEST_CHECK(pmt_alloc(PMT_COUNT - 16 * 8 - 8 + 1, PMTPRI_LOW) < 0);
+
+    pmt_free(big, 16);
+    for (i = 0; i < 16; i++) {
+        if (i != 4 && i != 5) pmt_free(blk[i], 8);
+    }
+    for (i = 0; i < 4; i++) {
+        pmt_free(hi[i], 2);
+    }
+    PMT_TEST_CHECK(pmt_stats_cmd(&st) == 0);
+    PMT_TEST_CHECK(st.inuse == 0 && st.high == 0 && st.low == PMT_COUNT);
+    PMT_TEST_CHECK(st.free_ranges == 1 && st.free_largest == PMT_COUNT);
+    PMT_TEST_CHECK(st.allocfail == 1 && st.allocfail_frag == 0);
+
+    printf("test pmt: passed\n");
+    return 0;
+}
+
+/*
+ * Other users of shmem only know the free lists and the sequential
+ * blocks.  Entries they free must be reused here, entries we hand out
+ * must be off their lists, and reading the stats must not touch shmem.
+ */
+static int
+test_pmt_shared(void)
+{
+    pciehw_shmem_t *pshmem, *snap;
+    pciesvc_cmdres_pmt_stats_t st;
+    int hi[3], pmti, i;
+
+    if (pciesvc_host_init() < 0) return -1;
+    pshmem = pciesvc_shmem_get();
+
+    /* stats on untouched shmem leave it untouched */
+    snap = malloc(sizeof(*snap));
+    PMT_TEST_CHECK(snap != NULL);
+    memcpy(snap, pshmem, sizeof(*snap));
+    PMT_TEST_CHECK(pmt_stats_cmd(&st) == 0);
+    PMT_TEST_CHECK(st.inuse == 0 && st.low == PMT_COUNT);
+    PMT_TEST_CHECK(memcmp(snap, pshmem, sizeof(*snap)) == 0);
+
+    for (i = 0; i < 3; i++) {
+        hi[i] = pmt_alloc(4, PMTPRI_HIGH);
+        PMT_TEST_CHECK(hi[i] == 4 * i);
+    }
+
+    /* free hi[1] the way the free list owners do, one entry at a time */
+    for (pmti = hi[1]; pmti < hi[1] + 4; pmti++) {
+        pshmem->spmt[pmti].next = pshmem->freepmt_high;
+        pshmem->freepmt_high = pmti;
+    }
+
+    memcpy(snap, pshmem, sizeof(*snap));
+    PMT_TEST_CHECK(pmt_stats_cmd(&st) == 0);
+    PMT_TEST_CHECK(st.inuse == 8 && st.free_ranges == 2);
+    PMT_TEST_CHECK(memcmp(snap, pshmem, sizeof(*snap)) == 0);
+
+    /* the listed hole is reused whole and taken off the list */
+    PMT_TEST_CHECK(pmt_alloc(4, PMTPRI_HIGH) == hi[1]);
+    PMT_TEST_CHECK(pshmem->freepmt_high == PMT_INVALID);
+    PMT_TEST_CHECK(pshmem->allocpmt_high == 12);
+
+    /* a partial reuse leaves the rest of the hole on the list */
+    pmt_free(hi[1], 4);
+    PMT_TEST_CHECK(pmt_alloc(1, PMTPRI_HIGH) == hi[1]);
+    for (i = 0, pmti = pshmem->freepmt_high; pmti != PMT_INVALID; i++) {
+        PMT_TEST_CHECK(pmti > hi[1] && pmti < hi[1] + 4);
+        pmti = pshmem->spmt[pmti].next;
+    }
+    PMT_TEST_CHECK(i == 3);
+
+    /* freeing the end shrinks the region and drains the list */
+    pmt_free(hi[2], 4);
+    pmt_free(hi[1], 1);
+    pmt_free(hi[0], 4);
+    PMT_TEST_CHECK(pshmem->allocpmt_high == 0);
+    PMT_TEST_CHECK(pshmem->freepmt_high == PMT_INVALID);
+
+    free(snap);
+    printf("test pmt shared: passed\n");
+    return 0;
+}
+
+static int
+cmd_test(void)
+{
+    pciesvc_host_stats_t stats;
+    pciehw_spmt_t *spmt;
+    pciehwdev_t *phwdev;
+    FILE *fp;
+    int loaded, r;
+
+    if (pciesvc_host_init() < 0 || host_dev_setup() < 0) return -1;
+
+    fp = fmemopen((void *)test_script, sizeof(test_script) - 1, "r");
+    if (fp == NULL) {
+        perror("fmemopen");
+        return -1;
+    }
+    r = replay_fp(fp, "test");
+    fclose(fp);
+
+    phwdev = pciehwdev_get(HOST_HWDEVH);
+    spmt = pciesvc_spmt_get(phwdev->bar[0].pmtb);
+    loaded = spmt->loaded && phwdev->bar[0].addr == 0x1e0000000ULL;
+    pciesvc_spmt_put(spmt, CLEAN);
+    pciehwdev_put(phwdev, CLEAN);
+    if (!loaded) {
+        fprintf(stderr, "test: bar0 pmt not loaded at 0x1e0000000\n");
+        r = -1;
+    }
+
+    pciesvc_host_get_stats(&stats);
+    if (stats.ind_cpl == 0) {
+        fprintf(stderr, "test: no completions\n");
+        r = -1;
+    }
+
+    if (test_pmt() < 0) {
+        r = -1;
+    }
+
+    if (test_pmt_shared() < 0) {
+        r = -1;
+    }
+
+    printf("test: %s\n", r ? "FAILED" : "passed");
+    return r;
+}
+
+/*****************************************************************
+ * bench
+ */
+
+static u_int64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+    const u_int64_t x = *(const u_int64_t *)a;
+    const u_int64_t y = *(const u_int64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Time pciesvc_indirect_poll() for "iters" copies of one tlp.
+ * Staging the tlp in the fake srams is not counted.
+ */
+static int
+bench_tlp(const char *name, host_tlp_t *t, const int iters, u_int64_t *lat)
+{
+    pciesvc_host_stats_t stats;
+    pciesvc_host_cpl_t cpl;
+    u_int64_t t0, sum;
+    int i;
+
+    pciesvc_host_clr_stats();
+    for (sum = 0, i = 0; i < iters; i++) {
+        pciesvc_host_indirect_stage(HOST_PORT, i & 0xf,
+                                    t->rtlp, t->rtlpsz, &t->info);
+        t0 = now_ns();
+        pciesvc_indirect_poll(HOST_PORT);
+        lat[i] = now_ns() - t0;
+        sum += lat[i];
+        if (pciesvc_host_indirect_cpl(&cpl) < 0) {
+            fprintf(stderr, "bench %s: not completed\n", name);
+            return -1;
+        }
+    }
+    pciesvc_host_get_stats(&stats);
+
+    qsort(lat, iters, sizeof(lat[0]), cmp_u64);
+    printf("%-8s %8d %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64
+           " %6.1f %6.1f %6s\n",
+           name, iters, lat[0], lat[iters / 2], lat[iters * 99 / 100],
+           sum / iters,
+           (double)stats.reg_rd / iters, (double)stats.reg_wr / iters,
+           cpl.cpl_stat == PCIECPL_SC ? "sc" :
+           cpl.cpl_stat == PCIECPL_UR ? "ur" : "other");
+    return 0;
+}
+
+static const char bench_setup[] =
+    "cfgwr   00:00.0 0x10 4 0xe0000000\n"
+    "cfgwr   00:00.0 0x14 4 0x00000001\n"
+    "cfgwr   00:00.0 0x04 2 0x0002\n";
+
+static int
+bench_indirect(const int iters)
+{
+    static const struct {
+        const char *name;
+        pcie_stlp_t stlp;
+    } bt[] = {
+        { "cfgrd",   { PCIE_STLP_CFGRD,   .addr = 0x00, .size = 4 } },
+        { "cfgwr",   { PCIE_STLP_CFGWR,   .addr = 0x3c, .size = 1,
+                       .data = 0x0a } },
+        { "memrd",   { PCIE_STLP_MEMRD,   .addr = 0x1e0000100, .size = 4 } },
+        { "memwr",   { PCIE_STLP_MEMWR,   .addr = 0x1e0000100, .size = 4,
+                       .data = 0x5a5a5a5a } },
+        { "memrd64", { PCIE_STLP_MEMRD64, .addr = 0x1e0000200, .size = 8 } },
+        { "memwr64", { PCIE_STLP_MEMWR64, .addr = 0x1e0000200, .size = 8,
+                       .data = 0x0123456789abcdefULL } },
+        { "iord",    { PCIE_STLP_IORD,    .addr = 0x1e0000300, .size = 4 } },
+        { "iowr",    { PCIE_STLP_IOWR,    .addr = 0x1e0000300, .size = 4,
+                       .data = 0xa5a5a5a5 } },
+    };
+    host_tlp_t t;
+    u_int64_t *lat;
+    FILE *fp;
+    int i, r;
+
+    if (pciesvc_host_init() < 0 || host_dev_setup() < 0) return -1;
+    fp = fmemopen((void *)bench_setup, sizeof(bench_setup) - 1, "r");
+    if (fp == NULL) return -1;
+    r = replay_fp(fp, "bench setup");
+    fclose(fp);
+    if (r < 0) return r;
+
+    lat = calloc(iters, sizeof(*lat));
+    if (lat == NULL) return -1;
+
+    printf("%-8s %8s %8s %8s %8s %8s %6s %6s %6s\n",
+           "tlp", "iters", "min_ns", "p50_ns", "p99_ns", "mean_ns",
+           "rd/tlp", "wr/tlp", "cpl");
+    for (i = 0; i < sizeof(bt) / sizeof(bt[0]) && r == 0; i++) {
+        pciesvc_memset(&t, 0, sizeof(t));
+        t.stlp = bt[i].stlp;
+        t.stlp.bdf = HOST_BDF;
+        t.stlp.tag = i;
+        if ((r = host_tlp_prep(&t)) == 0) {
+            r = bench_tlp(bt[i].name, &t, iters, lat);
+        }
+    }
+
+    /* unsupported tlp type (a message) completes UR */
+    if (r == 0) {
+        pciesvc_memset(&t, 0, sizeof(t));
+        t.rtlp[0] = 0x30;               /* Msg, routed to root complex */
+        t.rtlpsz = 16;
+        t.info.is_indirect = 1;
+        t.info.pmti = 0;
+        r = bench_tlp("msg", &t, iters, lat);
+    }
+
+    free(lat);
+    return r;
+}
+
+/*
+ * SR-IOV style pmt churn: sets of 1-8 contiguous entries are
+ * allocated and freed in random order.  Reports the cost of
+ * pmt_alloc()/pmt_free() and how often an allocation fails
+ * even though enough entries are free in total.
+ */
+#define CHURN_SLOTS     512
+
+static u_int32_t
+xorshift32(u_int32_t *s)
+{
+    u_int32_t x = *s;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static int
+bench_pmt(const int iters)
+{
+    struct {
+        int pmtb;
+        int pmtc;
+    } slot[CHURN_SLOTS];
+    u_int64_t alloc_ns, free_ns, t0;
+    u_int32_t seed = 0x2545f491;
+    int nalloc, nfree, nfail, nfrag, inuse, i, s, n, pmti;
+
+    if (pciesvc_host_init() < 0) return -1;
+
+    pciesvc_memset(slot, 0, sizeof(slot));
+    alloc_ns = free_ns = 0;
+    nalloc = nfree = nfail = nfrag = inuse = 0;
+
+    for (i = 0; i < iters; i++) {
+        s = xorshift32(&seed) % CHURN_SLOTS;
+        if (slot[s].pmtc) {
+            t0 = now_ns();
+            pmt_free(slot[s].pmtb, slot[s].pmtc);
+            free_ns += now_ns() - t0;
+            inuse -= slot[s].pmtc;
+            slot[s].pmtc = 0;
+            nfree++;
+        } else {
+            n = 1 << (xorshift32(&seed) % 4);
+            t0 = now_ns();
+            pmti = pmt_alloc(n, PMTPRI_LOW);
+            alloc_ns += now_ns() - t0;
+            if (pmti < 0) {
+                nfail++;
+                if (inuse + n <= PMT_COUNT) nfrag++;
+                continue;
+            }
+            slot[s].pmtb = pmti;
+            slot[s].pmtc = n;
+            inuse += n;
+            nalloc++;
+        }
+    }
+
+    printf("pmt churn: %d allocs %d frees, %d failed (%d with room), "
+           "alloc %" PRIu64 " ns, free %" PRIu64 " ns\n",
+           nalloc, nfree, nfail, nfrag,
+           nalloc + nfail ? alloc_ns / (nalloc + nfail) : 0,
+           nfree ? free_ns / nfree : 0);
+    return pmt_stats_show("pmt churn");
+}
+
+static int
+cmd_bench(const int iters)
+{
+    int r;
+
+    if ((r = bench_indirect(iters)) < 0) return r;
+    return bench_pmt(iters);
+}
+
+/*****************************************************************
+ * main
+ */
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+            "usage: pciesvc_host [-v] test\n"
+            "       pciesvc_host [-v] replay <file|->\n"
+            "       pciesvc_host [-v] bench [-n iters]\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *cmd;
+    int iters = 100000;
+    int opt, r;
+
+    while ((opt = getopt(argc, argv, "+v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage();
+        return 1;
+    }
+    cmd = argv[optind];
+    pciesvc_host_set_verbose(verbose);
+
+    if (strcmp(cmd, "test") == 0) {
+        r = cmd_test();
+    } else if (strcmp(cmd, "replay") == 0 && optind + 1 < argc) {
+        r = cmd_replay(argv[optind + 1]);
+    } else if (strcmp(cmd, "bench") == 0) {
+        optind++;
+        while ((opt = getopt(argc, argv, "n:")) != -1) {
+            switch (opt) {
+            case 'n':
+                iters = strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage();
+                return 1;
+            }
+        }
+        if (iters <= 0) {
+            usage();
+            return 1;
+        }
+        r = cmd_bench(iters);
+    } else {
+        usage();
+        return 1;
+    }
+
+    pciesvc_host_fini();
+    return r < 0 ? 1 : 0;
+}
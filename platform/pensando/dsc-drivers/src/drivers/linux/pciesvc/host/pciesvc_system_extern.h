@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2021-2022, Pensando Systems Inc.
+ */
+
+#ifndef __PCIESVC_SYSTEM_EXTERN_H__
+#define __PCIESVC_SYSTEM_EXTERN_H__
+
+/*
+ * Host userspace flavor of the pciesvc "system" functions.
+ * The pciesvc library is built with -DPCIESVC_SYSTEM_EXTERN and
+ * this directory ahead of the kpcimgr one on the include path,
+ * and the upcalls are implemented in pciesvc_host.c against a
+ * fake register space and calloc'd shmem/hwmem.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <endian.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <linux/pci_regs.h>
+
+#include "pciesvc.h"
+#include "portcfg.h"
+#include "notify_entry.h"
+#include "cfgspace.h"
+
+#define pciesvc_assert(expr) \
+    do { \
+        if (!(expr)) { \
+            pciesvc_host_assert_fail(#expr, __FILE__, __func__, __LINE__); \
+        } \
+    } while (0)
+
+#define pciesvc_usleep          usleep
+#define pciesvc_ffs             ffs
+#define pciesvc_ffsll           ffsll
+
+#define pciesvc_htobe32         htobe32
+#define pciesvc_be32toh         be32toh
+#define pciesvc_htobe16         htobe16
+#define pciesvc_be16toh         be16toh
+#define pciesvc_htole32         htole32
+#define pciesvc_le32toh         le32toh
+
+#ifndef likely
+#define likely(x)               __builtin_expect(!!(x), 1)
+#define unlikely(x)             __builtin_expect(!!(x), 0)
+#endif
+
+void pciesvc_host_assert_fail(const char *expr, const char *file,
+                              const char *func, const int line);
+
+int
+pciesvc_snprintf(char *buf, size_t len, const char *fmt, ...);
+
+int
+pciesvc_vsnprintf(char *buf, size_t len, const char *fmt, va_list ap);
+
+u_int64_t
+pciesvc_vtop(const void *hwmemva);
+
+void *
+pciesvc_hwmem_get(void);
+
+uint32_t
+pciesvc_reg_rd32(const uint64_t pa);
+void
+pciesvc_pciepreg_rd32(const uint64_t pa, uint32_t *dest);
+void
+pciesvc_reg_wr32(const uint64_t pa, const uint32_t val);
+#define pciesvc_pciepreg_wr32   pciesvc_reg_wr32
+
+int
+pciesvc_mem_rd(const uint64_t pa, void *buf, const size_t sz);
+void
+pciesvc_mem_wr(const uint64_t pa, const void *buf, const size_t sz);
+void
+pciesvc_mem_barrier(void);
+
+void *
+pciesvc_memset(void *s, int c, size_t n);
+void *
+pciesvc_memcpy(void *dst, const void *src, size_t n);
+void *
+pciesvc_memcpy_toio(void *dsthw, const void *src, size_t n);
+
+void
+pciesvc_log(const char *msg);
+
+int
+pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize);
+
+void *
+pciesvc_shmem_get(void);
+
+void pciesvc_debug_cmd(uint32_t *val);
+
+#endif /* __PCIESVC_SYSTEM_EXTERN_H__ */
@@ -16,6 +16,7 @@ extern "C" {
 typedef enum pciesvc_cmdcode_e {
     PCIESVC_CMD_NOP                     = 0,
     PCIESVC_CMD_SET_LOG_LEVEL           = 1,
+    PCIESVC_CMD_PMT_STATS               = 2,
 } pciesvc_cmdcode_t;
 
 typedef enum pciesvc_cmdstatus_e {
@@ -41,11 +42,28 @@ typedef struct pciesvc_cmdres_set_log_level_s {
     uint32_t old_level;
 } pciesvc_cmdres_set_log_level_t;
 
+typedef struct pciesvc_cmd_pmt_stats_s {
+    uint32_t cmd;
+} pciesvc_cmd_pmt_stats_t;
+
+typedef struct pciesvc_cmdres_pmt_stats_s {
+    uint32_t status;
+    uint32_t count;
+    uint32_t inuse;
+    uint32_t high;
+    uint32_t low;
+    uint32_t free_ranges;
+    uint32_t free_largest;
+    uint32_t allocfail;
+    uint32_t allocfail_frag;
+} pciesvc_cmdres_pmt_stats_t;
+
 typedef union pciesvc_cmd_u {
     uint32_t words[16];
     uint8_t cmd;
     pciesvc_cmd_nop_t nop;
     pciesvc_cmd_set_log_level_t set_log_level;
+    pciesvc_cmd_pmt_stats_t pmt_stats;
 } pciesvc_cmd_t;
 
 typedef union pciesvc_cmdres_u {
@@ -53,6 +71,7 @@ typedef union pciesvc_cmdres_u {
     uint8_t status;
     pciesvc_cmdres_nop_t nop;
     pciesvc_cmdres_set_log_level_t set_log_level;
+    pciesvc_cmdres_pmt_stats_t pmt_stats;
 } pciesvc_cmdres_t;
 
 #ifdef __cplusplus
@@ -38,6 +38,8 @@ struct pmt_s; typedef struct pmt_s pmt_t;
 int pmt_reserve_vf0adj(const int n);
 int pmt_alloc(const int n, const int pri);
 void pmt_free(const int pmtb, const int pmtc);
+struct pmt_stats_s; typedef struct pmt_stats_s pmt_stats_t;
+void pmt_get_stats(pmt_stats_t *stats);
 void pmt_get(const int pmti, pmt_t *pmt);
 void pmt_set(const int pmti, const pmt_t *pmt);
 void pmt_bar_set_bdf(pmt_t *pmt, const u_int16_t bdf);
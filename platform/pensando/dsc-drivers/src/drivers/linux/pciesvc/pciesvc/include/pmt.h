@@ -44,6 +44,20 @@ typedef enum pmtpri_e {
     PMTPRI_FLEXVFOVRD = PMTPRI_HIGH,    /* flexvf bar pmt override entry */
 } pmtpri_t;
 
+/*
+ * pmt allocator occupancy and fragmentation.
+ */
+typedef struct pmt_stats_s {
+    u_int32_t count;                    /* total pmt entries */
+    u_int32_t inuse;                    /* entries allocated */
+    u_int32_t high;                     /* end of PMTPRI_HIGH region */
+    u_int32_t low;                      /* start of PMTPRI_LOW region */
+    u_int32_t free_ranges;              /* contiguous free ranges */
+    u_int32_t free_largest;             /* largest contiguous free range */
+    u_int32_t allocfail;                /* pmt_alloc failures */
+    u_int32_t allocfail_frag;           /* failures with enough entries free */
+} pmt_stats_t;
+
 /* defines for PMT.type and PMR.type fields */
 #define PMT_TYPE_CFG    0       /* host cfg */
 #define PMT_TYPE_MEM    1       /* host mem bar */
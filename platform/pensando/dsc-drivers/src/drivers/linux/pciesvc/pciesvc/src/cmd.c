@@ -25,6 +25,25 @@ cmd_set_log_level(const pciesvc_cmd_set_log_level_t *cmd,
     return 0;
 }
 
+static int
+cmd_pmt_stats(const pciesvc_cmd_pmt_stats_t *cmd,
+              pciesvc_cmdres_pmt_stats_t *res)
+{
+    pmt_stats_t stats;
+
+    pmt_get_stats(&stats);
+    res->count = stats.count;
+    res->inuse = stats.inuse;
+    res->high = stats.high;
+    res->low = stats.low;
+    res->free_ranges = stats.free_ranges;
+    res->free_largest = stats.free_largest;
+    res->allocfail = stats.allocfail;
+    res->allocfail_frag = stats.allocfail_frag;
+    res->status = 0;
+    return 0;
+}
+
 int
 pciesvc_cmd_read(char *buf, const long int off, const size_t count)
 {
@@ -64,6 +83,9 @@ pciesvc_cmd_write(const char *buf, const long int off, const size_t count)
     case PCIESVC_CMD_SET_LOG_LEVEL:
         r = cmd_set_log_level(&cmd->set_log_level, &res->set_log_level);
         break;
+    case PCIESVC_CMD_PMT_STATS:
+        r = cmd_pmt_stats(&cmd->pmt_stats, &res->pmt_stats);
+        break;
     default:
         res->status = PCIESVC_CMDSTATUS_UNKNOWN_CMD;
         r = 0;  /* cmd_write "succeeded" */
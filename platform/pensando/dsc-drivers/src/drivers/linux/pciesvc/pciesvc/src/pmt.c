@@ -50,59 +50,263 @@ pmr_addr(const int pmti)
     return PMR_BASE + (pmti * PMR_STRIDE);
 }
 
+/*
+ * The free lists threaded through spmt->next, together with the
+ * sequential blocks [0, allocpmt_high) and [allocpmt_low, pmt_count()),
+ * are the allocator state in shmem and are shared with the other users
+ * of shmem.  To find contiguous free ranges we build a private in-use
+ * bitmap from that state when needed, and write back only through the
+ * free lists and the block bounds.
+ */
+#define PMTMAPSZ        ((PMT_COUNT + 31) / 32)
+
+typedef struct pmtmap_s {
+    u_int32_t w[PMTMAPSZ];
+} pmtmap_t;
+
+/* allocation failure counters for pmt_get_stats() */
+static u_int32_t pmt_allocfail;
+static u_int32_t pmt_allocfail_frag;
+
 static int
-pmt_alloc_high(const int n)
+pmtmap_inuse(const pmtmap_t *map, const int pmti)
+{
+    return (map->w[pmti >> 5] >> (pmti & 0x1f)) & 0x1;
+}
+
+static void
+pmtmap_set(pmtmap_t *map, const int pmtb, const int pmtc, const int inuse)
+{
+    int pmti;
+
+    for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
+        if (inuse) {
+            map->w[pmti >> 5] |= (1U << (pmti & 0x1f));
+        } else {
+            map->w[pmti >> 5] &= ~(1U << (pmti & 0x1f));
+        }
+    }
+}
+
+static int
+pmtmap_nfree(const pmtmap_t *map, const int lo, const int hi)
+{
+    int pmti, nfree = 0;
+
+    for (pmti = lo; pmti < hi; pmti++) {
+        if (!pmtmap_inuse(map, pmti)) nfree++;
+    }
+    return nfree;
+}
+
+/*
+ * Build the in-use map from the shmem allocator state.
+ * Only reads shmem.
+ */
+static void
+pmtmap_build(const pciehw_shmem_t *pshmem, pmtmap_t *map)
+{
+    const pciehw_spmt_t *spmt;
+    u_int32_t pmti, high, low;
+    int i, n;
+
+    pciesvc_memset(map, 0, sizeof(*map));
+    if (!pshmem->pmtpri) {
+        /* nothing allocated yet */
+        return;
+    }
+    high = pshmem->allocpmt_high;
+    low = pshmem->allocpmt_low;
+    if (high > pmt_count()) high = pmt_count();
+    if (low > pmt_count()) low = pmt_count();
+    pmtmap_set(map, 0, high, 1);
+    pmtmap_set(map, low, pmt_count() - low, 1);
+
+    /* the lists are bounded by the table size in case they are corrupt */
+    for (i = 0; i < 2; i++) {
+        pmti = i == 0 ? pshmem->freepmt_high : pshmem->freepmt_low;
+        for (n = 0; pmti < pmt_count() && n < pmt_count(); n++) {
+            spmt = &pshmem->spmt[pmti];
+            pmtmap_set(map, pmti, 1, 0);
+            pmti = spmt->next;
+        }
+    }
+}
+
+/*
+ * Return the first entry in [pmti, hi) whose in-use bit matches
+ * "inuse", or hi if there is none.
+ */
+static int
+pmtmap_next(const pmtmap_t *map, int pmti, const int hi, const int inuse)
+{
+    u_int32_t w;
+
+    while (pmti < hi) {
+        w = map->w[pmti >> 5];
+        if (!inuse) w = ~w;
+        w &= ~0U << (pmti & 0x1f);
+        if (w) {
+            pmti = (pmti & ~0x1f) + pciesvc_ffs(w) - 1;
+            return pmti < hi ? pmti : hi;
+        }
+        pmti = (pmti & ~0x1f) + 32;
+    }
+    return hi;
+}
+
+/*
+ * Find the lowest n free contiguous entries in [lo, hi).
+ */
+static int
+pmtmap_find_up(const pmtmap_t *map, const int lo, const int hi, const int n)
+{
+    int base, end;
+
+    for (base = pmtmap_next(map, lo, hi, 0);
+         base + n <= hi;
+         base = pmtmap_next(map, end, hi, 0)) {
+        end = pmtmap_next(map, base, base + n, 1);
+        if (end == base + n) {
+            return base;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Find the highest n free contiguous entries in [lo, hi).
+ */
+static int
+pmtmap_find_down(const pmtmap_t *map, const int lo, const int hi, const int n)
+{
+    int base, end, pmti = -1;
+
+    for (base = pmtmap_next(map, lo, hi, 0);
+         base < hi;
+         base = pmtmap_next(map, end, hi, 0)) {
+        end = pmtmap_next(map, base, hi, 1);
+        if (end - base >= n) {
+            pmti = end - n;
+        }
+    }
+    return pmti;
+}
+
+/*
+ * Unlink the entries in [lo, hi) from a free list.
+ */
+static void
+pmt_freelist_remove(u_int32_t *head, const int lo, const int hi)
+{
+    pciehw_spmt_t *spmt, *prev = NULL;
+    u_int32_t pmti, next;
+
+    for (pmti = *head; pmti < pmt_count(); pmti = next) {
+        spmt = pciesvc_spmt_get(pmti);
+        next = spmt->next;
+        if (pmti >= lo && pmti < hi) {
+            if (prev) {
+                prev->next = next;
+                pciesvc_spmt_put(prev, DIRTY);
+            } else {
+                *head = next;
+            }
+            spmt->next = PMT_INVALID;
+            pciesvc_spmt_put(spmt, DIRTY);
+        } else {
+            if (prev) pciesvc_spmt_put(prev, CLEAN);
+            prev = spmt;
+        }
+    }
+    if (prev) pciesvc_spmt_put(prev, CLEAN);
+}
+
+static void
+pmt_freelist_add(u_int32_t *head, const int pmtb, const int pmtc)
 {
-    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
     pciehw_spmt_t *spmt;
-    int pmti = -1;
+    int pmti;
 
-    if (n == 1 && pshmem->freepmt_high != PMT_INVALID) {
-        /* alloc a single entry from free list */
-        pmti = pshmem->freepmt_high;
+    for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
         spmt = pciesvc_spmt_get(pmti);
-        pshmem->freepmt_high = spmt->next;
-        spmt->next = PMT_INVALID;
+        spmt->next = *head;
         pciesvc_spmt_put(spmt, DIRTY);
-    } else if (pshmem->allocpmt_high + n <= pshmem->allocpmt_low) {
-        /* alloc multiple entries from sequential block */
-        pmti = pshmem->allocpmt_high;
-        pshmem->allocpmt_high += n;
+        *head = pmti;
+    }
+}
+
+static pciehw_shmem_t *
+pmt_shmem_get(void)
+{
+    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+
+    if (!pshmem->pmtpri) {
+        pshmem->allocpmt_low = pmt_count();
+        pshmem->freepmt_high = PMT_INVALID;
+        pshmem->freepmt_low = PMT_INVALID;
+        pshmem->allocpmt_vf0adj = -1;
+        pshmem->freeprt_slab = PRT_INVALID;
+        pshmem->pmtpri = 1;
+    }
+    return pshmem;
+}
+
+/*
+ * HIGH entries all come before LOW entries in the tcam.
+ * Allocate HIGH first-fit from the bottom of [0, allocpmt_low)
+ * so holes in the HIGH region are reused before the region grows.
+ */
+static int
+pmt_alloc_high(pciehw_shmem_t *pshmem, const int n)
+{
+    pmtmap_t map;
+    int pmti;
+
+    pmtmap_build(pshmem, &map);
+    pmti = pmtmap_find_up(&map, 0, pshmem->allocpmt_low, n);
+    if (pmti >= 0) {
+        pmt_freelist_remove(&pshmem->freepmt_high, pmti, pmti + n);
+        if (pmti + n > pshmem->allocpmt_high) {
+            pshmem->allocpmt_high = pmti + n;
+        }
+    } else if (pmtmap_nfree(&map, 0, pshmem->allocpmt_low) >= n) {
+        pmt_allocfail_frag++;
     }
     return pmti;
 }
 
+/*
+ * Allocate LOW last-fit from the top of [allocpmt_high, pmt_count())
+ * so holes in the LOW region are reused before the region grows.
+ */
 static int
-pmt_alloc_low(const int n)
+pmt_alloc_low(pciehw_shmem_t *pshmem, const int n)
 {
-    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
-    pciehw_spmt_t *spmt;
-    int pmti = -1;
+    pmtmap_t map;
+    int pmti;
 
-    if (n == 1 && pshmem->freepmt_low != PMT_INVALID) {
-        /* alloc a single entry from free list */
-        pmti = pshmem->freepmt_low;
-        spmt = pciesvc_spmt_get(pmti);
-        pshmem->freepmt_low = spmt->next;
-        spmt->next = PMT_INVALID;
-        pciesvc_spmt_put(spmt, DIRTY);
-    } else if (pshmem->allocpmt_low - n >= pshmem->allocpmt_high) {
-        /* alloc multiple entries from sequential block */
-        pshmem->allocpmt_low -= n;
-        pmti = pshmem->allocpmt_low;
+    pmtmap_build(pshmem, &map);
+    pmti = pmtmap_find_down(&map, pshmem->allocpmt_high, pmt_count(), n);
+    if (pmti >= 0) {
+        pmt_freelist_remove(&pshmem->freepmt_low, pmti, pmti + n);
+        if (pmti < pshmem->allocpmt_low) {
+            pshmem->allocpmt_low = pmti;
+        }
+    } else if (pmtmap_nfree(&map, pshmem->allocpmt_high, pmt_count()) >= n) {
+        pmt_allocfail_frag++;
     }
     return pmti;
 }
 
 static int
-pmt_alloc_vf0adj(const int n)
+pmt_alloc_vf0adj(pciehw_shmem_t *pshmem, const int n)
 {
-    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
     int pmti = -1;
 
     /* if no reserved vf0adj region alloc from high pri */
     if (pshmem->allocpmt_vf0adj == -1) {
-        pmti = pmt_alloc_high(n);
+        pmti = pmt_alloc_high(pshmem, n);
     } else if (pshmem->allocpmt_vf0adj + n <= pmt_count()) {
         pmti = pshmem->allocpmt_vf0adj;
         pshmem->allocpmt_vf0adj += n;
@@ -141,34 +345,29 @@ pmt_alloc_vf0adj(const int n)
  *                 This region grows down to meet the expectations of the
  *                 user but is low priority so entries can be overridden
  *                 by flexvf overrides in the HIGH region.
+ *
+ * Entries freed inside a region are reused by later allocations of
+ * the same priority, and a region shrinks back when its outermost
+ * entries are freed.
  */
 int
 pmt_alloc(const int n, const int pri)
 {
-    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+    pciehw_shmem_t *pshmem = pmt_shmem_get();
     int pmti = -1;
 
     pciesvc_assert(n > 0);
     pciesvc_assert(n <= pmt_count());
 
-    if (!pshmem->pmtpri) {
-        pshmem->allocpmt_low = pmt_count();
-        pshmem->freepmt_high = PMT_INVALID;
-        pshmem->freepmt_low = PMT_INVALID;
-        pshmem->allocpmt_vf0adj = -1;
-        pshmem->freeprt_slab = PRT_INVALID;
-        pshmem->pmtpri = 1;
-    }
-
     switch (pri) {
     case PMTPRI_HIGH:
-        pmti = pmt_alloc_high(n);
+        pmti = pmt_alloc_high(pshmem, n);
         break;
     case PMTPRI_LOW:
-        pmti = pmt_alloc_low(n);
+        pmti = pmt_alloc_low(pshmem, n);
         break;
     case PMTPRI_VF0ADJ:
-        pmti = pmt_alloc_vf0adj(n);
+        pmti = pmt_alloc_vf0adj(pshmem, n);
         break;
     default:
         pciesvc_logerror("pmt_alloc: unknown pri %d\n", pri);
@@ -176,6 +375,9 @@ pmt_alloc(const int n, const int pri)
         break;
     }
 
+    if (pmti < 0) {
+        pmt_allocfail++;
+    }
     return pmti;
 }
 
@@ -217,27 +419,37 @@ spmt_to_pmti(const pciehw_spmt_t *spmt)
 void
 pmt_free(const int pmtb, const int pmtc)
 {
-    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
-    pciehw_spmt_t *spmt;
+    pciehw_shmem_t *pshmem = pmt_shmem_get();
+    pmtmap_t map;
     int pmti;
 
     assert_pmts_in_range(pmtb, pmtc);
 
     if (pmt_to_pri(pmtb + pmtc) == PMTPRI_HIGH) {
-        /* free high pri */
-        for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
-            spmt = pciesvc_spmt_get(pmti);
-            spmt->next = pshmem->freepmt_high;
-            pciesvc_spmt_put(spmt, DIRTY);
-            pshmem->freepmt_high = pmti;
+        /* free high pri, shrink region if we freed the end */
+        pmt_freelist_add(&pshmem->freepmt_high, pmtb, pmtc);
+        pmtmap_build(pshmem, &map);
+        pmti = pshmem->allocpmt_high;
+        while (pmti > 0 && !pmtmap_inuse(&map, pmti - 1)) {
+            pmti--;
+        }
+        if (pmti < pshmem->allocpmt_high) {
+            pmt_freelist_remove(&pshmem->freepmt_high,
+                                pmti, pshmem->allocpmt_high);
+            pshmem->allocpmt_high = pmti;
         }
     } else if (pmt_to_pri(pmtb) == PMTPRI_LOW) {
-        /* free low pri */
-        for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
-            spmt = pciesvc_spmt_get(pmti);
-            spmt->next = pshmem->freepmt_low;
-            pciesvc_spmt_put(spmt, DIRTY);
-            pshmem->freepmt_low = pmti;
+        /* free low pri, shrink region if we freed the start */
+        pmt_freelist_add(&pshmem->freepmt_low, pmtb, pmtc);
+        pmtmap_build(pshmem, &map);
+        pmti = pshmem->allocpmt_low;
+        while (pmti < pmt_count() && !pmtmap_inuse(&map, pmti)) {
+            pmti++;
+        }
+        if (pmti > pshmem->allocpmt_low) {
+            pmt_freelist_remove(&pshmem->freepmt_low,
+                                pshmem->allocpmt_low, pmti);
+            pshmem->allocpmt_low = pmti;
         }
     } else {
         /* outside of both alloc ranges? */
@@ -249,6 +461,41 @@ pmt_free(const int pmtb, const int pmtc)
     }
 }
 
+/*
+ * Report allocator occupancy.  This only reads shmem so it can be
+ * used at any time without disturbing the allocator state.
+ */
+void
+pmt_get_stats(pmt_stats_t *stats)
+{
+    const pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+    pmtmap_t map;
+    int pmti, run;
+
+    pmtmap_build(pshmem, &map);
+
+    pciesvc_memset(stats, 0, sizeof(*stats));
+    stats->count = pmt_count();
+    stats->high = pshmem->pmtpri ? pshmem->allocpmt_high : 0;
+    stats->low = pshmem->pmtpri ? pshmem->allocpmt_low : pmt_count();
+    stats->allocfail = pmt_allocfail;
+    stats->allocfail_frag = pmt_allocfail_frag;
+
+    for (run = 0, pmti = 0; pmti < pmt_count(); pmti++) {
+        if (pmtmap_inuse(&map, pmti)) {
+            stats->inuse++;
+            run = 0;
+            continue;
+        }
+        if (run++ == 0) {
+            stats->free_ranges++;
+        }
+        if (run > stats->free_largest) {
+            stats->free_largest = run;
+        }
+    }
+}
+
 static void
 pmt_get_entry(const int pmti, pmt_entry_t *pmte)
 {
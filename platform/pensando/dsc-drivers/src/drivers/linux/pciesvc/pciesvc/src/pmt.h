@@ -11,6 +11,7 @@ typedef struct pmt_s pmt_t;
 
 void pmt_get(const int pmti, pmt_t *pmt);
 void pmt_set(const int pmti, const pmt_t *pmt);
+void pmt_get_stats(pmt_stats_t *stats);
 
 void pmt_bar_setaddr(pmt_t *pmt, const u_int64_t addr);
 void pmt_bar_setaddrm(pmt_t *pmt, const u_int64_t addr, const u_int64_t mask);
@@ -278,6 +278,18 @@ static ssize_t demo_write_eth_eeprom_data(unsigned int eth_index, char *buf, lof
     /* add vendor codes here */
     return -ENOSYS;
 }
+
+/*
+ * demo_get_eth_bus_id - Used to get the bus or mux segment of port eeprom
+ *
+ * This function returns the segment id, eeproms with different ids are
+ * read concurrently, otherwise it returns a negative value on failed.
+ */
+static int demo_get_eth_bus_id(unsigned int eth_index)
+{
+    /* add vendor codes here */
+    return -ENOSYS;
+}
 /************************************end of transceiver***************************************/
 
 static struct s3ip_sysfs_transceiver_drivers_s drivers = {
@@ -302,6 +314,7 @@ static struct s3ip_sysfs_transceiver_drivers_s drivers = {
     .get_eth_eeprom_size = demo_get_eth_eeprom_size,
     .read_eth_eeprom_data = demo_read_eth_eeprom_data,
     .write_eth_eeprom_data = demo_write_eth_eeprom_data,
+    .get_eth_bus_id = demo_get_eth_bus_id,
 };
 
 static int __init sff_dev_drv_init(void)
@@ -19,8 +19,32 @@ struct s3ip_sysfs_transceiver_drivers_s {
     int (*get_eth_eeprom_size)(unsigned int eth_index);
     ssize_t (*read_eth_eeprom_data)(unsigned int eth_index, char *buf, loff_t offset, size_t count);
     ssize_t (*write_eth_eeprom_data)(unsigned int eth_index, char *buf, loff_t offset, size_t count);
+    /*
+     * Optional, physical bus or mux segment of the port eeprom. Ports with the
+     * same id are read one after the other, different ids are read concurrently.
+     * A negative value, or no hook, gives the port a segment of its own.
+     */
+    int (*get_eth_bus_id)(unsigned int eth_index);
+};
+
+/* Asynchronous eeprom read, see s3ip_sysfs_sff_eeprom_read_submit */
+struct s3ip_sff_eeprom_req {
+    unsigned int eth_index;
+    loff_t offset;
+    size_t count;
+    char *buf;
+    ssize_t ret;                                        /* read length or negative errno */
+    void (*done)(struct s3ip_sff_eeprom_req *req);      /* called from the bus worker */
+    void *data;                                         /* caller data */
+
+    /* private to the transceiver frame */
+    struct list_head list;
+    u64 queued_ns;
+    void *priv;
 };
 
 extern int s3ip_sysfs_sff_drivers_register(struct s3ip_sysfs_transceiver_drivers_s *drv);
 extern void s3ip_sysfs_sff_drivers_unregister(void);
+extern int s3ip_sysfs_sff_eeprom_read_submit(struct s3ip_sff_eeprom_req *req);
+extern int s3ip_sysfs_sff_eeprom_read_batch(struct s3ip_sff_eeprom_req *reqs, int num);
 #endif /*_TRANSCEIVER_SYSFS_H_ */
@@ -9,11 +9,15 @@
  */
 
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
 
 #include "switch.h"
 #include "transceiver_sysfs.h"
 
 static int g_sff_loglevel = 0;
+static int g_sff_eeprom_cache = 1;
 
 #define SFF_INFO(fmt, args...) do {                                        \
     if (g_sff_loglevel & INFO) { \
@@ -33,20 +37,70 @@ static int g_sff_loglevel = 0;
     } \
 } while (0)
 
+/*
+ * Eeprom page cache of a port. The eeprom file is linear, 128 bytes pages:
+ * the lower page, then the upper pages 0, 1, 2 ... (A0 then A2 for SFP).
+ */
+#define SFF_EEPROM_PAGE_SIZE    (128)
+#define SFF_ID_SFP              (0x03)
+
+struct sff_page_s {
+    int valid;
+    char data[SFF_EEPROM_PAGE_SIZE];
+};
+
+struct sff_cache_s {
+    struct mutex lock;
+    unsigned int page_number;
+    struct sff_page_s **page;
+    int present;                    /* last seen presence, -1 if unknown */
+    int id;                         /* identifier byte of the module, -1 if unknown */
+};
+
 struct sff_obj_s {
     struct switch_obj *sff_obj;
     struct bin_attribute bin;
     int sff_creat_bin_flag;
+    struct sff_cache_s cache;
+};
+
+/* eeprom read queue of a bus or mux segment */
+struct sff_bus_s {
+    int bus_id;
+    unsigned int port_number;
+    spinlock_t lock;
+    struct list_head queue;
+    struct work_struct work;
+    unsigned int depth;             /* queued and in flight */
+    unsigned int max_depth;
+    u64 reads;
+    u64 errors;
+    u64 total_lat_ns;
+    u64 max_lat_ns;
+};
+
+struct sff_batch_s {
+    atomic_t pending;
+    struct completion done;
 };
 
 struct sff_s {
     unsigned int sff_number;
     struct sff_obj_s *sff;
+    unsigned int bus_number;
+    struct sff_bus_s *bus;
+    unsigned int *bus_idx;          /* eeprom bus of each port */
 };
 
 static struct sff_s g_sff;
 static struct switch_obj *g_sff_obj = NULL;
 static struct s3ip_sysfs_transceiver_drivers_s *g_sff_drv = NULL;
+static struct workqueue_struct *g_sff_eeprom_wq = NULL;
+static atomic64_t g_sff_cache_hits = ATOMIC64_INIT(0);
+static atomic64_t g_sff_cache_misses = ATOMIC64_INIT(0);
+static atomic64_t g_sff_cache_invalidations = ATOMIC64_INIT(0);
+
+static void sff_cache_present_update(unsigned int eth_index, int present);
 
 static ssize_t transceiver_power_on_show(struct switch_obj *obj, struct switch_attribute *attr,
                    char *buf)
@@ -206,6 +260,9 @@ static ssize_t eth_present_show(struct switch_obj *obj, struct switch_attribute
         SFF_ERR("get eth%u present status failed, ret: %d\n", eth_index, ret);
         return (ssize_t)snprintf(buf, PAGE_SIZE, "%s\n", SYSFS_DEV_ERROR);
     }
+    if (ret > 0) {
+        sff_cache_present_update(eth_index, buf[0] == '1');
+    }
     return ret;
 }
 
@@ -306,6 +363,430 @@ static ssize_t eth_interrupt_show(struct switch_obj *obj, struct switch_attribut
     return ret;
 }
 
+/*
+ * Eeprom reads are queued per bus or mux segment. Each segment is served by
+ * its own work item on an unbound workqueue, so the segments are read
+ * concurrently while the ports of one segment keep going one at a time.
+ */
+static void sff_bus_work(struct work_struct *work)
+{
+    struct sff_bus_s *bus = container_of(work, struct sff_bus_s, work);
+    struct s3ip_sff_eeprom_req *req;
+    u64 lat_ns;
+
+    while (1) {
+        spin_lock(&bus->lock);
+        req = list_first_entry_or_null(&bus->queue, struct s3ip_sff_eeprom_req, list);
+        if (req) {
+            list_del_init(&req->list);
+        }
+        spin_unlock(&bus->lock);
+        if (!req) {
+            break;
+        }
+
+        memset(req->buf, 0, req->count);
+        req->ret = g_sff_drv->read_eth_eeprom_data(req->eth_index, req->buf, req->offset, req->count);
+        lat_ns = ktime_get_ns() - req->queued_ns;
+
+        spin_lock(&bus->lock);
+        bus->depth--;
+        bus->reads++;
+        if (req->ret < 0) {
+            bus->errors++;
+        }
+        bus->total_lat_ns += lat_ns;
+        if (lat_ns > bus->max_lat_ns) {
+            bus->max_lat_ns = lat_ns;
+        }
+        spin_unlock(&bus->lock);
+
+        req->done(req);
+    }
+}
+
+int s3ip_sysfs_sff_eeprom_read_submit(struct s3ip_sff_eeprom_req *req)
+{
+    struct sff_bus_s *bus;
+
+    check_p(g_sff_drv);
+    check_p(g_sff_drv->read_eth_eeprom_data);
+    check_p(g_sff_eeprom_wq);
+    check_p(req->done);
+
+    if (req->eth_index < 1 || req->eth_index > g_sff.sff_number) {
+        SFF_ERR("invalid eth index: %u, eth number: %u\n", req->eth_index, g_sff.sff_number);
+        return -EINVAL;
+    }
+
+    bus = &g_sff.bus[g_sff.bus_idx[req->eth_index - 1]];
+    req->queued_ns = ktime_get_ns();
+    spin_lock(&bus->lock);
+    list_add_tail(&req->list, &bus->queue);
+    bus->depth++;
+    if (bus->depth > bus->max_depth) {
+        bus->max_depth = bus->depth;
+    }
+    spin_unlock(&bus->lock);
+    queue_work(g_sff_eeprom_wq, &bus->work);
+    return 0;
+}
+
+static void sff_batch_req_done(struct s3ip_sff_eeprom_req *req)
+{
+    struct sff_batch_s *batch = req->priv;
+
+    if (atomic_dec_and_test(&batch->pending)) {
+        complete(&batch->done);
+    }
+}
+
+/* Queue all the reads at once and wait for them, returns the number of successful reads */
+int s3ip_sysfs_sff_eeprom_read_batch(struct s3ip_sff_eeprom_req *reqs, int num)
+{
+    struct sff_batch_s batch;
+    int i, ret, ok;
+
+    atomic_set(&batch.pending, 1);
+    init_completion(&batch.done);
+    for (i = 0; i < num; i++) {
+        reqs[i].done = sff_batch_req_done;
+        reqs[i].priv = &batch;
+        atomic_inc(&batch.pending);
+        ret = s3ip_sysfs_sff_eeprom_read_submit(&reqs[i]);
+        if (ret < 0) {
+            reqs[i].ret = ret;
+            atomic_dec(&batch.pending);
+        }
+    }
+    if (!atomic_dec_and_test(&batch.pending)) {
+        wait_for_completion(&batch.done);
+    }
+
+    for (i = 0, ok = 0; i < num; i++) {
+        if (reqs[i].ret >= 0) {
+            ok++;
+        }
+    }
+    return ok;
+}
+
+static ssize_t sff_eeprom_read_sync(unsigned int eth_index, char *buf, loff_t offset, size_t count)
+{
+    struct s3ip_sff_eeprom_req req = {
+        .eth_index = eth_index,
+        .offset = offset,
+        .count = count,
+        .buf = buf,
+    };
+
+    s3ip_sysfs_sff_eeprom_read_batch(&req, 1);
+    return req.ret;
+}
+
+static ssize_t eeprom_stats_show(struct switch_obj *obj, struct switch_attribute *attr, char *buf)
+{
+    struct sff_bus_s *bus;
+    unsigned int i, depth, max_depth;
+    u64 reads, errors, total_lat_ns, max_lat_ns;
+    ssize_t len;
+
+    len = scnprintf(buf, PAGE_SIZE, "bus ports depth max_depth reads errors avg_lat_us max_lat_us\n");
+    for (i = 0; i < g_sff.bus_number; i++) {
+        bus = &g_sff.bus[i];
+        spin_lock(&bus->lock);
+        depth = bus->depth;
+        max_depth = bus->max_depth;
+        reads = bus->reads;
+        errors = bus->errors;
+        total_lat_ns = bus->total_lat_ns;
+        max_lat_ns = bus->max_lat_ns;
+        spin_unlock(&bus->lock);
+
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%d %u %u %u %llu %llu %llu %llu\n",
+            bus->bus_id, bus->port_number, depth, max_depth, reads, errors,
+            reads ? div64_u64(total_lat_ns, reads) / NSEC_PER_USEC : 0,
+            div_u64(max_lat_ns, NSEC_PER_USEC));
+    }
+    return len;
+}
+
+static ssize_t eeprom_stats_store(struct switch_obj *obj, struct switch_attribute *attr,
+                   const char* buf, size_t count)
+{
+    struct sff_bus_s *bus;
+    unsigned int i;
+
+    for (i = 0; i < g_sff.bus_number; i++) {
+        bus = &g_sff.bus[i];
+        spin_lock(&bus->lock);
+        bus->max_depth = bus->depth;
+        bus->reads = 0;
+        bus->errors = 0;
+        bus->total_lat_ns = 0;
+        bus->max_lat_ns = 0;
+        spin_unlock(&bus->lock);
+    }
+    return count;
+}
+
+/*
+ * Eeprom page cache. Only the static upper pages are cached, until the
+ * module is removed or written to: A0 of SFP, page 00h of SFF-8636 and
+ * pages 00h, 01h and 02h of CMIS modules. The lower page and the other
+ * pages hold monitors and clear-on-read flags, reads of them always go
+ * to the module with the caller's offset and length. The presence of a
+ * port is checked on cache misses only.
+ */
+static int sff_cache_page_is_static(struct sff_cache_s *cache, unsigned int page_idx)
+{
+    switch (cache->id) {
+    case SFF_ID_SFP:
+        /* A0 */
+        return page_idx < 2;
+    case 0x0c: /* QSFP */
+    case 0x0d: /* QSFP+ */
+    case 0x11: /* QSFP28 */
+        /* upper page 0 */
+        return page_idx == 1;
+    case 0x18: /* QSFP-DD */
+    case 0x19: /* OSFP */
+    case 0x1e: /* QSFP+ CMIS */
+        /* upper pages 0, 1 and 2 */
+        return (page_idx >= 1) && (page_idx <= 3);
+    default:
+        return 0;
+    }
+}
+
+/* called with the cache lock held */
+static void sff_cache_invalidate(struct sff_cache_s *cache)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->page_number; i++) {
+        if (cache->page[i]) {
+            cache->page[i]->valid = 0;
+        }
+    }
+    cache->id = -1;
+    atomic64_inc(&g_sff_cache_invalidations);
+}
+
+/* called with the cache lock held */
+static void sff_cache_present_set(unsigned int eth_index, struct sff_cache_s *cache, int present)
+{
+    if (cache->present != present) {
+        SFF_DBG("eth%u present %d -> %d, drop eeprom cache\n", eth_index, cache->present, present);
+        sff_cache_invalidate(cache);
+        cache->present = present;
+    }
+}
+
+static void sff_cache_present_update(unsigned int eth_index, int present)
+{
+    struct sff_cache_s *cache;
+
+    if (!g_sff.sff || eth_index < 1 || eth_index > g_sff.sff_number) {
+        return;
+    }
+    cache = &g_sff.sff[eth_index - 1].cache;
+    if (!cache->page) {
+        return;
+    }
+
+    mutex_lock(&cache->lock);
+    sff_cache_present_set(eth_index, cache, present);
+    mutex_unlock(&cache->lock);
+}
+
+/*
+ * Called with the cache lock held, returns 1 if the port is present,
+ * 0 if absent, negative if unknown.
+ */
+static int sff_cache_present_check(unsigned int eth_index, struct sff_cache_s *cache)
+{
+    char status[16];
+    ssize_t ret;
+    int present;
+
+    if (!g_sff_drv->get_eth_present_status) {
+        return -ENOSYS;
+    }
+    ret = g_sff_drv->get_eth_present_status(eth_index, status, sizeof(status));
+    if (ret <= 0) {
+        return -EIO;
+    }
+    present = (status[0] == '1');
+    sff_cache_present_set(eth_index, cache, present);
+    return present;
+}
+
+/* called with the cache lock held, reads the identifier of a present module */
+static void sff_cache_id_update(unsigned int eth_index, struct sff_cache_s *cache)
+{
+    char id;
+
+    if (sff_cache_present_check(eth_index, cache) != 1) {
+        return;
+    }
+    if (sff_eeprom_read_sync(eth_index, &id, 0, 1) == 1) {
+        cache->id = (unsigned char)id;
+    }
+}
+
+/* called with the cache lock held, returns the page or NULL if it is not cached */
+static struct sff_page_s *sff_cache_page_get(unsigned int eth_index, struct sff_cache_s *cache,
+                   unsigned int page_idx)
+{
+    struct sff_page_s *page = cache->page[page_idx];
+    ssize_t ret;
+
+    if (page && page->valid) {
+        atomic64_inc(&g_sff_cache_hits);
+        return page;
+    }
+
+    atomic64_inc(&g_sff_cache_misses);
+    /* the module may have been replaced since the cache was filled */
+    if (sff_cache_present_check(eth_index, cache) != 1 ||
+        !sff_cache_page_is_static(cache, page_idx)) {
+        return NULL;
+    }
+    if (!page) {
+        page = kzalloc(sizeof(struct sff_page_s), GFP_KERNEL);
+        if (!page) {
+            return NULL;
+        }
+        cache->page[page_idx] = page;
+    }
+    ret = sff_eeprom_read_sync(eth_index, page->data, (loff_t)page_idx * SFF_EEPROM_PAGE_SIZE,
+              SFF_EEPROM_PAGE_SIZE);
+    if (ret != SFF_EEPROM_PAGE_SIZE) {
+        return NULL;
+    }
+    page->valid = 1;
+    return page;
+}
+
+static ssize_t sff_eeprom_cache_read(unsigned int eth_index, char *buf, loff_t offset, size_t count)
+{
+    struct sff_cache_s *cache = &g_sff.sff[eth_index - 1].cache;
+    struct sff_page_s *page;
+    unsigned int page_idx, page_off;
+    size_t done, len;
+    ssize_t ret;
+
+    if (!g_sff_eeprom_cache || !cache->page) {
+        return sff_eeprom_read_sync(eth_index, buf, offset, count);
+    }
+
+    mutex_lock(&cache->lock);
+    if (cache->id < 0) {
+        sff_cache_id_update(eth_index, cache);
+    }
+    for (done = 0; done < count; done += len) {
+        page_idx = (offset + done) / SFF_EEPROM_PAGE_SIZE;
+        page_off = (offset + done) % SFF_EEPROM_PAGE_SIZE;
+        len = min_t(size_t, SFF_EEPROM_PAGE_SIZE - page_off, count - done);
+
+        page = NULL;
+        if (page_idx < cache->page_number && sff_cache_page_is_static(cache, page_idx)) {
+            page = sff_cache_page_get(eth_index, cache, page_idx);
+            if (!page) {
+                /* leave the rest to the driver */
+                len = count - done;
+            }
+        } else {
+            /* read up to the next static page from the module */
+            for (len = count - done; page_idx + 1 < cache->page_number; page_idx++) {
+                if (sff_cache_page_is_static(cache, page_idx + 1)) {
+                    len = min_t(size_t, len,
+                        (loff_t)(page_idx + 1) * SFF_EEPROM_PAGE_SIZE - (offset + done));
+                    break;
+                }
+            }
+        }
+        if (page) {
+            memcpy(buf + done, page->data + page_off, len);
+            continue;
+        }
+
+        ret = sff_eeprom_read_sync(eth_index, buf + done, offset + done, len);
+        if (ret < 0) {
+            mutex_unlock(&cache->lock);
+            return done ? done : ret;
+        }
+        if (offset + done == 0 && ret > 0 && cache->id >= 0 &&
+            (unsigned char)buf[0] != cache->id) {
+            /* another module was plugged in */
+            sff_cache_invalidate(cache);
+        }
+        if ((size_t)ret < len) {
+            done += ret;
+            break;
+        }
+    }
+    mutex_unlock(&cache->lock);
+
+    return done;
+}
+
+static void sff_cache_write_invalidate(unsigned int eth_index, loff_t offset, size_t count)
+{
+    struct sff_cache_s *cache = &g_sff.sff[eth_index - 1].cache;
+    unsigned int page_idx, first, last;
+
+    if (!cache->page || count == 0) {
+        return;
+    }
+
+    first = offset / SFF_EEPROM_PAGE_SIZE;
+    last = (offset + count - 1) / SFF_EEPROM_PAGE_SIZE;
+    mutex_lock(&cache->lock);
+    if (first == 0) {
+        /* lower page controls may change the other pages */
+        sff_cache_invalidate(cache);
+    } else {
+        for (page_idx = first; page_idx <= last && page_idx < cache->page_number; page_idx++) {
+            if (cache->page[page_idx]) {
+                cache->page[page_idx]->valid = 0;
+            }
+        }
+    }
+    mutex_unlock(&cache->lock);
+}
+
+static ssize_t eeprom_cache_show(struct switch_obj *obj, struct switch_attribute *attr, char *buf)
+{
+    return (ssize_t)snprintf(buf, PAGE_SIZE, "enable %d\nhits %lld\nmisses %lld\ninvalidations %lld\n",
+        g_sff_eeprom_cache, (long long)atomic64_read(&g_sff_cache_hits),
+        (long long)atomic64_read(&g_sff_cache_misses),
+        (long long)atomic64_read(&g_sff_cache_invalidations));
+}
+
+/* "enable <0|1>", or "clear" for the counters */
+static ssize_t eeprom_cache_store(struct switch_obj *obj, struct switch_attribute *attr,
+                   const char* buf, size_t count)
+{
+    char cmd[16];
+    unsigned int value;
+    int num;
+
+    num = sscanf(buf, "%15s %u", cmd, &value);
+    if (num == 2 && strcmp(cmd, "enable") == 0) {
+        g_sff_eeprom_cache = value ? 1 : 0;
+    } else if (num == 1 && strcmp(cmd, "clear") == 0) {
+        atomic64_set(&g_sff_cache_hits, 0);
+        atomic64_set(&g_sff_cache_misses, 0);
+        atomic64_set(&g_sff_cache_invalidations, 0);
+    } else {
+        SFF_ERR("invalid eeprom cache command: %s\n", buf);
+        return -EINVAL;
+    }
+    return count;
+}
+
 static ssize_t eth_eeprom_read(struct file *filp, struct kobject *kobj, struct bin_attribute *attr,
                    char *buf, loff_t offset, size_t count)
 {
@@ -318,8 +799,7 @@ static ssize_t eth_eeprom_read(struct file *filp, struct kobject *kobj, struct b
 
     eth_obj = to_switch_obj(kobj);
     eth_index = eth_obj->index;
-    memset(buf, 0, count);
-    rd_len = g_sff_drv->read_eth_eeprom_data(eth_index, buf, offset, count);
+    rd_len = sff_eeprom_cache_read(eth_index, buf, offset, count);
     if (rd_len < 0) {
         SFF_ERR("read eth%u eeprom data error, offset: 0x%llx, read len: %lu, ret: %ld.\n",
             eth_index, offset, count, rd_len);
@@ -345,6 +825,7 @@ static ssize_t eth_eeprom_write(struct file *filp, struct kobject *kobj, struct
     eth_obj = to_switch_obj(kobj);
     eth_index = eth_obj->index;
     wr_len = g_sff_drv->write_eth_eeprom_data(eth_index, buf, offset, count);
+    sff_cache_write_invalidate(eth_index, offset, count);
     if (wr_len < 0) {
         SFF_ERR("write eth%u eeprom data error, offset: 0x%llx, read len: %lu, ret: %ld.\n",
             eth_index, offset, count, wr_len);
@@ -385,9 +866,13 @@ static struct attribute_group sff_signal_attr_group = {
 
 /*******************************transceiver dir and attrs*******************************************/
 static struct switch_attribute transceiver_power_on_attr = __ATTR(power_on, S_IRUGO | S_IWUSR, transceiver_power_on_show, transceiver_power_on_store);
+static struct switch_attribute transceiver_eeprom_stats_attr = __ATTR(eeprom_stats, S_IRUGO | S_IWUSR, eeprom_stats_show, eeprom_stats_store);
+static struct switch_attribute transceiver_eeprom_cache_attr = __ATTR(eeprom_cache, S_IRUGO | S_IWUSR, eeprom_cache_show, eeprom_cache_store);
 
 static struct attribute *transceiver_dir_attrs[] = {
     &transceiver_power_on_attr.attr,
+    &transceiver_eeprom_stats_attr.attr,
+    &transceiver_eeprom_cache_attr.attr,
     NULL,
 };
 
@@ -396,6 +881,21 @@ static struct attribute_group sff_transceiver_attr_group = {
 };
 
 /* create eth* eeprom attributes */
+static void sff_cache_free(struct sff_cache_s *cache)
+{
+    unsigned int i;
+
+    if (cache->page) {
+        for (i = 0; i < cache->page_number; i++) {
+            kfree(cache->page[i]);
+        }
+        kfree(cache->page);
+        cache->page = NULL;
+    }
+    cache->page_number = 0;
+    return;
+}
+
 static int sff_sub_single_create_eeprom_attrs(unsigned int index)
 {
     int ret, eeprom_size;
@@ -410,6 +910,16 @@ static int sff_sub_single_create_eeprom_attrs(unsigned int index)
     }
 
     curr_sff = &g_sff.sff[index - 1];
+    mutex_init(&curr_sff->cache.lock);
+    curr_sff->cache.present = -1;
+    curr_sff->cache.id = -1;
+    curr_sff->cache.page_number = DIV_ROUND_UP(eeprom_size, SFF_EEPROM_PAGE_SIZE);
+    curr_sff->cache.page = kcalloc(curr_sff->cache.page_number, sizeof(struct sff_page_s *), GFP_KERNEL);
+    if (!curr_sff->cache.page) {
+        SFF_INFO("eth%u, no memory for the eeprom cache, read through.\n", index);
+        curr_sff->cache.page_number = 0;
+    }
+
     sysfs_bin_attr_init(&curr_sff->bin);
     curr_sff->bin.attr.name = "eeprom";
     curr_sff->bin.attr.mode = 0644;
@@ -420,6 +930,7 @@ static int sff_sub_single_create_eeprom_attrs(unsigned int index)
     ret = sysfs_create_bin_file(&curr_sff->sff_obj->kobj, &curr_sff->bin);
     if (ret) {
         SFF_ERR("eth%u, create eeprom bin error, ret: %d. \n", index, ret);
+        sff_cache_free(&curr_sff->cache);
         return -EBADRQC;
     }
 
@@ -462,6 +973,7 @@ static void sff_sub_single_remove_kobj_and_attrs(unsigned int index)
             sysfs_remove_bin_file(&curr_sff->sff_obj->kobj, &curr_sff->bin);
             curr_sff->sff_creat_bin_flag = 0;
         }
+        sff_cache_free(&curr_sff->cache);
         sysfs_remove_group(&curr_sff->sff_obj->kobj, &sff_signal_attr_group);
         switch_kobject_delete(&curr_sff->sff_obj);
     }
@@ -508,6 +1020,83 @@ error:
     return -EBADRQC;
 }
 
+/*
+ * Group the ports by eeprom bus and create the read queues. A port with
+ * an unknown bus gets a queue of its own.
+ */
+static int sff_bus_create(void)
+{
+    struct sff_bus_s *bus;
+    unsigned int sff_index, i;
+    int bus_id;
+
+    g_sff.bus = kcalloc(g_sff.sff_number, sizeof(struct sff_bus_s), GFP_KERNEL);
+    g_sff.bus_idx = kcalloc(g_sff.sff_number, sizeof(unsigned int), GFP_KERNEL);
+    if (!g_sff.bus || !g_sff.bus_idx) {
+        SFF_ERR("kcalloc g_sff.bus error, sff number = %u.\n", g_sff.sff_number);
+        kfree(g_sff.bus);
+        kfree(g_sff.bus_idx);
+        g_sff.bus = NULL;
+        g_sff.bus_idx = NULL;
+        return -ENOMEM;
+    }
+
+    for (sff_index = 1; sff_index <= g_sff.sff_number; sff_index++) {
+        bus_id = -1;
+        if (g_sff_drv->get_eth_bus_id) {
+            bus_id = g_sff_drv->get_eth_bus_id(sff_index);
+            if (bus_id < 0) {
+                bus_id = -1;
+            }
+        }
+        i = g_sff.bus_number;
+        if (bus_id >= 0) {
+            for (i = 0; i < g_sff.bus_number; i++) {
+                if (g_sff.bus[i].bus_id == bus_id) {
+                    break;
+                }
+            }
+        }
+        bus = &g_sff.bus[i];
+        if (i == g_sff.bus_number) {
+            bus->bus_id = bus_id;
+            spin_lock_init(&bus->lock);
+            INIT_LIST_HEAD(&bus->queue);
+            INIT_WORK(&bus->work, sff_bus_work);
+            g_sff.bus_number++;
+        }
+        bus->port_number++;
+        g_sff.bus_idx[sff_index - 1] = i;
+    }
+
+    g_sff_eeprom_wq = alloc_workqueue("s3ip_sff_eeprom", WQ_UNBOUND, 0);
+    if (!g_sff_eeprom_wq) {
+        SFF_ERR("alloc eeprom workqueue error.\n");
+        kfree(g_sff.bus);
+        kfree(g_sff.bus_idx);
+        g_sff.bus = NULL;
+        g_sff.bus_idx = NULL;
+        g_sff.bus_number = 0;
+        return -ENOMEM;
+    }
+    SFF_DBG("%u eth ports on %u eeprom buses\n", g_sff.sff_number, g_sff.bus_number);
+    return 0;
+}
+
+static void sff_bus_remove(void)
+{
+    if (g_sff_eeprom_wq) {
+        destroy_workqueue(g_sff_eeprom_wq);
+        g_sff_eeprom_wq = NULL;
+    }
+    kfree(g_sff.bus);
+    kfree(g_sff.bus_idx);
+    g_sff.bus = NULL;
+    g_sff.bus_idx = NULL;
+    g_sff.bus_number = 0;
+    return;
+}
+
 /* create eth directory and attributes */
 static int sff_sub_create(void)
 {
@@ -590,9 +1179,18 @@ int s3ip_sysfs_sff_drivers_register(struct s3ip_sysfs_transceiver_drivers_s *drv
         g_sff_drv = NULL;
         return ret;
     }
+    /* the eeprom files read through the queues */
+    ret = sff_bus_create();
+    if (ret < 0) {
+        SFF_ERR("create transceiver eeprom read queues failed, ret: %d\n", ret);
+        sff_transceiver_remove();
+        g_sff_drv = NULL;
+        return ret;
+    }
     ret = sff_sub_create();
     if (ret < 0) {
         SFF_ERR("create transceiver sub dir and attrs failed, ret: %d\n", ret);
+        sff_bus_remove();
         sff_transceiver_remove();
         g_sff_drv = NULL;
         return ret;
@@ -606,6 +1204,7 @@ void s3ip_sysfs_sff_drivers_unregister(void)
     if (g_sff_drv) {
         sff_sub_remove();
         sff_transceiver_remove();
+        sff_bus_remove();
         g_sff_drv = NULL;
         SFF_DBG("s3ip_sysfs_sff_drivers_unregister success.\n");
     }
@@ -614,5 +1213,9 @@ void s3ip_sysfs_sff_drivers_unregister(void)
 
 EXPORT_SYMBOL(s3ip_sysfs_sff_drivers_register);
 EXPORT_SYMBOL(s3ip_sysfs_sff_drivers_unregister);
+EXPORT_SYMBOL(s3ip_sysfs_sff_eeprom_read_submit);
+EXPORT_SYMBOL(s3ip_sysfs_sff_eeprom_read_batch);
 module_param(g_sff_loglevel, int, 0644);
 MODULE_PARM_DESC(g_sff_loglevel, "the log level(info=0x1, err=0x2, dbg=0x4).\n");
+module_param(g_sff_eeprom_cache, int, 0644);
+MODULE_PARM_DESC(g_sff_eeprom_cache, "cache the eeprom pages(disable=0, enable=1).\n");
@@ -6,6 +6,7 @@
  * Copyright (c) 2021 by Cisco Systems, Inc.
  *------------------------------------------------------------------
  */
+#include <chrono>
 #include <mutex>
 #include <string>
 #include <sys/stat.h>
@@ -20,6 +21,8 @@ namespace SSGTest {
 #define IS_MULTI_ASIC(x)  ((x) > 1)
 #define IS_SINGLE_ASIC(x) ((x) <= 1)
 #define NUM_UNIT_FILES 6
+#define NUM_BENCH_UNITS 48
+#define NUM_BENCH_RUNS 5
 
 /*
  * This test class uses following directory hierarchy for input and output
@@ -328,6 +331,125 @@ class SsgMainTest : public SsgFunctionTest {
         validate_depedency_in_unit_file(num_asics);
     }
 
+    /* Bench unit names. Even units are templates, each odd unit depends
+     * on the template before it.
+     */
+    std::string bench_unit_name(int i) {
+        if (i % 2 == 0)
+            return "bench_" + std::to_string(i) + "@.service";
+        return "bench_" + std::to_string(i) + ".service";
+    }
+
+    /* Writes the bench unit files and adds them to generated_services.conf */
+    void generate_bench_units() {
+        FILE* fp = fopen(TEST_CONFIG_FILE.c_str(), "a");
+        ASSERT_NE(fp, nullptr);
+        for (int i = 0; i < NUM_BENCH_UNITS; ++i) {
+            fputs((bench_unit_name(i) + "\n").c_str(), fp);
+        }
+        fclose(fp);
+    }
+
+    /* Restores the unit files and empties the output directory, so every
+     * run starts from a freshly installed image.
+     */
+    void reset_bench_files() {
+        fs::remove_all(fs::path(TEST_UNIT_FILE_PREFIX.c_str()));
+        fs::create_directories(fs::path(TEST_UNIT_FILE_PREFIX.c_str()));
+        copyfiles(TEST_UNIT_FILES.c_str(), TEST_UNIT_FILE_PREFIX.c_str());
+        fs::remove_all(fs::path(TEST_OUTPUT_DIR.c_str()));
+        fs::create_directories(fs::path(TEST_OUTPUT_DIR.c_str()));
+
+        for (int i = 0; i < NUM_BENCH_UNITS; ++i) {
+            FILE* fp = fopen((TEST_UNIT_FILE_PREFIX + bench_unit_name(i)).c_str(), "w");
+            ASSERT_NE(fp, nullptr);
+            fputs("[Unit]\nDescription=Bench service\n", fp);
+            if (i % 2) {
+                fputs(("After=bench_" + std::to_string(i - 1) + ".service"
+                       " single_inst.service\n").c_str(), fp);
+            }
+            fputs("[Service]\nType=oneshot\nExecStart=/bin/true\n", fp);
+            fputs("[Install]\nWantedBy=multi-user.target\n", fp);
+            fclose(fp);
+        }
+    }
+
+    /* Validates the symlinks and dependencies of the bench units */
+    void validate_bench_units(int num_asics) {
+        std::string test_target = "multi-user.target.wants";
+        for (int i = 0; i < NUM_BENCH_UNITS; ++i) {
+            std::string name = "bench_" + std::to_string(i);
+            if (i % 2 == 0) {
+                validate_output_unit_files({name + "@%1%.service"},
+                    test_target, true, num_asics);
+            } else {
+                validate_output_unit_files({name + ".service"},
+                    test_target, true, num_asics);
+                validate_output_dependency_list(
+                    {"After=bench_" + std::to_string(i - 1) + "@%1%.service"},
+                    name + ".service", true, num_asics);
+            }
+        }
+    }
+
+    /* ssg_main benchmark routine. Only ssg_main itself is timed.
+     * input: num_asics    number of asics
+     */
+    void ssg_main_benchmark(int num_asics) {
+        FILE* fp;
+        std::vector<char*> argv_;
+        std::vector<std::string> arguments = {
+                    "ssg_main",
+                    TEST_OUTPUT_DIR.c_str()
+                };
+        std::string num_asic_str = "NUM_ASIC=" + std::to_string(num_asics);
+        double total_us = 0;
+        double best_us = 0;
+
+        std::string unit_file_path = fs::current_path().string() + "/" +TEST_UNIT_FILE_PREFIX;
+        g_unit_file_prefix = unit_file_path.c_str();
+        g_config_file = TEST_CONFIG_FILE.c_str();
+        g_machine_config_file = TEST_MACHINE_CONF.c_str();
+        g_asic_conf_format = TEST_ASIC_CONF_FORMAT.c_str();
+
+        fp = fopen(TEST_ASIC_CONF.c_str(), "w");
+        ASSERT_NE(fp, nullptr);
+        fputs(num_asic_str.c_str(), fp);
+        fclose(fp);
+
+        for (const auto& arg : arguments) {
+            argv_.push_back((char*)arg.data());
+        }
+        argv_.push_back(nullptr);
+
+        generate_bench_units();
+
+        for (int run = 0; run < NUM_BENCH_RUNS; ++run) {
+            reset_bench_files();
+
+            auto start = std::chrono::steady_clock::now();
+            EXPECT_EQ(ssg_main(argv_.size(), argv_.data()), 0);
+            auto end = std::chrono::steady_clock::now();
+
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            total_us += us;
+            if ((run == 0) || (us < best_us))
+                best_us = us;
+        }
+
+        RecordProperty("best_us", std::to_string((long)best_us));
+        RecordProperty("mean_us", std::to_string((long)(total_us / NUM_BENCH_RUNS)));
+        std::cout << "ssg_main " << num_asics << " asics, "
+                  << NUM_UNIT_FILES + NUM_BENCH_UNITS << " units: best "
+                  << (long)best_us << " us, mean "
+                  << (long)(total_us / NUM_BENCH_RUNS) << " us" << std::endl;
+
+        /* Validate the output of the last run */
+        validate_service_file_generated_list(num_asics);
+        validate_depedency_in_unit_file(num_asics);
+        validate_bench_units(num_asics);
+    }
+
     /* Save global variables before running tests */
     virtual void SetUp() {
         SsgFunctionTest::SetUp();
@@ -542,6 +664,11 @@ TEST_F(SsgMainTest, ssg_main_10_npu) {
 TEST_F(SsgMainTest, ssg_main_40_npu) {
     ssg_main_test(40);
 }
+
+/* Benchmark ssg_main() multi(16) asic */
+TEST_F(SsgMainTest, ssg_main_16_npu_benchmark) {
+    ssg_main_benchmark(16);
+}
 }
 
 int main(int argc, char** argv) {
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -13,6 +14,7 @@
 #define MAX_NUM_INSTALL_LINES 48
 #define MAX_NUM_UNITS 128
 #define MAX_BUF_SIZE 512
+#define NAME_SET_INIT_SIZE 64
 
 const char* UNIT_FILE_PREFIX = "/usr/lib/systemd/system/";
 const char* CONFIG_FILE = "/etc/sonic/generated_services.conf";
@@ -39,9 +41,27 @@ const char* get_asic_conf_format() {
     return (g_asic_conf_format) ? g_asic_conf_format : ASIC_CONF_FORMAT;
 }
 
+struct name_set {
+    char** names;
+    int* values;
+    unsigned int size;
+    unsigned int count;
+};
+
+/*
+ * A unit to install and the target directories it is installed in,
+ * collected for every unit before any symlink is created
+ */
+struct unit_install {
+    char* name;
+    int num_targets;
+    char* targets[MAX_NUM_TARGETS];
+};
+
 static int num_asics;
-static char** multi_instance_services;
-static int num_multi_inst;
+static struct name_set multi_instance_services;
+static struct name_set target_dirs;
+static int install_dir_fd = -1;
 
 void strip_trailing_newline(char* str) {
     /***
@@ -53,79 +73,131 @@ void strip_trailing_newline(char* str) {
         str[l-1] = '\0';
 }
 
-
-static int get_target_lines(char* unit_file, char* target_lines[]) {
+/*
+ * Name sets are small open addressing hash tables keyed by name. They hold
+ * the multi instance services and the target directories opened so far, so
+ * a lookup does not scan a list of strings.
+ */
+static unsigned int name_hash(const char* name, size_t len) {
     /***
-    Gets installation information for a given unit file
+    FNV-1a hash of the first len characters of name
+    ***/
+    unsigned int hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 
-    Returns lines in the [Install] section of a unit file
+static unsigned int name_set_slot(const struct name_set* set, const char* name, size_t len) {
+    /***
+    Returns the slot holding name, or the empty slot it belongs to
     ***/
-    FILE *fp;
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t nread;
-    bool found_install;
-    int num_target_lines;
+    unsigned int mask = set->size - 1;
+    unsigned int i = name_hash(name, len) & mask;
 
+    while (set->names[i] != NULL) {
+        if ((strncmp(set->names[i], name, len) == 0) && (set->names[i][len] == '\0'))
+            break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
 
-    fp = fopen(unit_file, "r");
 
-    if (fp == NULL) {
-        fprintf(stderr, "Failed to open file %s\n", unit_file);
+static bool name_set_find(const struct name_set* set, const char* name, size_t len, int* value) {
+    unsigned int i;
+
+    if (set->size == 0)
+        return false;
+
+    i = name_set_slot(set, name, len);
+    if (set->names[i] == NULL)
+        return false;
+
+    if (value != NULL)
+        *value = set->values[i];
+    return true;
+}
+
+
+static int name_set_resize(struct name_set* set, unsigned int size) {
+    struct name_set new_set;
+    unsigned int i, j;
+
+    new_set.names = calloc(size, sizeof(char*));
+    new_set.values = calloc(size, sizeof(int));
+    new_set.size = size;
+    new_set.count = set->count;
+    if ((new_set.names == NULL) || (new_set.values == NULL)) {
+        free(new_set.names);
+        free(new_set.values);
         return -1;
     }
 
-    found_install = false;
-    num_target_lines = 0;
+    for (i = 0; i < set->size; i++) {
+        if (set->names[i] == NULL)
+            continue;
+        j = name_set_slot(&new_set, set->names[i], strlen(set->names[i]));
+        new_set.names[j] = set->names[i];
+        new_set.values[j] = set->values[i];
+    }
 
-    while ((nread = getline(&line, &len, fp)) != -1 ) {
-        // Assumes that [Install] is the last section of the unit file
-        if (strstr(line, "[Install]") != NULL) {
-             found_install = true;
-        }
-        else if (found_install) {
-            if (num_target_lines >= MAX_NUM_INSTALL_LINES) {
-                fprintf(stderr, "Number of lines in [Install] section of %s exceeds MAX_NUM_INSTALL_LINES\n", unit_file);
-                fputs("Extra [Install] lines will be ignored\n", stderr);
-                break;
-            }
-            target_lines[num_target_lines] = strdup(line);
-            num_target_lines++;
-        }
+    free(set->names);
+    free(set->values);
+    *set = new_set;
+    return 0;
+}
+
+
+static int name_set_add(struct name_set* set, const char* name, size_t len, int value) {
+    /***
+    Adds the first len characters of name to the set, or updates its value
+
+    The table is kept at most half full to keep the probe sequences short
+    ***/
+    unsigned int i;
+
+    if ((set->count + 1) * 2 > set->size) {
+        if (name_set_resize(set, set->size ? set->size * 2 : NAME_SET_INIT_SIZE) < 0)
+            return -1;
     }
 
-    free(line);
+    i = name_set_slot(set, name, len);
+    if (set->names[i] == NULL) {
+        set->names[i] = strndup(name, len);
+        if (set->names[i] == NULL)
+            return -1;
+        set->count++;
+    }
+    set->values[i] = value;
+    return 0;
+}
 
-    fclose(fp);
 
-    return num_target_lines;
+static void name_set_clear(struct name_set* set) {
+    for (unsigned int i = 0; i < set->size; i++)
+        free(set->names[i]);
+    free(set->names);
+    free(set->values);
+    memset(set, 0, sizeof(*set));
 }
 
-static bool is_multi_instance_service(char *service_name){
-    int i;
-    for(i=0; i < num_multi_inst; i++){
-        /*
-         * The service name may contain @.service or .service. Remove these
-         * postfixes and extract service name. Compare service name for absolute
-         * match in multi_instance_services[].
-         * This is to prevent services like database-chassis and systemd-timesyncd marked
-         * as multi instance services as they contain strings 'database' and 'syncd' respectively
-         * which are multi instance services in multi_instance_services[].
-         */
-        char *saveptr;
-        char *token = strtok_r(service_name, "@", &saveptr);
-        if (token) {
-            if (strstr(token, ".service") != NULL) {
-                /* If we are here, service_name did not have '@' delimiter but contains '.service' */
-                token = strtok_r(service_name, ".", &saveptr);
-            }
-        }
-        if (strncmp(service_name, multi_instance_services[i], strlen(service_name)) == 0) {
-            return true;
-        }
-    }
-    return false;
 
+static bool is_multi_instance_service(const char* service_name) {
+    /***
+    The service name may contain @.service or .service. Only the name in
+    front of these postfixes is looked up, for an absolute match in
+    multi_instance_services.
+    This is to prevent services like database-chassis and systemd-timesyncd marked
+    as multi instance services as they contain strings 'database' and 'syncd' respectively
+    which are multi instance services.
+    ***/
+    return name_set_find(&multi_instance_services, service_name,
+                         strcspn(service_name, "@."), NULL);
 }
 
 static int get_install_targets_from_line(char* target_string, char* install_type, char* targets[], int existing_targets) {
@@ -174,13 +246,95 @@ static int get_install_targets_from_line(char* target_string, char* install_type
     return num_targets;
 }
 
-static void replace_multi_inst_dep(char *src) {
+static char* read_unit_file(const char* path, size_t* size) {
+    /***
+    Reads a whole unit file into a NUL terminated buffer
+    ***/
+    struct stat st;
+    char* buf;
+    size_t len = 0;
+    ssize_t nread;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    buf = malloc(st.st_size + 1);
+    if (buf == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    while (len < (size_t)st.st_size) {
+        nread = read(fd, buf + len, st.st_size - len);
+        if (nread < 0) {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            close(fd);
+            return NULL;
+        }
+        if (nread == 0)
+            break;
+        len += nread;
+    }
+    close(fd);
+
+    buf[len] = '\0';
+    *size = len;
+    return buf;
+}
+
+
+static int write_unit_file(const char* path, const char* buf, size_t len) {
+    /***
+    Replaces a unit file with the given content through a temporary file
+    ***/
+    FILE *fp;
+    char tmp_file_path[PATH_MAX];
+    int r = 0;
+
+    snprintf(tmp_file_path, PATH_MAX, "%s.tmp", path);
+    fp = fopen(tmp_file_path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", tmp_file_path);
+        return -1;
+    }
+
+    if (fwrite(buf, 1, len, fp) != len)
+        r = -1;
+    if (fclose(fp) != 0)
+        r = -1;
+
+    if ((r == 0) && (rename(tmp_file_path, path) == 0))
+        return 0;
+
+    fprintf(stderr, "Failed to update unit file %s\n", path);
+    remove(tmp_file_path);
+    return -1;
+}
+
+
+static char* replace_multi_inst_dep(char* src, size_t src_len, size_t* len) {
+    /***
+    Rewrites the dependencies of a unit file on multi instance services
+
+    Works on the unit file content in memory and returns the rewritten
+    content, which the caller frees
+    ***/
     FILE *fp_src;
     FILE *fp_tmp;
     char buf[MAX_BUF_SIZE];
     char* line = NULL;
+    char* dst = NULL;
     int i;
-    ssize_t len;
+    size_t line_len = 0;
     char *token;
     char *word;
     char *line_copy;
@@ -190,7 +344,6 @@ static void replace_multi_inst_dep(char *src) {
     char *save_ptr2 = NULL;
     ssize_t nread;
     bool section_done = false;
-    char tmp_file_path[PATH_MAX];
 
     /* Assumes that the service files has 3 sections,
      * in the order: Unit, Service and Install.
@@ -200,11 +353,16 @@ static void replace_multi_inst_dep(char *src) {
      * sections, replace if dependent on multi instance
      * service.
      */
-    fp_src = fopen(src, "r");
-    snprintf(tmp_file_path, PATH_MAX, "%s.tmp", src);
-    fp_tmp = fopen(tmp_file_path, "w");
+    fp_src = fmemopen(src, src_len, "r");
+    if (fp_src == NULL)
+        return NULL;
+    fp_tmp = open_memstream(&dst, len);
+    if (fp_tmp == NULL) {
+        fclose(fp_src);
+        return NULL;
+    }
 
-    while ((nread = getline(&line, &len, fp_src)) != -1 ) {
+    while ((nread = getline(&line, &line_len, fp_src)) != -1 ) {
         if ((strstr(line, "[Service]") != NULL) ||
             (strstr(line, "[Timer]") != NULL)) {
             section_done = true;
@@ -245,76 +403,112 @@ static void replace_multi_inst_dep(char *src) {
         }
     }
     fclose(fp_src);
-    fclose(fp_tmp);
     free(line);
-    /* remove the .service file, rename the .service.tmp file
-     * as .service.
-     */
-    remove(src);
-    rename(tmp_file_path, src);
+
+    if (fclose(fp_tmp) != 0) {
+        free(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+
+static int get_install_targets_from_buffer(char* buf, char* unit_file, char* targets[]) {
+    /***
+    Parses the lines in the [Install] section of unit file content
+    ***/
+    char* line;
+    char* rest;
+    char* token;
+    char* saveptr;
+    char* target_suffix;
+    bool found_install = false;
+    int num_target_lines = 0;
+    int num_targets = 0;
+
+    for (line = strtok_r(buf, "\n", &saveptr); line != NULL;
+         line = strtok_r(NULL, "\n", &saveptr)) {
+        // Assumes that [Install] is the last section of the unit file
+        if (strstr(line, "[Install]") != NULL) {
+            found_install = true;
+            continue;
+        }
+        if (!found_install)
+            continue;
+
+        if (num_target_lines >= MAX_NUM_INSTALL_LINES) {
+            fprintf(stderr, "Number of lines in [Install] section of %s exceeds MAX_NUM_INSTALL_LINES\n", unit_file);
+            fputs("Extra [Install] lines will be ignored\n", stderr);
+            break;
+        }
+        num_target_lines++;
+
+        rest = line;
+        token = strtok_r(rest, "=", &rest);
+        if (token == NULL)
+            continue;
+
+        if (strstr(token, "RequiredBy") != NULL) {
+            target_suffix = ".requires";
+        }
+        else if (strstr(token, "WantedBy") != NULL) {
+            target_suffix = ".wants";
+        }
+        else {
+            continue;
+        }
+
+        while ((token = strtok_r(rest, "=", &rest))) {
+            num_targets += get_install_targets_from_line(token, target_suffix, targets, num_targets);
+        }
+    }
+    return num_targets;
 }
 
+
 int get_install_targets(char* unit_file, char* targets[]) {
     /***
     Returns install targets for a unit file
 
     Parses the information in the [Install] section of a given
     unit file to determine which directories to install the unit in
+
+    The unit file is read once. Dependencies on multi instance services
+    are rewritten in memory, and the file is only written back if the
+    rewrite changed it
     ***/
     char file_path[PATH_MAX];
-    char *target_lines[MAX_NUM_INSTALL_LINES];
-    int num_target_lines;
+    char* buf;
+    char* new_buf;
+    size_t len;
+    size_t new_len;
     int num_targets;
-    int found_targets;
-    char* token;
-    char* line = NULL;
-    bool first;
-    char* target_suffix;
-    char *instance_name;
-    char *dot_ptr;
-
-    strcpy(file_path, get_unit_file_prefix());
-    strcat(file_path, unit_file);
 
-    instance_name = strdup(unit_file);
-    dot_ptr = strchr(instance_name, '.');
-    *dot_ptr = '\0';
+    snprintf(file_path, PATH_MAX, "%s%s", get_unit_file_prefix(), unit_file);
 
-    if((num_asics > 1) && (!is_multi_instance_service(instance_name))) {
-        replace_multi_inst_dep(file_path);
-    }
-    free(instance_name);
-
-    num_target_lines = get_target_lines(file_path, target_lines);
-    if (num_target_lines < 0) {
+    buf = read_unit_file(file_path, &len);
+    if (buf == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", file_path);
         fprintf(stderr, "Error parsing targets for %s\n", unit_file);
         return -1;
     }
 
-    num_targets = 0;
-
-    for (int i = 0; i < num_target_lines; i++) {
-        line = target_lines[i];
-        first = true;
-
-        while ((token = strtok_r(line, "=", &line))) {
-            if (first) {
-                first = false;
-
-                if (strstr(token, "RequiredBy") != NULL) {
-                    target_suffix = ".requires";
-                }
-                else if (strstr(token, "WantedBy") != NULL) {
-                    target_suffix = ".wants";
-                }
-            }
-            else {
-                found_targets = get_install_targets_from_line(token, target_suffix, targets, num_targets);
-                num_targets += found_targets;
-            }
+    if ((num_asics > 1) && (len > 0) && (!is_multi_instance_service(unit_file))) {
+        new_buf = replace_multi_inst_dep(buf, len, &new_len);
+        if (new_buf == NULL) {
+            fprintf(stderr, "Failed to replace multi instance dependencies of %s\n", unit_file);
+        }
+        else {
+            if ((new_len != len) || (memcmp(new_buf, buf, len) != 0))
+                write_unit_file(file_path, new_buf, new_len);
+            free(buf);
+            buf = new_buf;
         }
-        free(target_lines[i]);
     }
+
+    num_targets = get_install_targets_from_buffer(buf, unit_file, targets);
+    free(buf);
+
     return num_targets;
 }
 
@@ -338,9 +532,8 @@ int get_unit_files(char* unit_files[]) {
     }
 
     int num_unit_files = 0;
-    num_multi_inst = 0;
 
-    multi_instance_services = calloc(MAX_NUM_UNITS, sizeof(char *));
+    name_set_clear(&multi_instance_services);
 
     while ((read = getline(&line, &len, fp)) != -1) {
         if (num_unit_files >= MAX_NUM_UNITS) {
@@ -352,9 +545,8 @@ int get_unit_files(char* unit_files[]) {
         /* Get the multi-instance services */
         pos = strchr(line, '@');
         if (pos != NULL) {
-            multi_instance_services[num_multi_inst] = calloc(strlen(line), sizeof(char));
-            strncpy(multi_instance_services[num_multi_inst], line, pos-line);
-            num_multi_inst++;
+            if (name_set_add(&multi_instance_services, line, pos - line, 0) < 0)
+                fprintf(stderr, "Failed to add multi instance service %s\n", line);
         }
 
         /* topology service to be started only for multiasic VS platform */
@@ -405,78 +597,108 @@ char* insert_instance_number(char* unit_file, int instance) {
 }
 
 
-static int create_symlink(char* unit, char* target, char* install_dir, int instance) {
+static int open_target_dir(char* target) {
+    /***
+    Returns a directory fd for a target directory in the installation directory
+
+    The directory is created or fixed up on first use, and the fd is kept
+    for the other units installed in the same target
+    ***/
     struct stat st;
-    char src_path[PATH_MAX];
-    char dest_path[PATH_MAX];
-    char final_install_dir[PATH_MAX];
-    char* unit_instance;
+    int fd;
     int r;
 
-    strcpy(src_path, get_unit_file_prefix());
-    strcat(src_path, unit);
-
-    if (instance < 0) {
-        unit_instance = strdup(unit);
-    }
-    else {
-        unit_instance = insert_instance_number(unit, instance);
-    }
-
-    strcpy(final_install_dir, install_dir);
-    strcat(final_install_dir, target);
-    strcpy(dest_path, final_install_dir);
-    strcat(dest_path, "/");
-    strcat(dest_path, unit_instance);
+    if (name_set_find(&target_dirs, target, strlen(target), &fd))
+        return fd;
 
-    free(unit_instance);
-
-    if (stat(final_install_dir, &st) == -1) {
+    r = fstatat(install_dir_fd, target, &st, 0);
+    if (r == -1) {
         // If doesn't exist, create
-        r = mkdir(final_install_dir, 0755);
-        if (r == -1) {
-            fprintf(stderr, "Unable to create target directory %s\n", final_install_dir);
-            return -1;
-        }
+        r = mkdirat(install_dir_fd, target, 0755);
+        if (r == -1)
+            fprintf(stderr, "Unable to create target directory %s\n", target);
     }
     else if (S_ISREG(st.st_mode)) {
         // If is regular file, remove and create
-        r = remove(final_install_dir);
+        r = unlinkat(install_dir_fd, target, 0);
         if (r == -1) {
-            fprintf(stderr, "Unable to remove file with same name as target directory %s\n", final_install_dir);
-            return -1;
+            fprintf(stderr, "Unable to remove file with same name as target directory %s\n", target);
         }
-
-        r = mkdir(final_install_dir, 0755);
-        if (r == -1) {
-            fprintf(stderr, "Unable to create target directory %s\n", final_install_dir);
-            return -1;
+        else {
+            r = mkdirat(install_dir_fd, target, 0755);
+            if (r == -1)
+                fprintf(stderr, "Unable to create target directory %s\n", target);
         }
     }
     else if (S_ISDIR(st.st_mode)) {
         // If directory, verify correct permissions
-        r = chmod(final_install_dir, 0755);
-        if (r == -1) {
-            fprintf(stderr, "Unable to change permissions of existing target directory %s\n", final_install_dir);
-            return -1;
-        }
+        r = fchmodat(install_dir_fd, target, 0755, 0);
+        if (r == -1)
+            fprintf(stderr, "Unable to change permissions of existing target directory %s\n", target);
     }
 
-    r = symlink(src_path, dest_path);
+    fd = -1;
+    if (r != -1) {
+        fd = openat(install_dir_fd, target, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            fprintf(stderr, "Unable to open target directory %s\n", target);
+    }
 
-    if (r < 0) {
-        if (errno == EEXIST)
-            return 0;
-        fprintf(stderr, "Error creating symlink %s from source %s\n", dest_path, src_path);
+    /* Failures are remembered too, so they are reported once per target */
+    if (name_set_add(&target_dirs, target, strlen(target), fd) < 0) {
+        if (fd >= 0)
+            close(fd);
         return -1;
     }
+    return fd;
+}
+
+
+static void close_target_dirs(void) {
+    for (unsigned int i = 0; i < target_dirs.size; i++) {
+        if ((target_dirs.names[i] != NULL) && (target_dirs.values[i] >= 0))
+            close(target_dirs.values[i]);
+    }
+    name_set_clear(&target_dirs);
+}
+
+
+static int create_symlink(char* unit, char* target, int instance) {
+    char src_path[PATH_MAX];
+    char* unit_instance;
+    int dir_fd;
+    int r;
+
+    dir_fd = open_target_dir(target);
+    if (dir_fd < 0)
+        return -1;
+
+    snprintf(src_path, PATH_MAX, "%s%s", get_unit_file_prefix(), unit);
 
+    if (instance < 0) {
+        unit_instance = strdup(unit);
+    }
+    else {
+        unit_instance = insert_instance_number(unit, instance);
+    }
+    if (unit_instance == NULL)
+        return -1;
+
+    r = symlinkat(src_path, dir_fd, unit_instance);
+
+    if ((r < 0) && (errno != EEXIST)) {
+        fprintf(stderr, "Error creating symlink %s/%s from source %s\n", target, unit_instance, src_path);
+        free(unit_instance);
+        return -1;
+    }
+
+    free(unit_instance);
     return 0;
 
 }
 
 
-static int install_unit_file(char* unit_file, char* target, char* install_dir) {
+static int install_unit_file(char* unit_file, char* target) {
     /***
     Creates a symlink for a unit file installation
 
@@ -488,8 +710,6 @@ static int install_unit_file(char* unit_file, char* target, char* install_dir) {
     services as well
     ***/
     char* target_instance;
-    char* prefix;
-    char* suffix;
     int r;
 
     assert(unit_file);
@@ -506,8 +726,10 @@ static int install_unit_file(char* unit_file, char* target, char* install_dir) {
             else {
                 target_instance = strdup(target);
             }
+            if (target_instance == NULL)
+                continue;
 
-            r = create_symlink(unit_file, target_instance, install_dir, i);
+            r = create_symlink(unit_file, target_instance, i);
             if (r < 0)
                 fprintf(stderr, "Error installing %s for target %s\n", unit_file, target_instance);
 
@@ -516,7 +738,7 @@ static int install_unit_file(char* unit_file, char* target, char* install_dir) {
         }
     }
     else {
-        r = create_symlink(unit_file, target, install_dir, -1);
+        r = create_symlink(unit_file, target, -1);
         if (r < 0)
             fprintf(stderr, "Error installing %s for target %s\n", unit_file, target);
     }
@@ -584,63 +806,73 @@ int get_num_of_asic() {
 
 int ssg_main(int argc, char **argv) {
     char* unit_files[MAX_NUM_UNITS];
-    char install_dir[PATH_MAX];
-    char* targets[MAX_NUM_TARGETS];
+    struct unit_install* units;
+    struct unit_install* unit;
     char* unit_instance;
-    char* prefix;
-    char* suffix;
-    char* saveptr;
+    char* pos;
     int num_unit_files;
-    int num_targets;
-    int r;
+    int num_units = 0;
 
     if (argc <= 1) {
         fputs("Installation directory required as argument\n", stderr);
         return 1;
     }
 
+    install_dir_fd = open(argv[1], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (install_dir_fd < 0) {
+        fprintf(stderr, "Failed to open installation directory %s\n", argv[1]);
+        return 1;
+    }
+
     num_asics = get_num_of_asic();
-    strcpy(install_dir, argv[1]);
-    strcat(install_dir, "/");
     num_unit_files = get_unit_files(unit_files);
 
-    // For each unit file, get the installation targets and install the unit
-    for (int i = 0; i < num_unit_files; i++) {
-        unit_instance = strdup(unit_files[i]);
-        if ((num_asics == 1) && strstr(unit_instance, "@") != NULL) {
-            prefix = strdup(strtok_r(unit_instance, "@", &saveptr));
-            suffix = strdup(strtok_r(NULL, "@", &saveptr));
-
-            strcpy(unit_instance, prefix);
-            strcat(unit_instance, suffix);
+    units = calloc(MAX_NUM_UNITS, sizeof(struct unit_install));
+    if (units == NULL) {
+        fputs("Failed to allocate unit list\n", stderr);
+        for (int i = 0; i < num_unit_files; i++)
+            free(unit_files[i]);
+        name_set_clear(&multi_instance_services);
+        close(install_dir_fd);
+        install_dir_fd = -1;
+        return 1;
+    }
 
-            free(prefix);
-            free(suffix);
+    // Parse every unit file once, before anything is installed
+    for (int i = 0; i < num_unit_files; i++) {
+        unit_instance = unit_files[i];
+        if ((num_asics == 1) && ((pos = strchr(unit_instance, '@')) != NULL)) {
+            memmove(pos, pos + 1, strlen(pos + 1) + 1);
         }
 
-        num_targets = get_install_targets(unit_instance, targets);
-        if (num_targets < 0) {
+        unit = &units[num_units];
+        unit->num_targets = get_install_targets(unit_instance, unit->targets);
+        if (unit->num_targets < 0) {
             fprintf(stderr, "Error parsing %s\n", unit_instance);
             free(unit_instance);
-            free(unit_files[i]);
             continue;
         }
+        unit->name = unit_instance;
+        num_units++;
+    }
 
-        for (int j = 0; j < num_targets; j++) {
-            if (install_unit_file(unit_instance, targets[j], install_dir) != 0)
-                fprintf(stderr, "Error installing %s to target directory %s\n", unit_instance, targets[j]);
+    // Install every unit in its targets
+    for (int i = 0; i < num_units; i++) {
+        unit = &units[i];
+        for (int j = 0; j < unit->num_targets; j++) {
+            if (install_unit_file(unit->name, unit->targets[j]) != 0)
+                fprintf(stderr, "Error installing %s to target directory %s\n", unit->name, unit->targets[j]);
 
-            free(targets[j]);
+            free(unit->targets[j]);
         }
-
-        free(unit_instance);
-        free(unit_files[i]);
+        free(unit->name);
     }
 
-    for (int i = 0; i < num_multi_inst; i++) {
-        free(multi_instance_services[i]);
-    }
-    free(multi_instance_services);
+    free(units);
+    close_target_dirs();
+    name_set_clear(&multi_instance_services);
+    close(install_dir_fd);
+    install_dir_fd = -1;
 
     return 0;
 }